@@ -0,0 +1,39 @@
+/**
+* @file codetab.h
+* @brief Orion++ code table record layout
+*
+* See docs/orion++/FORMAT.md, "Code". Every record is 4-byte aligned so a
+* mapped table can be read in place.
+*/
+
+#ifndef ORIONPP_CODETAB_H
+#define ORIONPP_CODETAB_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Counts a streaming writer could not know up front; readers count the records themselves
+#define ORIONPP_CODE_UNCOUNTED UINT32_MAX
+
+// Payloads are zero-padded to keep the next record aligned
+#define ORIONPP_CODE_ALIGN(n) (((n) + 3) & ~(size_t)3)
+
+typedef struct orionpp_code_table {
+  uint32_t instruction_count;
+  uint32_t value_count; // operands across all instructions
+} orionpp_code_table_t;
+
+typedef struct orionpp_code_record {
+  uint8_t root;
+  uint8_t child;
+  uint16_t value_count; // operands that follow
+} orionpp_code_record_t;
+
+typedef struct orionpp_code_value {
+  uint8_t root;
+  uint8_t child;
+  uint16_t reserved;
+  uint32_t bytesize; // followed by the payload
+} orionpp_code_value_t;
+
+#endif // ORIONPP_CODETAB_H
@@ -22,6 +22,8 @@ enum orionpp_error {
   ORIONPP_ERROR_INVALID_MAGIC,
   ORIONPP_ERROR_INVALID_VERSION,
   ORIONPP_ERROR_UNSUPPORTED_FEATURE,
+  ORIONPP_ERROR_IO,
+  ORIONPP_ERROR_UNEXPECTED_EOF,
   ORIONPP_ERROR_UNKNOWN
 };
 
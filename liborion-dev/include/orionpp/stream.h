@@ -0,0 +1,110 @@
+/**
+* @file stream.h
+* @brief Buffered reader and writer for Orion++ files
+*
+* Streams move data between a file handle and one block buffer so that
+* encoding or decoding a module costs a handful of system calls instead of
+* several per instruction.
+*/
+
+#ifndef ORIONPP_STREAM_H
+#define ORIONPP_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <orionpp/error.h>
+#include <orionpp/codetab.h>
+
+#ifdef WIN32
+typedef void *orionpp_handle_t; // HANDLE
+#else
+typedef int orionpp_handle_t; // file descriptor
+#endif
+
+#define ORIONPP_STREAM_DEFAULT_BUFFER (64 * 1024)
+
+typedef enum orionpp_stream_mode {
+  ORIONPP_STREAM_READER,
+  ORIONPP_STREAM_WRITER
+} orionpp_stream_mode_t;
+
+typedef struct orionpp_stream {
+  orionpp_handle_t handle; // not owned; closing the stream leaves it open
+  orionpp_stream_mode_t mode;
+  orionpp_byte_t *buffer;
+  size_t capacity;
+  size_t head; // reader: next unread byte
+  size_t tail; // reader: end of buffered data, writer: bytes pending
+  uint64_t offset; // bytes consumed or produced through the stream
+  uint64_t syscalls; // reads or writes issued on the handle
+  bool eof;
+  orionpp_error_t error; // first failure; later calls return it unchanged
+} orionpp_stream_t;
+
+/**
+* @brief Open a buffered reader on a handle
+* @param stream Stream to initialize
+* @param handle Handle positioned where reading starts
+* @param buffer_size Buffer size in bytes, 0 for ORIONPP_STREAM_DEFAULT_BUFFER
+* @return Error code
+*/
+orionpp_error_t orionpp_stream_reader(orionpp_stream_t *stream, orionpp_handle_t handle, size_t buffer_size);
+
+/**
+* @brief Open a buffered writer on a handle
+* @param stream Stream to initialize
+* @param handle Handle positioned where writing starts
+* @param buffer_size Buffer size in bytes, 0 for ORIONPP_STREAM_DEFAULT_BUFFER
+* @return Error code
+*/
+orionpp_error_t orionpp_stream_writer(orionpp_stream_t *stream, orionpp_handle_t handle, size_t buffer_size);
+
+/**
+* @brief Read exactly size bytes
+* @return ORIONPP_ERROR_UNEXPECTED_EOF if the handle ends first
+*/
+orionpp_error_t orionpp_stream_read(orionpp_stream_t *stream, void *data, size_t size);
+
+/**
+* @brief Read everything up to end of file into one allocation
+* @param data Receives a malloc'd buffer the caller frees
+* @param size Receives the number of bytes read
+* @return Error code
+*/
+orionpp_error_t orionpp_stream_read_all(orionpp_stream_t *stream, orionpp_byte_t **data, size_t *size);
+
+/**
+* @brief Append bytes, writing the buffer out whenever it fills. Writing
+* nothing succeeds without touching data, which may then be NULL.
+*/
+orionpp_error_t orionpp_stream_write(orionpp_stream_t *stream, const void *data, size_t size);
+
+/**
+* @brief Write out pending bytes of a writer
+*/
+orionpp_error_t orionpp_stream_flush(orionpp_stream_t *stream);
+
+/**
+* @brief Flush a writer and release the buffer; the handle stays open
+* @return First error the stream saw, including on the final flush
+*/
+orionpp_error_t orionpp_stream_close(orionpp_stream_t *stream);
+
+/**
+* @brief Write a file header followed by the code table header
+* @param table Counts, or ORIONPP_CODE_UNCOUNTED when they are not known yet
+*/
+orionpp_error_t orionpp_stream_write_image_header(orionpp_stream_t *stream, const orionpp_code_table_t *table);
+
+/**
+* @brief Write an instruction record; its value_count operands must follow
+*/
+orionpp_error_t orionpp_stream_write_record(orionpp_stream_t *stream, uint8_t root, uint8_t child, uint16_t value_count);
+
+/**
+* @brief Write an operand with its payload padded to the record alignment
+*/
+orionpp_error_t orionpp_stream_write_value(orionpp_stream_t *stream, uint8_t root, uint8_t child, const void *bytes, uint32_t bytesize);
+
+#endif // ORIONPP_STREAM_H
@@ -18,6 +18,8 @@ static const char *error_messages[] = {
   "INVALID_MAGIC",
   "INVALID_VERSION",
   "UNSUPPORTED_FEATURE",
+  "IO",
+  "UNEXPECTED_EOF",
   "UNKNOWN"
 };
 
@@ -23,7 +23,7 @@ orionpp_error_t orionpp_header_init(orionpp_header_t *header) {
   header->patch = version_patch;
   header->features = 0;
   header->typetab = 0;
-  header->abitab = 0;
+  header->datatab = 0;
   header->extrntab = 0;
   header->intrntab = 0;
   header->strtab = 0;
@@ -0,0 +1,221 @@
+/**
+* @file stream.c
+* @brief Buffered stream implementation
+*/
+
+#include "orionpp/stream.h"
+#include "orionpp/header.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+  #include <windows.h>
+#else
+  #include <errno.h>
+  #include <unistd.h>
+#endif
+
+// One read on the handle; returns bytes read, 0 at end of file, -1 on error
+static long long raw_read(orionpp_stream_t *stream, void *data, size_t size) {
+  stream->syscalls++;
+#ifdef WIN32
+  DWORD chunk = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+  DWORD got = 0;
+  if (!ReadFile(stream->handle, data, chunk, &got, NULL)) {
+    return GetLastError() == ERROR_BROKEN_PIPE ? 0 : -1;
+  }
+  return got;
+#else
+  ssize_t got;
+  do {
+    got = read(stream->handle, data, size);
+  } while (got < 0 && errno == EINTR);
+  return got;
+#endif
+}
+
+// Writes all of data, looping over short writes
+static orionpp_error_t raw_write(orionpp_stream_t *stream, const orionpp_byte_t *data, size_t size) {
+  while (size > 0) {
+    stream->syscalls++;
+#ifdef WIN32
+    DWORD chunk = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+    DWORD put = 0;
+    if (!WriteFile(stream->handle, data, chunk, &put, NULL)) return ORIONPP_ERROR_IO;
+#else
+    ssize_t put = write(stream->handle, data, size);
+    if (put < 0 && errno == EINTR) continue;
+    if (put <= 0) return ORIONPP_ERROR_IO;
+#endif
+    data += put;
+    size -= (size_t)put;
+  }
+  return ORIONPP_ERROR_GOOD;
+}
+
+static orionpp_error_t stream_open(orionpp_stream_t *stream, orionpp_handle_t handle, size_t buffer_size, orionpp_stream_mode_t mode) {
+  if (!stream) return ORIONPP_ERROR_INVALID_ARGUMENT;
+  
+  memset(stream, 0, sizeof(*stream));
+  stream->handle = handle;
+  stream->mode = mode;
+  stream->capacity = buffer_size ? buffer_size : ORIONPP_STREAM_DEFAULT_BUFFER;
+  stream->buffer = malloc(stream->capacity);
+  if (!stream->buffer) {
+    stream->error = ORIONPP_ERROR_NOMEM;
+    return ORIONPP_ERROR_NOMEM;
+  }
+  return ORIONPP_ERROR_GOOD;
+}
+
+orionpp_error_t orionpp_stream_reader(orionpp_stream_t *stream, orionpp_handle_t handle, size_t buffer_size) {
+  return stream_open(stream, handle, buffer_size, ORIONPP_STREAM_READER);
+}
+
+orionpp_error_t orionpp_stream_writer(orionpp_stream_t *stream, orionpp_handle_t handle, size_t buffer_size) {
+  return stream_open(stream, handle, buffer_size, ORIONPP_STREAM_WRITER);
+}
+
+orionpp_error_t orionpp_stream_read(orionpp_stream_t *stream, void *data, size_t size) {
+  if (!stream || stream->mode != ORIONPP_STREAM_READER) return ORIONPP_ERROR_INVALID_ARGUMENT;
+  if (stream->error) return stream->error;
+  
+  orionpp_byte_t *out = data;
+  while (size > 0) {
+    size_t buffered = stream->tail - stream->head;
+    if (buffered > 0) {
+      size_t take = buffered < size ? buffered : size;
+      memcpy(out, stream->buffer + stream->head, take);
+      stream->head += take;
+      stream->offset += take;
+      out += take;
+      size -= take;
+      continue;
+    }
+    if (stream->eof) return stream->error = ORIONPP_ERROR_UNEXPECTED_EOF;
+  
+    // Large requests bypass the buffer; small ones refill it
+    long long got;
+    if (size >= stream->capacity) {
+      got = raw_read(stream, out, size);
+      if (got > 0) {
+        stream->offset += (uint64_t)got;
+        out += got;
+        size -= (size_t)got;
+      }
+    } else {
+      got = raw_read(stream, stream->buffer, stream->capacity);
+      stream->head = 0;
+      stream->tail = got > 0 ? (size_t)got : 0;
+    }
+    if (got < 0) return stream->error = ORIONPP_ERROR_IO;
+    if (got == 0) stream->eof = true;
+  }
+  return ORIONPP_ERROR_GOOD;
+}
+
+orionpp_error_t orionpp_stream_read_all(orionpp_stream_t *stream, orionpp_byte_t **data, size_t *size) {
+  if (!stream || !data || !size || stream->mode != ORIONPP_STREAM_READER) return ORIONPP_ERROR_INVALID_ARGUMENT;
+  if (stream->error) return stream->error;
+  
+  // Start from what is already buffered, then read straight into the result
+  size_t length = stream->tail - stream->head;
+  size_t capacity = stream->capacity > length * 2 ? stream->capacity : length * 2;
+  orionpp_byte_t *result = malloc(capacity);
+  if (!result) return stream->error = ORIONPP_ERROR_NOMEM;
+  memcpy(result, stream->buffer + stream->head, length);
+  stream->head = stream->tail = 0;
+  
+  while (!stream->eof) {
+    if (length == capacity) {
+      orionpp_byte_t *grown = realloc(result, capacity * 2);
+      if (!grown) {
+        free(result);
+        return stream->error = ORIONPP_ERROR_NOMEM;
+      }
+      result = grown;
+      capacity *= 2;
+    }
+    long long got = raw_read(stream, result + length, capacity - length);
+    if (got < 0) {
+      free(result);
+      return stream->error = ORIONPP_ERROR_IO;
+    }
+    if (got == 0) stream->eof = true;
+    length += (size_t)got;
+  }
+  
+  stream->offset += length;
+  *data = result;
+  *size = length;
+  return ORIONPP_ERROR_GOOD;
+}
+
+orionpp_error_t orionpp_stream_write(orionpp_stream_t *stream, const void *data, size_t size) {
+  if (!stream || stream->mode != ORIONPP_STREAM_WRITER) return ORIONPP_ERROR_INVALID_ARGUMENT;
+  if (stream->error) return stream->error;
+  if (size == 0) return ORIONPP_ERROR_GOOD; // data may be NULL then
+  
+  if (stream->tail + size > stream->capacity) {
+    if (orionpp_stream_flush(stream) != ORIONPP_ERROR_GOOD) return stream->error;
+  
+    // Too big to ever fit: hand it to the handle directly
+    if (size >= stream->capacity) {
+      stream->error = raw_write(stream, data, size);
+      if (stream->error == ORIONPP_ERROR_GOOD) stream->offset += size;
+      return stream->error;
+    }
+  }
+  
+  memcpy(stream->buffer + stream->tail, data, size);
+  stream->tail += size;
+  stream->offset += size;
+  return ORIONPP_ERROR_GOOD;
+}
+
+orionpp_error_t orionpp_stream_flush(orionpp_stream_t *stream) {
+  if (!stream) return ORIONPP_ERROR_INVALID_ARGUMENT;
+  if (stream->error || stream->mode != ORIONPP_STREAM_WRITER || stream->tail == 0) return stream->error;
+  
+  stream->error = raw_write(stream, stream->buffer, stream->tail);
+  stream->tail = 0;
+  return stream->error;
+}
+
+orionpp_error_t orionpp_stream_close(orionpp_stream_t *stream) {
+  if (!stream) return ORIONPP_ERROR_INVALID_ARGUMENT;
+  
+  orionpp_stream_flush(stream);
+  free(stream->buffer);
+  stream->buffer = NULL;
+  stream->capacity = 0;
+  stream->head = stream->tail = 0;
+  return stream->error;
+}
+
+orionpp_error_t orionpp_stream_write_image_header(orionpp_stream_t *stream, const orionpp_code_table_t *table) {
+  if (!table) return ORIONPP_ERROR_INVALID_ARGUMENT;
+  
+  static const orionpp_byte_t padding[4] = { 0 };
+  orionpp_header_t header;
+  orionpp_header_init(&header);
+  header.codetab = ORIONPP_CODE_ALIGN(sizeof(header));
+  
+  orionpp_stream_write(stream, &header, sizeof(header));
+  orionpp_stream_write(stream, padding, header.codetab - sizeof(header));
+  return orionpp_stream_write(stream, table, sizeof(*table));
+}
+
+orionpp_error_t orionpp_stream_write_record(orionpp_stream_t *stream, uint8_t root, uint8_t child, uint16_t value_count) {
+  orionpp_code_record_t record = { root, child, value_count };
+  return orionpp_stream_write(stream, &record, sizeof(record));
+}
+
+orionpp_error_t orionpp_stream_write_value(orionpp_stream_t *stream, uint8_t root, uint8_t child, const void *bytes, uint32_t bytesize) {
+  static const orionpp_byte_t padding[4] = { 0 };
+  orionpp_code_value_t value = { root, child, 0, bytesize };
+  
+  orionpp_stream_write(stream, &value, sizeof(value));
+  if (bytesize > 0) orionpp_stream_write(stream, bytes, bytesize);
+  return orionpp_stream_write(stream, padding, ORIONPP_CODE_ALIGN((size_t)bytesize) - bytesize);
+}
@@ -7,24 +7,42 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 static void print_usage(const char* program_name) {
-  printf("Usage: %s [options] input_file\n", program_name);
+  printf("Usage: %s [options] input_file...\n", program_name);
   printf("Options:\n");
-  printf("  -o <file>     Output file (default: out.opp)\n");
+  printf("  -o <file>     Output file (default: out.opp for one input, input.opp for several)\n");
+  printf("  -O0 .. -O3    Optimization level (default: -O1)\n");
+  printf("  -j, --jobs N  Compile N files at a time (default: one per core)\n");
+  printf("  --merge       Merge all inputs into the -o module instead of one module each\n");
+  printf("  --cache-dir D Reuse the modules of unchanged sources from D (default: $OCC_CACHE_DIR)\n");
+  printf("  --no-cache    Compile everything even if a cache directory is set\n");
   printf("  -v            Verbose output\n");
   printf("  --debug-tokens Debug tokenization\n");
   printf("  --debug-ast   Debug AST generation\n");
+  printf("  --bench-lexer Report lexer throughput on the input instead of compiling\n");
   printf("  -h, --help    Show this help message\n");
 }
 
 static void parse_arguments(int argc, const char* argv[], CompilerOptions* options) {
   // Initialize default options
-  options->input_file = NULL;
-  options->output_file = "out.opp";
+  options->input_files = malloc((size_t)argc * sizeof(const char*));
+  if (!options->input_files) {
+    fprintf(stderr, "Error: Out of memory\n");
+    exit(1);
+  }
+  options->input_count = 0;
+  options->output_file = NULL;
+  options->jobs = 0;
+  options->opt_level = 1;
+  options->merge = false;
+  options->cache_dir = getenv("OCC_CACHE_DIR");
+  if (options->cache_dir && !*options->cache_dir) options->cache_dir = NULL;
   options->verbose = false;
   options->debug_tokens = false;
   options->debug_ast = false;
+  options->bench_lexer = false;
   
   for (int i = 1; i < argc; i++) {
     if (strcmp(argv[i], "-o") == 0) {
@@ -33,12 +51,37 @@ static void parse_arguments(int argc, const char* argv[], CompilerOptions* optio
         exit(1);
       }
       options->output_file = argv[++i];
+    } else if (strncmp(argv[i], "-O", 2) == 0 && argv[i][2] >= '0' && argv[i][2] <= '3' && argv[i][3] == '\0') {
+      options->opt_level = argv[i][2] - '0';
+    } else if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "Error: %s requires an argument\n", argv[i]);
+        exit(1);
+      }
+      int jobs = atoi(argv[++i]);
+      if (jobs < 1) {
+        fprintf(stderr, "Error: Invalid job count %d\n", jobs);
+        exit(1);
+      }
+      options->jobs = (size_t)jobs;
+    } else if (strcmp(argv[i], "--merge") == 0) {
+      options->merge = true;
+    } else if (strcmp(argv[i], "--cache-dir") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "Error: --cache-dir requires an argument\n");
+        exit(1);
+      }
+      options->cache_dir = argv[++i];
+    } else if (strcmp(argv[i], "--no-cache") == 0) {
+      options->cache_dir = NULL;
     } else if (strcmp(argv[i], "-v") == 0) {
       options->verbose = true;
     } else if (strcmp(argv[i], "--debug-tokens") == 0) {
       options->debug_tokens = true;
     } else if (strcmp(argv[i], "--debug-ast") == 0) {
       options->debug_ast = true;
+    } else if (strcmp(argv[i], "--bench-lexer") == 0) {
+      options->bench_lexer = true;
     } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
       print_usage(argv[0]);
       exit(0);
@@ -46,112 +89,84 @@ static void parse_arguments(int argc, const char* argv[], CompilerOptions* optio
       fprintf(stderr, "Error: Unknown option '%s'\n", argv[i]);
       exit(1);
     } else {
-      if (options->input_file != NULL) {
-        fprintf(stderr, "Error: Multiple input files specified\n");
-        exit(1);
-      }
-      options->input_file = argv[i];
+      options->input_files[options->input_count++] = argv[i];
     }
   }
   
-  if (options->input_file == NULL) {
+  if (options->input_count == 0) {
     fprintf(stderr, "Error: No input file specified\n");
     print_usage(argv[0]);
     exit(1);
   }
-}
-
-int compile_file(const CompilerOptions* options) {
-  if (options->verbose) {
-    report_info("Starting compilation...");
-    printf("Input: %s\n", options->input_file);
-    printf("Output: %s\n", options->output_file);
-  }
   
-  // Read source file
-  char* source = read_file(options->input_file);
-  if (!source) {
-    fprintf(stderr, "Error: Could not read file '%s'\n", options->input_file);
-    return 1;
+  if (options->output_file && options->input_count > 1 && !options->merge) {
+    fprintf(stderr, "Error: -o with several input files requires --merge\n");
+    exit(1);
   }
   
-  // Initialize lexer
-  Lexer lexer;
-  lexer_init(&lexer, source);
-  
-  // Debug tokenization if requested
-  if (options->debug_tokens) {
-    printf("=== TOKENS ===\n");
-    Lexer debug_lexer = lexer;
-    Token token;
-    do {
-      token = lexer_next_token(&debug_lexer);
-      printf("Line %d, Col %d: %s", token.line, token.column, token_type_to_string(token.type));
-      if (token.type == TOKEN_IDENTIFIER || token.type == TOKEN_NUMBER || 
-          token.type == TOKEN_STRING || token.type == TOKEN_CHAR) {
-        char* text = token_to_string(&token);
-        printf(" '%s'", text);
-        free(text);
-      }
-      printf("\n");
-    } while (token.type != TOKEN_EOF && token.type != TOKEN_ERROR);
-    printf("=== END TOKENS ===\n\n");
+  if (options->bench_lexer && options->input_count > 1) {
+    fprintf(stderr, "Error: --bench-lexer takes a single input file\n");
+    exit(1);
   }
   
-  // Initialize parser
-  Parser parser;
-  parser_init(&parser, &lexer);
-  
-  // Parse source code
-  ASTNode* ast = parse_program(&parser);
-  if (!ast || parser.had_error) {
-    fprintf(stderr, "Error: Parsing failed\n");
-    free(source);
-    if (ast) ast_free_node(ast);
-    return 1;
+  if (!options->output_file && options->input_count == 1) {
+    options->output_file = "out.opp";
   }
-  
-  // Debug AST if requested
-  if (options->debug_ast) {
-    printf("=== AST ===\n");
-    ast_print(ast, 0);
-    printf("=== END AST ===\n\n");
+}
+
+// Passes repeat until at least this much CPU time has been measured
+#define BENCH_LEXER_MIN_SECONDS 1.0
+
+int bench_lexer(const CompilerOptions* options) {
+  const char* input_file = options->input_files[0];
+  char* source = read_file(input_file);
+  if (!source) {
+    fprintf(stderr, "Error: Could not read file '%s'\n", input_file);
+    return 1;
   }
   
-  // Open output file
-  FILE* output = fopen(options->output_file, "wb");
-  if (!output) {
-    fprintf(stderr, "Error: Could not open output file '%s'\n", options->output_file);
+  // One table for all passes, so later passes find every name already interned
+  Arena* arena = ArenaCreate(OCC_ARENA_CHUNK_SIZE);
+  InternTable strings;
+  if (!arena || !intern_init(&strings, arena)) {
+    fprintf(stderr, "Error: Out of memory\n");
     free(source);
-    ast_free_node(ast);
+    ArenaFree(arena);
     return 1;
   }
   
-  // Initialize code generator
-  CodeGen codegen;
-  codegen_init(&codegen, output);
+  size_t bytes = strlen(source);
+  size_t tokens = 0;
+  int passes = 0;
+  double seconds = 0.0;
+  clock_t start = clock();
   
-  // Generate code
-  bool success = codegen_generate(&codegen, ast);
-  if (!success) {
-    fprintf(stderr, "Error: Code generation failed\n");
-    fclose(output);
-    codegen_cleanup(&codegen);
-    free(source);
-    ast_free_node(ast);
-    return 1;
-  }
+  do {
+    Lexer lexer;
+    lexer_init(&lexer, source, &strings);
+    Token token;
+    do {
+      token = lexer_next_token(&lexer);
+      tokens++;
+    } while (token.type != TOKEN_EOF && token.type != TOKEN_ERROR);
   
-  // Cleanup
-  fclose(output);
-  codegen_cleanup(&codegen);
-  free(source);
-  ast_free_node(ast);
+    if (token.type == TOKEN_ERROR) {
+      fprintf(stderr, "[line %d] Error: %.*s\n", token.line, token.length, token.start);
+      free(source);
+      ArenaFree(arena);
+      return 1;
+    }
+    passes++;
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+  } while (seconds < BENCH_LEXER_MIN_SECONDS);
   
-  if (options->verbose) {
-    report_info("Compilation completed successfully");
-  }
+  printf("%s: %zu bytes, %zu tokens per pass, %d passes in %.3f s\n",
+         input_file, bytes, tokens / passes, passes, seconds);
+  printf("%.0f tokens/sec, %.1f MB/s\n",
+         (double)tokens / seconds, (double)bytes * passes / seconds / (1024.0 * 1024.0));
   
+  free(source);
+  ArenaFree(arena);
   return 0;
 }
 
@@ -159,5 +174,7 @@ int main(int argc, const char* argv[]) {
   CompilerOptions options;
   parse_arguments(argc, argv, &options);
   
-  return compile_file(&options);
+  int result = options.bench_lexer ? bench_lexer(&options) : compile_files(&options);
+  free(options.input_files);
+  return result;
 }
\ No newline at end of file
@@ -0,0 +1,61 @@
+/**
+ * @file examples/loops.c
+ * @brief Loop-heavy integer kernels, the program the VM's superinstructions are profiled on
+ */
+
+int main() {
+  // Primes below 20000 by trial division
+  int count = 0;
+  int n;
+  for (n = 2; n < 20000; n++) {
+    int prime = 1;
+    int d = 2;
+    while (prime && d * d <= n) {
+      if (n % d == 0) {
+        prime = 0;
+      }
+      d++;
+    }
+    count = count + prime;
+  }
+  print(count);
+
+  // Sum of the greatest common divisors of all pairs below 300
+  int sum = 0;
+  int i;
+  for (i = 1; i < 300; i++) {
+    int j;
+    for (j = 1; j < 300; j++) {
+      int a = i;
+      int b = j;
+      while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+      }
+      sum = sum + a;
+    }
+  }
+  print(sum);
+
+  // Longest Collatz sequence starting below 30000
+  int longest = 0;
+  for (n = 1; n < 30000; n++) {
+    int x = n;
+    int steps = 0;
+    while (x != 1) {
+      if (x % 2 == 0) {
+        x = x / 2;
+      } else {
+        x = 3 * x + 1;
+      }
+      steps++;
+    }
+    if (steps > longest) {
+      longest = steps;
+    }
+  }
+  print(longest);
+
+  return 0;
+}
@@ -6,6 +6,7 @@
 #ifndef AST_H
 #define AST_H
 
+#include "utils.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -47,7 +48,11 @@ typedef enum {
   BINOP_GT,
   BINOP_GE,
   BINOP_AND,
-  BINOP_OR
+  BINOP_OR,
+  // Produced by the optimizer, never by the parser
+  BINOP_BIT_AND,
+  BINOP_SHL,
+  BINOP_SHR
 } BinaryOperator;
 
 // Unary operators
@@ -162,21 +167,29 @@ struct ASTNode {
 };
 
 // Function declarations
-ASTNode* ast_create_node(ASTNodeType type);
-void ast_free_node(ASTNode* node);
+//
+// Nodes and child arrays are allocated from the arena of the translation unit
+// and released together with ArenaFree or ArenaReset. Names are intern handles
+// (see intern.h), which the code generator compares by pointer; string values
+// are stored as given. Both must live at least as long as the arena.
+//
+// When the arena is out of memory the constructors return NULL and the
+// ast_add_* functions return false, leaving the parent as it was.
+ASTNode* ast_create_node(Arena* arena, ASTNodeType type);
 void ast_print(const ASTNode* node, int indent);
-ASTNode* ast_create_program(void);
-ASTNode* ast_create_function(const char* name, DataType return_type);
-ASTNode* ast_create_variable_decl(const char* name, DataType type, ASTNode* initializer);
-ASTNode* ast_create_assignment(const char* name, ASTNode* value);
-ASTNode* ast_create_binary_op(BinaryOperator op, ASTNode* left, ASTNode* right);
-ASTNode* ast_create_unary_op(UnaryOperator op, ASTNode* operand);
-ASTNode* ast_create_identifier(const char* name);
-ASTNode* ast_create_number(int64_t value);
-ASTNode* ast_create_string(const char* value);
-ASTNode* ast_create_call(const char* name);
-ASTNode* ast_create_block(void);
-void ast_add_statement(ASTNode* parent, ASTNode* statement);
-void ast_add_argument(ASTNode* call, ASTNode* argument);
+ASTNode* ast_create_program(Arena* arena);
+ASTNode* ast_create_function(Arena* arena, const char* name, DataType return_type);
+ASTNode* ast_create_variable_decl(Arena* arena, const char* name, DataType type, ASTNode* initializer);
+ASTNode* ast_create_assignment(Arena* arena, const char* name, ASTNode* value);
+ASTNode* ast_create_binary_op(Arena* arena, BinaryOperator op, ASTNode* left, ASTNode* right);
+ASTNode* ast_create_unary_op(Arena* arena, UnaryOperator op, ASTNode* operand);
+ASTNode* ast_create_identifier(Arena* arena, const char* name);
+ASTNode* ast_create_number(Arena* arena, int64_t value);
+ASTNode* ast_create_string(Arena* arena, const char* value);
+ASTNode* ast_create_call(Arena* arena, const char* name);
+ASTNode* ast_create_block(Arena* arena);
+bool ast_add_statement(Arena* arena, ASTNode* parent, ASTNode* statement);
+bool ast_add_argument(Arena* arena, ASTNode* call, ASTNode* argument);
+bool ast_add_parameter(Arena* arena, ASTNode* function, ASTNode* parameter);
 
 #endif // AST_H
\ No newline at end of file
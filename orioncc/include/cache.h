@@ -0,0 +1,40 @@
+/**
+ * @file include/cache.h
+ * @brief On-disk cache of compiled modules keyed by source content
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "driver.h"
+#include <stdio.h>
+
+// Bump whenever the code generator changes what it emits for the same source,
+// so modules produced by an older occ are never served again
+#define OCC_CACHE_VERSION "occ-cache-5"
+
+// Hex digits of a 128-bit key
+#define OCC_CACHE_KEY_LENGTH 32
+
+typedef struct {
+  char hex[OCC_CACHE_KEY_LENGTH + 1];
+} CacheKey;
+
+// Keys the source bytes together with the cache version and every option that
+// changes the emitted module. Paths and timestamps play no part, so renaming
+// or touching a file keeps its entry.
+void cache_key(const CompilerOptions* options, const char* source, size_t length, CacheKey* key);
+
+// Opens the module stored under key, or returns NULL on a miss
+FILE* cache_lookup(const char* cache_dir, const CacheKey* key);
+
+// Copies an entry from cache_lookup into output, which must be empty, and
+// closes it. The copy is a reflink where the file system supports it.
+bool cache_copy(FILE* entry, FILE* output);
+
+// Stores the whole of module under key, creating cache_dir if needed. The entry
+// appears atomically, so concurrent compilers never see a partial module.
+// A failed store only costs a later hit, so it is not an error.
+bool cache_store(const char* cache_dir, const CacheKey* key, FILE* module);
+
+#endif // CACHE_H
@@ -7,23 +7,63 @@
 #define CODEGEN_H
 
 #include "ast.h"
+#include "symtab.h"
 #include "orionpp/orionpp.h"
+#include "orionpp/stream.h"
 #include <stdio.h>
 
-// Symbol table entry
-typedef struct Symbol {
-  char* name;
-  DataType type;
-  orionpp_variable_id_t var_id;
-  struct Symbol* next;
-} Symbol;
+// Encoded instructions held back until the end of a function
+typedef struct {
+  orionpp_byte_t* data;
+  size_t size;
+  size_t capacity;
+} CodeBuffer;
+
+// Lifetime of a variable id as far as the temporary allocator is concerned
+typedef enum {
+  TEMP_NONE, // named variable or string constant, never recycled
+  TEMP_WORD, // live temporaries by type
+  TEMP_CHAR,
+  TEMP_FREE // declared in the current function and free for reuse
+} TempState;
+
+typedef struct {
+  orionpp_variable_id_t* ids;
+  size_t count;
+  size_t capacity;
+} TempList;
+
+// Temporaries live from the instruction that writes them to the one that
+// reads them. Once read they go back to the free list of their type and the
+// next expression reuses them, so a function declares only as many as are
+// ever live at once. Counts cover the current or last function.
+typedef struct {
+  uint8_t* state; // TempState by variable id
+  size_t state_capacity;
+  TempList free_word;
+  TempList free_char;
+  size_t requested; // temporaries handed out
+  size_t declared; // distinct ids behind them
+  size_t live;
+  size_t peak_live;
+} TempPool;
 
 // Code generator state
 typedef struct CodeGen {
   FILE* output;
-  Symbol* symbols;
+  orionpp_stream_t stream; // buffered image writer on output's handle
+  SymbolTable symbols;
   orionpp_variable_id_t next_var_id;
   orionpp_label_id_t next_label_id;
+  // Inside a function every VAR goes to declarations and the rest to body;
+  // both are written out when it ends, so each variable is declared exactly
+  // once on entry however often loops and branches reach its first use
+  bool in_function;
+  CodeBuffer declarations;
+  CodeBuffer body;
+  TempPool temps;
+  bool verbose; // report variables and peak live temporaries per function
+  int opt_level; // 2 and above build each function as SSA (see ir.h)
   bool had_error;
 } CodeGen;
 
@@ -33,10 +73,20 @@ void codegen_cleanup(CodeGen* codegen);
 bool codegen_generate(CodeGen* codegen, const ASTNode* ast);
 void codegen_error(CodeGen* codegen, const char* message);
 
-// Symbol table functions
+// The OS handle under a stdio file, for the buffered image stream
+orionpp_handle_t codegen_file_handle(FILE* file);
+
+// Symbol table functions. Adding a symbol or entering a scope reports running
+// out of memory as an error and returns NULL or false.
 Symbol* codegen_find_symbol(CodeGen* codegen, const char* name);
 Symbol* codegen_add_symbol(CodeGen* codegen, const char* name, DataType type);
-orionpp_variable_id_t codegen_get_temp_var(CodeGen* codegen);
+bool codegen_enter_scope(CodeGen* codegen);
+void codegen_leave_scope(CodeGen* codegen);
+// Returns a temporary of type, reusing a released one when possible. WORD and
+// C temporaries are declared; strings get a fresh id their CONST creates.
+orionpp_variable_id_t codegen_get_temp_var(CodeGen* codegen, orionpp_type_t type);
+// Called once the instruction reading var has been emitted; ignores named variables
+void codegen_release_temp(CodeGen* codegen, orionpp_variable_id_t var);
 orionpp_label_id_t codegen_get_label(CodeGen* codegen);
 
 // Code generation functions
@@ -55,6 +105,7 @@ orionpp_variable_id_t codegen_binary_op(CodeGen* codegen, const ASTNode* node);
 orionpp_variable_id_t codegen_unary_op(CodeGen* codegen, const ASTNode* node);
 
 // Instruction emission functions
+void emit_raw_instruction(CodeGen* codegen, const orinopp_instruction_t* instr);
 void emit_instruction(CodeGen* codegen, orionpp_opcode_t opcode, orionpp_opcode_module_t child);
 void emit_var_instruction(CodeGen* codegen, orionpp_variable_id_t var_id, orionpp_type_t type);
 void emit_const_instruction(CodeGen* codegen, orionpp_variable_id_t var_id, orionpp_type_t type, const void* data, size_t size);
@@ -69,7 +120,22 @@ void emit_conditional_branch_instruction(CodeGen* codegen, orionpp_opcode_module
 void emit_zero_branch_instruction(CodeGen* codegen, orionpp_opcode_module_t branch_op, orionpp_variable_id_t var, orionpp_label_id_t label_id);
 void emit_call_instruction(CodeGen* codegen, const char* function_name, orionpp_variable_id_t* args, size_t arg_count, orionpp_variable_id_t result);
 
-// Comparison result generation
+void emit_return_instruction(CodeGen* codegen, const orionpp_variable_id_t* value); // NULL for a bare return
+// Sets result_var to 1 or 0; it may be one of the operands
+void emit_comparison(CodeGen* codegen, BinaryOperator op, orionpp_variable_id_t result_var, orionpp_variable_id_t left_var, orionpp_variable_id_t right_var);
+
+// Opcodes of arithmetic operators and of the branches behind comparisons; false when op has none
+bool codegen_binary_opcode(BinaryOperator op, orionpp_opcode_module_t* opcode);
+bool codegen_branch_opcode(BinaryOperator op, orionpp_opcode_module_t* opcode);
+// The comparison that holds exactly when op does not, so a branch can skip instead of take
+BinaryOperator codegen_negate_comparison(BinaryOperator op);
+
+// Comparison result generation; releases both operands
 orionpp_variable_id_t codegen_comparison(CodeGen* codegen, BinaryOperator op, orionpp_variable_id_t left_var, orionpp_variable_id_t right_var);
 
+// Jumps to label when node is non-zero (when true) or zero (when false) and
+// falls through otherwise. Comparisons branch on their operands directly and
+// && and || short-circuit, so no 1 or 0 is materialized on the way.
+void codegen_condition(CodeGen* codegen, const ASTNode* node, bool when, orionpp_label_id_t label);
+
 #endif // CODEGEN_H
\ No newline at end of file
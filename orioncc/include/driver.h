@@ -0,0 +1,50 @@
+/**
+ * @file include/driver.h
+ * @brief Compiles translation units, several at a time, and merges their modules
+ */
+
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include "codegen.h"
+#include <stdio.h>
+
+// Compiler options
+typedef struct {
+  const char** input_files;
+  size_t input_count;
+  const char* output_file; // single input or merged module; NULL derives name.opp per input
+  size_t jobs; // worker threads, 0 for one per online core
+  int opt_level; // 0 compiles the AST as parsed, 1 optimizes it first, 2 adds the SSA passes, 3 loop hoisting
+  bool merge; // link every unit into output_file instead of one module each
+  const char* cache_dir; // reuse modules of unchanged sources from here; NULL disables
+  bool verbose;
+  bool debug_tokens;
+  bool debug_ast;
+  bool bench_lexer;
+} CompilerOptions;
+
+// One translation unit. Workers share nothing but the options, so every
+// unit owns its own lexer, parser, arena and code generator.
+typedef struct {
+  const char* input_file;
+  const char* output_file; // ignored when output is set
+  FILE* output; // stream to write to instead of output_file, left open
+  bool cached; // the module was copied from the cache
+  int status; // 0 on success
+} CompileUnit;
+
+// Compiles one translation unit
+int compile_file(const CompilerOptions* options, CompileUnit* unit);
+
+// Compiles every input on a pool of options->jobs threads; returns 0 when all succeed
+int compile_files(const CompilerOptions* options);
+
+// Concatenates the code of already compiled units into one module,
+// renumbering variables and labels so the units cannot collide
+int merge_units(const CompileUnit* units, size_t count, const char* output_file);
+
+// input.c -> input.opp; the result is malloc'd, NULL when out of memory
+char* default_output_file(const char* input_file);
+
+#endif // DRIVER_H
@@ -0,0 +1,41 @@
+/**
+ * @file include/intern.h
+ * @brief Interned identifier strings shared by the lexer, parser and code generator
+ */
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include "utils.h"
+
+// Every distinct text is stored once, so two handles are equal exactly when
+// their pointers are. A handle is a NUL-terminated string; its hash and
+// length sit just before it.
+typedef struct InternHeader {
+  uint32_t hash;
+  uint32_t length;
+} InternHeader;
+
+typedef struct InternTable {
+  Arena* arena; // strings and slots, freed with the arena
+  const char** slots; // open addressing, power-of-two capacity
+  size_t capacity;
+  size_t count;
+} InternTable;
+
+// Both return false or NULL when the arena is out of memory
+bool intern_init(InternTable* table, Arena* arena);
+
+// Returns the handle for text, adding it on first use
+const char* intern_string(InternTable* table, const char* text, size_t length);
+const char* intern_cstr(InternTable* table, const char* text);
+
+static inline uint32_t intern_hash(const char* handle) {
+  return ((const InternHeader*)handle - 1)->hash;
+}
+
+static inline size_t intern_length(const char* handle) {
+  return ((const InternHeader*)handle - 1)->length;
+}
+
+#endif // INTERN_H
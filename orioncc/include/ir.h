@@ -0,0 +1,131 @@
+/**
+ * @file include/ir.h
+ * @brief SSA control-flow graph between the AST and Orion++ emission
+ *
+ * At -O2 and above each function is built into basic blocks of SSA values,
+ * optimized across statements, and lowered back through the emit_*
+ * functions of the code generator. Everything lives in one arena per
+ * function.
+ */
+
+#ifndef IR_H
+#define IR_H
+
+#include "codegen.h"
+
+// Chunk size of the arena holding one function's IR
+#define IR_ARENA_CHUNK_SIZE (64 * 1024)
+
+typedef enum {
+  IR_CONST, // imm for WORD and C, text for STRING; also locals read before assignment
+  IR_PARAM, // incoming parameter held in var
+  IR_PHI, // one argument per predecessor, in predecessor order
+  IR_COPY, // assignment; removed by copy propagation, reintroduced to leave SSA
+  IR_CONVERT, // assignment to a variable of another type; lowered to MOV
+  IR_BINARY, // arithmetic and bitwise operator
+  IR_COMPARE, // comparison operator, 1 or 0
+  IR_CALL, // text is the callee
+  IR_LOAD_GLOBAL, // var is the global's VM variable
+  IR_STORE_GLOBAL
+} IROpcode;
+
+typedef enum {
+  IR_JUMP, // to targets[0]
+  IR_BRANCH, // to targets[0] when condition is non-zero, else targets[1]
+  IR_RETURN, // condition is the value, or NULL
+  IR_EXIT // falls off the end of the function; only its exit block
+} IRTerminator;
+
+typedef struct IRBlock IRBlock;
+
+typedef struct IRValue {
+  IROpcode op;
+  orionpp_type_t type;
+  BinaryOperator operator; // IR_BINARY and IR_COMPARE
+  uint32_t id; // dense within the function
+  IRBlock* block; // NULL once removed
+  struct IRValue** args;
+  uint32_t arg_count;
+  union {
+    int64_t imm;
+    const char* text;
+    orionpp_variable_id_t var;
+    uint32_t local; // phis under construction: the source variable
+  };
+  struct IRValue* forward; // set when the value was replaced
+  uint32_t vreg; // lowering: the location this value defines
+} IRValue;
+
+struct IRBlock {
+  uint32_t id;
+  IRValue** values; // phis first
+  size_t value_count;
+  IRBlock** preds;
+  size_t pred_count;
+  IRTerminator terminator;
+  IRValue* condition;
+  IRBlock* targets[2];
+  bool sealed; // every predecessor is known
+  bool removed;
+  // Analyses, valid after ir_compute_dominators
+  uint32_t rpo; // position in reverse post-order
+  IRBlock* idom;
+  uint32_t depth; // in the dominator tree
+};
+
+typedef struct {
+  Arena* arena;
+  const char* name;
+  IRBlock** blocks; // removed blocks stay in place
+  size_t block_count;
+  IRBlock* entry;
+  IRBlock** rpo; // reachable blocks in reverse post-order
+  size_t rpo_count;
+  uint32_t value_count;
+  bool failed; // the arena ran out; the function must not be lowered
+} IRFunction;
+
+typedef struct {
+  size_t values_before; // after construction
+  size_t values_after; // after the last pass
+  size_t copies; // copies and phis propagated
+  size_t folded;
+  size_t cse; // values replaced by an identical dominating one
+  size_t dead; // values deleted
+  size_t hoisted; // values moved out of loops
+  size_t branches; // branches and blocks simplified away
+} IRStats;
+
+// Builds the body of a function whose parameters the code generator has
+// already declared. Returns NULL after reporting through codegen_error.
+IRFunction* ir_build_function(CodeGen* codegen, const ASTNode* function, Arena* arena);
+
+// Runs the passes of level (2 or 3) to a fixed point, stopping early with
+// failed set when the arena runs out
+void ir_optimize(IRFunction* fn, int level, IRStats* stats);
+
+// Emits the function body through codegen; the caller wraps it like any other
+// function. Running out of memory is reported through codegen_error.
+void ir_lower(CodeGen* codegen, IRFunction* fn);
+
+// Helpers shared by the passes. Arrays grow in the function's arena; when it
+// runs out they set failed and return NULL or false, changing nothing.
+IRValue* ir_resolve(IRValue* value);
+void* ir_alloc(IRFunction* fn, size_t size);
+IRValue* ir_new_value(IRFunction* fn, IROpcode op, orionpp_type_t type);
+IRBlock* ir_new_block(IRFunction* fn);
+bool ir_add_arg(IRFunction* fn, IRValue* value, IRValue* arg);
+bool ir_append(IRFunction* fn, IRBlock* block, IRValue* value);
+// Drops forwarded and removed values and points arguments at their replacements
+void ir_sweep(IRFunction* fn);
+bool ir_add_pred(IRFunction* fn, IRBlock* block, IRBlock* pred);
+// Removes the index-th predecessor edge together with its phi arguments
+void ir_remove_pred(IRBlock* block, size_t index);
+size_t ir_successor_count(const IRBlock* block);
+// Orders reachable blocks and builds the dominator tree; on failure neither is valid
+bool ir_compute_dominators(IRFunction* fn);
+bool ir_dominates(const IRBlock* a, const IRBlock* b);
+// Values that must stay even when unused
+bool ir_has_side_effects(const IRValue* value);
+
+#endif // IR_H
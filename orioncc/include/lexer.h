@@ -9,6 +9,8 @@
 #include <stddef.h>
 #include <stdbool.h>
 
+typedef struct InternTable InternTable;
+
 // Token types
 typedef enum {
   // Literals
@@ -68,18 +70,22 @@ typedef struct Token {
   int length;
   int line;
   int column;
+  const char* name; // intern handle of an identifier, NULL for other tokens
 } Token;
 
 typedef struct Lexer {
   const char* source;
+  const char* end; // terminating NUL of source
   const char* current;
   const char* start;
+  const char* line_start; // first character of the current line
   int line;
-  int column;
+  int column; // of the token being scanned
+  InternTable* strings; // where identifiers are interned
 } Lexer;
 
 // Function declarations
-void lexer_init(Lexer* lexer, const char* source);
+void lexer_init(Lexer* lexer, const char* source, InternTable* strings);
 Token lexer_next_token(Lexer* lexer);
 const char* token_type_to_string(TokenType type);
 bool token_equals_text(const Token* token, const char* text);
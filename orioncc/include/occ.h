@@ -18,22 +18,18 @@ typedef struct Parser Parser;
 typedef struct CodeGen CodeGen;
 
 // Common includes
+#include "intern.h"
 #include "lexer.h"
 #include "ast.h"
 #include "parser.h"
 #include "codegen.h"
+#include "optimize.h"
+#include "ir.h"
+#include "driver.h"
+#include "cache.h"
 #include "utils.h"
 
-// Compiler options
-typedef struct {
-  const char* input_file;
-  const char* output_file;
-  bool verbose;
-  bool debug_tokens;
-  bool debug_ast;
-} CompilerOptions;
-
-// Main compiler function
-int compile_file(const CompilerOptions* options);
+// Lexes the input repeatedly and reports throughput instead of compiling
+int bench_lexer(const CompilerOptions* options);
 
 #endif // OCC_H
\ No newline at end of file
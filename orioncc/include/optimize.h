@@ -0,0 +1,30 @@
+/**
+ * @file include/optimize.h
+ * @brief AST optimizations run between parsing and code generation
+ */
+
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include "ast.h"
+
+// What a pass changed, for -v
+typedef struct {
+  size_t folded; // operators evaluated at compile time
+  size_t simplified; // identities and strength reductions
+  size_t pruned; // statements that can never run
+} OptimizeStats;
+
+// Folds constant expressions, removes identities such as x + 0 and x * 1,
+// turns multiplications and non-negative divisions by powers of two into
+// shifts, and drops if branches and loops whose condition is constant.
+// The program is rewritten in place; new nodes come from arena. Constants
+// are evaluated the way the VM evaluates the emitted code. Returns false when
+// out of memory, leaving a program that must not be compiled.
+bool optimize_program(ASTNode* program, Arena* arena, OptimizeStats* stats);
+
+// Evaluates left op right as the VM would; false when the VM would fault or
+// the result does not fit the 32-bit constant the code generator emits
+bool optimize_fold_binary(BinaryOperator op, int64_t left, int64_t right, int64_t* result);
+
+#endif // OPTIMIZE_H
@@ -11,6 +11,7 @@
 
 typedef struct Parser {
   Lexer* lexer;
+  Arena* arena; // owns every node and name of the parsed translation unit
   Token current_token;
   Token previous_token;
   bool had_error;
@@ -18,7 +19,7 @@ typedef struct Parser {
 } Parser;
 
 // Function declarations
-void parser_init(Parser* parser, Lexer* lexer);
+void parser_init(Parser* parser, Lexer* lexer, Arena* arena);
 ASTNode* parse_program(Parser* parser);
 void parser_error(Parser* parser, const char* message);
 void parser_advance(Parser* parser);
@@ -0,0 +1,61 @@
+/**
+ * @file include/symtab.h
+ * @brief Hashed, scoped symbol table for the code generator
+ */
+
+#ifndef SYMTAB_H
+#define SYMTAB_H
+
+#include "ast.h"
+#include "intern.h"
+#include "orionpp/orionpp.h"
+
+struct SymbolName;
+
+// Symbol table entry: one declaration of a name in one scope
+typedef struct Symbol {
+  const char* name; // intern handle
+  DataType type;
+  orionpp_variable_id_t var_id;
+  struct SymbolName* entry;
+  struct Symbol* shadowed; // same name in an enclosing scope
+  struct Symbol* next; // previous declaration in the same scope
+} Symbol;
+
+// A name and its innermost visible declaration
+typedef struct SymbolName {
+  const char* name;
+  Symbol* binding;
+  struct SymbolName* next; // hash chain
+} SymbolName;
+
+typedef struct SymbolTable {
+  Arena* arena; // every allocation of the table; outgrown arrays stay behind
+  SymbolName** buckets;
+  size_t bucket_count; // power of two
+  size_t name_count;
+  Symbol** scopes; // most recent declaration of each open scope
+  size_t scope_count;
+  size_t scope_capacity;
+  Symbol* free_symbols; // recycled when scopes close
+} SymbolTable;
+
+// Creates the table with the global scope open. Like symtab_enter_scope and
+// symtab_declare it fails (false or NULL) only when out of memory; the table
+// can still be freed.
+bool symtab_init(SymbolTable* table);
+void symtab_free(SymbolTable* table);
+
+// Opens a scope; declarations in it shadow the enclosing ones until it is left
+bool symtab_enter_scope(SymbolTable* table);
+// Closes the innermost scope, making its shadowed declarations visible again
+void symtab_leave_scope(SymbolTable* table);
+
+// Names are intern handles (see intern.h) and are hashed and compared by pointer
+
+// Innermost declaration of name, or NULL
+Symbol* symtab_find(SymbolTable* table, const char* name);
+// Declares name in the innermost scope; the var_id is left to the caller
+Symbol* symtab_declare(SymbolTable* table, const char* name, DataType type);
+
+#endif // SYMTAB_H
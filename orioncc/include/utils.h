@@ -9,15 +9,44 @@
 #include <stddef.h>
 #include <stdbool.h>
 
-// Memory management
-void* safe_malloc(size_t size);
-void* safe_realloc(void* ptr, size_t size);
-char* safe_strdup(const char* str);
+#include <stdint.h>
 
-// String utilities
+// Chunked bump allocator. Allocations are zeroed and live until the arena is
+// reset or freed. Creating and allocating return NULL when out of memory,
+// leaving the arena as it was.
+typedef struct ArenaChunk {
+  struct ArenaChunk* next;
+  size_t capacity;
+  char buffer[];
+} ArenaChunk;
+
+typedef struct {
+  ArenaChunk* root;
+  ArenaChunk* current;
+  size_t offset; // into current
+  size_t chunk_size;
+} Arena;
+
+Arena* ArenaCreate(size_t chunk_size);
+void* ArenaAllocAligned(Arena* arena, size_t size, size_t align);
+void* ArenaAlloc(Arena* arena, size_t size);
+char* ArenaAllocChars(Arena* arena, size_t count);
+void ArenaReset(Arena* arena); // keeps the chunks for reuse
+void ArenaFree(Arena* arena);
+
+// Chunk size of the per-translation-unit arena holding the AST
+#define OCC_ARENA_CHUNK_SIZE (64 * 1024)
+
+// Arena allocation: everything lives until the arena is reset or freed.
+// Both return NULL when out of memory; a failed grow leaves items as they were.
+char* arena_strndup(Arena* arena, const char* str, size_t length);
+void* arena_grow_array(Arena* arena, void* items, size_t count, size_t item_size);
+
+// String utilities; functions returning new strings return NULL when out of memory
 bool str_equals(const char* a, const char* b);
 char* str_slice(const char* str, int start, int length);
 void str_trim(char* str);
+uint32_t str_hash(const char* str, size_t length);
 
 // File utilities
 char* read_file(const char* filename);
@@ -23,7 +23,7 @@ i32 main(int argc, const char *argv[]) {
     AddFile(orioncc_program, "./src/*.c");
     AddFile(orioncc_program, "./app/main.c");
     if (isLinux()) {
-      LinkSystemLibraries(orioncc_program, "m"); // Add math only if on linux since MSVC includes this on STD
+      LinkSystemLibraries(orioncc_program, "m", "pthread"); // Add math only if on linux since MSVC includes this on STD, pthread for -j
     }
     LinkSystemLibraries(orioncc_program, "orion-dev");
     InstallExecutable(orioncc_program);
@@ -41,7 +41,7 @@ i32 main(int argc, const char *argv[]) {
     AddFile(orioncc_test, "./src/*.c");
     AddFile(orioncc_test, "./tests/test.c");
     if (isLinux()) {
-      LinkSystemLibraries(orioncc_test, "m"); // Add math only if on linux since MSVC includes this on STD
+      LinkSystemLibraries(orioncc_test, "m", "pthread"); // Add math only if on linux since MSVC includes this on STD, pthread for the parallel driver test
     }
     LinkSystemLibraries(orioncc_test, "orion-dev");
     InstallExecutable(orioncc_test);
@@ -9,108 +9,13 @@
 #include <stdlib.h>
 #include <string.h>
 
-ASTNode* ast_create_node(ASTNodeType type) {
-  ASTNode* node = safe_malloc(sizeof(ASTNode));
-  memset(node, 0, sizeof(ASTNode));
+ASTNode* ast_create_node(Arena* arena, ASTNodeType type) {
+  ASTNode* node = ArenaAlloc(arena, sizeof(ASTNode)); // zeroed by the arena
+  if (!node) return NULL;
   node->type = type;
   return node;
 }
 
-void ast_free_node(ASTNode* node) {
-  if (!node) return;
-  
-  switch (node->type) {
-    case AST_PROGRAM:
-      for (size_t i = 0; i < node->program.statement_count; i++) {
-        ast_free_node(node->program.statements[i]);
-      }
-      free(node->program.statements);
-      break;
-    
-    case AST_FUNCTION:
-      free(node->function.name);
-      for (size_t i = 0; i < node->function.parameter_count; i++) {
-        ast_free_node(node->function.parameters[i]);
-      }
-      free(node->function.parameters);
-      ast_free_node(node->function.body);
-      break;
-    
-    case AST_VARIABLE_DECL:
-      free(node->variable_decl.name);
-      ast_free_node(node->variable_decl.initializer);
-      break;
-    
-    case AST_ASSIGNMENT:
-      free(node->assignment.name);
-      ast_free_node(node->assignment.value);
-      break;
-    
-    case AST_BINARY_OP:
-      ast_free_node(node->binary_op.left);
-      ast_free_node(node->binary_op.right);
-      break;
-    
-    case AST_UNARY_OP:
-      ast_free_node(node->unary_op.operand);
-      break;
-    
-    case AST_CALL:
-      free(node->call.name);
-      for (size_t i = 0; i < node->call.argument_count; i++) {
-        ast_free_node(node->call.arguments[i]);
-      }
-      free(node->call.arguments);
-      break;
-    
-    case AST_IDENTIFIER:
-      free(node->identifier.name);
-      break;
-    
-    case AST_STRING:
-      free(node->string.value);
-      break;
-    
-    case AST_BLOCK:
-      for (size_t i = 0; i < node->block.statement_count; i++) {
-        ast_free_node(node->block.statements[i]);
-      }
-      free(node->block.statements);
-      break;
-    
-    case AST_IF:
-      ast_free_node(node->if_stmt.condition);
-      ast_free_node(node->if_stmt.then_branch);
-      ast_free_node(node->if_stmt.else_branch);
-      break;
-    
-    case AST_WHILE:
-      ast_free_node(node->while_stmt.condition);
-      ast_free_node(node->while_stmt.body);
-      break;
-    
-    case AST_FOR:
-      ast_free_node(node->for_stmt.init);
-      ast_free_node(node->for_stmt.condition);
-      ast_free_node(node->for_stmt.update);
-      ast_free_node(node->for_stmt.body);
-      break;
-    
-    case AST_RETURN:
-      ast_free_node(node->return_stmt.value);
-      break;
-    
-    case AST_EXPRESSION_STMT:
-      ast_free_node(node->expression_stmt.expression);
-      break;
-    
-    default:
-      break;
-  }
-  
-  free(node);
-}
-
 static void print_indent(int indent) {
   for (int i = 0; i < indent; i++) {
     printf("  ");
@@ -141,6 +46,9 @@ static const char* binary_op_to_string(BinaryOperator op) {
     case BINOP_GE: return ">=";
     case BINOP_AND: return "&&";
     case BINOP_OR: return "||";
+    case BINOP_BIT_AND: return "&";
+    case BINOP_SHL: return "<<";
+    case BINOP_SHR: return ">>";
     default: return "?";
   }
 }
@@ -173,7 +81,7 @@ void ast_print(const ASTNode* node, int indent) {
         ast_print(node->program.statements[i], indent + 1);
       }
       break;
-    
+  
     case AST_FUNCTION:
       printf("Function: %s -> %s\n", node->function.name, data_type_to_string(node->function.return_type));
       if (node->function.parameter_count > 0) {
@@ -187,7 +95,7 @@ void ast_print(const ASTNode* node, int indent) {
       printf("Body:\n");
       ast_print(node->function.body, indent + 2);
       break;
-    
+  
     case AST_VARIABLE_DECL:
       printf("VarDecl: %s : %s\n", node->variable_decl.name, data_type_to_string(node->variable_decl.type));
       if (node->variable_decl.initializer) {
@@ -196,53 +104,53 @@ void ast_print(const ASTNode* node, int indent) {
         ast_print(node->variable_decl.initializer, indent + 2);
       }
       break;
-    
+  
     case AST_ASSIGNMENT:
       printf("Assignment: %s =\n", node->assignment.name);
       ast_print(node->assignment.value, indent + 1);
       break;
-    
+  
     case AST_BINARY_OP:
       printf("BinaryOp: %s\n", binary_op_to_string(node->binary_op.operator));
       ast_print(node->binary_op.left, indent + 1);
       ast_print(node->binary_op.right, indent + 1);
       break;
-    
+  
     case AST_UNARY_OP:
       printf("UnaryOp: %s\n", unary_op_to_string(node->unary_op.operator));
       ast_print(node->unary_op.operand, indent + 1);
       break;
-    
+  
     case AST_CALL:
       printf("Call: %s\n", node->call.name);
       for (size_t i = 0; i < node->call.argument_count; i++) {
         ast_print(node->call.arguments[i], indent + 1);
       }
       break;
-    
+  
     case AST_IDENTIFIER:
       printf("Identifier: %s\n", node->identifier.name);
       break;
-    
+  
     case AST_NUMBER:
       printf("Number: %lld\n", (long long)node->number.value);
       break;
-    
+  
     case AST_STRING:
       printf("String: \"%s\"\n", node->string.value);
       break;
-    
+  
     case AST_CHAR:
       printf("Char: '%c'\n", node->character.value);
       break;
-    
+  
     case AST_BLOCK:
       printf("Block\n");
       for (size_t i = 0; i < node->block.statement_count; i++) {
         ast_print(node->block.statements[i], indent + 1);
       }
       break;
-    
+  
     case AST_IF:
       printf("If\n");
       print_indent(indent + 1);
@@ -257,7 +165,7 @@ void ast_print(const ASTNode* node, int indent) {
         ast_print(node->if_stmt.else_branch, indent + 2);
       }
       break;
-    
+  
     case AST_WHILE:
       printf("While\n");
       print_indent(indent + 1);
@@ -267,7 +175,7 @@ void ast_print(const ASTNode* node, int indent) {
       printf("Body:\n");
       ast_print(node->while_stmt.body, indent + 2);
       break;
-    
+  
     case AST_FOR:
       printf("For\n");
       if (node->for_stmt.init) {
@@ -289,114 +197,142 @@ void ast_print(const ASTNode* node, int indent) {
       printf("Body:\n");
       ast_print(node->for_stmt.body, indent + 2);
       break;
-    
+  
     case AST_RETURN:
       printf("Return\n");
       if (node->return_stmt.value) {
         ast_print(node->return_stmt.value, indent + 1);
       }
       break;
-    
+  
     case AST_EXPRESSION_STMT:
       printf("ExpressionStmt\n");
       ast_print(node->expression_stmt.expression, indent + 1);
       break;
-    
+  
     default:
       printf("Unknown node type: %d\n", node->type);
       break;
   }
 }
 
-ASTNode* ast_create_program(void) {
-  return ast_create_node(AST_PROGRAM);
+ASTNode* ast_create_program(Arena* arena) {
+  return ast_create_node(arena, AST_PROGRAM);
 }
 
-ASTNode* ast_create_function(const char* name, DataType return_type) {
-  ASTNode* node = ast_create_node(AST_FUNCTION);
-  node->function.name = safe_strdup(name);
+ASTNode* ast_create_function(Arena* arena, const char* name, DataType return_type) {
+  ASTNode* node = ast_create_node(arena, AST_FUNCTION);
+  if (!node) return NULL;
+  node->function.name = (char*)name;
   node->function.return_type = return_type;
   return node;
 }
 
-ASTNode* ast_create_variable_decl(const char* name, DataType type, ASTNode* initializer) {
-  ASTNode* node = ast_create_node(AST_VARIABLE_DECL);
-  node->variable_decl.name = safe_strdup(name);
+ASTNode* ast_create_variable_decl(Arena* arena, const char* name, DataType type, ASTNode* initializer) {
+  ASTNode* node = ast_create_node(arena, AST_VARIABLE_DECL);
+  if (!node) return NULL;
+  node->variable_decl.name = (char*)name;
   node->variable_decl.type = type;
   node->variable_decl.initializer = initializer;
   return node;
 }
 
-ASTNode* ast_create_assignment(const char* name, ASTNode* value) {
-  ASTNode* node = ast_create_node(AST_ASSIGNMENT);
-  node->assignment.name = safe_strdup(name);
+ASTNode* ast_create_assignment(Arena* arena, const char* name, ASTNode* value) {
+  ASTNode* node = ast_create_node(arena, AST_ASSIGNMENT);
+  if (!node) return NULL;
+  node->assignment.name = (char*)name;
   node->assignment.value = value;
   return node;
 }
 
-ASTNode* ast_create_binary_op(BinaryOperator op, ASTNode* left, ASTNode* right) {
-  ASTNode* node = ast_create_node(AST_BINARY_OP);
+ASTNode* ast_create_binary_op(Arena* arena, BinaryOperator op, ASTNode* left, ASTNode* right) {
+  ASTNode* node = ast_create_node(arena, AST_BINARY_OP);
+  if (!node) return NULL;
   node->binary_op.operator = op;
   node->binary_op.left = left;
   node->binary_op.right = right;
   return node;
 }
 
-ASTNode* ast_create_unary_op(UnaryOperator op, ASTNode* operand) {
-  ASTNode* node = ast_create_node(AST_UNARY_OP);
+ASTNode* ast_create_unary_op(Arena* arena, UnaryOperator op, ASTNode* operand) {
+  ASTNode* node = ast_create_node(arena, AST_UNARY_OP);
+  if (!node) return NULL;
   node->unary_op.operator = op;
   node->unary_op.operand = operand;
   return node;
 }
 
-ASTNode* ast_create_identifier(const char* name) {
-  ASTNode* node = ast_create_node(AST_IDENTIFIER);
-  node->identifier.name = safe_strdup(name);
+ASTNode* ast_create_identifier(Arena* arena, const char* name) {
+  ASTNode* node = ast_create_node(arena, AST_IDENTIFIER);
+  if (!node) return NULL;
+  node->identifier.name = (char*)name;
   return node;
 }
 
-ASTNode* ast_create_number(int64_t value) {
-  ASTNode* node = ast_create_node(AST_NUMBER);
+ASTNode* ast_create_number(Arena* arena, int64_t value) {
+  ASTNode* node = ast_create_node(arena, AST_NUMBER);
+  if (!node) return NULL;
   node->number.value = value;
   return node;
 }
 
-ASTNode* ast_create_string(const char* value) {
-  ASTNode* node = ast_create_node(AST_STRING);
-  node->string.value = safe_strdup(value);
+ASTNode* ast_create_string(Arena* arena, const char* value) {
+  ASTNode* node = ast_create_node(arena, AST_STRING);
+  if (!node) return NULL;
+  node->string.value = (char*)value;
   return node;
 }
 
-ASTNode* ast_create_block(void) {
-  return ast_create_node(AST_BLOCK);
+ASTNode* ast_create_block(Arena* arena) {
+  return ast_create_node(arena, AST_BLOCK);
 }
 
-ASTNode* ast_create_call(const char* name) {
-  ASTNode* node = ast_create_node(AST_CALL);
-  node->call.name = safe_strdup(name);
+ASTNode* ast_create_call(Arena* arena, const char* name) {
+  ASTNode* node = ast_create_node(arena, AST_CALL);
+  if (!node) return NULL;
+  node->call.name = (char*)name;
   node->call.arguments = NULL;
   node->call.argument_count = 0;
   return node;
 }
 
-void ast_add_statement(ASTNode* parent, ASTNode* statement) {
-  if (!parent || !statement) return;
+bool ast_add_statement(Arena* arena, ASTNode* parent, ASTNode* statement) {
+  if (!parent || !statement) return true;
   
   if (parent->type == AST_PROGRAM) {
-    parent->program.statements = safe_realloc(parent->program.statements, 
-      (parent->program.statement_count + 1) * sizeof(ASTNode*));
+    ASTNode** statements = arena_grow_array(arena, parent->program.statements,
+      parent->program.statement_count, sizeof(ASTNode*));
+    if (!statements) return false;
+    parent->program.statements = statements;
     parent->program.statements[parent->program.statement_count++] = statement;
   } else if (parent->type == AST_BLOCK) {
-    parent->block.statements = safe_realloc(parent->block.statements,
-      (parent->block.statement_count + 1) * sizeof(ASTNode*));
+    ASTNode** statements = arena_grow_array(arena, parent->block.statements,
+      parent->block.statement_count, sizeof(ASTNode*));
+    if (!statements) return false;
+    parent->block.statements = statements;
     parent->block.statements[parent->block.statement_count++] = statement;
   }
+  return true;
 }
 
-void ast_add_argument(ASTNode* call, ASTNode* argument) {
-  if (!call || !argument || call->type != AST_CALL) return;
+bool ast_add_argument(Arena* arena, ASTNode* call, ASTNode* argument) {
+  if (!call || !argument || call->type != AST_CALL) return true;
   
-  call->call.arguments = safe_realloc(call->call.arguments,
-    (call->call.argument_count + 1) * sizeof(ASTNode*));
+  ASTNode** arguments = arena_grow_array(arena, call->call.arguments,
+    call->call.argument_count, sizeof(ASTNode*));
+  if (!arguments) return false;
+  call->call.arguments = arguments;
   call->call.arguments[call->call.argument_count++] = argument;
-}
\ No newline at end of file
+  return true;
+}
+
+bool ast_add_parameter(Arena* arena, ASTNode* function, ASTNode* parameter) {
+  if (!function || !parameter || function->type != AST_FUNCTION) return true;
+  
+  ASTNode** parameters = arena_grow_array(arena, function->function.parameters,
+    function->function.parameter_count, sizeof(ASTNode*));
+  if (!parameters) return false;
+  function->function.parameters = parameters;
+  function->function.parameters[function->function.parameter_count++] = parameter;
+  return true;
+}
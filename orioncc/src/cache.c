@@ -0,0 +1,156 @@
+/**
+ * @file src/cache.c
+ * @brief Compiled module cache implementation
+ */
+
+#ifndef WIN32
+  #define _DEFAULT_SOURCE // fileno
+#endif
+
+#include "cache.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+  #include <direct.h>
+  #include <process.h>
+  #define cache_mkdir(path) _mkdir(path)
+  #define cache_pid() _getpid()
+#else
+  #include <sys/stat.h>
+  #include <unistd.h>
+  #define cache_mkdir(path) mkdir(path, 0777)
+  #define cache_pid() getpid()
+#endif
+
+#ifdef __linux__
+  #include <sys/ioctl.h>
+  #include <linux/fs.h>
+#endif
+
+#define CACHE_COPY_CHUNK (64 * 1024)
+
+// MurmurHash64A; two seeds give the 128 bits of a key
+static uint64_t cache_hash(const void* data, size_t length, uint64_t seed) {
+  const uint64_t m = 0xc6a4a7935bd1e995ull;
+  const int r = 47;
+  const unsigned char* p = data;
+  const unsigned char* end = p + (length & ~(size_t)7);
+  uint64_t h = seed ^ (length * m);
+  
+  for (; p != end; p += 8) {
+    uint64_t k;
+    memcpy(&k, p, sizeof(k));
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+  
+  switch (length & 7) {
+    case 7: h ^= (uint64_t)p[6] << 48; // fallthrough
+    case 6: h ^= (uint64_t)p[5] << 40; // fallthrough
+    case 5: h ^= (uint64_t)p[4] << 32; // fallthrough
+    case 4: h ^= (uint64_t)p[3] << 24; // fallthrough
+    case 3: h ^= (uint64_t)p[2] << 16; // fallthrough
+    case 2: h ^= (uint64_t)p[1] << 8; // fallthrough
+    case 1: h ^= (uint64_t)p[0];
+      h *= m;
+  }
+  
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return h;
+}
+
+void cache_key(const CompilerOptions* options, const char* source, size_t length, CacheKey* key) {
+  // Only the optimization level changes the emitted module; the debug dumps
+  // and job count affect what is printed and how fast
+  char salt[64];
+  int salt_length = snprintf(salt, sizeof(salt), "%s -O%d", OCC_CACHE_VERSION, options->opt_level);
+  
+  uint64_t seed = cache_hash(salt, (size_t)salt_length, 0);
+  uint64_t high = cache_hash(source, length, seed);
+  uint64_t low = cache_hash(source, length, ~seed);
+  snprintf(key->hex, sizeof(key->hex), "%016llx%016llx", (unsigned long long)high, (unsigned long long)low);
+}
+
+// dir/key.opp, or dir/key.suffix.opp; malloc'd
+static char* cache_path(const char* cache_dir, const CacheKey* key, const char* suffix) {
+  size_t size = strlen(cache_dir) + OCC_CACHE_KEY_LENGTH + (suffix ? strlen(suffix) + 1 : 0) + sizeof("/.opp");
+  char* path = malloc(size);
+  if (!path) return NULL;
+  
+  if (suffix) snprintf(path, size, "%s/%s.%s.opp", cache_dir, key->hex, suffix);
+  else snprintf(path, size, "%s/%s.opp", cache_dir, key->hex);
+  return path;
+}
+
+// Copies from the current position of from to the end; false on a read or write error
+static bool copy_stream(FILE* from, FILE* to) {
+  char* buffer = malloc(CACHE_COPY_CHUNK);
+  if (!buffer) return false;
+  
+  size_t n;
+  bool ok = true;
+  while (ok && (n = fread(buffer, 1, CACHE_COPY_CHUNK, from)) > 0) {
+    ok = fwrite(buffer, 1, n, to) == n;
+  }
+  free(buffer);
+  return ok && !ferror(from) && fflush(to) == 0;
+}
+
+FILE* cache_lookup(const char* cache_dir, const CacheKey* key) {
+  char* path = cache_path(cache_dir, key, NULL);
+  if (!path) return NULL;
+  FILE* entry = fopen(path, "rb");
+  free(path);
+  return entry;
+}
+
+bool cache_copy(FILE* entry, FILE* output) {
+  // Sharing the extents is free; copy when the file system cannot
+  bool copied = false;
+#ifdef FICLONE
+  fflush(output);
+  copied = ioctl(fileno(output), FICLONE, fileno(entry)) == 0;
+#endif
+  if (!copied) copied = copy_stream(entry, output);
+  
+  fclose(entry);
+  return copied;
+}
+
+bool cache_store(const char* cache_dir, const CacheKey* key, FILE* module) {
+  // Unique per process and store, so racing compilers write separate files
+  static atomic_uint stores;
+  char suffix[48];
+  snprintf(suffix, sizeof(suffix), "%ld-%u.tmp", (long)cache_pid(), atomic_fetch_add(&stores, 1));
+  
+  char* path = cache_path(cache_dir, key, NULL);
+  char* temp_path = cache_path(cache_dir, key, suffix);
+  if (!path || !temp_path) {
+    free(path);
+    free(temp_path);
+    return false;
+  }
+  
+  cache_mkdir(cache_dir);
+  FILE* temp = fopen(temp_path, "wb");
+  bool stored = false;
+  if (temp) {
+    fflush(module);
+    rewind(module);
+    stored = copy_stream(module, temp);
+    stored = fclose(temp) == 0 && stored;
+    stored = stored && rename(temp_path, path) == 0;
+    if (!stored) remove(temp_path);
+  }
+  
+  free(path);
+  free(temp_path);
+  return stored;
+}
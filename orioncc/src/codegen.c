@@ -3,7 +3,12 @@
  * @brief Enhanced code generator implementation with conditional branches for Orion++ IR
  */
 
+#ifndef WIN32
+  #define _DEFAULT_SOURCE // fileno
+#endif
+
 #include "codegen.h"
+#include "ir.h"
 #include "utils.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -13,8 +18,7 @@
   #include <io.h>
 #endif
 
-// Helper function to get file handle
-static file_handle_t get_file_handle(FILE* file) {
+orionpp_handle_t codegen_file_handle(FILE* file) {
 #ifdef WIN32
   return (HANDLE)_get_osfhandle(_fileno(file));
 #else
@@ -23,21 +27,31 @@ static file_handle_t get_file_handle(FILE* file) {
 }
 
 void codegen_init(CodeGen* codegen, FILE* output) {
+  memset(codegen, 0, sizeof(*codegen));
   codegen->output = output;
-  codegen->symbols = NULL;
-  codegen->next_var_id = 0;
-  codegen->next_label_id = 0;
-  codegen->had_error = false;
+  if (!symtab_init(&codegen->symbols)) {
+    codegen_error(codegen, "Out of memory allocating symbol table");
+    return;
+  }
+  
+  // Instruction count is unknown until the end, so the table is left uncounted
+  orionpp_code_table_t table = { ORIONPP_CODE_UNCOUNTED, ORIONPP_CODE_UNCOUNTED };
+  fflush(output);
+  if (orionpp_stream_writer(&codegen->stream, codegen_file_handle(output), 0) != ORIONPP_ERROR_GOOD) {
+    codegen_error(codegen, "Out of memory allocating output buffer");
+    return;
+  }
+  orionpp_stream_write_image_header(&codegen->stream, &table);
 }
 
 void codegen_cleanup(CodeGen* codegen) {
-  Symbol* current = codegen->symbols;
-  while (current) {
-    Symbol* next = current->next;
-    free(current->name);
-    free(current);
-    current = next;
-  }
+  orionpp_stream_close(&codegen->stream);
+  symtab_free(&codegen->symbols);
+  free(codegen->declarations.data);
+  free(codegen->body.data);
+  free(codegen->temps.state);
+  free(codegen->temps.free_word.ids);
+  free(codegen->temps.free_char.ids);
 }
 
 void codegen_error(CodeGen* codegen, const char* message) {
@@ -46,34 +60,151 @@ void codegen_error(CodeGen* codegen, const char* message) {
 }
 
 Symbol* codegen_find_symbol(CodeGen* codegen, const char* name) {
-  Symbol* current = codegen->symbols;
-  while (current) {
-    if (strcmp(current->name, name) == 0) {
-      return current;
-    }
-    current = current->next;
-  }
-  return NULL;
+  return symtab_find(&codegen->symbols, name);
 }
 
 Symbol* codegen_add_symbol(CodeGen* codegen, const char* name, DataType type) {
-  Symbol* symbol = safe_malloc(sizeof(Symbol));
-  symbol->name = safe_strdup(name);
-  symbol->type = type;
+  Symbol* symbol = symtab_declare(&codegen->symbols, name, type);
+  if (!symbol) {
+    codegen_error(codegen, "Out of memory declaring symbol");
+    return NULL;
+  }
   symbol->var_id = codegen->next_var_id++;
-  symbol->next = codegen->symbols;
-  codegen->symbols = symbol;
   return symbol;
 }
 
-orionpp_variable_id_t codegen_get_temp_var(CodeGen* codegen) {
-  return codegen->next_var_id++;
+bool codegen_enter_scope(CodeGen* codegen) {
+  if (symtab_enter_scope(&codegen->symbols)) return true;
+  codegen_error(codegen, "Out of memory entering scope");
+  return false;
+}
+
+// Variable ids are not reused: a closed scope's variables stay declared in the VM
+void codegen_leave_scope(CodeGen* codegen) {
+  symtab_leave_scope(&codegen->symbols);
+}
+
+// Makes var addressable in the state array
+static bool temps_track(CodeGen* codegen, orionpp_variable_id_t var) {
+  TempPool* temps = &codegen->temps;
+  if (var < temps->state_capacity) return true;
+  
+  size_t capacity = temps->state_capacity ? temps->state_capacity * 2 : 256;
+  while (capacity <= var) capacity *= 2;
+  uint8_t* state = realloc(temps->state, capacity);
+  if (!state) {
+    codegen_error(codegen, "Out of memory tracking temporaries");
+    return false;
+  }
+  memset(state + temps->state_capacity, TEMP_NONE, capacity - temps->state_capacity);
+  temps->state = state;
+  temps->state_capacity = capacity;
+  return true;
+}
+
+// Ids declared by one function are never handed to another
+static void temps_reset(TempPool* temps, bool counts) {
+  temps->free_word.count = 0;
+  temps->free_char.count = 0;
+  if (counts) {
+    temps->requested = 0;
+    temps->declared = 0;
+    temps->live = 0;
+    temps->peak_live = 0;
+  }
+}
+
+orionpp_variable_id_t codegen_get_temp_var(CodeGen* codegen, orionpp_type_t type) {
+  TempPool* temps = &codegen->temps;
+  TempList* list = type == ORIONPP_TYPE_WORD ? &temps->free_word : type == ORIONPP_TYPE_C ? &temps->free_char : NULL;
+  if (!list) return codegen->next_var_id++;
+  
+  orionpp_variable_id_t var;
+  if (list->count > 0) {
+    var = list->ids[--list->count];
+  } else {
+    var = codegen->next_var_id++;
+    emit_var_instruction(codegen, var, type);
+    temps->declared++;
+  }
+  
+  if (temps_track(codegen, var)) {
+    temps->state[var] = list == &temps->free_word ? TEMP_WORD : TEMP_CHAR;
+  }
+  temps->requested++;
+  if (++temps->live > temps->peak_live) temps->peak_live = temps->live;
+  return var;
+}
+
+void codegen_release_temp(CodeGen* codegen, orionpp_variable_id_t var) {
+  TempPool* temps = &codegen->temps;
+  if (var >= temps->state_capacity) return;
+  uint8_t state = temps->state[var];
+  if (state != TEMP_WORD && state != TEMP_CHAR) return;
+  
+  TempList* list = state == TEMP_WORD ? &temps->free_word : &temps->free_char;
+  if (list->count == list->capacity) {
+    // Failing to grow only loses the reuse
+    size_t capacity = list->capacity ? list->capacity * 2 : 32;
+    orionpp_variable_id_t* ids = realloc(list->ids, capacity * sizeof(orionpp_variable_id_t));
+    if (!ids) return;
+    list->ids = ids;
+    list->capacity = capacity;
+  }
+  list->ids[list->count++] = var;
+  temps->state[var] = TEMP_FREE;
+  temps->live--;
 }
 
 orionpp_label_id_t codegen_get_label(CodeGen* codegen) {
   return codegen->next_label_id++;
 }
 
+static bool buffer_append(CodeGen* codegen, CodeBuffer* buffer, const void* data, size_t size) {
+  if (buffer->size + size > buffer->capacity) {
+    size_t capacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+    while (capacity < buffer->size + size) capacity *= 2;
+    orionpp_byte_t* grown = realloc(buffer->data, capacity);
+    if (!grown) {
+      codegen_error(codegen, "Out of memory buffering function");
+      return false;
+    }
+    buffer->data = grown;
+    buffer->capacity = capacity;
+  }
+  memcpy(buffer->data + buffer->size, data, size);
+  buffer->size += size;
+  return true;
+}
+
+// Same layout orionpp_stream_write_record and orionpp_stream_write_value produce
+static void buffer_instruction(CodeGen* codegen, CodeBuffer* buffer, const orinopp_instruction_t* instr) {
+  static const orionpp_byte_t padding[4] = { 0 };
+  orionpp_code_record_t record = { instr->root, instr->child, (uint16_t)instr->value_count };
+  if (!buffer_append(codegen, buffer, &record, sizeof(record))) return;
+  
+  for (size_t i = 0; i < instr->value_count; i++) {
+    const orinopp_value_t* value = &instr->values[i];
+    orionpp_code_value_t header = { value->root, value->child, 0, (uint32_t)value->bytesize };
+    buffer_append(codegen, buffer, &header, sizeof(header));
+    if (value->bytesize > 0) buffer_append(codegen, buffer, value->bytes, value->bytesize);
+    buffer_append(codegen, buffer, padding, ORIONPP_CODE_ALIGN(value->bytesize) - value->bytesize);
+  }
+}
+
+void emit_raw_instruction(CodeGen* codegen, const orinopp_instruction_t* instr) {
+  if (codegen->in_function) {
+    buffer_instruction(codegen, &codegen->body, instr);
+    return;
+  }
+  
+  orionpp_stream_write_record(&codegen->stream, instr->root, instr->child, (uint16_t)instr->value_count);
+  for (size_t i = 0; i < instr->value_count; i++) {
+    const orinopp_value_t* value = &instr->values[i];
+    orionpp_stream_write_value(&codegen->stream, value->root, value->child, value->bytes, (uint32_t)value->bytesize);
+  }
+}
+
 void emit_instruction(CodeGen* codegen, orionpp_opcode_t opcode, orionpp_opcode_module_t child) {
   orinopp_instruction_t instr;
   instr.root = opcode;
@@ -81,7 +212,7 @@ void emit_instruction(CodeGen* codegen, orionpp_opcode_t opcode, orionpp_opcode_
   instr.values = NULL;
   instr.value_count = 0;
   
-  orionpp_writef(get_file_handle(codegen->output), &instr);
+  emit_raw_instruction(codegen, &instr);
 }
 
 void emit_var_instruction(CodeGen* codegen, orionpp_variable_id_t var_id, orionpp_type_t type) {
@@ -89,7 +220,8 @@ void emit_var_instruction(CodeGen* codegen, orionpp_variable_id_t var_id, orionp
   instr.root = ORIONPP_OP_ISA;
   instr.child = ORIONPP_OP_ISA_VAR;
   instr.value_count = 2;
-  instr.values = safe_malloc(2 * sizeof(orinopp_value_t));
+  orinopp_value_t values[2];
+  instr.values = values;
   
   // Variable ID
   instr.values[0].root = ORIONPP_TYPE_VARID;
@@ -103,8 +235,12 @@ void emit_var_instruction(CodeGen* codegen, orionpp_variable_id_t var_id, orionp
   instr.values[1].bytes = NULL;
   instr.values[1].bytesize = 0;
   
-  orionpp_writef(get_file_handle(codegen->output), &instr);
-  free(instr.values);
+  // Hoisted to the entry of the enclosing function
+  if (codegen->in_function) {
+    buffer_instruction(codegen, &codegen->declarations, &instr);
+  } else {
+    emit_raw_instruction(codegen, &instr);
+  }
 }
 
 void emit_const_instruction(CodeGen* codegen, orionpp_variable_id_t var_id, orionpp_type_t type, const void* data, size_t size) {
@@ -112,7 +248,8 @@ void emit_const_instruction(CodeGen* codegen, orionpp_variable_id_t var_id, orio
   instr.root = ORIONPP_OP_ISA;
   instr.child = ORIONPP_OP_ISA_CONST;
   instr.value_count = 3;
-  instr.values = safe_malloc(3 * sizeof(orinopp_value_t));
+  orinopp_value_t values[3];
+  instr.values = values;
   
   // Variable ID
   instr.values[0].root = ORIONPP_TYPE_VARID;
@@ -132,8 +269,7 @@ void emit_const_instruction(CodeGen* codegen, orionpp_variable_id_t var_id, orio
   instr.values[2].bytes = (char*)data;
   instr.values[2].bytesize = size;
   
-  orionpp_writef(get_file_handle(codegen->output), &instr);
-  free(instr.values);
+  emit_raw_instruction(codegen, &instr);
 }
 
 void emit_mov_instruction(CodeGen* codegen, orionpp_variable_id_t dest, orionpp_variable_id_t src) {
@@ -141,7 +277,8 @@ void emit_mov_instruction(CodeGen* codegen, orionpp_variable_id_t dest, orionpp_
   instr.root = ORIONPP_OP_ISA;
   instr.child = ORIONPP_OP_ISA_MOV;
   instr.value_count = 2;
-  instr.values = safe_malloc(2 * sizeof(orinopp_value_t));
+  orinopp_value_t values[2];
+  instr.values = values;
   
   // Destination
   instr.values[0].root = ORIONPP_TYPE_VARID;
@@ -155,8 +292,7 @@ void emit_mov_instruction(CodeGen* codegen, orionpp_variable_id_t dest, orionpp_
   instr.values[1].bytes = (char*)&src;
   instr.values[1].bytesize = sizeof(src);
   
-  orionpp_writef(get_file_handle(codegen->output), &instr);
-  free(instr.values);
+  emit_raw_instruction(codegen, &instr);
 }
 
 void emit_binary_instruction(CodeGen* codegen, orionpp_opcode_module_t op, orionpp_variable_id_t dest, orionpp_variable_id_t left, orionpp_variable_id_t right) {
@@ -164,7 +300,8 @@ void emit_binary_instruction(CodeGen* codegen, orionpp_opcode_module_t op, orion
   instr.root = ORIONPP_OP_ISA;
   instr.child = op;
   instr.value_count = 3;
-  instr.values = safe_malloc(3 * sizeof(orinopp_value_t));
+  orinopp_value_t values[3];
+  instr.values = values;
   
   // Destination
   instr.values[0].root = ORIONPP_TYPE_VARID;
@@ -184,8 +321,7 @@ void emit_binary_instruction(CodeGen* codegen, orionpp_opcode_module_t op, orion
   instr.values[2].bytes = (char*)&right;
   instr.values[2].bytesize = sizeof(right);
   
-  orionpp_writef(get_file_handle(codegen->output), &instr);
-  free(instr.values);
+  emit_raw_instruction(codegen, &instr);
 }
 
 void emit_unary_instruction(CodeGen* codegen, orionpp_opcode_module_t op, orionpp_variable_id_t dest, orionpp_variable_id_t operand) {
@@ -193,7 +329,8 @@ void emit_unary_instruction(CodeGen* codegen, orionpp_opcode_module_t op, orionp
   instr.root = ORIONPP_OP_ISA;
   instr.child = op;
   instr.value_count = 2;
-  instr.values = safe_malloc(2 * sizeof(orinopp_value_t));
+  orinopp_value_t values[2];
+  instr.values = values;
   
   // Destination
   instr.values[0].root = ORIONPP_TYPE_VARID;
@@ -207,8 +344,7 @@ void emit_unary_instruction(CodeGen* codegen, orionpp_opcode_module_t op, orionp
   instr.values[1].bytes = (char*)&operand;
   instr.values[1].bytesize = sizeof(operand);
   
-  orionpp_writef(get_file_handle(codegen->output), &instr);
-  free(instr.values);
+  emit_raw_instruction(codegen, &instr);
 }
 
 void emit_label_instruction(CodeGen* codegen, orionpp_label_id_t label_id) {
@@ -216,7 +352,8 @@ void emit_label_instruction(CodeGen* codegen, orionpp_label_id_t label_id) {
   instr.root = ORIONPP_OP_ISA;
   instr.child = ORIONPP_OP_ISA_LABEL;
   instr.value_count = 1;
-  instr.values = safe_malloc(sizeof(orinopp_value_t));
+  orinopp_value_t values[1];
+  instr.values = values;
   
   // Label ID
   instr.values[0].root = ORIONPP_TYPE_LABELID;
@@ -224,8 +361,7 @@ void emit_label_instruction(CodeGen* codegen, orionpp_label_id_t label_id) {
   instr.values[0].bytes = (char*)&label_id;
   instr.values[0].bytesize = sizeof(label_id);
   
-  orionpp_writef(get_file_handle(codegen->output), &instr);
-  free(instr.values);
+  emit_raw_instruction(codegen, &instr);
 }
 
 void emit_jump_instruction(CodeGen* codegen, orionpp_label_id_t label_id) {
@@ -233,7 +369,8 @@ void emit_jump_instruction(CodeGen* codegen, orionpp_label_id_t label_id) {
   instr.root = ORIONPP_OP_ISA;
   instr.child = ORIONPP_OP_ISA_JMP;
   instr.value_count = 1;
-  instr.values = safe_malloc(sizeof(orinopp_value_t));
+  orinopp_value_t values[1];
+  instr.values = values;
   
   // Label ID
   instr.values[0].root = ORIONPP_TYPE_LABELID;
@@ -241,8 +378,7 @@ void emit_jump_instruction(CodeGen* codegen, orionpp_label_id_t label_id) {
   instr.values[0].bytes = (char*)&label_id;
   instr.values[0].bytesize = sizeof(label_id);
   
-  orionpp_writef(get_file_handle(codegen->output), &instr);
-  free(instr.values);
+  emit_raw_instruction(codegen, &instr);
 }
 
 void emit_conditional_branch_instruction(CodeGen* codegen, orionpp_opcode_module_t branch_op, orionpp_variable_id_t left, orionpp_variable_id_t right, orionpp_label_id_t label_id) {
@@ -250,7 +386,8 @@ void emit_conditional_branch_instruction(CodeGen* codegen, orionpp_opcode_module
   instr.root = ORIONPP_OP_ISA;
   instr.child = branch_op;
   instr.value_count = 3;
-  instr.values = safe_malloc(3 * sizeof(orinopp_value_t));
+  orinopp_value_t values[3];
+  instr.values = values;
   
   // Left operand
   instr.values[0].root = ORIONPP_TYPE_VARID;
@@ -270,8 +407,7 @@ void emit_conditional_branch_instruction(CodeGen* codegen, orionpp_opcode_module
   instr.values[2].bytes = (char*)&label_id;
   instr.values[2].bytesize = sizeof(label_id);
   
-  orionpp_writef(get_file_handle(codegen->output), &instr);
-  free(instr.values);
+  emit_raw_instruction(codegen, &instr);
 }
 
 void emit_zero_branch_instruction(CodeGen* codegen, orionpp_opcode_module_t branch_op, orionpp_variable_id_t var, orionpp_label_id_t label_id) {
@@ -279,7 +415,8 @@ void emit_zero_branch_instruction(CodeGen* codegen, orionpp_opcode_module_t bran
   instr.root = ORIONPP_OP_ISA;
   instr.child = branch_op;
   instr.value_count = 2;
-  instr.values = safe_malloc(2 * sizeof(orinopp_value_t));
+  orinopp_value_t values[2];
+  instr.values = values;
   
   // Variable
   instr.values[0].root = ORIONPP_TYPE_VARID;
@@ -293,8 +430,7 @@ void emit_zero_branch_instruction(CodeGen* codegen, orionpp_opcode_module_t bran
   instr.values[1].bytes = (char*)&label_id;
   instr.values[1].bytesize = sizeof(label_id);
   
-  orionpp_writef(get_file_handle(codegen->output), &instr);
-  free(instr.values);
+  emit_raw_instruction(codegen, &instr);
 }
 
 void emit_call_instruction(CodeGen* codegen, const char* function_name, orionpp_variable_id_t* args, size_t arg_count, orionpp_variable_id_t result) {
@@ -303,7 +439,11 @@ void emit_call_instruction(CodeGen* codegen, const char* function_name, orionpp_
   instr.root = ORIONPP_OP_ISA;
   instr.child = ORIONPP_OP_ISA_CALL;
   instr.value_count = 2 + arg_count;
-  instr.values = safe_malloc((2 + arg_count) * sizeof(orinopp_value_t));
+  instr.values = malloc((2 + arg_count) * sizeof(orinopp_value_t));
+  if (!instr.values) {
+    codegen_error(codegen, "Out of memory emitting call");
+    return;
+  }
   
   // Result variable
   instr.values[0].root = ORIONPP_TYPE_VARID;
@@ -325,15 +465,49 @@ void emit_call_instruction(CodeGen* codegen, const char* function_name, orionpp_
     instr.values[2 + i].bytesize = sizeof(args[i]);
   }
   
-  orionpp_writef(get_file_handle(codegen->output), &instr);
+  emit_raw_instruction(codegen, &instr);
   free(instr.values);
 }
 
-orionpp_variable_id_t codegen_comparison(CodeGen* codegen, BinaryOperator op, orionpp_variable_id_t left_var, orionpp_variable_id_t right_var) {
-  // Create a result variable to store the comparison result (1 for true, 0 for false)
-  orionpp_variable_id_t result_var = codegen_get_temp_var(codegen);
-  emit_var_instruction(codegen, result_var, ORIONPP_TYPE_WORD);
-  
+bool codegen_binary_opcode(BinaryOperator op, orionpp_opcode_module_t* opcode) {
+  switch (op) {
+    case BINOP_ADD: *opcode = ORIONPP_OP_ISA_ADD; return true;
+    case BINOP_SUB: *opcode = ORIONPP_OP_ISA_SUB; return true;
+    case BINOP_MUL: *opcode = ORIONPP_OP_ISA_MUL; return true;
+    case BINOP_DIV: *opcode = ORIONPP_OP_ISA_DIV; return true;
+    case BINOP_MOD: *opcode = ORIONPP_OP_ISA_MOD; return true;
+    case BINOP_BIT_AND: *opcode = ORIONPP_OP_ISA_AND; return true;
+    case BINOP_SHL: *opcode = ORIONPP_OP_ISA_SHL; return true;
+    case BINOP_SHR: *opcode = ORIONPP_OP_ISA_SHR; return true;
+    default: return false;
+  }
+}
+
+bool codegen_branch_opcode(BinaryOperator op, orionpp_opcode_module_t* opcode) {
+  switch (op) {
+    case BINOP_EQ: *opcode = ORIONPP_OP_ISA_BREQ; return true;
+    case BINOP_NE: *opcode = ORIONPP_OP_ISA_BRNEQ; return true;
+    case BINOP_LT: *opcode = ORIONPP_OP_ISA_BRLT; return true;
+    case BINOP_LE: *opcode = ORIONPP_OP_ISA_BRLE; return true;
+    case BINOP_GT: *opcode = ORIONPP_OP_ISA_BRGT; return true;
+    case BINOP_GE: *opcode = ORIONPP_OP_ISA_BRGE; return true;
+    default: return false;
+  }
+}
+
+BinaryOperator codegen_negate_comparison(BinaryOperator op) {
+  switch (op) {
+    case BINOP_EQ: return BINOP_NE;
+    case BINOP_NE: return BINOP_EQ;
+    case BINOP_LT: return BINOP_GE;
+    case BINOP_LE: return BINOP_GT;
+    case BINOP_GT: return BINOP_LE;
+    case BINOP_GE: return BINOP_LT;
+    default: return op;
+  }
+}
+
+void emit_comparison(CodeGen* codegen, BinaryOperator op, orionpp_variable_id_t result_var, orionpp_variable_id_t left_var, orionpp_variable_id_t right_var) {
   // Create labels for true and false cases
   orionpp_label_id_t true_label = codegen_get_label(codegen);
   orionpp_label_id_t false_label = codegen_get_label(codegen);
@@ -341,28 +515,9 @@ orionpp_variable_id_t codegen_comparison(CodeGen* codegen, BinaryOperator op, or
   
   // Emit appropriate conditional branch
   orionpp_opcode_module_t branch_op;
-  switch (op) {
-    case BINOP_EQ:
-      branch_op = ORIONPP_OP_ISA_BREQ;
-      break;
-    case BINOP_NE:
-      branch_op = ORIONPP_OP_ISA_BRNEQ;
-      break;
-    case BINOP_LT:
-      branch_op = ORIONPP_OP_ISA_BRLT;
-      break;
-    case BINOP_LE:
-      branch_op = ORIONPP_OP_ISA_BRLE;
-      break;
-    case BINOP_GT:
-      branch_op = ORIONPP_OP_ISA_BRGT;
-      break;
-    case BINOP_GE:
-      branch_op = ORIONPP_OP_ISA_BRGE;
-      break;
-    default:
-      codegen_error(codegen, "Unsupported comparison operator");
-      return result_var;
+  if (!codegen_branch_opcode(op, &branch_op)) {
+    codegen_error(codegen, "Unsupported comparison operator");
+    return;
   }
   
   // Emit conditional branch to true label
@@ -380,17 +535,123 @@ orionpp_variable_id_t codegen_comparison(CodeGen* codegen, BinaryOperator op, or
   
   // End label
   emit_label_instruction(codegen, end_label);
+}
+
+void emit_return_instruction(CodeGen* codegen, const orionpp_variable_id_t* value) {
+  if (!value) {
+    emit_instruction(codegen, ORIONPP_OP_ISA, ORIONPP_OP_ISA_RET);
+    return;
+  }
+  
+  orinopp_instruction_t instr;
+  instr.root = ORIONPP_OP_ISA;
+  instr.child = ORIONPP_OP_ISA_RET;
+  instr.value_count = 1;
+  orinopp_value_t values[1];
+  instr.values = values;
+  
+  instr.values[0].root = ORIONPP_TYPE_VARID;
+  instr.values[0].child = 0;
+  instr.values[0].bytes = (char*)value;
+  instr.values[0].bytesize = sizeof(*value);
   
+  emit_raw_instruction(codegen, &instr);
+}
+
+orionpp_variable_id_t codegen_comparison(CodeGen* codegen, BinaryOperator op, orionpp_variable_id_t left_var, orionpp_variable_id_t right_var) {
+  // The operands are read by the branch, so the result (1 for true, 0 for false) may take their place
+  codegen_release_temp(codegen, left_var);
+  codegen_release_temp(codegen, right_var);
+  orionpp_variable_id_t result_var = codegen_get_temp_var(codegen, ORIONPP_TYPE_WORD);
+  emit_comparison(codegen, op, result_var, left_var, right_var);
+  return result_var;
+}
+
+void codegen_condition(CodeGen* codegen, const ASTNode* node, bool when, orionpp_label_id_t label) {
+  if (node->type == AST_NUMBER) {
+    // while (1) and folded conditions need no test
+    if ((node->number.value != 0) == when) emit_jump_instruction(codegen, label);
+    return;
+  }
+  
+  if (node->type == AST_UNARY_OP && node->unary_op.operator == UNOP_NOT) {
+    codegen_condition(codegen, node->unary_op.operand, !when, label);
+    return;
+  }
+  
+  if (node->type == AST_BINARY_OP) {
+    BinaryOperator op = node->binary_op.operator;
+    if (op == BINOP_AND || op == BINOP_OR) {
+      // Jumping when && is false or || is true takes the same edge for both
+      // operands; otherwise the left one decides whether to test the right
+      if ((op == BINOP_AND) != when) {
+        codegen_condition(codegen, node->binary_op.left, when, label);
+        if (codegen->had_error) return;
+        codegen_condition(codegen, node->binary_op.right, when, label);
+        return;
+      }
+      orionpp_label_id_t skip_label = codegen_get_label(codegen);
+      codegen_condition(codegen, node->binary_op.left, !when, skip_label);
+      if (codegen->had_error) return;
+      codegen_condition(codegen, node->binary_op.right, when, label);
+      emit_label_instruction(codegen, skip_label);
+      return;
+    }
+  
+    orionpp_opcode_module_t branch_op;
+    if (codegen_branch_opcode(when ? op : codegen_negate_comparison(op), &branch_op)) {
+      orionpp_variable_id_t left_var = codegen_expression(codegen, node->binary_op.left);
+      if (codegen->had_error) return;
+      orionpp_variable_id_t right_var = codegen_expression(codegen, node->binary_op.right);
+      if (codegen->had_error) return;
+  
+      emit_conditional_branch_instruction(codegen, branch_op, left_var, right_var, label);
+      codegen_release_temp(codegen, left_var);
+      codegen_release_temp(codegen, right_var);
+      return;
+    }
+  }
+  
+  orionpp_variable_id_t condition_var = codegen_expression(codegen, node);
+  if (codegen->had_error) return;
+  emit_zero_branch_instruction(codegen, when ? ORIONPP_OP_ISA_BRNZ : ORIONPP_OP_ISA_BRZ, condition_var, label);
+  codegen_release_temp(codegen, condition_var);
+}
+
+// && and || as values: 1 or 0, with the right operand evaluated only when it decides
+static orionpp_variable_id_t codegen_logical(CodeGen* codegen, const ASTNode* node) {
+  orionpp_label_id_t false_label = codegen_get_label(codegen);
+  orionpp_label_id_t end_label = codegen_get_label(codegen);
+  
+  codegen_condition(codegen, node, false, false_label);
+  if (codegen->had_error) return 0;
+  
+  orionpp_variable_id_t result_var = codegen_get_temp_var(codegen, ORIONPP_TYPE_WORD);
+  int32_t true_value = 1;
+  emit_const_instruction(codegen, result_var, ORIONPP_TYPE_WORD, &true_value, sizeof(true_value));
+  emit_jump_instruction(codegen, end_label);
+  
+  emit_label_instruction(codegen, false_label);
+  int32_t false_value = 0;
+  emit_const_instruction(codegen, result_var, ORIONPP_TYPE_WORD, &false_value, sizeof(false_value));
+  
+  emit_label_instruction(codegen, end_label);
   return result_var;
 }
 
 bool codegen_generate(CodeGen* codegen, const ASTNode* ast) {
   if (!ast) {
     codegen_error(codegen, "AST is null");
-    return false;
+  } else if (!codegen->had_error) {
+    codegen_program(codegen, ast);
   }
   
-  codegen_program(codegen, ast);
+  // Everything reaches the file here, before the caller closes it
+  orionpp_error_t err = orionpp_stream_flush(&codegen->stream);
+  if (err != ORIONPP_ERROR_GOOD) {
+    codegen->had_error = true;
+    fprintf(stderr, "CodeGen Error: Failed to write output: %s\n", orionpp_strerr(err));
+  }
   return !codegen->had_error;
 }
 
@@ -409,28 +670,63 @@ void codegen_program(CodeGen* codegen, const ASTNode* node) {
     } else {
       codegen_statement(codegen, stmt);
     }
-    
+  
     if (codegen->had_error) {
       return;
     }
   }
 }
 
+// Builds the body as SSA, optimizes it across statements and lowers it back
+static void codegen_function_ir(CodeGen* codegen, const ASTNode* node) {
+  Arena* arena = ArenaCreate(IR_ARENA_CHUNK_SIZE);
+  if (!arena) {
+    codegen_error(codegen, "Out of memory building IR");
+    return;
+  }
+  
+  IRFunction* fn = ir_build_function(codegen, node, arena);
+  if (fn) {
+    IRStats stats;
+    ir_optimize(fn, codegen->opt_level, &stats);
+    if (fn->failed) codegen_error(codegen, "Out of memory optimizing IR");
+    else ir_lower(codegen, fn);
+  
+    if (codegen->verbose) {
+      printf("info: %s: %zu IR values down to %zu (%zu copies, %zu folded, %zu common, %zu dead, %zu hoisted, %zu branches)\n",
+             node->function.name, stats.values_before, stats.values_after, stats.copies, stats.folded,
+             stats.cse, stats.dead, stats.hoisted, stats.branches);
+    }
+  }
+  ArenaFree(arena);
+}
+
 void codegen_function(CodeGen* codegen, const ASTNode* node) {
   if (node->type != AST_FUNCTION) {
     codegen_error(codegen, "Expected function node");
     return;
   }
   
+  if (codegen->in_function) {
+    codegen_error(codegen, "Nested functions are not supported");
+    return;
+  }
+  
   // Add function symbol
-  codegen_add_symbol(codegen, node->function.name, node->function.return_type);
+  if (!codegen_add_symbol(codegen, node->function.name, node->function.return_type)) return;
+  
+  // Parameters and the body's locals go out of scope with the function
+  codegen->in_function = true;
+  temps_reset(&codegen->temps, true);
+  if (!codegen_enter_scope(codegen)) return;
   
   // Add function parameters to symbol table
   for (size_t i = 0; i < node->function.parameter_count; i++) {
     const ASTNode* param = node->function.parameters[i];
     if (param->type == AST_VARIABLE_DECL) {
       Symbol* param_symbol = codegen_add_symbol(codegen, param->variable_decl.name, param->variable_decl.type);
-      
+      if (!param_symbol) return;
+  
       // Emit parameter variable declaration
       orionpp_type_t opp_type;
       switch (param->variable_decl.type) {
@@ -450,11 +746,27 @@ void codegen_function(CodeGen* codegen, const ASTNode* node) {
   
   // Generate function body
   if (node->function.body) {
-    codegen_statement(codegen, node->function.body);
+    if (codegen->opt_level >= 2) codegen_function_ir(codegen, node);
+    else codegen_statement(codegen, node->function.body);
   }
+  codegen_leave_scope(codegen);
   
   // Emit function end hint
   emit_instruction(codegen, ORIONPP_OP_HINT, ORIONPP_OP_HINT_FUNCEND);
+  
+  // Declarations first, then the body
+  codegen->in_function = false;
+  orionpp_stream_write(&codegen->stream, codegen->declarations.data, codegen->declarations.size);
+  orionpp_stream_write(&codegen->stream, codegen->body.data, codegen->body.size);
+  codegen->declarations.size = 0;
+  codegen->body.size = 0;
+  temps_reset(&codegen->temps, false);
+  
+  if (codegen->verbose) {
+    const TempPool* temps = &codegen->temps;
+    printf("info: %s: %zu temporaries share %zu variables, peak %zu live\n",
+           node->function.name, temps->requested, temps->declared, temps->peak_live);
+  }
 }
 
 void codegen_variable_decl(CodeGen* codegen, const ASTNode* node) {
@@ -464,6 +776,7 @@ void codegen_variable_decl(CodeGen* codegen, const ASTNode* node) {
   }
   
   Symbol* symbol = codegen_add_symbol(codegen, node->variable_decl.name, node->variable_decl.type);
+  if (!symbol) return;
   
   // Determine Orion++ type
   orionpp_type_t opp_type;
@@ -485,9 +798,10 @@ void codegen_variable_decl(CodeGen* codegen, const ASTNode* node) {
   if (node->variable_decl.initializer) {
     // Generate initializer expression
     orionpp_variable_id_t init_var = codegen_expression(codegen, node->variable_decl.initializer);
-    
+  
     // Emit assignment
     emit_mov_instruction(codegen, symbol->var_id, init_var);
+    codegen_release_temp(codegen, init_var);
   }
 }
 
@@ -514,7 +828,7 @@ void codegen_statement(CodeGen* codegen, const ASTNode* node) {
       codegen_assignment(codegen, node);
       break;
     case AST_EXPRESSION_STMT:
-      codegen_expression(codegen, node->expression_stmt.expression);
+      codegen_release_temp(codegen, codegen_expression(codegen, node->expression_stmt.expression));
       break;
     case AST_VARIABLE_DECL:
       codegen_variable_decl(codegen, node);
@@ -534,12 +848,12 @@ void codegen_block(CodeGen* codegen, const ASTNode* node) {
     return;
   }
   
+  if (!codegen_enter_scope(codegen)) return;
   for (size_t i = 0; i < node->block.statement_count; i++) {
     codegen_statement(codegen, node->block.statements[i]);
-    if (codegen->had_error) {
-      return;
-    }
+    if (codegen->had_error) break;
   }
+  codegen_leave_scope(codegen);
 }
 
 void codegen_if_statement(CodeGen* codegen, const ASTNode* node) {
@@ -548,16 +862,13 @@ void codegen_if_statement(CodeGen* codegen, const ASTNode* node) {
     return;
   }
   
-  // Generate condition
-  orionpp_variable_id_t condition_var = codegen_expression(codegen, node->if_stmt.condition);
-  if (codegen->had_error) return;
-  
   // Create labels
   orionpp_label_id_t else_label = codegen_get_label(codegen);
   orionpp_label_id_t end_label = codegen_get_label(codegen);
   
-  // Branch to else if condition is zero (false)
-  emit_zero_branch_instruction(codegen, ORIONPP_OP_ISA_BRZ, condition_var, else_label);
+  // Branch to else if condition is false
+  codegen_condition(codegen, node->if_stmt.condition, false, else_label);
+  if (codegen->had_error) return;
   
   // Generate then branch
   codegen_statement(codegen, node->if_stmt.then_branch);
@@ -592,13 +903,10 @@ void codegen_while_statement(CodeGen* codegen, const ASTNode* node) {
   // Loop label
   emit_label_instruction(codegen, loop_label);
   
-  // Generate condition
-  orionpp_variable_id_t condition_var = codegen_expression(codegen, node->while_stmt.condition);
+  // Branch to end if condition is false
+  codegen_condition(codegen, node->while_stmt.condition, false, end_label);
   if (codegen->had_error) return;
   
-  // Branch to end if condition is zero (false)
-  emit_zero_branch_instruction(codegen, ORIONPP_OP_ISA_BRZ, condition_var, end_label);
-  
   // Generate body
   codegen_statement(codegen, node->while_stmt.body);
   if (codegen->had_error) return;
@@ -610,12 +918,7 @@ void codegen_while_statement(CodeGen* codegen, const ASTNode* node) {
   emit_label_instruction(codegen, end_label);
 }
 
-void codegen_for_statement(CodeGen* codegen, const ASTNode* node) {
-  if (node->type != AST_FOR) {
-    codegen_error(codegen, "Expected for statement node");
-    return;
-  }
-  
+static void codegen_for_loop(CodeGen* codegen, const ASTNode* node) {
   // Generate initialization
   if (node->for_stmt.init) {
     codegen_statement(codegen, node->for_stmt.init);
@@ -631,11 +934,9 @@ void codegen_for_statement(CodeGen* codegen, const ASTNode* node) {
   
   // Generate condition
   if (node->for_stmt.condition) {
-    orionpp_variable_id_t condition_var = codegen_expression(codegen, node->for_stmt.condition);
+    // Branch to end if condition is false
+    codegen_condition(codegen, node->for_stmt.condition, false, end_label);
     if (codegen->had_error) return;
-    
-    // Branch to end if condition is zero (false)
-    emit_zero_branch_instruction(codegen, ORIONPP_OP_ISA_BRZ, condition_var, end_label);
   }
   
   // Generate body
@@ -644,7 +945,7 @@ void codegen_for_statement(CodeGen* codegen, const ASTNode* node) {
   
   // Generate update
   if (node->for_stmt.update) {
-    codegen_expression(codegen, node->for_stmt.update);
+    codegen_release_temp(codegen, codegen_expression(codegen, node->for_stmt.update));
     if (codegen->had_error) return;
   }
   
@@ -655,6 +956,18 @@ void codegen_for_statement(CodeGen* codegen, const ASTNode* node) {
   emit_label_instruction(codegen, end_label);
 }
 
+void codegen_for_statement(CodeGen* codegen, const ASTNode* node) {
+  if (node->type != AST_FOR) {
+    codegen_error(codegen, "Expected for statement node");
+    return;
+  }
+  
+  // A declaration in the initializer is scoped to the loop
+  if (!codegen_enter_scope(codegen)) return;
+  codegen_for_loop(codegen, node);
+  codegen_leave_scope(codegen);
+}
+
 void codegen_return_statement(CodeGen* codegen, const ASTNode* node) {
   if (node->type != AST_RETURN) {
     codegen_error(codegen, "Expected return statement node");
@@ -664,24 +977,11 @@ void codegen_return_statement(CodeGen* codegen, const ASTNode* node) {
   if (node->return_stmt.value) {
     orionpp_variable_id_t return_var = codegen_expression(codegen, node->return_stmt.value);
     if (codegen->had_error) return;
-    
-    // Emit return instruction with value
-    orinopp_instruction_t instr;
-    instr.root = ORIONPP_OP_ISA;
-    instr.child = ORIONPP_OP_ISA_RET;
-    instr.value_count = 1;
-    instr.values = safe_malloc(sizeof(orinopp_value_t));
-    
-    instr.values[0].root = ORIONPP_TYPE_VARID;
-    instr.values[0].child = 0;
-    instr.values[0].bytes = (char*)&return_var;
-    instr.values[0].bytesize = sizeof(return_var);
-    
-    orionpp_writef(get_file_handle(codegen->output), &instr);
-    free(instr.values);
+  
+    emit_return_instruction(codegen, &return_var);
+    codegen_release_temp(codegen, return_var);
   } else {
-    // Emit return instruction without value
-    emit_instruction(codegen, ORIONPP_OP_ISA, ORIONPP_OP_ISA_RET);
+    emit_return_instruction(codegen, NULL);
   }
 }
 
@@ -701,6 +1001,7 @@ void codegen_assignment(CodeGen* codegen, const ASTNode* node) {
   if (codegen->had_error) return;
   
   emit_mov_instruction(codegen, symbol->var_id, value_var);
+  codegen_release_temp(codegen, value_var);
 }
 
 orionpp_variable_id_t codegen_expression(CodeGen* codegen, const ASTNode* node) {
@@ -723,19 +1024,23 @@ orionpp_variable_id_t codegen_expression(CodeGen* codegen, const ASTNode* node)
       return symbol->var_id;
     }
     case AST_NUMBER: {
-      orionpp_variable_id_t temp_var = codegen_get_temp_var(codegen);
+      orionpp_variable_id_t temp_var = codegen_get_temp_var(codegen, ORIONPP_TYPE_WORD);
       int32_t value = (int32_t)node->number.value;
       emit_const_instruction(codegen, temp_var, ORIONPP_TYPE_WORD, &value, sizeof(value));
       return temp_var;
     }
     case AST_CALL: {
       // Generate function call
-      orionpp_variable_id_t result_var = codegen_get_temp_var(codegen);
-      
+      orionpp_variable_id_t result_var = codegen_get_temp_var(codegen, ORIONPP_TYPE_WORD);
+  
       // Generate argument expressions
       orionpp_variable_id_t* arg_vars = NULL;
       if (node->call.argument_count > 0) {
-        arg_vars = safe_malloc(node->call.argument_count * sizeof(orionpp_variable_id_t));
+        arg_vars = malloc(node->call.argument_count * sizeof(orionpp_variable_id_t));
+        if (!arg_vars) {
+          codegen_error(codegen, "Out of memory generating call");
+          return 0;
+        }
         for (size_t i = 0; i < node->call.argument_count; i++) {
           arg_vars[i] = codegen_expression(codegen, node->call.arguments[i]);
           if (codegen->had_error) {
@@ -744,21 +1049,24 @@ orionpp_variable_id_t codegen_expression(CodeGen* codegen, const ASTNode* node)
           }
         }
       }
-      
+  
       // Emit call instruction
       emit_call_instruction(codegen, node->call.name, arg_vars, node->call.argument_count, result_var);
-      
+      for (size_t i = 0; i < node->call.argument_count; i++) {
+        codegen_release_temp(codegen, arg_vars[i]);
+      }
+  
       if (arg_vars) free(arg_vars);
       return result_var;
     }
     case AST_STRING: {
-      orionpp_variable_id_t temp_var = codegen_get_temp_var(codegen);
+      orionpp_variable_id_t temp_var = codegen_get_temp_var(codegen, ORIONPP_TYPE_STRING);
       emit_const_instruction(codegen, temp_var, ORIONPP_TYPE_STRING, 
                            node->string.value, strlen(node->string.value) + 1);
       return temp_var;
     }
     case AST_CHAR: {
-      orionpp_variable_id_t temp_var = codegen_get_temp_var(codegen);
+      orionpp_variable_id_t temp_var = codegen_get_temp_var(codegen, ORIONPP_TYPE_C);
       char value = node->character.value;
       emit_const_instruction(codegen, temp_var, ORIONPP_TYPE_C, &value, sizeof(value));
       return temp_var;
@@ -782,6 +1090,10 @@ orionpp_variable_id_t codegen_binary_op(CodeGen* codegen, const ASTNode* node) {
     return 0;
   }
   
+  if (node->binary_op.operator == BINOP_AND || node->binary_op.operator == BINOP_OR) {
+    return codegen_logical(codegen, node);
+  }
+  
   orionpp_variable_id_t left_var = codegen_expression(codegen, node->binary_op.left);
   if (codegen->had_error) return 0;
   
@@ -801,26 +1113,17 @@ orionpp_variable_id_t codegen_binary_op(CodeGen* codegen, const ASTNode* node) {
       break;
   }
   
-  // Handle arithmetic and logical operators
-  orionpp_variable_id_t result_var = codegen_get_temp_var(codegen);
-  
-  // Emit variable declaration for result
-  emit_var_instruction(codegen, result_var, ORIONPP_TYPE_WORD);
-  
+  // Handle arithmetic and bitwise operators
   orionpp_opcode_module_t op;
-  switch (node->binary_op.operator) {
-    case BINOP_ADD: op = ORIONPP_OP_ISA_ADD; break;
-    case BINOP_SUB: op = ORIONPP_OP_ISA_SUB; break;
-    case BINOP_MUL: op = ORIONPP_OP_ISA_MUL; break;
-    case BINOP_DIV: op = ORIONPP_OP_ISA_DIV; break;
-    case BINOP_MOD: op = ORIONPP_OP_ISA_MOD; break;
-    case BINOP_AND: op = ORIONPP_OP_ISA_AND; break;
-    case BINOP_OR: op = ORIONPP_OP_ISA_OR; break;
-    default:
-      codegen_error(codegen, "Unsupported binary operator");
-      return result_var;
+  if (!codegen_binary_opcode(node->binary_op.operator, &op)) {
+    codegen_error(codegen, "Unsupported binary operator");
+    return 0;
   }
   
+  // The VM reads both operands before writing, so the result may reuse one
+  codegen_release_temp(codegen, left_var);
+  codegen_release_temp(codegen, right_var);
+  orionpp_variable_id_t result_var = codegen_get_temp_var(codegen, ORIONPP_TYPE_WORD);
   emit_binary_instruction(codegen, op, result_var, left_var, right_var);
   return result_var;
 }
@@ -834,44 +1137,54 @@ orionpp_variable_id_t codegen_unary_op(CodeGen* codegen, const ASTNode* node) {
   orionpp_variable_id_t operand_var = codegen_expression(codegen, node->unary_op.operand);
   if (codegen->had_error) return 0;
   
-  orionpp_variable_id_t result_var = codegen_get_temp_var(codegen);
-  
-  // Emit variable declaration for result  
-  emit_var_instruction(codegen, result_var, ORIONPP_TYPE_WORD);
-  
+  orionpp_variable_id_t result_var;
   switch (node->unary_op.operator) {
     case UNOP_MINUS: {
       // Negate by subtracting from zero
-      orionpp_variable_id_t zero_var = codegen_get_temp_var(codegen);
+      orionpp_variable_id_t zero_var = codegen_get_temp_var(codegen, ORIONPP_TYPE_WORD);
       int32_t zero = 0;
       emit_const_instruction(codegen, zero_var, ORIONPP_TYPE_WORD, &zero, sizeof(zero));
+      codegen_release_temp(codegen, zero_var);
+      codegen_release_temp(codegen, operand_var);
+      result_var = codegen_get_temp_var(codegen, ORIONPP_TYPE_WORD);
       emit_binary_instruction(codegen, ORIONPP_OP_ISA_SUB, result_var, zero_var, operand_var);
       break;
     }
     case UNOP_NOT: {
-      emit_unary_instruction(codegen, ORIONPP_OP_ISA_NOT, result_var, operand_var);
-      break;
-    }
-    case UNOP_PRE_INC: {
-      emit_unary_instruction(codegen, ORIONPP_OP_ISA_INC, result_var, operand_var);
+      // !x is x == 0
+      orionpp_variable_id_t zero_var = codegen_get_temp_var(codegen, ORIONPP_TYPE_WORD);
+      int32_t zero = 0;
+      emit_const_instruction(codegen, zero_var, ORIONPP_TYPE_WORD, &zero, sizeof(zero));
+      result_var = codegen_comparison(codegen, BINOP_EQ, operand_var, zero_var);
       break;
     }
+    case UNOP_PRE_INC:
     case UNOP_PRE_DEC: {
-      emit_unary_instruction(codegen, ORIONPP_OP_ISA_DEC, result_var, operand_var);
-      break;
-    }
-    case UNOP_POST_INC: {
-      emit_unary_instruction(codegen, ORIONPP_OP_ISA_INCp, result_var, operand_var);
+      orionpp_opcode_module_t op = node->unary_op.operator == UNOP_PRE_INC ? ORIONPP_OP_ISA_INC : ORIONPP_OP_ISA_DEC;
+      if (node->unary_op.operand->type == AST_IDENTIFIER) {
+        // ++x stores into x and yields it
+        emit_unary_instruction(codegen, op, operand_var, operand_var);
+        result_var = operand_var;
+        break;
+      }
+      codegen_release_temp(codegen, operand_var);
+      result_var = codegen_get_temp_var(codegen, ORIONPP_TYPE_WORD);
+      emit_unary_instruction(codegen, op, result_var, operand_var);
       break;
     }
+    case UNOP_POST_INC:
     case UNOP_POST_DEC: {
-      emit_unary_instruction(codegen, ORIONPP_OP_ISA_DECp, result_var, operand_var);
+      // These write the operand after the result, so the two must differ
+      result_var = codegen_get_temp_var(codegen, ORIONPP_TYPE_WORD);
+      emit_unary_instruction(codegen, node->unary_op.operator == UNOP_POST_INC ? ORIONPP_OP_ISA_INCp : ORIONPP_OP_ISA_DECp,
+                             result_var, operand_var);
+      codegen_release_temp(codegen, operand_var);
       break;
     }
     default:
       codegen_error(codegen, "Unsupported unary operator");
-      break;
+      return 0;
   }
   
   return result_var;
-}
\ No newline at end of file
+}
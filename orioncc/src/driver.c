@@ -0,0 +1,412 @@
+/**
+ * @file src/driver.c
+ * @brief Per-unit compilation, the parallel driver and module merging
+ */
+
+#include "driver.h"
+#include "cache.h"
+#include "intern.h"
+#include "lexer.h"
+#include "optimize.h"
+#include "parser.h"
+#include "orionpp/header.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+  #include <windows.h>
+#else
+  #include <unistd.h>
+#endif
+
+#define OCC_MAX_JOBS 256
+
+// Copies a cached module to the unit's output
+static int fetch_unit(const CompilerOptions* options, CompileUnit* unit, FILE* entry) {
+  FILE* output = unit->output ? unit->output : fopen(unit->output_file, "wb");
+  if (!output) {
+    fprintf(stderr, "Error: Could not open output file '%s'\n", unit->output_file);
+    fclose(entry);
+    return 1;
+  }
+  
+  bool copied = cache_copy(entry, output);
+  if (!unit->output && fclose(output) != 0) copied = false;
+  if (!copied) {
+    fprintf(stderr, "Error: Could not copy the cached module of '%s'\n", unit->input_file);
+    return 1;
+  }
+  
+  if (options->verbose) {
+    printf("info: %s is unchanged, reused the cached module\n", unit->input_file);
+  }
+  unit->cached = true;
+  unit->status = 0;
+  return 0;
+}
+
+// Stores a freshly compiled module; failing to only costs the next hit
+static void store_unit(const CompilerOptions* options, const CompileUnit* unit, const CacheKey* key) {
+  FILE* module = unit->output ? unit->output : fopen(unit->output_file, "rb");
+  if (!module) return;
+  
+  if (!cache_store(options->cache_dir, key, module) && options->verbose) {
+    printf("info: Could not cache the module of %s in %s\n", unit->input_file, options->cache_dir);
+  }
+  if (!unit->output) fclose(module);
+}
+
+int compile_file(const CompilerOptions* options, CompileUnit* unit) {
+  unit->status = 1;
+  
+  if (options->verbose) {
+    printf("info: Compiling %s -> %s\n", unit->input_file, unit->output ? "(merged module)" : unit->output_file);
+  }
+  
+  // Read source file
+  char* source = read_file(unit->input_file);
+  if (!source) {
+    fprintf(stderr, "Error: Could not read file '%s'\n", unit->input_file);
+    return 1;
+  }
+  
+  // An unchanged source is served from the cache without running the front end;
+  // the dumps need the front end, so they bypass it
+  CacheKey key;
+  bool use_cache = options->cache_dir && !options->debug_tokens && !options->debug_ast;
+  if (use_cache) {
+    cache_key(options, source, strlen(source), &key);
+    FILE* entry = cache_lookup(options->cache_dir, &key);
+    if (entry) {
+      free(source);
+      return fetch_unit(options, unit, entry);
+    }
+  }
+  
+  // The AST and the interned identifiers live in one arena freed at the end
+  Arena* arena = ArenaCreate(OCC_ARENA_CHUNK_SIZE);
+  InternTable strings;
+  if (!arena || !intern_init(&strings, arena)) {
+    fprintf(stderr, "Error: Out of memory compiling '%s'\n", unit->input_file);
+    free(source);
+    ArenaFree(arena);
+    return 1;
+  }
+  
+  // Initialize lexer
+  Lexer lexer;
+  lexer_init(&lexer, source, &strings);
+  
+  // Debug tokenization if requested
+  if (options->debug_tokens) {
+    printf("=== TOKENS ===\n");
+    Lexer debug_lexer = lexer;
+    Token token;
+    do {
+      token = lexer_next_token(&debug_lexer);
+      printf("Line %d, Col %d: %s", token.line, token.column, token_type_to_string(token.type));
+      if (token.type == TOKEN_IDENTIFIER || token.type == TOKEN_NUMBER ||
+          token.type == TOKEN_STRING || token.type == TOKEN_CHAR) {
+        printf(" '%.*s'", token.length, token.start);
+      }
+      printf("\n");
+    } while (token.type != TOKEN_EOF && token.type != TOKEN_ERROR);
+    printf("=== END TOKENS ===\n\n");
+  }
+  
+  // Initialize parser
+  Parser parser;
+  parser_init(&parser, &lexer, arena);
+  
+  // Parse source code
+  ASTNode* ast = parse_program(&parser);
+  if (!ast || parser.had_error) {
+    fprintf(stderr, "Error: Parsing '%s' failed\n", unit->input_file);
+    free(source);
+    ArenaFree(arena);
+    return 1;
+  }
+  
+  if (options->opt_level > 0) {
+    OptimizeStats stats;
+    if (!optimize_program(ast, arena, &stats)) {
+      fprintf(stderr, "Error: Out of memory optimizing '%s'\n", unit->input_file);
+      free(source);
+      ArenaFree(arena);
+      return 1;
+    }
+    if (options->verbose) {
+      printf("info: %s: folded %zu, simplified %zu, pruned %zu\n",
+             unit->input_file, stats.folded, stats.simplified, stats.pruned);
+    }
+  }
+  
+  // Debug AST if requested; shows what the code generator sees
+  if (options->debug_ast) {
+    printf("=== AST ===\n");
+    ast_print(ast, 0);
+    printf("=== END AST ===\n\n");
+  }
+  
+  // Open output file
+  FILE* output = unit->output ? unit->output : fopen(unit->output_file, "wb");
+  if (!output) {
+    fprintf(stderr, "Error: Could not open output file '%s'\n", unit->output_file);
+    free(source);
+    ArenaFree(arena);
+    return 1;
+  }
+  
+  // Initialize code generator
+  CodeGen codegen;
+  codegen_init(&codegen, output);
+  codegen.verbose = options->verbose;
+  codegen.opt_level = options->opt_level;
+  
+  // Generate code
+  bool success = codegen_generate(&codegen, ast);
+  
+  // Cleanup
+  if (!unit->output) fclose(output);
+  codegen_cleanup(&codegen);
+  free(source);
+  ArenaFree(arena);
+  
+  if (!success) {
+    fprintf(stderr, "Error: Code generation for '%s' failed\n", unit->input_file);
+    return 1;
+  }
+  
+  if (use_cache) store_unit(options, unit, &key);
+  unit->status = 0;
+  return 0;
+}
+
+char* default_output_file(const char* input_file) {
+  // Replace the extension of the last path component, or append one
+  const char* name = input_file;
+  for (const char* p = input_file; *p; p++) {
+    if (*p == '/' || *p == '\\') name = p + 1;
+  }
+  const char* dot = strrchr(name, '.');
+  size_t stem = dot && dot != name ? (size_t)(dot - input_file) : strlen(input_file);
+  
+  char* output_file = malloc(stem + sizeof(".opp"));
+  if (!output_file) return NULL;
+  memcpy(output_file, input_file, stem);
+  memcpy(output_file + stem, ".opp", sizeof(".opp"));
+  return output_file;
+}
+
+static size_t online_cores(void) {
+#ifdef WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors;
+#else
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return cores > 0 ? (size_t)cores : 1;
+#endif
+}
+
+typedef struct {
+  const CompilerOptions* options;
+  CompileUnit* units;
+  size_t unit_count;
+  atomic_size_t next; // first unit nobody has claimed
+  atomic_size_t failed;
+} CompileBatch;
+
+// Units differ a lot in size, so workers claim them one at a time
+static void* compile_worker(void* arg) {
+  CompileBatch* batch = arg;
+  
+  size_t index;
+  while ((index = atomic_fetch_add_explicit(&batch->next, 1, memory_order_relaxed)) < batch->unit_count) {
+    if (compile_file(batch->options, &batch->units[index]) != 0) {
+      atomic_fetch_add_explicit(&batch->failed, 1, memory_order_relaxed);
+    }
+  }
+  return NULL;
+}
+
+static size_t run_workers(CompileBatch* batch, size_t threads) {
+  pthread_t handles[OCC_MAX_JOBS];
+  
+  // The calling thread doubles as the first worker
+  size_t started = 1;
+  for (; started < threads; started++) {
+    if (pthread_create(&handles[started], NULL, compile_worker, batch) != 0) break;
+  }
+  compile_worker(batch);
+  for (size_t i = 1; i < started; i++) {
+    pthread_join(handles[i], NULL);
+  }
+  return atomic_load(&batch->failed);
+}
+
+int compile_files(const CompilerOptions* options) {
+  size_t count = options->input_count;
+  if (count == 0) return 1;
+  
+  CompileUnit* units = calloc(count, sizeof(CompileUnit));
+  char** derived = calloc(count, sizeof(char*));
+  if (!units || !derived) {
+    fprintf(stderr, "Error: Out of memory\n");
+    free(units);
+    free(derived);
+    return 1;
+  }
+  
+  int result = 1;
+  for (size_t i = 0; i < count; i++) {
+    units[i].input_file = options->input_files[i];
+    if (options->merge) {
+      // Units are merged from scratch files once all of them are compiled
+      units[i].output = tmpfile();
+      if (!units[i].output) {
+        fprintf(stderr, "Error: Could not create a temporary file for '%s'\n", units[i].input_file);
+        goto cleanup;
+      }
+    } else if (options->output_file && count == 1) {
+      units[i].output_file = options->output_file;
+    } else {
+      units[i].output_file = derived[i] = default_output_file(units[i].input_file);
+      if (!derived[i]) {
+        fprintf(stderr, "Error: Out of memory\n");
+        goto cleanup;
+      }
+    }
+  }
+  
+  // Token and AST dumps would interleave, so they compile one unit at a time
+  size_t threads = options->jobs ? options->jobs : online_cores();
+  if (options->debug_tokens || options->debug_ast) threads = 1;
+  if (threads > count) threads = count;
+  if (threads > OCC_MAX_JOBS) threads = OCC_MAX_JOBS;
+  
+  CompileBatch batch = { .options = options, .units = units, .unit_count = count };
+  atomic_init(&batch.next, 0);
+  atomic_init(&batch.failed, 0);
+  
+  size_t failed = run_workers(&batch, threads);
+  if (failed > 0) {
+    if (count > 1) fprintf(stderr, "Error: %zu of %zu files failed to compile\n", failed, count);
+    goto cleanup;
+  }
+  
+  result = 0;
+  if (options->merge) {
+    result = merge_units(units, count, options->output_file ? options->output_file : "out.opp");
+  }
+
+cleanup:
+  for (size_t i = 0; i < count; i++) {
+    if (units[i].output) fclose(units[i].output);
+    free(derived[i]);
+  }
+  free(units);
+  free(derived);
+  return result;
+}
+
+// Adds base to a variable or label id operand in place and records the
+// range the unit uses, so the next unit can start past it
+static void rebase_id(orionpp_byte_t* bytes, uint32_t bytesize, uint32_t base, uint32_t* next_base) {
+  if (bytesize != sizeof(uint32_t)) return;
+  
+  uint32_t id;
+  memcpy(&id, bytes, sizeof(id));
+  id += base;
+  memcpy(bytes, &id, sizeof(id));
+  if (id >= *next_base) *next_base = id + 1;
+}
+
+// Copies the code records of one compiled unit to the writer. Cached units
+// never ran the code generator, so the id ranges come from the module itself.
+static int merge_unit(orionpp_stream_t* writer, const CompileUnit* unit, uint32_t* var_base, uint32_t* label_base) {
+  fflush(unit->output);
+  rewind(unit->output);
+  
+  orionpp_stream_t reader;
+  orionpp_byte_t* data = NULL;
+  size_t size = 0;
+  orionpp_error_t err = orionpp_stream_reader(&reader, codegen_file_handle(unit->output), 0);
+  if (err == ORIONPP_ERROR_GOOD) err = orionpp_stream_read_all(&reader, &data, &size);
+  orionpp_stream_close(&reader);
+  if (err != ORIONPP_ERROR_GOOD) {
+    fprintf(stderr, "Error: Could not read back '%s': %s\n", unit->input_file, orionpp_strerr(err));
+    return 1;
+  }
+  
+  const orionpp_header_t* header = (const orionpp_header_t*)data;
+  if (size < sizeof(*header) || orionpp_header_validate(header) != ORIONPP_ERROR_GOOD ||
+      header->codetab > size - sizeof(orionpp_code_table_t)) {
+    fprintf(stderr, "Error: Compiled module of '%s' is malformed\n", unit->input_file);
+    free(data);
+    return 1;
+  }
+  
+  // Records are aligned, so the payloads can be patched in place
+  uint32_t var_start = *var_base;
+  uint32_t label_start = *label_base;
+  orionpp_byte_t* p = data + header->codetab + sizeof(orionpp_code_table_t);
+  orionpp_byte_t* end = data + size;
+  while (p + sizeof(orionpp_code_record_t) <= end) {
+    orionpp_code_record_t record;
+    memcpy(&record, p, sizeof(record));
+    p += sizeof(record);
+    orionpp_stream_write_record(writer, record.root, record.child, record.value_count);
+  
+    for (uint16_t i = 0; i < record.value_count; i++) {
+      orionpp_code_value_t value;
+      if (p + sizeof(value) > end) break;
+      memcpy(&value, p, sizeof(value));
+      p += sizeof(value);
+      if (value.bytesize > (size_t)(end - p)) break;
+  
+      if (value.root == ORIONPP_TYPE_VARID) rebase_id(p, value.bytesize, var_start, var_base);
+      if (value.root == ORIONPP_TYPE_LABELID) rebase_id(p, value.bytesize, label_start, label_base);
+      orionpp_stream_write_value(writer, value.root, value.child, p, value.bytesize);
+      p += ORIONPP_CODE_ALIGN((size_t)value.bytesize);
+    }
+  }
+  
+  free(data);
+  return 0;
+}
+
+int merge_units(const CompileUnit* units, size_t count, const char* output_file) {
+  FILE* output = fopen(output_file, "wb");
+  if (!output) {
+    fprintf(stderr, "Error: Could not open output file '%s'\n", output_file);
+    return 1;
+  }
+  
+  orionpp_stream_t writer;
+  orionpp_code_table_t table = { ORIONPP_CODE_UNCOUNTED, ORIONPP_CODE_UNCOUNTED };
+  if (orionpp_stream_writer(&writer, codegen_file_handle(output), 0) != ORIONPP_ERROR_GOOD) {
+    fprintf(stderr, "Error: Out of memory\n");
+    fclose(output);
+    return 1;
+  }
+  orionpp_stream_write_image_header(&writer, &table);
+  
+  // Each unit numbers from zero; later units are shifted past the earlier ones
+  int result = 0;
+  uint32_t var_base = 0;
+  uint32_t label_base = 0;
+  for (size_t i = 0; i < count && result == 0; i++) {
+    result = merge_unit(&writer, &units[i], &var_base, &label_base);
+  }
+  
+  orionpp_error_t err = orionpp_stream_close(&writer);
+  if (result == 0 && err != ORIONPP_ERROR_GOOD) {
+    fprintf(stderr, "Error: Failed to write '%s': %s\n", output_file, orionpp_strerr(err));
+    result = 1;
+  }
+  fclose(output);
+  return result;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file src/intern.c
+ * @brief String interning implementation
+ */
+
+#include "intern.h"
+#include <string.h>
+
+#define INTERN_INITIAL_CAPACITY 256
+
+bool intern_init(InternTable* table, Arena* arena) {
+  table->arena = arena;
+  table->capacity = INTERN_INITIAL_CAPACITY;
+  table->count = 0;
+  table->slots = ArenaAlloc(arena, table->capacity * sizeof(const char*)); // zeroed by the arena
+  return table->slots != NULL;
+}
+
+// Outgrown slot arrays stay in the arena; they add up to less than the live one
+static bool intern_grow(InternTable* table) {
+  size_t capacity = table->capacity * 2;
+  const char** slots = ArenaAlloc(table->arena, capacity * sizeof(const char*)); // zeroed by the arena
+  if (!slots) return false;
+  
+  for (size_t i = 0; i < table->capacity; i++) {
+    const char* handle = table->slots[i];
+    if (!handle) continue;
+  
+    size_t index = intern_hash(handle) & (capacity - 1);
+    while (slots[index]) {
+      index = (index + 1) & (capacity - 1);
+    }
+    slots[index] = handle;
+  }
+  
+  table->slots = slots;
+  table->capacity = capacity;
+  return true;
+}
+
+const char* intern_string(InternTable* table, const char* text, size_t length) {
+  uint32_t hash = str_hash(text, length);
+  size_t index = hash & (table->capacity - 1);
+  
+  const char* handle;
+  while ((handle = table->slots[index]) != NULL) {
+    if (intern_hash(handle) == hash && intern_length(handle) == length && memcmp(handle, text, length) == 0) {
+      return handle;
+    }
+    index = (index + 1) & (table->capacity - 1);
+  }
+  
+  // Keep probe sequences short: at most half full. Growing first means a
+  // failed allocation leaves the table as it was.
+  if ((table->count + 1) * 2 > table->capacity) {
+    if (!intern_grow(table)) return NULL;
+    index = hash & (table->capacity - 1);
+    while (table->slots[index]) {
+      index = (index + 1) & (table->capacity - 1);
+    }
+  }
+  
+  InternHeader* header = ArenaAllocAligned(table->arena, sizeof(InternHeader) + length + 1, _Alignof(InternHeader));
+  if (!header) return NULL;
+  header->hash = hash;
+  header->length = (uint32_t)length;
+  char* copy = (char*)(header + 1);
+  memcpy(copy, text, length);
+  copy[length] = '\0';
+  
+  table->slots[index] = copy;
+  table->count++;
+  return copy;
+}
+
+const char* intern_cstr(InternTable* table, const char* text) {
+  return intern_string(table, text, strlen(text));
+}
@@ -0,0 +1,763 @@
+/**
+ * @file src/ir.c
+ * @brief SSA construction from the AST and the helpers shared by the IR passes
+ *
+ * Construction follows Braun et al., "Simple and Efficient Construction of
+ * Static Single Assignment Form": each local's current value is looked up per
+ * block, and phis are placed on demand, completed when their block is sealed.
+ */
+
+#include "ir.h"
+#include <string.h>
+
+IRValue* ir_resolve(IRValue* value) {
+  while (value && value->forward) value = value->forward;
+  return value;
+}
+
+void* ir_alloc(IRFunction* fn, size_t size) {
+  void* memory = ArenaAlloc(fn->arena, size);
+  if (!memory) fn->failed = true;
+  return memory;
+}
+
+static void* ir_grow(IRFunction* fn, void* items, size_t count, size_t item_size) {
+  void* grown = arena_grow_array(fn->arena, items, count, item_size);
+  if (!grown) fn->failed = true;
+  return grown;
+}
+
+IRValue* ir_new_value(IRFunction* fn, IROpcode op, orionpp_type_t type) {
+  IRValue* value = ir_alloc(fn, sizeof(IRValue));
+  if (!value) return NULL;
+  value->op = op;
+  value->type = type;
+  value->id = fn->value_count++;
+  return value;
+}
+
+IRBlock* ir_new_block(IRFunction* fn) {
+  IRBlock* block = ir_alloc(fn, sizeof(IRBlock));
+  IRBlock** blocks = block ? ir_grow(fn, fn->blocks, fn->block_count, sizeof(IRBlock*)) : NULL;
+  if (!blocks) return NULL;
+  block->id = (uint32_t)fn->block_count;
+  block->terminator = IR_EXIT;
+  block->rpo = UINT32_MAX;
+  fn->blocks = blocks;
+  fn->blocks[fn->block_count++] = block;
+  return block;
+}
+
+bool ir_add_arg(IRFunction* fn, IRValue* value, IRValue* arg) {
+  IRValue** args = ir_grow(fn, value->args, value->arg_count, sizeof(IRValue*));
+  if (!args) return false;
+  value->args = args;
+  value->args[value->arg_count++] = arg;
+  return true;
+}
+
+bool ir_append(IRFunction* fn, IRBlock* block, IRValue* value) {
+  IRValue** values = ir_grow(fn, block->values, block->value_count, sizeof(IRValue*));
+  if (!values) return false;
+  block->values = values;
+  block->values[block->value_count++] = value;
+  value->block = block;
+  return true;
+}
+
+void ir_sweep(IRFunction* fn) {
+  for (size_t b = 0; b < fn->block_count; b++) {
+    IRBlock* block = fn->blocks[b];
+    size_t kept = 0;
+    for (size_t i = 0; i < block->value_count; i++) {
+      IRValue* value = block->values[i];
+      if (value->forward || value->block != block) continue;
+      for (uint32_t a = 0; a < value->arg_count; a++) {
+        value->args[a] = ir_resolve(value->args[a]);
+      }
+      block->values[kept++] = value;
+    }
+    block->value_count = block->removed ? 0 : kept;
+    block->condition = ir_resolve(block->condition);
+  }
+}
+
+bool ir_add_pred(IRFunction* fn, IRBlock* block, IRBlock* pred) {
+  IRBlock** preds = ir_grow(fn, block->preds, block->pred_count, sizeof(IRBlock*));
+  if (!preds) return false;
+  block->preds = preds;
+  block->preds[block->pred_count++] = pred;
+  return true;
+}
+
+void ir_remove_pred(IRBlock* block, size_t index) {
+  size_t tail = block->pred_count - index - 1;
+  memmove(&block->preds[index], &block->preds[index + 1], tail * sizeof(IRBlock*));
+  block->pred_count--;
+  
+  for (size_t i = 0; i < block->value_count && block->values[i]->op == IR_PHI; i++) {
+    IRValue* phi = block->values[i];
+    if (index >= phi->arg_count) continue;
+    memmove(&phi->args[index], &phi->args[index + 1], (phi->arg_count - index - 1) * sizeof(IRValue*));
+    phi->arg_count--;
+  }
+}
+
+size_t ir_successor_count(const IRBlock* block) {
+  switch (block->terminator) {
+    case IR_JUMP: return 1;
+    case IR_BRANCH: return 2;
+    default: return 0;
+  }
+}
+
+static IRBlock* intersect(IRBlock* a, IRBlock* b) {
+  while (a != b) {
+    while (a->rpo > b->rpo) a = a->idom;
+    while (b->rpo > a->rpo) b = b->idom;
+  }
+  return a;
+}
+
+// Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm"
+bool ir_compute_dominators(IRFunction* fn) {
+  // Everything is allocated up front, so failing leaves the blocks untouched
+  IRBlock** order = ir_alloc(fn, fn->block_count * sizeof(IRBlock*));
+  IRBlock** stack = ir_alloc(fn, fn->block_count * sizeof(IRBlock*));
+  uint8_t* next = ir_alloc(fn, fn->block_count);
+  IRBlock** rpo = ir_alloc(fn, fn->block_count * sizeof(IRBlock*));
+  if (!order || !stack || !next || !rpo) return false;
+  
+  for (size_t i = 0; i < fn->block_count; i++) {
+    fn->blocks[i]->rpo = UINT32_MAX;
+    fn->blocks[i]->idom = NULL;
+  }
+  
+  // Post-order by an explicit depth-first walk; rpo marks blocks on the way
+  size_t count = 0, depth = 0;
+  stack[depth++] = fn->entry;
+  fn->entry->rpo = 0;
+  while (depth > 0) {
+    IRBlock* block = stack[depth - 1];
+    if (next[block->id] < ir_successor_count(block)) {
+      IRBlock* succ = block->targets[next[block->id]++];
+      if (succ->rpo == UINT32_MAX) {
+        succ->rpo = 0;
+        stack[depth++] = succ;
+      }
+    } else {
+      order[count++] = block;
+      depth--;
+    }
+  }
+  
+  fn->rpo = rpo;
+  fn->rpo_count = count;
+  for (size_t i = 0; i < count; i++) {
+    fn->rpo[i] = order[count - 1 - i];
+    fn->rpo[i]->rpo = (uint32_t)i;
+  }
+  
+  fn->entry->idom = fn->entry;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t i = 1; i < count; i++) {
+      IRBlock* block = fn->rpo[i];
+      IRBlock* idom = NULL;
+      for (size_t p = 0; p < block->pred_count; p++) {
+        IRBlock* pred = block->preds[p];
+        if (pred->rpo == UINT32_MAX || !pred->idom) continue;
+        idom = idom ? intersect(pred, idom) : pred;
+      }
+      if (idom != block->idom) {
+        block->idom = idom;
+        changed = true;
+      }
+    }
+  }
+  
+  for (size_t i = 0; i < count; i++) {
+    IRBlock* block = fn->rpo[i];
+    block->depth = i == 0 ? 0 : block->idom->depth + 1;
+  }
+  return true;
+}
+
+bool ir_dominates(const IRBlock* a, const IRBlock* b) {
+  if (a->rpo == UINT32_MAX || b->rpo == UINT32_MAX) return false;
+  while (b->depth > a->depth) b = b->idom;
+  return a == b;
+}
+
+bool ir_has_side_effects(const IRValue* value) {
+  switch (value->op) {
+    case IR_CALL:
+    case IR_STORE_GLOBAL:
+      return true;
+    case IR_BINARY:
+      // Division faults on zero, so it stays unless the divisor is known
+      if (value->operator == BINOP_DIV || value->operator == BINOP_MOD) {
+        const IRValue* divisor = ir_resolve(value->args[1]);
+        return divisor->op != IR_CONST || divisor->imm == 0;
+      }
+      return false;
+    default:
+      return false;
+  }
+}
+
+// Construction
+
+// Current value of one local at the end of one block
+typedef struct {
+  uint64_t key; // block id << 32 | local + 1, 0 when empty
+  IRValue* value;
+} IRDefinition;
+
+typedef struct {
+  CodeGen* codegen;
+  IRFunction* fn;
+  IRBlock* current;
+  IRBlock* exit;
+  SymbolTable locals; // var_id is the index into local_types
+  orionpp_type_t* local_types;
+  uint32_t local_count;
+  IRDefinition* defs;
+  size_t def_capacity; // power of two
+  size_t def_count;
+} IRBuilder;
+
+static IRValue* build_expression(IRBuilder* b, const ASTNode* node);
+static void build_statement(IRBuilder* b, const ASTNode* node);
+static IRValue* read_variable(IRBuilder* b, uint32_t local, IRBlock* block);
+
+// Stops construction after an error or once the arena has run out
+static bool stopped(const IRBuilder* b) {
+  return b->codegen->had_error || b->fn->failed;
+}
+
+static orionpp_type_t ir_type(DataType type) {
+  return type == TYPE_CHAR ? ORIONPP_TYPE_C : ORIONPP_TYPE_WORD;
+}
+
+static IRDefinition* def_slot(IRDefinition* defs, size_t capacity, uint64_t key) {
+  size_t mask = capacity - 1;
+  size_t i = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+  while (defs[i].key != 0 && defs[i].key != key) i = (i + 1) & mask;
+  return &defs[i];
+}
+
+static void def_write(IRBuilder* b, IRBlock* block, uint32_t local, IRValue* value) {
+  if ((b->def_count + 1) * 2 > b->def_capacity) {
+    size_t capacity = b->def_capacity ? b->def_capacity * 2 : 64;
+    IRDefinition* defs = ir_alloc(b->fn, capacity * sizeof(IRDefinition));
+    if (!defs) return;
+    for (size_t i = 0; i < b->def_capacity; i++) {
+      if (b->defs[i].key != 0) *def_slot(defs, capacity, b->defs[i].key) = b->defs[i];
+    }
+    b->defs = defs;
+    b->def_capacity = capacity;
+  }
+  
+  IRDefinition* slot = def_slot(b->defs, b->def_capacity, (uint64_t)block->id << 32 | (local + 1));
+  if (slot->key == 0) b->def_count++;
+  slot->key = (uint64_t)block->id << 32 | (local + 1);
+  slot->value = value;
+}
+
+static IRValue* def_read(IRBuilder* b, IRBlock* block, uint32_t local) {
+  if (b->def_capacity == 0) return NULL;
+  IRDefinition* slot = def_slot(b->defs, b->def_capacity, (uint64_t)block->id << 32 | (local + 1));
+  return slot->key != 0 ? ir_resolve(slot->value) : NULL;
+}
+
+// A local with no name, for values merged from several blocks. Until the
+// builder stops, a failure only shows in fn->failed.
+static uint32_t add_local(IRBuilder* b, orionpp_type_t type) {
+  orionpp_type_t* types = ir_grow(b->fn, b->local_types, b->local_count, sizeof(orionpp_type_t));
+  if (!types) return 0;
+  b->local_types = types;
+  b->local_types[b->local_count] = type;
+  return b->local_count++;
+}
+
+static uint32_t declare_local(IRBuilder* b, const char* name, DataType type) {
+  Symbol* symbol = symtab_declare(&b->locals, name, type);
+  if (!symbol) {
+    b->fn->failed = true;
+    return 0;
+  }
+  symbol->var_id = add_local(b, ir_type(type));
+  return symbol->var_id;
+}
+
+// The emit functions return NULL once the arena has run out
+static IRValue* emit(IRBuilder* b, IROpcode op, orionpp_type_t type) {
+  IRValue* value = ir_new_value(b->fn, op, type);
+  if (!value || !ir_append(b->fn, b->current, value)) return NULL;
+  return value;
+}
+
+static IRValue* emit_constant(IRBuilder* b, orionpp_type_t type, int64_t imm) {
+  IRValue* value = emit(b, IR_CONST, type);
+  if (value) value->imm = imm;
+  return value;
+}
+
+static IRValue* emit_binary(IRBuilder* b, IROpcode op, BinaryOperator operator, IRValue* left, IRValue* right) {
+  if (!left || !right) return NULL;
+  IRValue* value = emit(b, op, ORIONPP_TYPE_WORD);
+  if (!value) return NULL;
+  value->operator = operator;
+  if (!ir_add_arg(b->fn, value, left) || !ir_add_arg(b->fn, value, right)) return NULL;
+  return value;
+}
+
+// A local read before any assignment holds 0, like a freshly declared variable
+static IRValue* undefined(IRBuilder* b, uint32_t local) {
+  IRValue* value = ir_new_value(b->fn, IR_CONST, b->local_types[local]);
+  if (!value || !ir_append(b->fn, b->fn->entry, value)) return NULL;
+  return value;
+}
+
+static IRValue* new_phi(IRBuilder* b, IRBlock* block, uint32_t local) {
+  IRValue* phi = ir_new_value(b->fn, IR_PHI, b->local_types[local]);
+  if (!phi) return NULL;
+  phi->local = local;
+  
+  // Phis stay ahead of the block's other values
+  size_t position = 0;
+  while (position < block->value_count && block->values[position]->op == IR_PHI) position++;
+  if (!ir_append(b->fn, block, phi)) return NULL;
+  memmove(&block->values[position + 1], &block->values[position], (block->value_count - 1 - position) * sizeof(IRValue*));
+  block->values[position] = phi;
+  return phi;
+}
+
+static IRValue* remove_trivial_phi(IRBuilder* b, IRValue* phi) {
+  IRValue* same = NULL;
+  for (uint32_t i = 0; i < phi->arg_count; i++) {
+    IRValue* arg = ir_resolve(phi->args[i]);
+    if (arg == same || arg == phi) continue;
+    if (same) return phi;
+    same = arg;
+  }
+  
+  // Phis that only see themselves are unreachable or read before assignment
+  phi->forward = same ? same : undefined(b, phi->local);
+  return phi->forward;
+}
+
+static IRValue* add_phi_operands(IRBuilder* b, IRValue* phi) {
+  IRBlock* block = phi->block;
+  for (size_t i = 0; i < block->pred_count; i++) {
+    IRValue* arg = read_variable(b, phi->local, block->preds[i]);
+    if (!arg || !ir_add_arg(b->fn, phi, arg)) return NULL;
+  }
+  return remove_trivial_phi(b, phi);
+}
+
+static IRValue* read_variable(IRBuilder* b, uint32_t local, IRBlock* block) {
+  // A definition that could not be recorded would send loops around forever
+  if (b->fn->failed) return NULL;
+  IRValue* value = def_read(b, block, local);
+  if (value) return value;
+  
+  if (!block->sealed) {
+    // Completed by seal_block once every predecessor is known
+    value = new_phi(b, block, local);
+  } else if (block->pred_count == 0) {
+    value = undefined(b, local);
+  } else if (block->pred_count == 1) {
+    value = read_variable(b, local, block->preds[0]);
+  } else {
+    // Written first so that loops reaching back here find the phi
+    value = new_phi(b, block, local);
+    if (!value) return NULL;
+    def_write(b, block, local, value);
+    value = add_phi_operands(b, value);
+  }
+  if (!value) return NULL;
+  def_write(b, block, local, value);
+  return value;
+}
+
+static void seal_block(IRBuilder* b, IRBlock* block) {
+  // Completing a phi can add more incomplete ones to this block; they come later
+  for (size_t i = 0; i < block->value_count && block->values[i]->op == IR_PHI; i++) {
+    IRValue* phi = block->values[i];
+    if (!phi->forward && phi->arg_count == 0) add_phi_operands(b, phi);
+  }
+  block->sealed = true;
+}
+
+static IRBlock* new_block(IRBuilder* b, bool sealed) {
+  IRBlock* block = ir_new_block(b->fn);
+  if (block) block->sealed = sealed;
+  return block;
+}
+
+static void jump(IRBuilder* b, IRBlock* target) {
+  b->current->terminator = IR_JUMP;
+  b->current->targets[0] = target;
+  ir_add_pred(b->fn, target, b->current);
+}
+
+static void branch(IRBuilder* b, IRValue* condition, IRBlock* if_true, IRBlock* if_false) {
+  b->current->terminator = IR_BRANCH;
+  b->current->condition = condition;
+  b->current->targets[0] = if_true;
+  b->current->targets[1] = if_false;
+  ir_add_pred(b->fn, if_true, b->current);
+  ir_add_pred(b->fn, if_false, b->current);
+}
+
+// Assignment to a local or global; returns the value the variable now holds
+static IRValue* assign(IRBuilder* b, const char* name, IRValue* value) {
+  Symbol* local = symtab_find(&b->locals, name);
+  if (local) {
+    orionpp_type_t type = b->local_types[local->var_id];
+    IRValue* copy = emit(b, value->type == type ? IR_COPY : IR_CONVERT, type);
+    if (!copy || !ir_add_arg(b->fn, copy, value)) return NULL;
+    def_write(b, b->current, local->var_id, copy);
+    return copy;
+  }
+  
+  Symbol* global = codegen_find_symbol(b->codegen, name);
+  if (!global) {
+    codegen_error(b->codegen, "Undefined variable");
+    return NULL;
+  }
+  IRValue* store = emit(b, IR_STORE_GLOBAL, ir_type(global->type));
+  if (!store) return NULL;
+  store->var = global->var_id;
+  if (!ir_add_arg(b->fn, store, value)) return NULL;
+  IRValue* load = emit(b, IR_LOAD_GLOBAL, store->type);
+  if (load) load->var = global->var_id;
+  return load;
+}
+
+static IRValue* build_identifier(IRBuilder* b, const char* name) {
+  Symbol* local = symtab_find(&b->locals, name);
+  if (local) return read_variable(b, local->var_id, b->current);
+  
+  Symbol* global = codegen_find_symbol(b->codegen, name);
+  if (!global) {
+    codegen_error(b->codegen, "Undefined variable");
+    return NULL;
+  }
+  IRValue* load = emit(b, IR_LOAD_GLOBAL, ir_type(global->type));
+  if (load) load->var = global->var_id;
+  return load;
+}
+
+static IRValue* build_unary(IRBuilder* b, const ASTNode* node) {
+  IRValue* operand = build_expression(b, node->unary_op.operand);
+  if (!operand) return NULL;
+  
+  UnaryOperator operator = node->unary_op.operator;
+  switch (operator) {
+    case UNOP_MINUS:
+      return emit_binary(b, IR_BINARY, BINOP_SUB, emit_constant(b, ORIONPP_TYPE_WORD, 0), operand);
+    case UNOP_NOT:
+      return emit_binary(b, IR_COMPARE, BINOP_EQ, operand, emit_constant(b, ORIONPP_TYPE_WORD, 0));
+    case UNOP_PRE_INC:
+    case UNOP_PRE_DEC:
+    case UNOP_POST_INC:
+    case UNOP_POST_DEC: {
+      bool increment = operator == UNOP_PRE_INC || operator == UNOP_POST_INC;
+      IRValue* value = emit_binary(b, IR_BINARY, increment ? BINOP_ADD : BINOP_SUB, operand,
+                                   emit_constant(b, ORIONPP_TYPE_WORD, 1));
+      if (!value) return NULL;
+      if (node->unary_op.operand->type == AST_IDENTIFIER) {
+        IRValue* stored = assign(b, node->unary_op.operand->identifier.name, value);
+        if (!stored) return NULL;
+        value = stored;
+      }
+      return operator == UNOP_PRE_INC || operator == UNOP_PRE_DEC ? value : operand;
+    }
+    default:
+      codegen_error(b->codegen, "Unsupported unary operator");
+      return NULL;
+  }
+}
+
+// Ends the current block with a branch on node. The right operand of && and
+// || gets a block of its own, entered only when the left one does not decide.
+static bool build_condition(IRBuilder* b, const ASTNode* node, IRBlock* if_true, IRBlock* if_false) {
+  if (node->type == AST_UNARY_OP && node->unary_op.operator == UNOP_NOT) {
+    return build_condition(b, node->unary_op.operand, if_false, if_true);
+  }
+  
+  if (node->type == AST_BINARY_OP && (node->binary_op.operator == BINOP_AND || node->binary_op.operator == BINOP_OR)) {
+    IRBlock* right = new_block(b, false);
+    if (!right) return false;
+    bool is_and = node->binary_op.operator == BINOP_AND;
+    if (!build_condition(b, node->binary_op.left, is_and ? right : if_true, is_and ? if_false : right)) return false;
+    seal_block(b, right);
+    b->current = right;
+    return build_condition(b, node->binary_op.right, if_true, if_false);
+  }
+  
+  if (node->type == AST_NUMBER) {
+    jump(b, node->number.value != 0 ? if_true : if_false);
+    return true;
+  }
+  
+  IRValue* condition = build_expression(b, node);
+  if (!condition) return false;
+  branch(b, condition, if_true, if_false);
+  return true;
+}
+
+// && and || as values: a phi of 1 and 0 behind the branches of build_condition
+static IRValue* build_logical(IRBuilder* b, const ASTNode* node) {
+  uint32_t local = add_local(b, ORIONPP_TYPE_WORD);
+  IRBlock* if_true = new_block(b, false);
+  IRBlock* if_false = new_block(b, false);
+  IRBlock* join = new_block(b, false);
+  if (stopped(b) || !build_condition(b, node, if_true, if_false)) return NULL;
+  seal_block(b, if_true);
+  seal_block(b, if_false);
+  
+  b->current = if_true;
+  def_write(b, if_true, local, emit_constant(b, ORIONPP_TYPE_WORD, 1));
+  jump(b, join);
+  b->current = if_false;
+  def_write(b, if_false, local, emit_constant(b, ORIONPP_TYPE_WORD, 0));
+  jump(b, join);
+  
+  seal_block(b, join);
+  b->current = join;
+  return read_variable(b, local, join);
+}
+
+static IRValue* build_expression(IRBuilder* b, const ASTNode* node) {
+  if (!node) {
+    codegen_error(b->codegen, "Expression node is null");
+    return NULL;
+  }
+  
+  switch (node->type) {
+    case AST_NUMBER:
+      return emit_constant(b, ORIONPP_TYPE_WORD, (int32_t)node->number.value);
+    case AST_CHAR:
+      return emit_constant(b, ORIONPP_TYPE_C, node->character.value);
+    case AST_STRING: {
+      IRValue* value = emit(b, IR_CONST, ORIONPP_TYPE_STRING);
+      if (value) value->text = node->string.value;
+      return value;
+    }
+    case AST_IDENTIFIER:
+      return build_identifier(b, node->identifier.name);
+    case AST_ASSIGNMENT: {
+      IRValue* value = build_expression(b, node->assignment.value);
+      return value ? assign(b, node->assignment.name, value) : NULL;
+    }
+    case AST_BINARY_OP: {
+      if (node->binary_op.operator == BINOP_AND || node->binary_op.operator == BINOP_OR) {
+        return build_logical(b, node);
+      }
+      IRValue* left = build_expression(b, node->binary_op.left);
+      if (!left) return NULL;
+      IRValue* right = build_expression(b, node->binary_op.right);
+      if (!right) return NULL;
+  
+      switch (node->binary_op.operator) {
+        case BINOP_EQ:
+        case BINOP_NE:
+        case BINOP_LT:
+        case BINOP_LE:
+        case BINOP_GT:
+        case BINOP_GE:
+          return emit_binary(b, IR_COMPARE, node->binary_op.operator, left, right);
+        default:
+          return emit_binary(b, IR_BINARY, node->binary_op.operator, left, right);
+      }
+    }
+    case AST_UNARY_OP:
+      return build_unary(b, node);
+    case AST_CALL: {
+      IRValue* call = ir_new_value(b->fn, IR_CALL, ORIONPP_TYPE_WORD);
+      if (!call) return NULL;
+      call->text = node->call.name;
+      for (size_t i = 0; i < node->call.argument_count; i++) {
+        IRValue* arg = build_expression(b, node->call.arguments[i]);
+        if (!arg || !ir_add_arg(b->fn, call, arg)) return NULL;
+      }
+      // Appended after the arguments, which it reads
+      return ir_append(b->fn, b->current, call) ? call : NULL;
+    }
+    default:
+      codegen_error(b->codegen, "Unknown expression type");
+      return NULL;
+  }
+}
+
+static void build_block(IRBuilder* b, const ASTNode* node) {
+  if (!symtab_enter_scope(&b->locals)) {
+    b->fn->failed = true;
+    return;
+  }
+  for (size_t i = 0; i < node->block.statement_count; i++) {
+    build_statement(b, node->block.statements[i]);
+    if (stopped(b)) break;
+  }
+  symtab_leave_scope(&b->locals);
+}
+
+static void build_if(IRBuilder* b, const ASTNode* node) {
+  IRBlock* then_block = new_block(b, false);
+  IRBlock* else_block = node->if_stmt.else_branch ? new_block(b, false) : NULL;
+  IRBlock* join = new_block(b, false);
+  if (stopped(b)) return;
+  if (!build_condition(b, node->if_stmt.condition, then_block, else_block ? else_block : join)) return;
+  seal_block(b, then_block);
+  if (else_block) seal_block(b, else_block);
+  
+  b->current = then_block;
+  build_statement(b, node->if_stmt.then_branch);
+  jump(b, join);
+  if (else_block) {
+    b->current = else_block;
+    build_statement(b, node->if_stmt.else_branch);
+    jump(b, join);
+  }
+  seal_block(b, join);
+  b->current = join;
+}
+
+// Shared by while and for: header evaluates condition, body runs then update
+static void build_loop(IRBuilder* b, const ASTNode* condition, const ASTNode* body, const ASTNode* update) {
+  IRBlock* header = new_block(b, false);
+  IRBlock* body_block = new_block(b, false);
+  IRBlock* after = new_block(b, false);
+  if (stopped(b)) return;
+  jump(b, header);
+  
+  b->current = header;
+  if (condition) {
+    if (!build_condition(b, condition, body_block, after)) return;
+  } else {
+    jump(b, body_block);
+  }
+  seal_block(b, body_block);
+  
+  b->current = body_block;
+  build_statement(b, body);
+  if (update && !stopped(b)) build_expression(b, update);
+  jump(b, header);
+  seal_block(b, header);
+  seal_block(b, after);
+  b->current = after;
+}
+
+static void build_statement(IRBuilder* b, const ASTNode* node) {
+  if (!node || stopped(b)) return;
+  
+  switch (node->type) {
+    case AST_BLOCK:
+      build_block(b, node);
+      break;
+    case AST_IF:
+      build_if(b, node);
+      break;
+    case AST_WHILE:
+      build_loop(b, node->while_stmt.condition, node->while_stmt.body, NULL);
+      break;
+    case AST_FOR:
+      // A declaration in the initializer is scoped to the loop
+      if (!symtab_enter_scope(&b->locals)) {
+        b->fn->failed = true;
+        break;
+      }
+      build_statement(b, node->for_stmt.init);
+      if (!stopped(b)) {
+        build_loop(b, node->for_stmt.condition, node->for_stmt.body, node->for_stmt.update);
+      }
+      symtab_leave_scope(&b->locals);
+      break;
+    case AST_RETURN: {
+      IRValue* value = NULL;
+      if (node->return_stmt.value) {
+        value = build_expression(b, node->return_stmt.value);
+        if (!value) return;
+      }
+      // Anything after the return is unreachable until a label joins it again
+      IRBlock* unreachable = new_block(b, true);
+      if (!unreachable) return;
+      b->current->terminator = IR_RETURN;
+      b->current->condition = value;
+      b->current = unreachable;
+      break;
+    }
+    case AST_ASSIGNMENT:
+    case AST_EXPRESSION_STMT:
+      build_expression(b, node->type == AST_ASSIGNMENT ? node : node->expression_stmt.expression);
+      break;
+    case AST_VARIABLE_DECL: {
+      uint32_t local = declare_local(b, node->variable_decl.name, node->variable_decl.type);
+      if (b->fn->failed) break;
+      if (node->variable_decl.initializer) {
+        IRValue* value = build_expression(b, node->variable_decl.initializer);
+        if (value) assign(b, node->variable_decl.name, value);
+      } else {
+        // Each declaration starts over, even inside a loop
+        def_write(b, b->current, local, undefined(b, local));
+      }
+      break;
+    }
+    case AST_FUNCTION:
+      codegen_error(b->codegen, "Nested functions are not supported");
+      break;
+    default:
+      codegen_error(b->codegen, "Unknown statement type");
+      break;
+  }
+}
+
+static void build_body(IRBuilder* b, const ASTNode* function) {
+  IRFunction* fn = b->fn;
+  fn->entry = new_block(b, true);
+  b->exit = new_block(b, false);
+  if (fn->failed) return;
+  b->current = fn->entry;
+  
+  // Parameters arrive in the variables the code generator declared for them
+  for (size_t i = 0; i < function->function.parameter_count; i++) {
+    const ASTNode* param = function->function.parameters[i];
+    if (param->type != AST_VARIABLE_DECL) continue;
+    Symbol* symbol = codegen_find_symbol(b->codegen, param->variable_decl.name);
+    uint32_t local = declare_local(b, param->variable_decl.name, param->variable_decl.type);
+    if (fn->failed) return;
+    IRValue* value = emit(b, IR_PARAM, b->local_types[local]);
+    if (!value) return;
+    value->var = symbol->var_id;
+    def_write(b, fn->entry, local, value);
+  }
+  
+  build_statement(b, function->function.body);
+  jump(b, b->exit);
+  seal_block(b, b->exit);
+}
+
+IRFunction* ir_build_function(CodeGen* codegen, const ASTNode* function, Arena* arena) {
+  IRFunction* fn = ArenaAlloc(arena, sizeof(IRFunction));
+  if (!fn) {
+    codegen_error(codegen, "Out of memory building IR");
+    return NULL;
+  }
+  fn->arena = arena;
+  fn->name = function->function.name;
+  
+  IRBuilder b = { .codegen = codegen, .fn = fn };
+  if (symtab_init(&b.locals)) build_body(&b, function);
+  else fn->failed = true;
+  symtab_free(&b.locals);
+  
+  if (fn->failed) codegen_error(codegen, "Out of memory building IR");
+  if (codegen->had_error) return NULL;
+  ir_sweep(fn);
+  return fn;
+}
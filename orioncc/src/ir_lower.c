@@ -0,0 +1,539 @@
+/**
+ * @file src/ir_lower.c
+ * @brief Lowering of optimized SSA back to Orion++ through the emit_* functions
+ *
+ * Phis become copies at the end of their predecessors, after edges from
+ * branches into blocks with phis are split. Every value then gets a VM
+ * variable from a linear scan over live intervals, so values that are never
+ * live at once share one, as temporaries do on the direct path. A
+ * comparison read only by the branch ending its block becomes that branch.
+ */
+
+#include "ir.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_VREG UINT32_MAX
+
+typedef struct {
+  uint32_t* ids;
+  size_t count;
+} LocationPool;
+
+typedef struct {
+  CodeGen* codegen;
+  IRFunction* fn;
+  IRBlock** layout;
+  size_t layout_count;
+  IRValue** vregs; // by vreg
+  size_t vreg_count;
+  uint32_t* start; // live interval by vreg, in instruction positions
+  uint32_t* end;
+  orionpp_variable_id_t* location; // by vreg
+  bool* fused; // by value id: comparisons emitted as their block's branch
+  bool* labelled; // by block id
+  orionpp_label_id_t* labels;
+  LocationPool word_pool;
+  LocationPool char_pool;
+  orionpp_variable_id_t scratch[2]; // breaks copy cycles, WORD and C; 0 until needed
+  size_t declared;
+  size_t peak_live;
+} Lowering;
+
+static bool has_phis(const IRBlock* block) {
+  return block->value_count > 0 && block->values[0]->op == IR_PHI;
+}
+
+// The block whose phis read the copies at the end of block, if any
+static IRBlock* phi_successor(const IRBlock* block) {
+  return block->terminator == IR_JUMP && has_phis(block->targets[0]) ? block->targets[0] : NULL;
+}
+
+static size_t pred_index(const IRBlock* block, const IRBlock* pred) {
+  size_t i = 0;
+  while (block->preds[i] != pred) i++;
+  return i;
+}
+
+// The stages below return false once the function's arena has run out
+
+// Copies for phis need a block of their own on edges out of a branch
+static bool split_critical_edges(IRFunction* fn) {
+  for (size_t r = 0; r < fn->rpo_count; r++) {
+    IRBlock* block = fn->rpo[r];
+    if (block->terminator != IR_BRANCH) continue;
+    for (size_t s = 0; s < 2; s++) {
+      IRBlock* succ = block->targets[s];
+      if (!has_phis(succ)) continue;
+      IRBlock* split = ir_new_block(fn);
+      if (!split || !ir_add_pred(fn, split, block)) return false;
+      split->terminator = IR_JUMP;
+      split->targets[0] = succ;
+      succ->preds[pred_index(succ, block)] = split;
+      block->targets[s] = split;
+    }
+  }
+  return ir_compute_dominators(fn);
+}
+
+// Reverse post-order with the block that falls off the end last
+static bool lay_out(Lowering* l) {
+  IRFunction* fn = l->fn;
+  l->layout = ir_alloc(fn, fn->rpo_count * sizeof(IRBlock*));
+  if (!l->layout) return false;
+  IRBlock* exit = NULL;
+  for (size_t r = 0; r < fn->rpo_count; r++) {
+    IRBlock* block = fn->rpo[r];
+    if (block->terminator == IR_EXIT && !exit) exit = block;
+    else l->layout[l->layout_count++] = block;
+  }
+  if (exit) l->layout[l->layout_count++] = exit;
+  return true;
+}
+
+// Comparisons used once, by the branch of their own block, need no 1 or 0
+static bool fuse_comparisons(Lowering* l) {
+  IRFunction* fn = l->fn;
+  uint32_t* uses = ir_alloc(fn, fn->value_count * sizeof(uint32_t));
+  l->fused = ir_alloc(fn, fn->value_count * sizeof(bool));
+  if (!uses || !l->fused) return false;
+  for (size_t i = 0; i < l->layout_count; i++) {
+    IRBlock* block = l->layout[i];
+    for (size_t v = 0; v < block->value_count; v++) {
+      IRValue* value = block->values[v];
+      for (uint32_t a = 0; a < value->arg_count; a++) uses[value->args[a]->id]++;
+    }
+    if (block->condition) uses[block->condition->id]++;
+  }
+  for (size_t i = 0; i < l->layout_count; i++) {
+    IRBlock* block = l->layout[i];
+    IRValue* condition = block->condition;
+    if (block->terminator == IR_BRANCH && condition->op == IR_COMPARE && condition->block == block &&
+        uses[condition->id] == 1) {
+      l->fused[condition->id] = true;
+    }
+  }
+  return true;
+}
+
+static bool needs_location(const Lowering* l, const IRValue* value) {
+  return value->op != IR_STORE_GLOBAL && !l->fused[value->id];
+}
+
+static bool number_values(Lowering* l) {
+  IRFunction* fn = l->fn;
+  l->vregs = ir_alloc(fn, fn->value_count * sizeof(IRValue*));
+  if (!l->vregs) return false;
+  for (size_t i = 0; i < l->layout_count; i++) {
+    IRBlock* block = l->layout[i];
+    for (size_t v = 0; v < block->value_count; v++) {
+      IRValue* value = block->values[v];
+      value->vreg = NO_VREG;
+      if (!needs_location(l, value)) continue;
+      value->vreg = (uint32_t)l->vreg_count;
+      l->vregs[l->vreg_count++] = value;
+    }
+  }
+  return true;
+}
+
+static void extend(Lowering* l, uint32_t vreg, uint32_t position) {
+  if (vreg == NO_VREG) return;
+  if (position < l->start[vreg]) l->start[vreg] = position;
+  if (position > l->end[vreg]) l->end[vreg] = position;
+}
+
+static void set_bit(uint64_t* bits, uint32_t index) {
+  bits[index / 64] |= (uint64_t)1 << (index % 64);
+}
+
+static bool test_bit(const uint64_t* bits, uint32_t index) {
+  return (bits[index / 64] >> (index % 64)) & 1;
+}
+
+// Reads not preceded by a write in the block go to gen, writes to kill
+static void note_use(uint64_t* gen, const uint64_t* kill, const IRValue* value) {
+  if (value->vreg != NO_VREG && !test_bit(kill, value->vreg)) set_bit(gen, value->vreg);
+}
+
+// One interval per value from its first to its last live position
+static bool build_intervals(Lowering* l) {
+  IRFunction* fn = l->fn;
+  size_t words = (l->vreg_count + 63) / 64;
+  size_t count = l->layout_count;
+  uint64_t* sets = ir_alloc(fn, 4 * count * words * sizeof(uint64_t));
+  uint32_t* index = ir_alloc(fn, fn->block_count * sizeof(uint32_t));
+  l->start = ir_alloc(fn, l->vreg_count * sizeof(uint32_t));
+  l->end = ir_alloc(fn, l->vreg_count * sizeof(uint32_t));
+  if (!sets || !index || !l->start || !l->end) return false;
+  uint64_t* gen = sets;
+  uint64_t* kill = sets + count * words;
+  uint64_t* live_in = sets + 2 * count * words;
+  uint64_t* live_out = sets + 3 * count * words;
+  
+  for (size_t i = 0; i < count; i++) {
+    IRBlock* block = l->layout[i];
+    uint64_t* g = gen + i * words;
+    uint64_t* k = kill + i * words;
+    index[block->id] = (uint32_t)i;
+  
+    for (size_t v = 0; v < block->value_count; v++) {
+      IRValue* value = block->values[v];
+      if (value->op == IR_PHI) continue;
+      for (uint32_t a = 0; a < value->arg_count; a++) note_use(g, k, value->args[a]);
+      if (value->vreg != NO_VREG) set_bit(k, value->vreg);
+    }
+  
+    // Phi copies read all their sources before writing any phi
+    IRBlock* succ = phi_successor(block);
+    if (succ) {
+      size_t p = pred_index(succ, block);
+      for (size_t v = 0; v < succ->value_count && succ->values[v]->op == IR_PHI; v++) {
+        note_use(g, k, succ->values[v]->args[p]);
+      }
+      for (size_t v = 0; v < succ->value_count && succ->values[v]->op == IR_PHI; v++) {
+        set_bit(k, succ->values[v]->vreg);
+      }
+    }
+    if (block->condition) note_use(g, k, block->condition);
+  }
+  
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t i = count; i-- > 0;) {
+      IRBlock* block = l->layout[i];
+      uint64_t* in = live_in + i * words;
+      uint64_t* out = live_out + i * words;
+      for (size_t s = 0; s < ir_successor_count(block); s++) {
+        const uint64_t* succ_in = live_in + index[block->targets[s]->id] * words;
+        for (size_t w = 0; w < words; w++) out[w] |= succ_in[w];
+      }
+      for (size_t w = 0; w < words; w++) {
+        uint64_t bits = gen[i * words + w] | (out[w] & ~kill[i * words + w]);
+        if (bits != in[w]) {
+          in[w] = bits;
+          changed = true;
+        }
+      }
+    }
+  }
+  
+  memset(l->start, 0xff, l->vreg_count * sizeof(uint32_t));
+  
+  // Positions: block start, one per value, the phi copies, the terminator
+  uint32_t position = 0;
+  for (size_t i = 0; i < count; i++) {
+    IRBlock* block = l->layout[i];
+    uint32_t block_start = position++;
+    for (size_t v = 0; v < block->value_count; v++) {
+      IRValue* value = block->values[v];
+      if (value->op == IR_PHI) continue;
+      for (uint32_t a = 0; a < value->arg_count; a++) extend(l, value->args[a]->vreg, position);
+      extend(l, value->vreg, position);
+      position++;
+    }
+    IRBlock* succ = phi_successor(block);
+    if (succ) {
+      size_t p = pred_index(succ, block);
+      for (size_t v = 0; v < succ->value_count && succ->values[v]->op == IR_PHI; v++) {
+        extend(l, succ->values[v]->args[p]->vreg, position);
+        extend(l, succ->values[v]->vreg, position);
+      }
+      position++;
+    }
+    if (block->condition && l->fused[block->condition->id]) {
+      extend(l, block->condition->args[0]->vreg, position);
+      extend(l, block->condition->args[1]->vreg, position);
+    } else if (block->condition) {
+      extend(l, block->condition->vreg, position);
+    }
+    uint32_t block_end = position++;
+  
+    for (size_t w = 0; w < words; w++) {
+      for (uint64_t bits = live_in[i * words + w]; bits; bits &= bits - 1) {
+        extend(l, (uint32_t)(w * 64 + __builtin_ctzll(bits)), block_start);
+      }
+      for (uint64_t bits = live_out[i * words + w]; bits; bits &= bits - 1) {
+        extend(l, (uint32_t)(w * 64 + __builtin_ctzll(bits)), block_end);
+      }
+    }
+  }
+  return true;
+}
+
+static LocationPool* pool_for(Lowering* l, orionpp_type_t type) {
+  return type == ORIONPP_TYPE_C ? &l->char_pool : &l->word_pool;
+}
+
+static orionpp_variable_id_t new_location(Lowering* l, orionpp_type_t type) {
+  orionpp_variable_id_t var = l->codegen->next_var_id++;
+  emit_var_instruction(l->codegen, var, type);
+  l->declared++;
+  return var;
+}
+
+static int compare_keys(const void* a, const void* b) {
+  uint64_t x = *(const uint64_t*)a;
+  uint64_t y = *(const uint64_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+// Linear scan: an interval may take a variable whose interval ends where it
+// starts, since every instruction reads its operands before writing
+static bool allocate_locations(Lowering* l) {
+  IRFunction* fn = l->fn;
+  l->location = ir_alloc(fn, l->vreg_count * sizeof(orionpp_variable_id_t));
+  uint64_t* order = ir_alloc(fn, l->vreg_count * sizeof(uint64_t)); // start << 32 | vreg
+  uint32_t* active = ir_alloc(fn, l->vreg_count * sizeof(uint32_t));
+  l->word_pool.ids = ir_alloc(fn, l->vreg_count * sizeof(uint32_t));
+  l->char_pool.ids = ir_alloc(fn, l->vreg_count * sizeof(uint32_t));
+  if (!l->location || !order || !active || !l->word_pool.ids || !l->char_pool.ids) return false;
+  
+  size_t allocated = 0;
+  for (uint32_t vreg = 0; vreg < l->vreg_count; vreg++) {
+    IRValue* value = l->vregs[vreg];
+    if (value->op == IR_PARAM) l->location[vreg] = value->var;
+    else if (value->type == ORIONPP_TYPE_STRING) l->location[vreg] = l->codegen->next_var_id++;
+    else order[allocated++] = (uint64_t)l->start[vreg] << 32 | vreg;
+  }
+  qsort(order, allocated, sizeof(uint64_t), compare_keys);
+  
+  size_t active_count = 0;
+  for (size_t i = 0; i < allocated; i++) {
+    uint32_t vreg = (uint32_t)order[i];
+    size_t kept = 0;
+    for (size_t a = 0; a < active_count; a++) {
+      uint32_t other = active[a];
+      if (l->end[other] <= l->start[vreg]) {
+        LocationPool* pool = pool_for(l, l->vregs[other]->type);
+        pool->ids[pool->count++] = l->location[other];
+      } else {
+        active[kept++] = other;
+      }
+    }
+    active_count = kept;
+  
+    LocationPool* pool = pool_for(l, l->vregs[vreg]->type);
+    l->location[vreg] = pool->count > 0 ? pool->ids[--pool->count] : new_location(l, l->vregs[vreg]->type);
+    active[active_count++] = vreg;
+    if (active_count > l->peak_live) l->peak_live = active_count;
+  }
+  return true;
+}
+
+static orionpp_variable_id_t location_of(const Lowering* l, const IRValue* value) {
+  return l->location[value->vreg];
+}
+
+static orionpp_label_id_t label_of(Lowering* l, const IRBlock* block) {
+  return l->labels[block->id];
+}
+
+static void lower_value(Lowering* l, IRValue* value) {
+  CodeGen* codegen = l->codegen;
+  orionpp_variable_id_t dest = value->vreg != NO_VREG ? location_of(l, value) : 0;
+  switch (value->op) {
+    case IR_CONST:
+      if (value->type == ORIONPP_TYPE_STRING) {
+        emit_const_instruction(codegen, dest, value->type, value->text, strlen(value->text) + 1);
+      } else if (value->type == ORIONPP_TYPE_C) {
+        char imm = (char)value->imm;
+        emit_const_instruction(codegen, dest, value->type, &imm, sizeof(imm));
+      } else {
+        int32_t imm = (int32_t)value->imm;
+        emit_const_instruction(codegen, dest, value->type, &imm, sizeof(imm));
+      }
+      break;
+    case IR_PARAM:
+    case IR_PHI:
+      break;
+    case IR_COPY:
+    case IR_CONVERT:
+      if (dest != location_of(l, value->args[0])) emit_mov_instruction(codegen, dest, location_of(l, value->args[0]));
+      break;
+    case IR_BINARY: {
+      orionpp_opcode_module_t op;
+      if (!codegen_binary_opcode(value->operator, &op)) {
+        codegen_error(codegen, "Unsupported binary operator");
+        return;
+      }
+      emit_binary_instruction(codegen, op, dest, location_of(l, value->args[0]), location_of(l, value->args[1]));
+      break;
+    }
+    case IR_COMPARE:
+      if (l->fused[value->id]) break;
+      emit_comparison(codegen, value->operator, dest, location_of(l, value->args[0]), location_of(l, value->args[1]));
+      break;
+    case IR_CALL: {
+      orionpp_variable_id_t* args = NULL;
+      if (value->arg_count > 0) {
+        args = malloc(value->arg_count * sizeof(orionpp_variable_id_t));
+        if (!args) {
+          codegen_error(codegen, "Out of memory generating call");
+          return;
+        }
+        for (uint32_t i = 0; i < value->arg_count; i++) args[i] = location_of(l, value->args[i]);
+      }
+      emit_call_instruction(codegen, value->text, args, value->arg_count, dest);
+      free(args);
+      break;
+    }
+    case IR_LOAD_GLOBAL:
+      emit_mov_instruction(codegen, dest, value->var);
+      break;
+    case IR_STORE_GLOBAL:
+      emit_mov_instruction(codegen, value->var, location_of(l, value->args[0]));
+      break;
+  }
+}
+
+// Copies into the phis of succ as one parallel assignment: a copy goes once
+// no pending copy still reads its destination, and a cycle is broken by
+// saving one destination in the scratch variable of its type
+static void lower_phi_copies(Lowering* l, IRBlock* block, IRBlock* succ) {
+  size_t p = pred_index(succ, block);
+  size_t count = 0;
+  while (count < succ->value_count && succ->values[count]->op == IR_PHI) count++;
+  
+  orionpp_variable_id_t* dests = malloc(count * sizeof(orionpp_variable_id_t));
+  orionpp_variable_id_t* sources = malloc(count * sizeof(orionpp_variable_id_t));
+  orionpp_type_t* types = malloc(count * sizeof(orionpp_type_t));
+  if (!dests || !sources || !types) {
+    free(dests);
+    free(sources);
+    free(types);
+    codegen_error(l->codegen, "Out of memory lowering phis");
+    return;
+  }
+  
+  size_t pending = 0;
+  for (size_t i = 0; i < count; i++) {
+    IRValue* phi = succ->values[i];
+    orionpp_variable_id_t dest = location_of(l, phi);
+    orionpp_variable_id_t source = location_of(l, phi->args[p]);
+    if (dest == source) continue;
+    dests[pending] = dest;
+    sources[pending] = source;
+    types[pending] = phi->type;
+    pending++;
+  }
+  
+  while (pending > 0) {
+    size_t ready = pending;
+    for (size_t i = 0; i < pending && ready == pending; i++) {
+      bool read = false;
+      for (size_t j = 0; j < pending && !read; j++) read = j != i && sources[j] == dests[i];
+      if (!read) ready = i;
+    }
+  
+    if (ready == pending) {
+      size_t slot = types[0] == ORIONPP_TYPE_C ? 1 : 0;
+      if (l->scratch[slot] == 0) l->scratch[slot] = new_location(l, types[0]);
+      emit_mov_instruction(l->codegen, l->scratch[slot], dests[0]);
+      for (size_t j = 0; j < pending; j++) {
+        if (sources[j] == dests[0]) sources[j] = l->scratch[slot];
+      }
+      continue;
+    }
+  
+    emit_mov_instruction(l->codegen, dests[ready], sources[ready]);
+    pending--;
+    dests[ready] = dests[pending];
+    sources[ready] = sources[pending];
+    types[ready] = types[pending];
+  }
+  free(dests);
+  free(sources);
+  free(types);
+}
+
+// Labels only where control arrives other than by falling through
+static bool assign_labels(Lowering* l) {
+  IRFunction* fn = l->fn;
+  l->labelled = ir_alloc(fn, fn->block_count * sizeof(bool));
+  l->labels = ir_alloc(fn, fn->block_count * sizeof(orionpp_label_id_t));
+  if (!l->labelled || !l->labels) return false;
+  for (size_t i = 0; i < l->layout_count; i++) {
+    IRBlock* block = l->layout[i];
+    IRBlock* next = i + 1 < l->layout_count ? l->layout[i + 1] : NULL;
+    if (block->terminator == IR_JUMP && block->targets[0] != next) {
+      l->labelled[block->targets[0]->id] = true;
+    } else if (block->terminator == IR_BRANCH) {
+      if (block->targets[0] != next) l->labelled[block->targets[0]->id] = true;
+      if (block->targets[1] != next) l->labelled[block->targets[1]->id] = true;
+    }
+  }
+  for (size_t i = 0; i < l->layout_count; i++) {
+    IRBlock* block = l->layout[i];
+    if (l->labelled[block->id]) l->labels[block->id] = codegen_get_label(l->codegen);
+  }
+  return true;
+}
+
+static void lower_terminator(Lowering* l, IRBlock* block, IRBlock* next) {
+  CodeGen* codegen = l->codegen;
+  switch (block->terminator) {
+    case IR_JUMP:
+      if (block->targets[0] != next) emit_jump_instruction(codegen, label_of(l, block->targets[0]));
+      break;
+    case IR_BRANCH: {
+      IRValue* compare = block->condition;
+      if (l->fused[compare->id]) {
+        // Branch on the comparison, or on its negation to skip to the false target
+        BinaryOperator op = block->targets[0] == next ? codegen_negate_comparison(compare->operator) : compare->operator;
+        orionpp_opcode_module_t branch_op;
+        codegen_branch_opcode(op, &branch_op);
+        emit_conditional_branch_instruction(codegen, branch_op, location_of(l, compare->args[0]), location_of(l, compare->args[1]),
+                                            label_of(l, block->targets[block->targets[0] == next ? 1 : 0]));
+        if (block->targets[0] != next && block->targets[1] != next) {
+          emit_jump_instruction(codegen, label_of(l, block->targets[1]));
+        }
+        break;
+      }
+      orionpp_variable_id_t condition = location_of(l, compare);
+      if (block->targets[1] == next) {
+        emit_zero_branch_instruction(codegen, ORIONPP_OP_ISA_BRNZ, condition, label_of(l, block->targets[0]));
+      } else {
+        emit_zero_branch_instruction(codegen, ORIONPP_OP_ISA_BRZ, condition, label_of(l, block->targets[1]));
+        if (block->targets[0] != next) emit_jump_instruction(codegen, label_of(l, block->targets[0]));
+      }
+      break;
+    }
+    case IR_RETURN:
+      if (block->condition) {
+        orionpp_variable_id_t value = location_of(l, block->condition);
+        emit_return_instruction(codegen, &value);
+      } else {
+        emit_return_instruction(codegen, NULL);
+      }
+      break;
+    case IR_EXIT:
+      // Laid out last, so it falls off the end
+      break;
+  }
+}
+
+void ir_lower(CodeGen* codegen, IRFunction* fn) {
+  Lowering l = { .codegen = codegen, .fn = fn };
+  if (!split_critical_edges(fn) || !lay_out(&l) || !fuse_comparisons(&l) || !number_values(&l) ||
+      !build_intervals(&l) || !allocate_locations(&l) || !assign_labels(&l)) {
+    codegen_error(codegen, "Out of memory lowering IR");
+    return;
+  }
+  
+  for (size_t i = 0; i < l.layout_count && !codegen->had_error; i++) {
+    IRBlock* block = l.layout[i];
+    IRBlock* next = i + 1 < l.layout_count ? l.layout[i + 1] : NULL;
+    if (l.labelled[block->id]) emit_label_instruction(codegen, label_of(&l, block));
+    for (size_t v = 0; v < block->value_count; v++) lower_value(&l, block->values[v]);
+    IRBlock* succ = phi_successor(block);
+    if (succ) lower_phi_copies(&l, block, succ);
+    lower_terminator(&l, block, next);
+  }
+  
+  // Reported like the temporaries of the direct path
+  codegen->temps.requested = l.vreg_count;
+  codegen->temps.declared = l.declared;
+  codegen->temps.peak_live = l.peak_live;
+}
@@ -0,0 +1,520 @@
+/**
+ * @file src/ir_opt.c
+ * @brief Optimization passes over the SSA form
+ *
+ * Each pass only marks what it changes: replaced values get a forward
+ * pointer, deleted ones lose their block, and ir_sweep tidies up between
+ * passes. Values are pure unless ir_has_side_effects says otherwise, so any
+ * value nobody reads can go and identical ones can share a result.
+ */
+
+#include "ir.h"
+#include "optimize.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Rounds of the whole pipeline; later rounds only pick up what earlier ones exposed
+#define IR_MAX_ROUNDS 16
+
+static bool is_live(const IRBlock* block, const IRValue* value) {
+  return !value->forward && value->block == block;
+}
+
+static bool word_constant(const IRValue* value, int64_t* imm) {
+  if (value->op != IR_CONST || value->type != ORIONPP_TYPE_WORD) return false;
+  *imm = value->imm;
+  return true;
+}
+
+static size_t count_values(const IRFunction* fn) {
+  size_t count = 0;
+  for (size_t b = 0; b < fn->block_count; b++) {
+    const IRBlock* block = fn->blocks[b];
+    if (block->removed) continue;
+    for (size_t i = 0; i < block->value_count; i++) {
+      if (is_live(block, block->values[i])) count++;
+    }
+  }
+  return count;
+}
+
+// The only argument of a phi other than itself, or NULL when there are several
+static IRValue* unique_argument(IRValue* phi) {
+  IRValue* same = NULL;
+  for (uint32_t i = 0; i < phi->arg_count; i++) {
+    IRValue* arg = ir_resolve(phi->args[i]);
+    if (arg == phi || arg == same) continue;
+    if (same) return NULL;
+    same = arg;
+  }
+  return same;
+}
+
+// Copies, conversions to the type a value already has, and trivial phis
+static size_t propagate_copies(IRFunction* fn) {
+  size_t count = 0;
+  for (size_t b = 0; b < fn->block_count; b++) {
+    IRBlock* block = fn->blocks[b];
+    if (block->removed) continue;
+    for (size_t i = 0; i < block->value_count; i++) {
+      IRValue* value = block->values[i];
+      if (!is_live(block, value)) continue;
+  
+      IRValue* same = NULL;
+      if (value->op == IR_COPY) {
+        same = ir_resolve(value->args[0]);
+      } else if (value->op == IR_CONVERT) {
+        IRValue* arg = ir_resolve(value->args[0]);
+        if (arg->type == value->type) same = arg;
+      } else if (value->op == IR_PHI) {
+        same = unique_argument(value);
+      }
+      if (same) {
+        value->forward = same;
+        count++;
+      }
+    }
+  }
+  return count;
+}
+
+static void make_constant(IRValue* value, int64_t imm) {
+  value->op = IR_CONST;
+  value->type = ORIONPP_TYPE_WORD;
+  value->imm = imm;
+  value->arg_count = 0;
+}
+
+// Operators on constants, and x + 0, x - 0 and x * 1 once propagation exposes them
+static size_t fold_constants(IRFunction* fn) {
+  size_t count = 0;
+  for (size_t b = 0; b < fn->block_count; b++) {
+    IRBlock* block = fn->blocks[b];
+    if (block->removed) continue;
+    for (size_t i = 0; i < block->value_count; i++) {
+      IRValue* value = block->values[i];
+      if (!is_live(block, value)) continue;
+  
+      int64_t left = 0, right = 0, result;
+      if (value->op != IR_BINARY && value->op != IR_COMPARE) continue;
+  
+      IRValue* lhs = ir_resolve(value->args[0]);
+      IRValue* rhs = ir_resolve(value->args[1]);
+      bool lconst = word_constant(lhs, &left);
+      bool rconst = word_constant(rhs, &right);
+      if (lconst && rconst && optimize_fold_binary(value->operator, left, right, &result)) {
+        make_constant(value, result);
+        count++;
+        continue;
+      }
+      if (value->op != IR_BINARY) continue;
+  
+      // The survivor must already be a WORD, as the result would have been
+      IRValue* same = NULL;
+      switch (value->operator) {
+        case BINOP_ADD:
+          if (rconst && right == 0) same = lhs;
+          else if (lconst && left == 0) same = rhs;
+          break;
+        case BINOP_SUB:
+          if (rconst && right == 0) same = lhs;
+          break;
+        case BINOP_MUL:
+          if (rconst && right == 1) same = lhs;
+          else if (lconst && left == 1) same = rhs;
+          break;
+        default:
+          break;
+      }
+      if (same && same->type == ORIONPP_TYPE_WORD) {
+        value->forward = same;
+        count++;
+      }
+    }
+  }
+  return count;
+}
+
+// Common subexpressions
+
+typedef struct IRExpression {
+  IRValue* value;
+  struct IRExpression* next;
+} IRExpression;
+
+static bool is_commutative(BinaryOperator operator) {
+  switch (operator) {
+    case BINOP_ADD:
+    case BINOP_MUL:
+    case BINOP_EQ:
+    case BINOP_NE:
+    case BINOP_BIT_AND:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Strings get a variable of their own each, so they are never shared
+static bool is_expression(const IRValue* value) {
+  switch (value->op) {
+    case IR_CONST:
+      return value->type != ORIONPP_TYPE_STRING;
+    case IR_BINARY:
+      return !ir_has_side_effects(value);
+    case IR_COMPARE:
+    case IR_CONVERT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static uint64_t expression_hash(const IRValue* value) {
+  uint64_t hash = (uint64_t)value->op * 31 + (uint64_t)value->operator * 7 + value->type;
+  if (value->op == IR_CONST) return hash ^ (uint64_t)value->imm * 0x9E3779B97F4A7C15ull;
+  
+  bool unordered = value->op != IR_CONVERT && is_commutative(value->operator);
+  for (uint32_t i = 0; i < value->arg_count; i++) {
+    uint64_t id = ir_resolve(value->args[i])->id + 1;
+    hash = unordered ? hash + id * 0x9E3779B97F4A7C15ull : (hash ^ id) * 0x100000001B3ull;
+  }
+  return hash;
+}
+
+static bool same_expression(const IRValue* a, const IRValue* b) {
+  if (a->op != b->op || a->type != b->type || a->arg_count != b->arg_count) return false;
+  if (a->op == IR_CONST) return a->imm == b->imm;
+  if ((a->op == IR_BINARY || a->op == IR_COMPARE) && a->operator != b->operator) return false;
+  
+  bool in_order = true, swapped = a->arg_count == 2;
+  for (uint32_t i = 0; i < a->arg_count; i++) {
+    in_order = in_order && ir_resolve(a->args[i]) == ir_resolve(b->args[i]);
+    swapped = swapped && ir_resolve(a->args[i]) == ir_resolve(b->args[1 - i]);
+  }
+  return in_order || (swapped && a->op != IR_CONVERT && is_commutative(a->operator));
+}
+
+// Replaces each expression by an identical one in a dominating position.
+// Blocks go in reverse post-order, so every dominator is seen first.
+static size_t eliminate_common(IRFunction* fn) {
+  size_t capacity = 64;
+  while (capacity < (size_t)fn->value_count * 2) capacity *= 2;
+  IRExpression** table = calloc(capacity, sizeof(IRExpression*));
+  if (!table) return 0;
+  
+  size_t count = 0;
+  for (size_t r = 0; r < fn->rpo_count && !fn->failed; r++) {
+    IRBlock* block = fn->rpo[r];
+    for (size_t i = 0; i < block->value_count; i++) {
+      IRValue* value = block->values[i];
+      if (!is_live(block, value) || !is_expression(value)) continue;
+  
+      IRExpression** bucket = &table[expression_hash(value) & (capacity - 1)];
+      IRExpression* entry = *bucket;
+      while (entry && !(same_expression(entry->value, value) && ir_dominates(entry->value->block, block))) {
+        entry = entry->next;
+      }
+      if (entry) {
+        value->forward = entry->value;
+        count++;
+      } else {
+        entry = ir_alloc(fn, sizeof(IRExpression));
+        if (!entry) break;
+        entry->value = value;
+        entry->next = *bucket;
+        *bucket = entry;
+      }
+    }
+  }
+  free(table);
+  return count;
+}
+
+// Keeps what has side effects, decides a branch or is returned, and what they read
+static size_t eliminate_dead(IRFunction* fn) {
+  uint8_t* live = calloc(fn->value_count, 1);
+  IRValue** worklist = malloc(fn->value_count * sizeof(IRValue*));
+  if (!live || !worklist) {
+    free(live);
+    free(worklist);
+    return 0;
+  }
+  
+  size_t pending = 0;
+  for (size_t b = 0; b < fn->block_count; b++) {
+    IRBlock* block = fn->blocks[b];
+    if (block->removed) continue;
+    for (size_t i = 0; i < block->value_count; i++) {
+      IRValue* value = block->values[i];
+      if (is_live(block, value) && ir_has_side_effects(value) && !live[value->id]) {
+        live[value->id] = 1;
+        worklist[pending++] = value;
+      }
+    }
+    IRValue* condition = ir_resolve(block->condition);
+    if (condition && !live[condition->id]) {
+      live[condition->id] = 1;
+      worklist[pending++] = condition;
+    }
+  }
+  
+  while (pending > 0) {
+    IRValue* value = worklist[--pending];
+    for (uint32_t i = 0; i < value->arg_count; i++) {
+      IRValue* arg = ir_resolve(value->args[i]);
+      if (!live[arg->id]) {
+        live[arg->id] = 1;
+        worklist[pending++] = arg;
+      }
+    }
+  }
+  
+  size_t count = 0;
+  for (size_t b = 0; b < fn->block_count; b++) {
+    IRBlock* block = fn->blocks[b];
+    if (block->removed) continue;
+    for (size_t i = 0; i < block->value_count; i++) {
+      IRValue* value = block->values[i];
+      if (is_live(block, value) && !live[value->id]) {
+        value->block = NULL;
+        count++;
+      }
+    }
+  }
+  free(live);
+  free(worklist);
+  return count;
+}
+
+// Control flow
+
+static size_t pred_index(const IRBlock* block, const IRBlock* pred) {
+  size_t i = 0;
+  while (block->preds[i] != pred) i++;
+  return i;
+}
+
+static bool has_phis(const IRBlock* block) {
+  for (size_t i = 0; i < block->value_count && block->values[i]->op == IR_PHI; i++) {
+    if (is_live(block, block->values[i])) return true;
+  }
+  return false;
+}
+
+static bool is_empty(const IRBlock* block) {
+  for (size_t i = 0; i < block->value_count; i++) {
+    if (is_live(block, block->values[i])) return false;
+  }
+  return true;
+}
+
+static void remove_block(IRBlock* block) {
+  block->removed = true;
+  block->pred_count = 0;
+  block->terminator = IR_EXIT;
+  block->condition = NULL;
+}
+
+// Folds branches that always go one way, drops unreachable blocks, lets
+// predecessors skip blocks that only jump, and merges straight-line pairs
+static size_t simplify_branches(IRFunction* fn) {
+  size_t count = 0;
+  for (size_t b = 0; b < fn->block_count; b++) {
+    IRBlock* block = fn->blocks[b];
+    if (block->removed || block->terminator != IR_BRANCH) continue;
+  
+    const IRValue* condition = ir_resolve(block->condition);
+    size_t taken;
+    if (block->targets[0] == block->targets[1]) taken = 0;
+    else if (condition->op == IR_CONST && condition->type != ORIONPP_TYPE_STRING) taken = condition->imm != 0 ? 0 : 1;
+    else continue;
+  
+    IRBlock* dropped = block->targets[1 - taken];
+    ir_remove_pred(dropped, pred_index(dropped, block));
+    block->terminator = IR_JUMP;
+    block->targets[0] = block->targets[taken];
+    block->condition = NULL;
+    count++;
+  }
+  
+  // Without the order every block would look unreachable
+  if (!ir_compute_dominators(fn)) return count;
+  for (size_t b = 0; b < fn->block_count; b++) {
+    IRBlock* block = fn->blocks[b];
+    if (block->removed || block->rpo != UINT32_MAX) continue;
+    for (size_t s = 0; s < ir_successor_count(block); s++) {
+      IRBlock* succ = block->targets[s];
+      if (succ->removed) continue;
+      for (size_t p = succ->pred_count; p-- > 0;) {
+        if (succ->preds[p] == block) ir_remove_pred(succ, p);
+      }
+    }
+    remove_block(block);
+    count++;
+  }
+  
+  for (size_t b = 0; b < fn->block_count; b++) {
+    IRBlock* block = fn->blocks[b];
+    if (block->removed || block == fn->entry || block->terminator != IR_JUMP) continue;
+    IRBlock* target = block->targets[0];
+    if (target == block || !is_empty(block) || has_phis(target)) continue;
+  
+    // One entry per edge, so a branch with both arms here comes up twice
+    for (size_t p = 0; p < block->pred_count; p++) {
+      IRBlock* pred = block->preds[p];
+      pred->targets[pred->targets[0] == block ? 0 : 1] = target;
+      if (!ir_add_pred(fn, target, pred)) return count;
+    }
+    ir_remove_pred(target, pred_index(target, block));
+    remove_block(block);
+    count++;
+  }
+  
+  for (size_t b = 0; b < fn->block_count; b++) {
+    IRBlock* block = fn->blocks[b];
+    while (!block->removed && block->terminator == IR_JUMP) {
+      IRBlock* next = block->targets[0];
+      if (next == block || next == fn->entry || next->pred_count != 1) break;
+  
+      for (size_t i = 0; i < next->value_count; i++) {
+        IRValue* value = next->values[i];
+        if (!is_live(next, value)) continue;
+        if (value->op == IR_PHI) value->forward = ir_resolve(value->args[0]);
+        else if (!ir_append(fn, block, value)) return count;
+      }
+      block->terminator = next->terminator;
+      block->condition = next->condition;
+      block->targets[0] = next->targets[0];
+      block->targets[1] = next->targets[1];
+      for (size_t s = 0; s < ir_successor_count(next); s++) {
+        IRBlock* succ = next->targets[s];
+        for (size_t p = 0; p < succ->pred_count; p++) {
+          if (succ->preds[p] == next) succ->preds[p] = block;
+        }
+      }
+      remove_block(next);
+      count++;
+    }
+  }
+  return count;
+}
+
+// Moves pure values whose operands are all defined outside a loop into the
+// block that enters it. Only loops with a single entry edge that ends in a
+// jump qualify, so the moved code runs exactly once per entry.
+static size_t hoist_invariants(IRFunction* fn) {
+  if (!ir_compute_dominators(fn)) return 0;
+  uint8_t* in_loop = malloc(fn->block_count);
+  IRBlock** stack = malloc(fn->block_count * sizeof(IRBlock*));
+  if (!in_loop || !stack) {
+    free(in_loop);
+    free(stack);
+    return 0;
+  }
+  
+  size_t count = 0;
+  // Inner loops have later headers, so values move out one level per header
+  for (size_t h = fn->rpo_count; h-- > 0 && !fn->failed;) {
+    IRBlock* header = fn->rpo[h];
+    memset(in_loop, 0, fn->block_count);
+    size_t depth = 0;
+    for (size_t p = 0; p < header->pred_count; p++) {
+      IRBlock* pred = header->preds[p];
+      if (ir_dominates(header, pred) && !in_loop[pred->id]) {
+        in_loop[pred->id] = 1;
+        stack[depth++] = pred;
+      }
+    }
+    if (depth == 0) continue;
+  
+    in_loop[header->id] = 1;
+    while (depth > 0) {
+      IRBlock* block = stack[--depth];
+      for (size_t p = 0; p < block->pred_count; p++) {
+        IRBlock* pred = block->preds[p];
+        if (pred->rpo != UINT32_MAX && !in_loop[pred->id]) {
+          in_loop[pred->id] = 1;
+          stack[depth++] = pred;
+        }
+      }
+    }
+  
+    IRBlock* preheader = NULL;
+    size_t entries = 0;
+    for (size_t p = 0; p < header->pred_count; p++) {
+      if (!in_loop[header->preds[p]->id]) {
+        preheader = header->preds[p];
+        entries++;
+      }
+    }
+    if (entries != 1 || preheader->terminator != IR_JUMP) continue;
+  
+    // Loop blocks follow the header in reverse post-order, operands before users
+    for (size_t r = h; r < fn->rpo_count; r++) {
+      IRBlock* block = fn->rpo[r];
+      if (!in_loop[block->id]) continue;
+      for (size_t i = 0; i < block->value_count; i++) {
+        IRValue* value = block->values[i];
+        if (!is_live(block, value) || !is_expression(value)) continue;
+  
+        bool invariant = true;
+        for (uint32_t a = 0; a < value->arg_count && invariant; a++) {
+          invariant = !in_loop[ir_resolve(value->args[a])->block->id];
+        }
+        if (invariant && ir_append(fn, preheader, value)) count++;
+      }
+    }
+  }
+  free(in_loop);
+  free(stack);
+  return count;
+}
+
+void ir_optimize(IRFunction* fn, int level, IRStats* stats) {
+  memset(stats, 0, sizeof(*stats));
+  stats->values_before = count_values(fn);
+  
+  for (int round = 0; round < IR_MAX_ROUNDS; round++) {
+    size_t changes = 0, n;
+  
+    n = propagate_copies(fn);
+    stats->copies += n;
+    changes += n;
+    n = fold_constants(fn);
+    stats->folded += n;
+    changes += n;
+    ir_sweep(fn);
+  
+    n = simplify_branches(fn);
+    stats->branches += n;
+    changes += n;
+    if (fn->failed) return;
+    ir_sweep(fn);
+  
+    if (!ir_compute_dominators(fn)) return;
+    n = eliminate_common(fn);
+    stats->cse += n;
+    changes += n;
+    if (fn->failed) return;
+    ir_sweep(fn);
+  
+    if (level >= 3) {
+      n = hoist_invariants(fn);
+      stats->hoisted += n;
+      changes += n;
+      if (fn->failed) return;
+      ir_sweep(fn);
+    }
+  
+    n = eliminate_dead(fn);
+    stats->dead += n;
+    changes += n;
+    ir_sweep(fn);
+  
+    if (changes == 0) break;
+  }
+  
+  if (!ir_compute_dominators(fn)) return;
+  stats->values_after = count_values(fn);
+}
@@ -4,13 +4,52 @@
  */
 
 #include "lexer.h"
-#include "utils.h"
+#include "intern.h"
 #include <string.h>
-#include <ctype.h>
 #include <stdlib.h>
 
+// Character classes, so the hot loops take one table load per byte instead
+// of locale-aware ctype calls. Bytes outside ASCII have no class.
+enum {
+  CHAR_SPACE = 1 << 0,
+  CHAR_IDENT_START = 1 << 1,
+  CHAR_DIGIT = 1 << 2
+};
+
+#define W CHAR_SPACE
+#define A CHAR_IDENT_START
+#define N CHAR_DIGIT
+static const unsigned char char_class[256] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, W, W, 0, 0, W, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  W, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  N, N, N, N, N, N, N, N, N, N, 0, 0, 0, 0, 0, 0,
+  0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+  A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, A,
+  0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+  A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, 0,
+};
+#undef W
+#undef A
+#undef N
+
+#define IS_SPACE(c) (char_class[(unsigned char)(c)] & CHAR_SPACE)
+#define IS_IDENT_START(c) (char_class[(unsigned char)(c)] & CHAR_IDENT_START)
+#define IS_IDENT(c) (char_class[(unsigned char)(c)] & (CHAR_IDENT_START | CHAR_DIGIT))
+#define IS_DIGIT(c) (char_class[(unsigned char)(c)] & CHAR_DIGIT)
+
 static bool is_at_end(Lexer* lexer) {
-  return *lexer->current == '\0';
+  return lexer->current >= lexer->end;
+}
+
+// Counts the newlines in [from, to) and moves the line start past the last one
+static void skip_lines(Lexer* lexer, const char* from, const char* to) {
+  const char* newline;
+  while ((newline = memchr(from, '\n', (size_t)(to - from))) != NULL) {
+    lexer->line++;
+    lexer->line_start = newline + 1;
+    from = newline + 1;
+  }
 }
 
 static char advance(Lexer* lexer) {
@@ -19,9 +58,7 @@ static char advance(Lexer* lexer) {
   char c = *lexer->current++;
   if (c == '\n') {
     lexer->line++;
-    lexer->column = 1;
-  } else {
-    lexer->column++;
+    lexer->line_start = lexer->current;
   }
   return c;
 }
@@ -30,15 +67,10 @@ static char peek(Lexer* lexer) {
   return *lexer->current;
 }
 
-static char peek_next(Lexer* lexer) {
-  if (is_at_end(lexer)) return '\0';
-  return lexer->current[1];
-}
-
 static bool match(Lexer* lexer, char expected) {
   if (is_at_end(lexer)) return false;
   if (*lexer->current != expected) return false;
-  advance(lexer);
+  lexer->current++;
   return true;
 }
 
@@ -48,7 +80,8 @@ static Token make_token(Lexer* lexer, TokenType type) {
   token.start = lexer->start;
   token.length = (int)(lexer->current - lexer->start);
   token.line = lexer->line;
-  token.column = lexer->column - token.length;
+  token.column = lexer->column;
+  token.name = NULL;
   return token;
 }
 
@@ -59,110 +92,119 @@ static Token error_token(Lexer* lexer, const char* message) {
   token.length = (int)strlen(message);
   token.line = lexer->line;
   token.column = lexer->column;
+  token.name = NULL;
   return token;
 }
 
+// Comment bodies are skipped with memchr, which libc vectorizes
 static void skip_whitespace(Lexer* lexer) {
+  const char* p = lexer->current;
   for (;;) {
-    char c = peek(lexer);
-    switch (c) {
-      case ' ':
-      case '\r':
-      case '\t':
-      case '\n':
-        advance(lexer);
-        break;
-      case '/':
-        if (peek_next(lexer) == '/') {
-          // Line comment
-          while (peek(lexer) != '\n' && !is_at_end(lexer)) {
-            advance(lexer);
-          }
-        } else if (peek_next(lexer) == '*') {
-          // Block comment
-          advance(lexer); // consume '/'
-          advance(lexer); // consume '*'
-          while (!is_at_end(lexer)) {
-            if (peek(lexer) == '*' && peek_next(lexer) == '/') {
-              advance(lexer); // consume '*'
-              advance(lexer); // consume '/'
-              break;
-            }
-            advance(lexer);
-          }
-        } else {
-          return;
+    while (IS_SPACE(*p)) {
+      if (*p == '\n') {
+        lexer->line++;
+        lexer->line_start = p + 1;
+      }
+      p++;
+    }
+  
+    if (p[0] != '/' || p >= lexer->end) break;
+  
+    if (p[1] == '/') {
+      // Line comment; the newline is left for the whitespace loop
+      const char* newline = memchr(p, '\n', (size_t)(lexer->end - p));
+      p = newline ? newline : lexer->end;
+    } else if (p[1] == '*') {
+      // Block comment
+      const char* body = p + 2;
+      const char* q = body;
+      const char* close = NULL;
+      while (q < lexer->end && (q = memchr(q, '*', (size_t)(lexer->end - q))) != NULL) {
+        if (q[1] == '/') {
+          close = q;
+          break;
         }
-        break;
-      default:
-        return;
+        q++;
+      }
+      p = close ? close + 2 : lexer->end;
+      skip_lines(lexer, body, close ? close : lexer->end);
+    } else {
+      break;
     }
   }
+  lexer->current = p;
 }
 
-static TokenType check_keyword(const char* start, int length, const char* rest, TokenType type) {
-  if (strlen(rest) == length - 1 && memcmp(start + 1, rest, length - 1) == 0) {
-    return type;
-  }
-  return TOKEN_IDENTIFIER;
-}
-
-static TokenType identifier_type(Lexer* lexer) {
-  switch (lexer->start[0]) {
-    case 'c':
-      if (lexer->current - lexer->start > 4) {
-        return check_keyword(lexer->start, lexer->current - lexer->start, "onst", TOKEN_CONST);
+// Keywords are told apart by length and first character, then one fixed-size compare
+static TokenType identifier_type(const char* start, size_t length) {
+  switch (length) {
+    case 2:
+      if (start[0] == 'i' && start[1] == 'f') return TOKEN_IF;
+      break;
+    case 3:
+      if (start[0] == 'i' && memcmp(start, "int", 3) == 0) return TOKEN_INT;
+      if (start[0] == 'f' && memcmp(start, "for", 3) == 0) return TOKEN_FOR;
+      break;
+    case 4:
+      switch (start[0]) {
+        case 'c': if (memcmp(start, "char", 4) == 0) return TOKEN_CHAR_KW; break;
+        case 'e': if (memcmp(start, "else", 4) == 0) return TOKEN_ELSE; break;
+        case 'v': if (memcmp(start, "void", 4) == 0) return TOKEN_VOID; break;
       }
-      return check_keyword(lexer->start, lexer->current - lexer->start, "har", TOKEN_CHAR_KW);
-    case 'e':
-      return check_keyword(lexer->start, lexer->current - lexer->start, "lse", TOKEN_ELSE);
-    case 'f':
-      return check_keyword(lexer->start, lexer->current - lexer->start, "or", TOKEN_FOR);
-    case 'i':
-      if (lexer->current - lexer->start > 1) {
-        switch (lexer->start[1]) {
-          case 'f': return check_keyword(lexer->start, lexer->current - lexer->start, "f", TOKEN_IF);
-          case 'n': return check_keyword(lexer->start, lexer->current - lexer->start, "nt", TOKEN_INT);
-        }
+      break;
+    case 5:
+      switch (start[0]) {
+        case 'c': if (memcmp(start, "const", 5) == 0) return TOKEN_CONST; break;
+        case 'w': if (memcmp(start, "while", 5) == 0) return TOKEN_WHILE; break;
       }
       break;
-    case 'r':
-      return check_keyword(lexer->start, lexer->current - lexer->start, "eturn", TOKEN_RETURN);
-    case 'v':
-      return check_keyword(lexer->start, lexer->current - lexer->start, "oid", TOKEN_VOID);
-    case 'w':
-      return check_keyword(lexer->start, lexer->current - lexer->start, "hile", TOKEN_WHILE);
+    case 6:
+      if (start[0] == 'r' && memcmp(start, "return", 6) == 0) return TOKEN_RETURN;
+      break;
   }
   return TOKEN_IDENTIFIER;
 }
 
 static Token identifier(Lexer* lexer) {
-  while (isalnum(peek(lexer)) || peek(lexer) == '_') {
-    advance(lexer);
+  const char* p = lexer->current;
+  while (IS_IDENT(*p)) {
+    p++;
+  }
+  lexer->current = p;
+  
+  size_t length = (size_t)(p - lexer->start);
+  Token token = make_token(lexer, identifier_type(lexer->start, length));
+  if (token.type == TOKEN_IDENTIFIER) {
+    token.name = intern_string(lexer->strings, token.start, length);
+    if (!token.name) return error_token(lexer, "Out of memory.");
   }
-  return make_token(lexer, identifier_type(lexer));
+  return token;
 }
 
 static Token number(Lexer* lexer) {
-  while (isdigit(peek(lexer))) {
-    advance(lexer);
+  const char* p = lexer->current;
+  while (IS_DIGIT(*p)) {
+    p++;
   }
+  lexer->current = p;
   return make_token(lexer, TOKEN_NUMBER);
 }
 
 static Token string(Lexer* lexer) {
-  while (peek(lexer) != '"' && !is_at_end(lexer)) {
-    if (peek(lexer) == '\n') lexer->line++;
-    advance(lexer);
+  const char* quote = memchr(lexer->current, '"', (size_t)(lexer->end - lexer->current));
+  if (!quote) {
+    Token token = error_token(lexer, "Unterminated string.");
+    skip_lines(lexer, lexer->current, lexer->end);
+    lexer->current = lexer->end;
+    return token;
   }
   
-  if (is_at_end(lexer)) {
-    return error_token(lexer, "Unterminated string.");
-  }
-  
-  // Consume the closing quote
-  advance(lexer);
-  return make_token(lexer, TOKEN_STRING);
+  // Consume the closing quote; the token keeps the line it starts on
+  const char* body = lexer->current;
+  lexer->current = quote + 1;
+  Token token = make_token(lexer, TOKEN_STRING);
+  skip_lines(lexer, body, quote);
+  return token;
 }
 
 static Token character(Lexer* lexer) {
@@ -180,10 +222,13 @@ static Token character(Lexer* lexer) {
   return make_token(lexer, TOKEN_CHAR);
 }
 
-void lexer_init(Lexer* lexer, const char* source) {
+void lexer_init(Lexer* lexer, const char* source, InternTable* strings) {
   lexer->source = source;
+  lexer->end = source + strlen(source);
+  lexer->strings = strings;
   lexer->start = source;
   lexer->current = source;
+  lexer->line_start = source;
   lexer->line = 1;
   lexer->column = 1;
 }
@@ -191,6 +236,7 @@ void lexer_init(Lexer* lexer, const char* source) {
 Token lexer_next_token(Lexer* lexer) {
   skip_whitespace(lexer);
   lexer->start = lexer->current;
+  lexer->column = (int)(lexer->start - lexer->line_start) + 1;
   
   if (is_at_end(lexer)) {
     return make_token(lexer, TOKEN_EOF);
@@ -198,10 +244,10 @@ Token lexer_next_token(Lexer* lexer) {
   
   char c = advance(lexer);
   
-  if (isalpha(c) || c == '_') {
+  if (IS_IDENT_START(c)) {
     return identifier(lexer);
   }
-  if (isdigit(c)) {
+  if (IS_DIGIT(c)) {
     return number(lexer);
   }
   
@@ -298,7 +344,8 @@ bool token_equals_text(const Token* token, const char* text) {
 }
 
 char* token_to_string(const Token* token) {
-  char* str = safe_malloc(token->length + 1);
+  char* str = malloc(token->length + 1);
+  if (!str) return NULL;
   memcpy(str, token->start, token->length);
   str[token->length] = '\0';
   return str;
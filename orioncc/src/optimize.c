@@ -0,0 +1,410 @@
+/**
+ * @file src/optimize.c
+ * @brief Constant folding and algebraic simplification of the AST
+ */
+
+#include "optimize.h"
+#include "symtab.h"
+#include <string.h>
+
+typedef struct {
+  Arena* arena;
+  SymbolTable symbols; // declared types, so identities never change a result type
+  OptimizeStats* stats;
+  bool failed; // out of memory; the nodes it could not replace are left as they were
+} Optimizer;
+
+static ASTNode* optimize_expression(Optimizer* opt, ASTNode* node);
+static ASTNode* optimize_statement(Optimizer* opt, ASTNode* node);
+
+static ASTNode* out_of_memory(Optimizer* opt, ASTNode* node) {
+  opt->failed = true;
+  return node;
+}
+
+static bool enter_scope(Optimizer* opt) {
+  if (symtab_enter_scope(&opt->symbols)) return true;
+  opt->failed = true;
+  return false;
+}
+
+// A missing declaration could let an outer one of another type answer for it
+static void declare(Optimizer* opt, const char* name, DataType type) {
+  if (!symtab_declare(&opt->symbols, name, type)) opt->failed = true;
+}
+
+// The code generator emits number literals as 32-bit CONSTs and the VM
+// computes in 64 bits, so operands are truncated the same way and only
+// results that survive a CONST are folded
+static bool constant_value(const ASTNode* node, int64_t* value) {
+  if (!node || node->type != AST_NUMBER) return false;
+  *value = (int32_t)node->number.value;
+  return true;
+}
+
+static bool fits_constant(int64_t value) {
+  return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+// log2 of a power of two above one, or -1
+static int power_of_two(int64_t value) {
+  if (value < 2 || (value & (value - 1)) != 0) return -1;
+  int shift = 0;
+  while ((value >>= 1) != 0) shift++;
+  return shift;
+}
+
+static ASTNode* make_number(Optimizer* opt, ASTNode* node, int64_t value) {
+  if (node->type != AST_NUMBER) {
+    ASTNode* number = ast_create_number(opt->arena, value);
+    if (!number) return out_of_memory(opt, node);
+    node = number;
+  } else {
+    node->number.value = value;
+  }
+  return node;
+}
+
+// Calls, assignments and increments must run even when their value is unused
+static bool has_side_effects(const ASTNode* node) {
+  if (!node) return false;
+  
+  switch (node->type) {
+    case AST_CALL:
+    case AST_ASSIGNMENT:
+      return true;
+    case AST_UNARY_OP:
+      if (node->unary_op.operator != UNOP_MINUS && node->unary_op.operator != UNOP_NOT) return true;
+      return has_side_effects(node->unary_op.operand);
+    case AST_BINARY_OP:
+      return has_side_effects(node->binary_op.left) || has_side_effects(node->binary_op.right);
+    default:
+      return false;
+  }
+}
+
+// Whether the expression yields a word, as the operators do. A char operand
+// standing in for c * 1 would change the type of the result.
+static bool yields_word(Optimizer* opt, const ASTNode* node) {
+  switch (node->type) {
+    case AST_NUMBER:
+    case AST_BINARY_OP:
+    case AST_UNARY_OP:
+      return true;
+    case AST_IDENTIFIER: {
+      Symbol* symbol = symtab_find(&opt->symbols, node->identifier.name);
+      return symbol && symbol->type == TYPE_INT;
+    }
+    case AST_ASSIGNMENT: {
+      Symbol* symbol = symtab_find(&opt->symbols, node->assignment.name);
+      return symbol && symbol->type == TYPE_INT;
+    }
+    default:
+      return false;
+  }
+}
+
+// Known to be at least zero, so dividing by 2^k is a right shift
+static bool is_non_negative(const ASTNode* node) {
+  int64_t value;
+  if (constant_value(node, &value)) return value >= 0;
+  if (node->type == AST_UNARY_OP) return node->unary_op.operator == UNOP_NOT;
+  if (node->type != AST_BINARY_OP) return false;
+  
+  const ASTNode* left = node->binary_op.left;
+  const ASTNode* right = node->binary_op.right;
+  switch (node->binary_op.operator) {
+    case BINOP_EQ:
+    case BINOP_NE:
+    case BINOP_LT:
+    case BINOP_LE:
+    case BINOP_GT:
+    case BINOP_GE:
+    case BINOP_AND:
+    case BINOP_OR:
+      return true;
+    case BINOP_BIT_AND:
+      return is_non_negative(left) || is_non_negative(right);
+    case BINOP_SHR:
+      return is_non_negative(left);
+    case BINOP_DIV:
+    case BINOP_MOD:
+      return is_non_negative(left) && is_non_negative(right);
+    default:
+      return false;
+  }
+}
+
+// Evaluates op like the VM; false when the VM would fault or the result does not fit
+bool optimize_fold_binary(BinaryOperator op, int64_t left, int64_t right, int64_t* result) {
+  switch (op) {
+    case BINOP_ADD: *result = left + right; break;
+    case BINOP_SUB: *result = left - right; break;
+    case BINOP_MUL: *result = left * right; break;
+    case BINOP_DIV:
+      if (right == 0) return false;
+      *result = left / right;
+      break;
+    case BINOP_MOD:
+      if (right == 0) return false;
+      *result = left % right;
+      break;
+    case BINOP_EQ: *result = left == right; break;
+    case BINOP_NE: *result = left != right; break;
+    case BINOP_LT: *result = left < right; break;
+    case BINOP_LE: *result = left <= right; break;
+    case BINOP_GT: *result = left > right; break;
+    case BINOP_GE: *result = left >= right; break;
+    case BINOP_AND: *result = left && right; break;
+    case BINOP_OR: *result = left || right; break;
+    case BINOP_BIT_AND: *result = left & right; break;
+    case BINOP_SHL:
+      if (right < 0 || right > 31) return false;
+      *result = left * ((int64_t)1 << right);
+      break;
+    case BINOP_SHR:
+      if (right < 0 || right > 31) return false;
+      *result = left >> right;
+      break;
+    default:
+      return false;
+  }
+  return fits_constant(*result);
+}
+
+// Rewrites x op 2^k into a shift or mask by a fresh constant
+static ASTNode* reduce_strength(Optimizer* opt, ASTNode* node, BinaryOperator op, ASTNode* operand, int64_t constant) {
+  ASTNode* number = ast_create_number(opt->arena, constant);
+  if (!number) return out_of_memory(opt, node);
+  
+  node->binary_op.operator = op;
+  node->binary_op.left = operand;
+  node->binary_op.right = number;
+  opt->stats->simplified++;
+  return node;
+}
+
+static ASTNode* optimize_binary(Optimizer* opt, ASTNode* node) {
+  ASTNode* left = node->binary_op.left = optimize_expression(opt, node->binary_op.left);
+  ASTNode* right = node->binary_op.right = optimize_expression(opt, node->binary_op.right);
+  BinaryOperator op = node->binary_op.operator;
+  
+  int64_t lvalue = 0, rvalue = 0, result;
+  bool lconst = constant_value(left, &lvalue);
+  bool rconst = constant_value(right, &rvalue);
+  if (lconst && rconst) {
+    if (optimize_fold_binary(op, lvalue, rvalue, &result)) {
+      opt->stats->folded++;
+      return make_number(opt, left, result);
+    }
+    return node;
+  }
+  
+  // 0 && x and 1 || x never evaluate x
+  if (lconst && ((op == BINOP_AND && lvalue == 0) || (op == BINOP_OR && lvalue != 0))) {
+    opt->stats->folded++;
+    return make_number(opt, left, op == BINOP_OR);
+  }
+  
+  // x + 0, 0 + x, x - 0, x * 1, 1 * x, x / 1
+  bool left_identity = lconst && ((lvalue == 0 && op == BINOP_ADD) || (lvalue == 1 && op == BINOP_MUL));
+  bool right_identity = rconst &&
+      ((rvalue == 0 && (op == BINOP_ADD || op == BINOP_SUB || op == BINOP_SHL || op == BINOP_SHR)) ||
+       (rvalue == 1 && (op == BINOP_MUL || op == BINOP_DIV)));
+  if (left_identity && yields_word(opt, right)) {
+    opt->stats->simplified++;
+    return right;
+  }
+  if (right_identity && yields_word(opt, left)) {
+    opt->stats->simplified++;
+    return left;
+  }
+  
+  // x * 0, 0 * x, x & 0, 0 & x, x % 1 are zero when x can be skipped
+  ASTNode* other = lconst ? right : left;
+  int64_t constant = lconst ? lvalue : rvalue;
+  if ((lconst || rconst) && !has_side_effects(other) &&
+      ((constant == 0 && (op == BINOP_MUL || op == BINOP_AND || op == BINOP_BIT_AND)) || (rconst && rvalue == 1 && op == BINOP_MOD))) {
+    opt->stats->simplified++;
+    return make_number(opt, lconst ? left : right, 0);
+  }
+  
+  // Multiplying by 2^k is a left shift, which the VM leaves undefined for a
+  // negative operand. Division truncates toward zero but a right shift
+  // rounds down. Either way only non-negative operands are shifted.
+  int shift = (lconst || rconst) ? power_of_two(constant) : -1;
+  if (shift > 0 && op == BINOP_MUL && is_non_negative(other)) {
+    return reduce_strength(opt, node, BINOP_SHL, other, shift);
+  }
+  if (shift > 0 && rconst && op == BINOP_DIV && is_non_negative(left)) {
+    return reduce_strength(opt, node, BINOP_SHR, left, shift);
+  }
+  if (shift > 0 && rconst && op == BINOP_MOD && is_non_negative(left)) {
+    return reduce_strength(opt, node, BINOP_BIT_AND, left, rvalue - 1);
+  }
+  return node;
+}
+
+static ASTNode* optimize_unary(Optimizer* opt, ASTNode* node) {
+  ASTNode* operand = node->unary_op.operand = optimize_expression(opt, node->unary_op.operand);
+  
+  int64_t value;
+  if (!constant_value(operand, &value)) return node;
+  if (node->unary_op.operator == UNOP_MINUS && fits_constant(-value)) {
+    opt->stats->folded++;
+    return make_number(opt, operand, -value);
+  }
+  if (node->unary_op.operator == UNOP_NOT) {
+    opt->stats->folded++;
+    return make_number(opt, operand, value == 0);
+  }
+  return node;
+}
+
+static ASTNode* optimize_expression(Optimizer* opt, ASTNode* node) {
+  if (!node) return NULL;
+  
+  switch (node->type) {
+    case AST_BINARY_OP:
+      return optimize_binary(opt, node);
+    case AST_UNARY_OP:
+      return optimize_unary(opt, node);
+    case AST_ASSIGNMENT:
+      node->assignment.value = optimize_expression(opt, node->assignment.value);
+      return node;
+    case AST_CALL:
+      for (size_t i = 0; i < node->call.argument_count; i++) {
+        node->call.arguments[i] = optimize_expression(opt, node->call.arguments[i]);
+      }
+      return node;
+    default:
+      return node;
+  }
+}
+
+// A branch that replaces its if or loop keeps a declaration in its own scope
+static ASTNode* keep_scoped(Optimizer* opt, ASTNode* statement) {
+  if (statement && statement->type == AST_VARIABLE_DECL) {
+    ASTNode* block = ast_create_block(opt->arena);
+    if (!block || !ast_add_statement(opt->arena, block, statement)) return out_of_memory(opt, statement);
+    return block;
+  }
+  return statement;
+}
+
+static void optimize_statements(Optimizer* opt, ASTNode** statements, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    statements[i] = optimize_statement(opt, statements[i]);
+  }
+}
+
+static void optimize_function(Optimizer* opt, ASTNode* node) {
+  declare(opt, node->function.name, node->function.return_type);
+  
+  if (!enter_scope(opt)) return;
+  for (size_t i = 0; i < node->function.parameter_count; i++) {
+    const ASTNode* param = node->function.parameters[i];
+    if (param->type == AST_VARIABLE_DECL) {
+      declare(opt, param->variable_decl.name, param->variable_decl.type);
+    }
+  }
+  node->function.body = optimize_statement(opt, node->function.body);
+  symtab_leave_scope(&opt->symbols);
+}
+
+static ASTNode* optimize_if(Optimizer* opt, ASTNode* node) {
+  ASTNode* condition = node->if_stmt.condition = optimize_expression(opt, node->if_stmt.condition);
+  node->if_stmt.then_branch = optimize_statement(opt, node->if_stmt.then_branch);
+  node->if_stmt.else_branch = optimize_statement(opt, node->if_stmt.else_branch);
+  
+  int64_t value;
+  if (!constant_value(condition, &value)) return node;
+  
+  opt->stats->pruned++;
+  ASTNode* taken = value != 0 ? node->if_stmt.then_branch : node->if_stmt.else_branch;
+  if (taken) return keep_scoped(opt, taken);
+  ASTNode* block = ast_create_block(opt->arena);
+  return block ? block : out_of_memory(opt, node);
+}
+
+static ASTNode* optimize_while(Optimizer* opt, ASTNode* node) {
+  ASTNode* condition = node->while_stmt.condition = optimize_expression(opt, node->while_stmt.condition);
+  node->while_stmt.body = optimize_statement(opt, node->while_stmt.body);
+  
+  int64_t value;
+  if (constant_value(condition, &value) && value == 0) {
+    opt->stats->pruned++;
+    ASTNode* block = ast_create_block(opt->arena);
+    return block ? block : out_of_memory(opt, node);
+  }
+  return node;
+}
+
+static ASTNode* optimize_for(Optimizer* opt, ASTNode* node) {
+  if (!enter_scope(opt)) return node;
+  node->for_stmt.init = optimize_statement(opt, node->for_stmt.init);
+  ASTNode* condition = node->for_stmt.condition = optimize_expression(opt, node->for_stmt.condition);
+  node->for_stmt.update = optimize_expression(opt, node->for_stmt.update);
+  node->for_stmt.body = optimize_statement(opt, node->for_stmt.body);
+  symtab_leave_scope(&opt->symbols);
+  
+  // The initializer still runs once
+  int64_t value;
+  if (constant_value(condition, &value) && value == 0) {
+    opt->stats->pruned++;
+    ASTNode* block = ast_create_block(opt->arena);
+    if (!block || !ast_add_statement(opt->arena, block, node->for_stmt.init)) return out_of_memory(opt, node);
+    return block;
+  }
+  return node;
+}
+
+static ASTNode* optimize_statement(Optimizer* opt, ASTNode* node) {
+  if (!node) return NULL;
+  
+  switch (node->type) {
+    case AST_FUNCTION:
+      optimize_function(opt, node);
+      return node;
+    case AST_VARIABLE_DECL:
+      // Declared first: the code generator resolves the initializer after the name
+      declare(opt, node->variable_decl.name, node->variable_decl.type);
+      node->variable_decl.initializer = optimize_expression(opt, node->variable_decl.initializer);
+      return node;
+    case AST_BLOCK:
+      if (!enter_scope(opt)) return node;
+      optimize_statements(opt, node->block.statements, node->block.statement_count);
+      symtab_leave_scope(&opt->symbols);
+      return node;
+    case AST_IF:
+      return optimize_if(opt, node);
+    case AST_WHILE:
+      return optimize_while(opt, node);
+    case AST_FOR:
+      return optimize_for(opt, node);
+    case AST_RETURN:
+      node->return_stmt.value = optimize_expression(opt, node->return_stmt.value);
+      return node;
+    case AST_ASSIGNMENT:
+      return optimize_expression(opt, node);
+    case AST_EXPRESSION_STMT:
+      node->expression_stmt.expression = optimize_expression(opt, node->expression_stmt.expression);
+      return node;
+    default:
+      return node;
+  }
+}
+
+bool optimize_program(ASTNode* program, Arena* arena, OptimizeStats* stats) {
+  if (!program || program->type != AST_PROGRAM) return true;
+  
+  Optimizer opt = { .arena = arena, .stats = stats };
+  memset(stats, 0, sizeof(*stats));
+  if (symtab_init(&opt.symbols)) {
+    optimize_statements(&opt, program->program.statements, program->program.statement_count);
+  } else {
+    opt.failed = true;
+  }
+  symtab_free(&opt.symbols);
+  return !opt.failed;
+}
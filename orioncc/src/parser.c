@@ -9,8 +9,9 @@
 #include <stdlib.h>
 #include <string.h>
 
-void parser_init(Parser* parser, Lexer* lexer) {
+void parser_init(Parser* parser, Lexer* lexer, Arena* arena) {
   parser->lexer = lexer;
+  parser->arena = arena;
   parser->had_error = false;
   parser->panic_mode = false;
   parser_advance(parser);
@@ -29,9 +30,7 @@ void parser_error(Parser* parser, const char* message) {
   } else if (parser->previous_token.type == TOKEN_ERROR) {
     // Nothing
   } else {
-    char* text = token_to_string(&parser->previous_token);
-    fprintf(stderr, " at '%s'", text);
-    free(text);
+    fprintf(stderr, " at '%.*s'", parser->previous_token.length, parser->previous_token.start);
   }
   
   fprintf(stderr, ": %s\n", message);
@@ -43,7 +42,7 @@ void parser_advance(Parser* parser) {
   for (;;) {
     parser->current_token = lexer_next_token(parser->lexer);
     if (parser->current_token.type != TOKEN_ERROR) break;
-    
+  
     parser_error(parser, parser->current_token.start);
   }
 }
@@ -72,7 +71,7 @@ void parser_synchronize(Parser* parser) {
   
   while (parser->current_token.type != TOKEN_EOF) {
     if (parser->previous_token.type == TOKEN_SEMICOLON) return;
-    
+  
     switch (parser->current_token.type) {
       case TOKEN_IF:
       case TOKEN_FOR:
@@ -85,11 +84,22 @@ void parser_synchronize(Parser* parser) {
       default:
         break;
     }
-    
+  
     parser_advance(parser);
   }
 }
 
+// Reports a node the arena had no room for; parsing carries on so the
+// failure surfaces like any other error
+static ASTNode* check_node(Parser* parser, ASTNode* node) {
+  if (!node) parser_error(parser, "Out of memory.");
+  return node;
+}
+
+static void check_added(Parser* parser, bool added) {
+  if (!added) parser_error(parser, "Out of memory.");
+}
+
 DataType token_to_data_type(TokenType type) {
   switch (type) {
     case TOKEN_INT: return TYPE_INT;
@@ -100,14 +110,15 @@ DataType token_to_data_type(TokenType type) {
 }
 
 ASTNode* parse_program(Parser* parser) {
-  ASTNode* program = ast_create_program();
+  ASTNode* program = check_node(parser, ast_create_program(parser->arena));
+  if (!program) return NULL;
   
   while (!parser_check(parser, TOKEN_EOF)) {
     if (parser->panic_mode) parser_synchronize(parser);
-    
+  
     ASTNode* decl = parse_declaration(parser);
     if (decl) {
-      ast_add_statement(program, decl);
+      check_added(parser, ast_add_statement(parser->arena, program, decl));
     }
   }
   
@@ -118,40 +129,35 @@ ASTNode* parse_declaration(Parser* parser) {
   // Check for type specifiers
   if (parser_match(parser, TOKEN_INT) || parser_match(parser, TOKEN_CHAR_KW) || parser_match(parser, TOKEN_VOID)) {
     DataType type = token_to_data_type(parser->previous_token.type);
-    
+  
     if (!parser_check(parser, TOKEN_IDENTIFIER)) {
       parser_error(parser, "Expected identifier after type specifier.");
       return NULL;
     }
-    
-    char* name = token_to_string(&parser->current_token);
+  
+    const char* name = parser->current_token.name;
     parser_advance(parser);
-    
+  
     if (parser_match(parser, TOKEN_LEFT_PAREN)) {
       // Function declaration
-      ASTNode* func = ast_create_function(name, type);
-      free(name);
-      
+      ASTNode* func = check_node(parser, ast_create_function(parser->arena, name, type));
+      if (!func) return NULL;
+  
       // Parse parameters
       if (!parser_check(parser, TOKEN_RIGHT_PAREN)) {
         do {
           // Parse parameter type
           if (parser_match(parser, TOKEN_INT) || parser_match(parser, TOKEN_CHAR_KW) || parser_match(parser, TOKEN_VOID)) {
             DataType param_type = token_to_data_type(parser->previous_token.type);
-            
+  
             // Parse parameter name
             if (parser_check(parser, TOKEN_IDENTIFIER)) {
-              char* param_name = token_to_string(&parser->current_token);
+              const char* param_name = parser->current_token.name;
               parser_advance(parser);
-              
+  
               // Create parameter node
-              ASTNode* param = ast_create_variable_decl(param_name, param_type, NULL);
-              free(param_name);
-              
-              // Add to function parameters
-              func->function.parameters = safe_realloc(func->function.parameters, 
-                (func->function.parameter_count + 1) * sizeof(ASTNode*));
-              func->function.parameters[func->function.parameter_count++] = param;
+              ASTNode* param = check_node(parser, ast_create_variable_decl(parser->arena, param_name, param_type, NULL));
+              check_added(parser, ast_add_parameter(parser->arena, func, param));
             } else {
               parser_error(parser, "Expected parameter name.");
               break;
@@ -162,9 +168,9 @@ ASTNode* parse_declaration(Parser* parser) {
           }
         } while (parser_match(parser, TOKEN_COMMA));
       }
-      
+  
       parser_consume(parser, TOKEN_RIGHT_PAREN, "Expected ')' after parameters.");
-      
+  
       // Parse function body
       if (parser_check(parser, TOKEN_LEFT_BRACE)) {
         parser_advance(parser); // consume '{'
@@ -173,7 +179,7 @@ ASTNode* parse_declaration(Parser* parser) {
         parser_error(parser, "Expected '{' before function body.");
         return func;
       }
-      
+  
       return func;
     } else {
       // Variable declaration
@@ -181,12 +187,10 @@ ASTNode* parse_declaration(Parser* parser) {
       if (parser_match(parser, TOKEN_ASSIGN)) {
         initializer = parse_expression(parser);
       }
-      
+  
       parser_consume(parser, TOKEN_SEMICOLON, "Expected ';' after variable declaration.");
-      
-      ASTNode* var_decl = ast_create_variable_decl(name, type, initializer);
-      free(name);
-      return var_decl;
+  
+      return check_node(parser, ast_create_variable_decl(parser->arena, name, type, initializer));
     }
   }
   
@@ -224,14 +228,14 @@ ASTNode* parse_statement(Parser* parser) {
 }
 
 ASTNode* parse_block(Parser* parser) {
-  ASTNode* block = ast_create_block();
+  ASTNode* block = check_node(parser, ast_create_block(parser->arena));
   
   while (!parser_check(parser, TOKEN_RIGHT_BRACE) && !parser_check(parser, TOKEN_EOF)) {
     if (parser->panic_mode) parser_synchronize(parser);
-    
+  
     ASTNode* stmt = parse_declaration(parser);
     if (stmt) {
-      ast_add_statement(block, stmt);
+      check_added(parser, ast_add_statement(parser->arena, block, stmt));
     }
   }
   
@@ -251,7 +255,8 @@ ASTNode* parse_if_statement(Parser* parser) {
     else_branch = parse_statement(parser);
   }
   
-  ASTNode* if_stmt = ast_create_node(AST_IF);
+  ASTNode* if_stmt = check_node(parser, ast_create_node(parser->arena, AST_IF));
+  if (!if_stmt) return NULL;
   if_stmt->if_stmt.condition = condition;
   if_stmt->if_stmt.then_branch = then_branch;
   if_stmt->if_stmt.else_branch = else_branch;
@@ -266,7 +271,8 @@ ASTNode* parse_while_statement(Parser* parser) {
   
   ASTNode* body = parse_statement(parser);
   
-  ASTNode* while_stmt = ast_create_node(AST_WHILE);
+  ASTNode* while_stmt = check_node(parser, ast_create_node(parser->arena, AST_WHILE));
+  if (!while_stmt) return NULL;
   while_stmt->while_stmt.condition = condition;
   while_stmt->while_stmt.body = body;
   
@@ -301,7 +307,8 @@ ASTNode* parse_for_statement(Parser* parser) {
   
   ASTNode* body = parse_statement(parser);
   
-  ASTNode* for_stmt = ast_create_node(AST_FOR);
+  ASTNode* for_stmt = check_node(parser, ast_create_node(parser->arena, AST_FOR));
+  if (!for_stmt) return NULL;
   for_stmt->for_stmt.init = init;
   for_stmt->for_stmt.condition = condition;
   for_stmt->for_stmt.update = update;
@@ -318,7 +325,8 @@ ASTNode* parse_return_statement(Parser* parser) {
   
   parser_consume(parser, TOKEN_SEMICOLON, "Expected ';' after return value.");
   
-  ASTNode* return_stmt = ast_create_node(AST_RETURN);
+  ASTNode* return_stmt = check_node(parser, ast_create_node(parser->arena, AST_RETURN));
+  if (!return_stmt) return NULL;
   return_stmt->return_stmt.value = value;
   
   return return_stmt;
@@ -328,7 +336,8 @@ ASTNode* parse_expression_statement(Parser* parser) {
   ASTNode* expr = parse_expression(parser);
   parser_consume(parser, TOKEN_SEMICOLON, "Expected ';' after expression.");
   
-  ASTNode* expr_stmt = ast_create_node(AST_EXPRESSION_STMT);
+  ASTNode* expr_stmt = check_node(parser, ast_create_node(parser->arena, AST_EXPRESSION_STMT));
+  if (!expr_stmt) return NULL;
   expr_stmt->expression_stmt.expression = expr;
   
   return expr_stmt;
@@ -342,13 +351,13 @@ ASTNode* parse_assignment(Parser* parser) {
   ASTNode* expr = parse_logical_or(parser);
   
   if (parser_match(parser, TOKEN_ASSIGN)) {
-    if (expr->type != AST_IDENTIFIER) {
+    if (!expr || expr->type != AST_IDENTIFIER) {
       parser_error(parser, "Invalid assignment target.");
       return expr;
     }
-    
+  
     ASTNode* value = parse_assignment(parser);
-    return ast_create_assignment(expr->identifier.name, value);
+    return check_node(parser, ast_create_assignment(parser->arena, expr->identifier.name, value));
   }
   
   return expr;
@@ -359,7 +368,7 @@ ASTNode* parse_logical_or(Parser* parser) {
   
   while (parser_match(parser, TOKEN_LOGICAL_OR)) {
     ASTNode* right = parse_logical_and(parser);
-    expr = ast_create_binary_op(BINOP_OR, expr, right);
+    expr = check_node(parser, ast_create_binary_op(parser->arena, BINOP_OR, expr, right));
   }
   
   return expr;
@@ -370,7 +379,7 @@ ASTNode* parse_logical_and(Parser* parser) {
   
   while (parser_match(parser, TOKEN_LOGICAL_AND)) {
     ASTNode* right = parse_equality(parser);
-    expr = ast_create_binary_op(BINOP_AND, expr, right);
+    expr = check_node(parser, ast_create_binary_op(parser->arena, BINOP_AND, expr, right));
   }
   
   return expr;
@@ -382,7 +391,7 @@ ASTNode* parse_equality(Parser* parser) {
   while (parser_match(parser, TOKEN_EQUAL) || parser_match(parser, TOKEN_NOT_EQUAL)) {
     BinaryOperator op = (parser->previous_token.type == TOKEN_EQUAL) ? BINOP_EQ : BINOP_NE;
     ASTNode* right = parse_comparison(parser);
-    expr = ast_create_binary_op(op, expr, right);
+    expr = check_node(parser, ast_create_binary_op(parser->arena, op, expr, right));
   }
   
   return expr;
@@ -402,7 +411,7 @@ ASTNode* parse_comparison(Parser* parser) {
       default: op = BINOP_LT; break;
     }
     ASTNode* right = parse_term(parser);
-    expr = ast_create_binary_op(op, expr, right);
+    expr = check_node(parser, ast_create_binary_op(parser->arena, op, expr, right));
   }
   
   return expr;
@@ -414,7 +423,7 @@ ASTNode* parse_term(Parser* parser) {
   while (parser_match(parser, TOKEN_MINUS) || parser_match(parser, TOKEN_PLUS)) {
     BinaryOperator op = (parser->previous_token.type == TOKEN_PLUS) ? BINOP_ADD : BINOP_SUB;
     ASTNode* right = parse_factor(parser);
-    expr = ast_create_binary_op(op, expr, right);
+    expr = check_node(parser, ast_create_binary_op(parser->arena, op, expr, right));
   }
   
   return expr;
@@ -432,7 +441,7 @@ ASTNode* parse_factor(Parser* parser) {
       default: op = BINOP_MUL; break;
     }
     ASTNode* right = parse_unary(parser);
-    expr = ast_create_binary_op(op, expr, right);
+    expr = check_node(parser, ast_create_binary_op(parser->arena, op, expr, right));
   }
   
   return expr;
@@ -442,13 +451,13 @@ ASTNode* parse_unary(Parser* parser) {
   if (parser_match(parser, TOKEN_LOGICAL_NOT) || parser_match(parser, TOKEN_MINUS)) {
     UnaryOperator op = (parser->previous_token.type == TOKEN_LOGICAL_NOT) ? UNOP_NOT : UNOP_MINUS;
     ASTNode* operand = parse_unary(parser);
-    return ast_create_unary_op(op, operand);
+    return check_node(parser, ast_create_unary_op(parser->arena, op, operand));
   }
   
   if (parser_match(parser, TOKEN_INCREMENT) || parser_match(parser, TOKEN_DECREMENT)) {
     UnaryOperator op = (parser->previous_token.type == TOKEN_INCREMENT) ? UNOP_PRE_INC : UNOP_PRE_DEC;
     ASTNode* operand = parse_call(parser);
-    return ast_create_unary_op(op, operand);
+    return check_node(parser, ast_create_unary_op(parser->arena, op, operand));
   }
   
   return parse_call(parser);
@@ -460,30 +469,30 @@ ASTNode* parse_call(Parser* parser) {
   while (true) {
     if (parser_match(parser, TOKEN_LEFT_PAREN)) {
       // Function call
-      if (expr->type != AST_IDENTIFIER) {
+      if (!expr || expr->type != AST_IDENTIFIER) {
         parser_error(parser, "Only identifiers can be called.");
         return expr;
       }
-      
-      ASTNode* call = ast_create_call(expr->identifier.name);
-      
+  
+      ASTNode* call = check_node(parser, ast_create_call(parser->arena, expr->identifier.name));
+      if (!call) return NULL;
+  
       // Parse arguments
       if (!parser_check(parser, TOKEN_RIGHT_PAREN)) {
         do {
           ASTNode* arg = parse_expression(parser);
           if (arg) {
-            ast_add_argument(call, arg);
+            check_added(parser, ast_add_argument(parser->arena, call, arg));
           }
         } while (parser_match(parser, TOKEN_COMMA));
       }
-      
+  
       parser_consume(parser, TOKEN_RIGHT_PAREN, "Expected ')' after arguments.");
-      
-      ast_free_node(expr);
-      expr = call;
+  
+      expr = call; // the callee identifier stays in the arena
     } else if (parser_match(parser, TOKEN_INCREMENT) || parser_match(parser, TOKEN_DECREMENT)) {
       UnaryOperator op = (parser->previous_token.type == TOKEN_INCREMENT) ? UNOP_POST_INC : UNOP_POST_DEC;
-      expr = ast_create_unary_op(op, expr);
+      expr = check_node(parser, ast_create_unary_op(parser->arena, op, expr));
     } else {
       break;
     }
@@ -494,40 +503,33 @@ ASTNode* parse_call(Parser* parser) {
 
 ASTNode* parse_primary(Parser* parser) {
   if (parser_match(parser, TOKEN_NUMBER)) {
-    char* text = token_to_string(&parser->previous_token);
-    int64_t value = strtoll(text, NULL, 10);
-    free(text);
-    return ast_create_number(value);
+    // Digits end at the first non-digit, so the token can be parsed in place
+    int64_t value = strtoll(parser->previous_token.start, NULL, 10);
+    return check_node(parser, ast_create_number(parser->arena, value));
   }
   
   if (parser_match(parser, TOKEN_STRING)) {
-    char* text = token_to_string(&parser->previous_token);
     // Remove quotes
-    size_t len = strlen(text);
-    if (len >= 2) {
-      text[len - 1] = '\0';
-      ASTNode* string_node = ast_create_string(text + 1);
-      free(text);
-      return string_node;
+    const Token* token = &parser->previous_token;
+    const char* value = "";
+    if (token->length >= 2) {
+      value = arena_strndup(parser->arena, token->start + 1, (size_t)token->length - 2);
+      if (!value) return check_node(parser, NULL);
     }
-    free(text);
-    return ast_create_string("");
+    return check_node(parser, ast_create_string(parser->arena, value));
   }
   
   if (parser_match(parser, TOKEN_CHAR)) {
-    char* text = token_to_string(&parser->previous_token);
-    char value = (strlen(text) >= 3) ? text[1] : '\0'; // Skip opening quote
-    free(text);
-    ASTNode* char_node = ast_create_node(AST_CHAR);
+    const Token* token = &parser->previous_token;
+    char value = (token->length >= 3) ? token->start[1] : '\0'; // Skip opening quote
+    ASTNode* char_node = check_node(parser, ast_create_node(parser->arena, AST_CHAR));
+    if (!char_node) return NULL;
     char_node->character.value = value;
     return char_node;
   }
   
   if (parser_match(parser, TOKEN_IDENTIFIER)) {
-    char* name = token_to_string(&parser->previous_token);
-    ASTNode* identifier = ast_create_identifier(name);
-    free(name);
-    return identifier;
+    return check_node(parser, ast_create_identifier(parser->arena, parser->previous_token.name));
   }
   
   if (parser_match(parser, TOKEN_LEFT_PAREN)) {
@@ -0,0 +1,132 @@
+/**
+ * @file src/symtab.c
+ * @brief Hashed, scoped symbol table implementation
+ */
+
+#include "symtab.h"
+#include "utils.h"
+#include <string.h>
+
+#define SYMTAB_INITIAL_BUCKETS 64
+#define SYMTAB_ARENA_CHUNK_SIZE (16 * 1024)
+
+bool symtab_init(SymbolTable* table) {
+  memset(table, 0, sizeof(*table));
+  table->arena = ArenaCreate(SYMTAB_ARENA_CHUNK_SIZE);
+  if (!table->arena) return false;
+  table->bucket_count = SYMTAB_INITIAL_BUCKETS;
+  table->buckets = ArenaAlloc(table->arena, table->bucket_count * sizeof(SymbolName*));
+  if (!table->buckets) return false;
+  
+  return symtab_enter_scope(table);
+}
+
+void symtab_free(SymbolTable* table) {
+  ArenaFree(table->arena);
+  memset(table, 0, sizeof(*table));
+}
+
+bool symtab_enter_scope(SymbolTable* table) {
+  if (table->scope_count == table->scope_capacity) {
+    size_t capacity = table->scope_capacity ? table->scope_capacity * 2 : 16;
+    Symbol** scopes = ArenaAlloc(table->arena, capacity * sizeof(Symbol*));
+    if (!scopes) return false;
+    if (table->scope_count > 0) memcpy(scopes, table->scopes, table->scope_count * sizeof(Symbol*));
+    table->scopes = scopes;
+    table->scope_capacity = capacity;
+  }
+  table->scopes[table->scope_count++] = NULL;
+  return true;
+}
+
+void symtab_leave_scope(SymbolTable* table) {
+  if (table->scope_count == 0) return;
+  
+  Symbol* symbol = table->scopes[--table->scope_count];
+  while (symbol) {
+    Symbol* next = symbol->next;
+    symbol->entry->binding = symbol->shadowed;
+    symbol->next = table->free_symbols;
+    table->free_symbols = symbol;
+    symbol = next;
+  }
+}
+
+static void symtab_grow(SymbolTable* table) {
+  size_t bucket_count = table->bucket_count * 2;
+  SymbolName** buckets = ArenaAlloc(table->arena, bucket_count * sizeof(SymbolName*));
+  if (!buckets) return; // chains just get longer
+  
+  for (size_t i = 0; i < table->bucket_count; i++) {
+    SymbolName* entry = table->buckets[i];
+    while (entry) {
+      SymbolName* next = entry->next;
+      size_t index = intern_hash(entry->name) & (bucket_count - 1);
+      entry->next = buckets[index];
+      buckets[index] = entry;
+      entry = next;
+    }
+  }
+  
+  table->buckets = buckets;
+  table->bucket_count = bucket_count;
+}
+
+static SymbolName* symtab_lookup(SymbolTable* table, const char* name) {
+  SymbolName* entry = table->buckets[intern_hash(name) & (table->bucket_count - 1)];
+  while (entry && entry->name != name) {
+    entry = entry->next;
+  }
+  return entry;
+}
+
+static SymbolName* symtab_entry(SymbolTable* table, const char* name) {
+  SymbolName* entry = symtab_lookup(table, name);
+  if (entry) return entry;
+  
+  // Keep the load factor at or below one
+  if (table->name_count >= table->bucket_count) {
+    symtab_grow(table);
+  }
+  
+  entry = ArenaAlloc(table->arena, sizeof(SymbolName));
+  if (!entry) return NULL;
+  entry->name = name;
+  entry->binding = NULL;
+  
+  size_t index = intern_hash(name) & (table->bucket_count - 1);
+  entry->next = table->buckets[index];
+  table->buckets[index] = entry;
+  table->name_count++;
+  return entry;
+}
+
+Symbol* symtab_find(SymbolTable* table, const char* name) {
+  SymbolName* entry = symtab_lookup(table, name);
+  return entry ? entry->binding : NULL;
+}
+
+Symbol* symtab_declare(SymbolTable* table, const char* name, DataType type) {
+  SymbolName* entry = symtab_entry(table, name);
+  if (!entry) return NULL;
+  
+  Symbol* symbol = table->free_symbols;
+  if (symbol) {
+    table->free_symbols = symbol->next;
+  } else {
+    symbol = ArenaAlloc(table->arena, sizeof(Symbol));
+    if (!symbol) return NULL;
+  }
+  
+  symbol->name = entry->name;
+  symbol->type = type;
+  symbol->var_id = 0;
+  symbol->entry = entry;
+  symbol->shadowed = entry->binding;
+  entry->binding = symbol;
+  
+  // Scope lists are LIFO, so leaving a scope restores bindings in reverse order
+  symbol->next = table->scopes[table->scope_count - 1];
+  table->scopes[table->scope_count - 1] = symbol;
+  return symbol;
+}
@@ -9,52 +9,132 @@
 #include <string.h>
 #include <ctype.h>
 
-void* safe_malloc(size_t size) {
-  void* ptr = malloc(size);
-  if (!ptr) {
-    fprintf(stderr, "Error: Memory allocation failed\n");
-    exit(1);
-  }
-  return ptr;
+static ArenaChunk* arena_new_chunk(size_t capacity) {
+  ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + capacity);
+  if (!chunk) return NULL;
+  chunk->next = NULL;
+  chunk->capacity = capacity;
+  return chunk;
 }
 
-void* safe_realloc(void* ptr, size_t size) {
-  void* new_ptr = realloc(ptr, size);
-  if (!new_ptr && size > 0) {
-    fprintf(stderr, "Error: Memory reallocation failed\n");
-    exit(1);
+Arena* ArenaCreate(size_t chunk_size) {
+  Arena* arena = malloc(sizeof(Arena));
+  if (!arena) return NULL;
+  arena->chunk_size = chunk_size;
+  arena->root = arena->current = arena_new_chunk(chunk_size);
+  arena->offset = 0;
+  if (!arena->root) {
+    free(arena);
+    return NULL;
   }
-  return new_ptr;
+  return arena;
 }
 
-char* safe_strdup(const char* str) {
-  if (!str) return NULL;
+// First offset at or after offset whose address in chunk is aligned
+static size_t arena_align(const ArenaChunk* chunk, size_t offset, size_t align) {
+  uintptr_t base = (uintptr_t)chunk->buffer;
+  return (size_t)(((base + offset + align - 1) & ~(uintptr_t)(align - 1)) - base);
+}
+
+// align is a power of two
+void* ArenaAllocAligned(Arena* arena, size_t size, size_t align) {
+  ArenaChunk* chunk = arena->current;
+  size_t offset = arena_align(chunk, arena->offset, align);
+  
+  // Move on to the next chunk that fits, reusing those kept by a reset
+  while (offset + size > chunk->capacity) {
+    ArenaChunk* next = chunk->next;
+    if (!next) {
+      size_t capacity = size + align > arena->chunk_size ? size + align : arena->chunk_size;
+      next = arena_new_chunk(capacity);
+      if (!next) return NULL;
+      chunk->next = next;
+    }
+    chunk = next;
+    offset = arena_align(chunk, 0, align);
+  }
   
-  size_t len = strlen(str);
-  char* copy = safe_malloc(len + 1);
-  memcpy(copy, str, len + 1);
+  void* result = chunk->buffer + offset;
+  arena->current = chunk;
+  arena->offset = offset + size;
+  if (size) memset(result, 0, size);
+  return result;
+}
+
+void* ArenaAlloc(Arena* arena, size_t size) {
+  return ArenaAllocAligned(arena, size, 2 * sizeof(void*));
+}
+
+char* ArenaAllocChars(Arena* arena, size_t count) {
+  return ArenaAllocAligned(arena, count, 1);
+}
+
+void ArenaReset(Arena* arena) {
+  arena->current = arena->root;
+  arena->offset = 0;
+}
+
+void ArenaFree(Arena* arena) {
+  if (!arena) return;
+  for (ArenaChunk* chunk = arena->root; chunk;) {
+    ArenaChunk* next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  free(arena);
+}
+
+char* arena_strndup(Arena* arena, const char* str, size_t length) {
+  char* copy = ArenaAllocChars(arena, length + 1);
+  if (!copy) return NULL;
+  memcpy(copy, str, length);
+  copy[length] = '\0';
   return copy;
 }
 
+// Makes room for one more item. Capacity doubles at powers of two, so no
+// capacity field is needed; outgrown arrays stay behind in the arena.
+void* arena_grow_array(Arena* arena, void* items, size_t count, size_t item_size) {
+  if (count != 0 && (count < 4 || (count & (count - 1)) != 0)) return items;
+  
+  size_t capacity = count == 0 ? 4 : count * 2;
+  void* grown = ArenaAlloc(arena, capacity * item_size);
+  if (!grown) return NULL;
+  if (count > 0) memcpy(grown, items, count * item_size);
+  return grown;
+}
+
 bool str_equals(const char* a, const char* b) {
   if (a == b) return true;
   if (!a || !b) return false;
   return strcmp(a, b) == 0;
 }
 
+// FNV-1a
+uint32_t str_hash(const char* str, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char)str[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
 char* str_slice(const char* str, int start, int length) {
   if (!str) return NULL;
   
   int str_len = (int)strlen(str);
   if (start < 0 || start >= str_len || length <= 0) {
-    return safe_strdup("");
+    length = 0;
+    start = 0;
   }
   
   if (start + length > str_len) {
     length = str_len - start;
   }
   
-  char* slice = safe_malloc(length + 1);
+  char* slice = malloc(length + 1);
+  if (!slice) return NULL;
   memcpy(slice, str + start, length);
   slice[length] = '\0';
   return slice;
@@ -99,7 +179,11 @@ char* read_file(const char* filename) {
   }
   
   // Allocate buffer
-  char* buffer = safe_malloc(size + 1);
+  char* buffer = malloc(size + 1);
+  if (!buffer) {
+    fclose(file);
+    return NULL;
+  }
   
   // Read file
   size_t bytes_read = fread(buffer, 1, size, file);
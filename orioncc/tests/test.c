@@ -4,7 +4,9 @@
  */
 
 #include "../include/occ.h"
+#include "orionpp/header.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
@@ -12,8 +14,11 @@ void test_lexer() {
   printf("Testing lexer...\n");
   
   const char* source = "int main() { return 42; }";
+  Arena* arena = ArenaCreate(OCC_ARENA_CHUNK_SIZE);
+  InternTable strings;
+  intern_init(&strings, arena);
   Lexer lexer;
-  lexer_init(&lexer, source);
+  lexer_init(&lexer, source, &strings);
   
   Token token = lexer_next_token(&lexer);
   assert(token.type == TOKEN_INT);
@@ -46,6 +51,36 @@ void test_lexer() {
   token = lexer_next_token(&lexer);
   assert(token.type == TOKEN_EOF);
   
+  // Identifiers with the same text share one handle
+  lexer_init(&lexer, "count main count", &strings);
+  Token first = lexer_next_token(&lexer);
+  Token second = lexer_next_token(&lexer);
+  Token third = lexer_next_token(&lexer);
+  assert(first.name && first.name == third.name);
+  assert(second.name == intern_cstr(&strings, "main"));
+  assert(first.name != second.name);
+  assert(intern_length(first.name) == 5 && str_hash("count", 5) == intern_hash(first.name));
+  
+  // Every keyword, near-misses that stay identifiers, and positions after comments
+  const char* keywords = "int char void if else while for return const";
+  TokenType keyword_types[] = { TOKEN_INT, TOKEN_CHAR_KW, TOKEN_VOID, TOKEN_IF, TOKEN_ELSE, TOKEN_WHILE, TOKEN_FOR, TOKEN_RETURN, TOKEN_CONST };
+  lexer_init(&lexer, keywords, &strings);
+  for (size_t i = 0; i < sizeof(keyword_types) / sizeof(keyword_types[0]); i++) {
+    assert(lexer_next_token(&lexer).type == keyword_types[i]);
+  }
+  
+  lexer_init(&lexer, "iff in chars _if returns /* a\n b */ x // c\n  \"s\n\" y", &strings);
+  for (int i = 0; i < 5; i++) {
+    assert(lexer_next_token(&lexer).type == TOKEN_IDENTIFIER);
+  }
+  token = lexer_next_token(&lexer);
+  assert(token.name == intern_cstr(&strings, "x") && token.line == 2 && token.column == 7);
+  token = lexer_next_token(&lexer);
+  assert(token.type == TOKEN_STRING && token.line == 3 && token.column == 3);
+  token = lexer_next_token(&lexer);
+  assert(token.name == intern_cstr(&strings, "y") && token.line == 4 && token.column == 3);
+  
+  ArenaFree(arena);
   printf("Lexer tests passed!\n");
 }
 
@@ -54,10 +89,13 @@ void test_parser() {
   
   const char* source = "int main() { int x = 5; return x + 2; }";
   Lexer lexer;
-  lexer_init(&lexer, source);
+  Arena* arena = ArenaCreate(OCC_ARENA_CHUNK_SIZE);
+  InternTable strings;
+  intern_init(&strings, arena);
+  lexer_init(&lexer, source, &strings);
   
   Parser parser;
-  parser_init(&parser, &lexer);
+  parser_init(&parser, &lexer, arena);
   
   ASTNode* ast = parse_program(&parser);
   assert(ast != NULL);
@@ -73,7 +111,7 @@ void test_parser() {
     printf("Parser had errors, but basic structure is correct...\n");
   }
   
-  ast_free_node(ast);
+  ArenaFree(arena);
   printf("Parser tests passed!\n");
 }
 
@@ -82,16 +120,19 @@ void test_simple_expression() {
   
   const char* source = "int x = 2 + 3 * 4;";
   Lexer lexer;
-  lexer_init(&lexer, source);
+  Arena* arena = ArenaCreate(OCC_ARENA_CHUNK_SIZE);
+  InternTable strings;
+  intern_init(&strings, arena);
+  lexer_init(&lexer, source, &strings);
   
   Parser parser;
-  parser_init(&parser, &lexer);
+  parser_init(&parser, &lexer, arena);
   
   ASTNode* ast = parse_program(&parser);
   assert(ast != NULL);
   assert(!parser.had_error);
   
-  ast_free_node(ast);
+  ArenaFree(arena);
   printf("Expression tests passed!\n");
 }
 
@@ -100,10 +141,13 @@ void test_function_calls() {
   
   const char* source = "int test() { int x = add(1, 2); return x; }";
   Lexer lexer;
-  lexer_init(&lexer, source);
+  Arena* arena = ArenaCreate(OCC_ARENA_CHUNK_SIZE);
+  InternTable strings;
+  intern_init(&strings, arena);
+  lexer_init(&lexer, source, &strings);
   
   Parser parser;
-  parser_init(&parser, &lexer);
+  parser_init(&parser, &lexer, arena);
   
   ASTNode* ast = parse_program(&parser);
   assert(ast != NULL);
@@ -112,7 +156,7 @@ void test_function_calls() {
     printf("Parser had errors with function calls, but continuing...\n");
   }
   
-  ast_free_node(ast);
+  ArenaFree(arena);
   printf("Function call tests completed!\n");
 }
 
@@ -132,41 +176,206 @@ void test_control_flow() {
     "}";
   
   Lexer lexer;
-  lexer_init(&lexer, source);
+  Arena* arena = ArenaCreate(OCC_ARENA_CHUNK_SIZE);
+  InternTable strings;
+  intern_init(&strings, arena);
+  lexer_init(&lexer, source, &strings);
   
   Parser parser;
-  parser_init(&parser, &lexer);
+  parser_init(&parser, &lexer, arena);
   
   ASTNode* ast = parse_program(&parser);
   assert(ast != NULL);
   
   if (parser.had_error) {
     printf("Parser had errors, but continuing test...\n");
-    ast_free_node(ast);
+    ArenaFree(arena);
     printf("Control flow tests completed with errors!\n");
     return;
   }
   
-  ast_free_node(ast);
+  ArenaFree(arena);
   printf("Control flow tests passed!\n");
 }
 
+void test_arena_ast() {
+  printf("Testing arena-allocated AST...\n");
+  
+  // Enough children to grow every vector past its first few doublings
+  char source[2048];
+  int len = snprintf(source, sizeof(source), "int f(int a, int b, int c, int d, int e, int g) {");
+  for (int i = 0; i < 20; i++) {
+    len += snprintf(source + len, sizeof(source) - len, " int v%d = %d;", i, i);
+  }
+  snprintf(source + len, sizeof(source) - len, " return add(1, 2, 3, 4, 5, 6, 7, 8, 9); }");
+  
+  Arena* arena = ArenaCreate(OCC_ARENA_CHUNK_SIZE);
+  for (int pass = 0; pass < 2; pass++) {
+    InternTable strings;
+    intern_init(&strings, arena);
+    Lexer lexer;
+    lexer_init(&lexer, source, &strings);
+    Parser parser;
+    parser_init(&parser, &lexer, arena);
+  
+    ASTNode* ast = parse_program(&parser);
+    assert(ast != NULL && !parser.had_error);
+    ASTNode* func = ast->program.statements[0];
+    assert(func->function.parameter_count == 6);
+    assert(str_equals(func->function.parameters[5]->variable_decl.name, "g"));
+  
+    ASTNode* body = func->function.body;
+    assert(body->block.statement_count == 21);
+    for (int i = 0; i < 20; i++) {
+      ASTNode* decl = body->block.statements[i];
+      assert(decl->variable_decl.initializer->number.value == i);
+    }
+  
+    ASTNode* call = body->block.statements[20]->return_stmt.value;
+    assert(call->type == AST_CALL && str_equals(call->call.name, "add"));
+    assert(call->call.argument_count == 9);
+    for (size_t i = 0; i < 9; i++) {
+      assert(call->call.arguments[i]->number.value == (int64_t)i + 1);
+    }
+  
+    // The second pass reuses the chunks of the first
+    ArenaReset(arena);
+  }
+  ArenaFree(arena);
+  
+  printf("Arena AST tests passed!\n");
+}
+
+void test_optimizer() {
+  printf("Testing AST optimizer...\n");
+  
+  const char* source =
+    "int f(int x) {"
+    "  int a = 2 + 3 * 4;"
+    "  int b = x * 1 + 0;"
+    "  int c = (x < 3) * 8;"
+    "  int d = x / 4;"
+    "  int e = (x < 3) / 2;"
+    "  int g = 1 / 0;"
+    "  char h = 'a';"
+    "  int i = h * 1;"
+    "  int j = f(x) * 0;"
+    "  if (3 > 4) { a = 1; } else { a = 2; }"
+    "  while (0) { a = 3; }"
+    "  return -a;"
+    "}"
+    "int k(int x) { return x * 4; }";
+  
+  Arena* arena = ArenaCreate(OCC_ARENA_CHUNK_SIZE);
+  InternTable strings;
+  intern_init(&strings, arena);
+  Lexer lexer;
+  lexer_init(&lexer, source, &strings);
+  Parser parser;
+  parser_init(&parser, &lexer, arena);
+  ASTNode* ast = parse_program(&parser);
+  assert(ast != NULL && !parser.had_error);
+  
+  OptimizeStats stats;
+  optimize_program(ast, arena, &stats);
+  ASTNode** body = ast->program.statements[0]->function.body->block.statements;
+  
+  // Constants fold, identities disappear
+  ASTNode* a = body[0]->variable_decl.initializer;
+  assert(a->type == AST_NUMBER && a->number.value == 14);
+  ASTNode* b = body[1]->variable_decl.initializer;
+  assert(b->type == AST_IDENTIFIER && str_equals(b->identifier.name, "x"));
+  
+  // Powers of two become shifts, but a signed operand keeps its multiplication
+  // or division
+  ASTNode* c = body[2]->variable_decl.initializer;
+  assert(c->binary_op.operator == BINOP_SHL && c->binary_op.right->number.value == 3);
+  assert(body[3]->variable_decl.initializer->binary_op.operator == BINOP_DIV);
+  ASTNode* product = ast->program.statements[1]->function.body->block.statements[0]->return_stmt.value;
+  assert(product->binary_op.operator == BINOP_MUL && product->binary_op.right->number.value == 4);
+  ASTNode* e = body[4]->variable_decl.initializer;
+  assert(e->binary_op.operator == BINOP_SHR && e->binary_op.right->number.value == 1);
+  
+  // Faults are left for run time, char results keep their type, calls still run
+  assert(body[5]->variable_decl.initializer->type == AST_BINARY_OP);
+  assert(body[7]->variable_decl.initializer->binary_op.operator == BINOP_MUL);
+  assert(body[8]->variable_decl.initializer->binary_op.operator == BINOP_MUL);
+  
+  // The else branch replaces the if, the loop is gone
+  ASTNode* taken = body[9];
+  assert(taken->type == AST_BLOCK && taken->block.statements[0]->expression_stmt.expression->assignment.value->number.value == 2);
+  assert(body[10]->type == AST_BLOCK && body[10]->block.statement_count == 0);
+  assert(body[11]->return_stmt.value->type == AST_UNARY_OP);
+  assert(stats.folded == 3 && stats.pruned == 2);
+  
+  ArenaFree(arena);
+  printf("AST optimizer tests passed!\n");
+}
+
+void test_symbol_table() {
+  printf("Testing scoped symbol table...\n");
+  
+  Arena* arena = ArenaCreate(OCC_ARENA_CHUNK_SIZE);
+  InternTable strings;
+  intern_init(&strings, arena);
+  const char* x = intern_cstr(&strings, "x");
+  const char* y = intern_cstr(&strings, "y");
+  
+  SymbolTable table;
+  symtab_init(&table);
+  
+  Symbol* outer = symtab_declare(&table, x, TYPE_INT);
+  outer->var_id = 1;
+  
+  // Inner declarations shadow until their scope closes
+  symtab_enter_scope(&table);
+  Symbol* inner = symtab_declare(&table, x, TYPE_CHAR);
+  inner->var_id = 2;
+  symtab_declare(&table, y, TYPE_INT);
+  assert(symtab_find(&table, x) == inner);
+  assert(inner->shadowed == outer);
+  symtab_leave_scope(&table);
+  
+  assert(symtab_find(&table, x) == outer);
+  assert(symtab_find(&table, y) == NULL);
+  
+  // Enough names to rehash several times
+  char name[16];
+  for (int i = 0; i < 1000; i++) {
+    snprintf(name, sizeof(name), "v%d", i);
+    symtab_declare(&table, intern_cstr(&strings, name), TYPE_INT)->var_id = (orionpp_variable_id_t)i;
+  }
+  for (int i = 0; i < 1000; i++) {
+    snprintf(name, sizeof(name), "v%d", i);
+    Symbol* symbol = symtab_find(&table, intern_cstr(&strings, name));
+    assert(symbol && symbol->var_id == (orionpp_variable_id_t)i);
+  }
+  assert(symtab_find(&table, x) == outer);
+  
+  symtab_free(&table);
+  ArenaFree(arena);
+  printf("Symbol table tests passed!\n");
+}
+
 void test_code_generation() {
   printf("Testing code generation...\n");
   
   const char* source = "int main() { int x = 42; return x; }";
   Lexer lexer;
-  lexer_init(&lexer, source);
+  Arena* arena = ArenaCreate(OCC_ARENA_CHUNK_SIZE);
+  InternTable strings;
+  intern_init(&strings, arena);
+  lexer_init(&lexer, source, &strings);
   
   Parser parser;
-  parser_init(&parser, &lexer);
+  parser_init(&parser, &lexer, arena);
   
   ASTNode* ast = parse_program(&parser);
   assert(ast != NULL);
   
   if (parser.had_error) {
     printf("Parser had errors, skipping code generation test...\n");
-    ast_free_node(ast);
+    ArenaFree(arena);
     printf("Code generation test skipped due to parser errors!\n");
     return;
   }
@@ -181,7 +390,16 @@ void test_code_generation() {
   
   fclose(output);
   codegen_cleanup(&codegen);
-  ast_free_node(ast);
+  ArenaFree(arena);
+  
+  // Output is an image: header first, written through one buffered stream
+  assert(codegen.stream.syscalls <= 1);
+  output = fopen("test_output.opp", "rb");
+  assert(output != NULL);
+  unsigned char magic[4] = { 0 };
+  assert(fread(magic, 1, sizeof(magic), output) == sizeof(magic));
+  assert(magic[0] == ORIONPP_MAGIC0 && magic[3] == ORIONPP_MAGIC3);
+  fclose(output);
   
   if (success) {
     printf("Code generation tests passed!\n");
@@ -190,6 +408,360 @@ void test_code_generation() {
   }
 }
 
+// Counts VAR records in a module and whether any id is declared twice
+static size_t count_var_records(const char* path, bool* duplicate) {
+  FILE* file = fopen(path, "rb");
+  assert(file != NULL);
+  orionpp_header_t header;
+  assert(fread(&header, sizeof(header), 1, file) == 1);
+  fseek(file, (long)(header.codetab + sizeof(orionpp_code_table_t)), SEEK_SET);
+  
+  bool seen[256] = { false };
+  size_t count = 0;
+  *duplicate = false;
+  orionpp_code_record_t record;
+  while (fread(&record, sizeof(record), 1, file) == 1) {
+    for (uint16_t i = 0; i < record.value_count; i++) {
+      orionpp_code_value_t value;
+      unsigned char payload[64] = { 0 };
+      assert(fread(&value, sizeof(value), 1, file) == 1);
+      size_t padded = ORIONPP_CODE_ALIGN((size_t)value.bytesize);
+      assert(padded <= sizeof(payload) && fread(payload, 1, padded, file) == padded);
+  
+      if (record.child == ORIONPP_OP_ISA_VAR && i == 0) {
+        uint32_t id;
+        memcpy(&id, payload, sizeof(id));
+        assert(id < 256);
+        *duplicate |= seen[id];
+        seen[id] = true;
+        count++;
+      }
+    }
+  }
+  fclose(file);
+  return count;
+}
+
+// Counts the records of one ISA opcode in a module
+static size_t count_opcode_records(const char* path, orionpp_opcode_module_t opcode) {
+  FILE* file = fopen(path, "rb");
+  assert(file != NULL);
+  orionpp_header_t header;
+  assert(fread(&header, sizeof(header), 1, file) == 1);
+  fseek(file, (long)(header.codetab + sizeof(orionpp_code_table_t)), SEEK_SET);
+  
+  size_t count = 0;
+  orionpp_code_record_t record;
+  while (fread(&record, sizeof(record), 1, file) == 1) {
+    if (record.root == ORIONPP_OP_ISA && record.child == opcode) count++;
+    for (uint16_t i = 0; i < record.value_count; i++) {
+      orionpp_code_value_t value;
+      assert(fread(&value, sizeof(value), 1, file) == 1);
+      fseek(file, (long)ORIONPP_CODE_ALIGN((size_t)value.bytesize), SEEK_CUR);
+    }
+  }
+  fclose(file);
+  return count;
+}
+
+void test_temp_reuse() {
+  printf("Testing temporary reuse...\n");
+  
+  // Every statement needs temporaries, but never more than two at once
+  char source[4096];
+  int len = snprintf(source, sizeof(source), "int f(int a) { int b = 0;");
+  for (int i = 0; i < 50; i++) {
+    len += snprintf(source + len, sizeof(source) - len, " b = b + a * %d - (a < %d);", i + 3, i);
+  }
+  snprintf(source + len, sizeof(source) - len, " while (b > 0) { int c = b - 1; b = c; } return b; }");
+  
+  Arena* arena = ArenaCreate(OCC_ARENA_CHUNK_SIZE);
+  InternTable strings;
+  intern_init(&strings, arena);
+  Lexer lexer;
+  lexer_init(&lexer, source, &strings);
+  Parser parser;
+  parser_init(&parser, &lexer, arena);
+  ASTNode* ast = parse_program(&parser);
+  assert(ast != NULL && !parser.had_error);
+  
+  FILE* output = fopen("test_temps.opp", "wb");
+  assert(output != NULL);
+  CodeGen codegen;
+  codegen_init(&codegen, output);
+  assert(codegen_generate(&codegen, ast));
+  fclose(output);
+  
+  assert(codegen.temps.requested > 250);
+  assert(codegen.temps.declared == codegen.temps.peak_live);
+  assert(codegen.temps.peak_live <= 3);
+  assert(codegen.temps.live == 0);
+  
+  // Declarations are hoisted, so the loop body does not declare c again
+  bool duplicate;
+  size_t vars = count_var_records("test_temps.opp", &duplicate);
+  assert(!duplicate);
+  assert(vars == 3 + codegen.temps.declared);
+  
+  codegen_cleanup(&codegen);
+  ArenaFree(arena);
+  remove("test_temps.opp");
+  printf("Temporary reuse tests passed!\n");
+}
+
+void test_ssa_optimizer() {
+  printf("Testing SSA optimizer...\n");
+  
+  // u is never read, a * b is computed twice and a * 7 does not change in the loop
+  const char* source =
+    "int f(int a, int b) { int u = a - b; int x = a * b; int y = a * b; int s = 0; int i = 0;"
+    " while (i < 10) { s = s + a * 7; i = i + 1; } return x + y + s; }";
+  
+  Arena* arena = ArenaCreate(OCC_ARENA_CHUNK_SIZE);
+  InternTable strings;
+  intern_init(&strings, arena);
+  Lexer lexer;
+  lexer_init(&lexer, source, &strings);
+  Parser parser;
+  parser_init(&parser, &lexer, arena);
+  ASTNode* ast = parse_program(&parser);
+  assert(ast != NULL && !parser.had_error);
+  const ASTNode* function = ast->program.statements[0];
+  
+  // Parameters are declared by the code generator before the body is built
+  FILE* output = fopen("test_ssa.opp", "wb");
+  assert(output != NULL);
+  CodeGen codegen;
+  codegen_init(&codegen, output);
+  codegen_enter_scope(&codegen);
+  for (size_t i = 0; i < function->function.parameter_count; i++) {
+    const ASTNode* param = function->function.parameters[i];
+    codegen_add_symbol(&codegen, param->variable_decl.name, param->variable_decl.type);
+  }
+  
+  Arena* ir_arena = ArenaCreate(IR_ARENA_CHUNK_SIZE);
+  IRFunction* fn = ir_build_function(&codegen, function, ir_arena);
+  assert(fn != NULL);
+  IRStats stats;
+  ir_optimize(fn, 3, &stats);
+  assert(stats.cse >= 1);
+  assert(stats.dead >= 1);
+  assert(stats.hoisted >= 2); // the constant and the product
+  assert(stats.values_after < stats.values_before);
+  
+  // The loop keeps only its counter, sum and comparison
+  size_t multiplies = 0, subtracts = 0;
+  for (size_t r = 0; r < fn->rpo_count; r++) {
+    const IRBlock* block = fn->rpo[r];
+    for (size_t i = 0; i < block->value_count; i++) {
+      const IRValue* value = block->values[i];
+      if (value->op != IR_BINARY) continue;
+      if (value->operator == BINOP_MUL) {
+        multiplies++;
+        assert(fn->entry == block);
+      }
+      if (value->operator == BINOP_SUB) subtracts++;
+    }
+  }
+  assert(multiplies == 2);
+  assert(subtracts == 0);
+  ArenaFree(ir_arena);
+  codegen_leave_scope(&codegen);
+  codegen_cleanup(&codegen);
+  fclose(output);
+  
+  // The whole path at -O3 declares each variable once, loop or not
+  output = fopen("test_ssa.opp", "wb");
+  assert(output != NULL);
+  codegen_init(&codegen, output);
+  codegen.opt_level = 3;
+  assert(codegen_generate(&codegen, ast));
+  fclose(output);
+  bool duplicate;
+  assert(count_var_records("test_ssa.opp", &duplicate) > 0);
+  assert(!duplicate);
+  
+  codegen_cleanup(&codegen);
+  ArenaFree(arena);
+  remove("test_ssa.opp");
+  printf("SSA optimizer tests passed!\n");
+}
+
+void test_condition_branches() {
+  printf("Testing condition branches...\n");
+  
+  // Every test is a comparison, so no condition is ever held as a 1 or 0
+  const char* source =
+    "int f(int n) { int s = 0; int i = 0;"
+    " while (i < n && i != 7) { if (i > 3 || i == 1) s = s + i; i = i + 1; }"
+    " for (i = 0; !(i >= n); i = i + 1) s = s - 1;"
+    " if (s > 0 && g(s)) s = 0; return s; }";
+  
+  Arena* arena = ArenaCreate(OCC_ARENA_CHUNK_SIZE);
+  InternTable strings;
+  intern_init(&strings, arena);
+  Lexer lexer;
+  lexer_init(&lexer, source, &strings);
+  Parser parser;
+  parser_init(&parser, &lexer, arena);
+  ASTNode* ast = parse_program(&parser);
+  assert(ast != NULL && !parser.had_error);
+  
+  for (int level = 0; level <= 3; level += 3) {
+    FILE* output = fopen("test_branches.opp", "wb");
+    assert(output != NULL);
+    CodeGen codegen;
+    codegen_init(&codegen, output);
+    codegen.opt_level = level;
+    assert(codegen_generate(&codegen, ast));
+    fclose(output);
+    codegen_cleanup(&codegen);
+  
+    // Only the call's result is tested against zero; ! just swaps the targets
+    size_t zero_tests = count_opcode_records("test_branches.opp", ORIONPP_OP_ISA_BRZ) +
+                        count_opcode_records("test_branches.opp", ORIONPP_OP_ISA_BRNZ);
+    assert(zero_tests == 1);
+    assert(count_opcode_records("test_branches.opp", ORIONPP_OP_ISA_NOT) == 0);
+  }
+  remove("test_branches.opp");
+  
+  // && and || are logical, and the right operand is skipped once the left decides
+  int64_t result;
+  assert(optimize_fold_binary(BINOP_AND, 2, 4, &result) && result == 1);
+  assert(optimize_fold_binary(BINOP_OR, 0, -3, &result) && result == 1);
+  lexer_init(&lexer, "int h() { return 0 && g(1 / 0); }", &strings);
+  parser_init(&parser, &lexer, arena);
+  ast = parse_program(&parser);
+  assert(ast != NULL && !parser.had_error);
+  OptimizeStats stats = { 0 };
+  optimize_program(ast, arena, &stats);
+  const ASTNode* body = ast->program.statements[0]->function.body;
+  const ASTNode* value = body->block.statements[0]->return_stmt.value;
+  assert(value->type == AST_NUMBER && value->number.value == 0);
+  
+  ArenaFree(arena);
+  printf("Condition branch tests passed!\n");
+}
+
+void test_parallel_compile() {
+  printf("Testing parallel compilation...\n");
+  
+  char* derived = default_output_file("src/unit.c");
+  assert(strcmp(derived, "src/unit.opp") == 0);
+  free(derived);
+  derived = default_output_file("dir.d/.hidden");
+  assert(strcmp(derived, "dir.d/.hidden.opp") == 0);
+  free(derived);
+  
+  const char* inputs[] = { "test_unit_a.c", "test_unit_b.c", "test_unit_missing.c" };
+  const char* sources[] = {
+    "int main() { int x = 1; if (x > 0) { x = 2; } return x; }",
+    "int twice(int a) { int b = a + a; return b; }"
+  };
+  for (size_t i = 0; i < 2; i++) {
+    assert(write_file(inputs[i], sources[i], strlen(sources[i])));
+  }
+  
+  // One module per unit, two workers
+  CompilerOptions options = { .input_files = inputs, .input_count = 2, .jobs = 2 };
+  assert(compile_files(&options) == 0);
+  bool duplicate;
+  size_t vars_a = count_var_records("test_unit_a.opp", &duplicate);
+  size_t vars_b = count_var_records("test_unit_b.opp", &duplicate);
+  assert(vars_a > 0 && vars_b > 0);
+  
+  // Merged, ids of the second unit no longer collide with the first
+  options.merge = true;
+  options.output_file = "test_merged.opp";
+  assert(compile_files(&options) == 0);
+  assert(count_var_records("test_merged.opp", &duplicate) == vars_a + vars_b);
+  assert(!duplicate);
+  
+  // A unit that fails does not stop the others, but fails the build
+  options.merge = false;
+  options.output_file = NULL;
+  options.input_count = 3;
+  assert(compile_files(&options) != 0);
+  
+  for (size_t i = 0; i < 2; i++) {
+    remove(inputs[i]);
+  }
+  remove("test_unit_a.opp");
+  remove("test_unit_b.opp");
+  remove("test_merged.opp");
+  
+  printf("Parallel compilation tests passed!\n");
+}
+
+static bool files_equal(const char* a, const char* b) {
+  FILE* fa = fopen(a, "rb");
+  FILE* fb = fopen(b, "rb");
+  bool equal = fa && fb;
+  while (equal) {
+    int ca = fgetc(fa);
+    equal = ca == fgetc(fb);
+    if (ca == EOF) break;
+  }
+  if (fa) fclose(fa);
+  if (fb) fclose(fb);
+  return equal;
+}
+
+void test_compile_cache() {
+  printf("Testing the compile cache...\n");
+  
+  const char* cache_dir = "test_cache";
+  const char* sources[] = {
+    "int main() { int x = 1; while (x < 10) { x = x + x; } return x; }",
+    "int main() { int y = 2; return y * 3; }"
+  };
+  assert(write_file("test_cached.c", sources[0], strlen(sources[0])));
+  
+  // First build misses and fills the cache
+  CompilerOptions options = { .input_count = 1, .cache_dir = cache_dir };
+  CompileUnit unit = { .input_file = "test_cached.c", .output_file = "test_cached.opp" };
+  assert(compile_file(&options, &unit) == 0);
+  assert(!unit.cached);
+  assert(rename("test_cached.opp", "test_cached_fresh.opp") == 0);
+  
+  // Second build reuses the module byte for byte
+  unit.cached = false;
+  assert(compile_file(&options, &unit) == 0);
+  assert(unit.cached);
+  assert(files_equal("test_cached.opp", "test_cached_fresh.opp"));
+  
+  // Changed source misses again
+  assert(write_file("test_cached.c", sources[1], strlen(sources[1])));
+  unit.cached = false;
+  assert(compile_file(&options, &unit) == 0);
+  assert(!unit.cached);
+  
+  // Merging cached units still gives every unit its own ids
+  const char* inputs[] = { "test_cached.c", "test_cached.c" };
+  options = (CompilerOptions){ .input_files = inputs, .input_count = 2, .jobs = 1,
+                               .merge = true, .output_file = "test_cached_merged.opp", .cache_dir = cache_dir };
+  assert(compile_files(&options) == 0);
+  bool duplicate;
+  size_t vars = count_var_records("test_cached.opp", &duplicate);
+  assert(count_var_records("test_cached_merged.opp", &duplicate) == 2 * vars);
+  assert(!duplicate);
+  
+  for (size_t i = 0; i < 2; i++) {
+    CacheKey key;
+    char path[64];
+    cache_key(&options, sources[i], strlen(sources[i]), &key);
+    snprintf(path, sizeof(path), "%s/%s.opp", cache_dir, key.hex);
+    assert(remove(path) == 0);
+  }
+  remove(cache_dir);
+  remove("test_cached.c");
+  remove("test_cached.opp");
+  remove("test_cached_fresh.opp");
+  remove("test_cached_merged.opp");
+  
+  printf("Compile cache tests passed!\n");
+}
+
 int main() {
   printf("Running Orion C Compiler Tests\n");
   printf("==============================\n\n");
@@ -199,7 +771,15 @@ int main() {
   test_simple_expression();
   test_function_calls();
   test_control_flow();
+  test_arena_ast();
+  test_optimizer();
+  test_symbol_table();
   test_code_generation();
+  test_temp_reuse();
+  test_ssa_optimizer();
+  test_condition_branches();
+  test_parallel_compile();
+  test_compile_cache();
   
   printf("\nAll tests completed! ✓\n");
   return 0;
@@ -5,6 +5,10 @@
 
 #include "vm.h"
 #include "validator.h"
+#include "batch.h"
+#include "loader.h"
+#include "profile.h"
+#include "jit.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -17,6 +21,14 @@ typedef struct {
   bool validate_only;
   bool verbose;
   ValidationLevel validation_level;
+  const char* manifest_file;
+  size_t jobs;
+  const char* image_file;
+  bool profile;
+  const char* folded_file;
+  const char* super_file;
+  VMJitMode jit;
+  uint32_t jit_threshold;
 } VMOptions;
 
 static void print_usage(const char* program_name) {
@@ -28,11 +40,27 @@ static void print_usage(const char* program_name) {
   printf("  --validate-only   Only validate, don't execute\n");
   printf("  --validation-level LEVEL  Set validation level (0-3)\n");
   printf("                    0: None, 1: Basic, 2: Strict, 3: Paranoid\n");
+  printf("                    0-1 run verified programs without runtime checks,\n");
+  printf("                    2 keeps operand checks, 3 validates every step\n");
+  printf("  --manifest FILE   Run the program once per manifest line (batch mode)\n");
+  printf("                    Each line holds the integers returned by input(0), input(1), ...\n");
+  printf("  --jobs N          Worker threads for batch mode (default 1)\n");
+  printf("  --write-image FILE  Save the program as a memory-mappable image and exit\n");
+  printf("  --profile         Report opcode, instruction and pair counts and handler time on stderr\n");
+  printf("  --profile-folded FILE  Profile and write handler time as folded stacks for flamegraph.pl\n");
+  printf("  --profile-super FILE   Profile, add the opcode pairs to the superinstruction table FILE\n");
+  printf("                    and pick its superinstructions again\n");
+  printf("  --jit             Compile hot loops of verified integer code to native x86-64\n");
+  printf("  --jit-eager       Compile all verified integer code before running\n");
+  printf("  --jit-threshold N  Back edges before --jit compiles a loop (default %d)\n", OVM_JIT_HOT_LOOP);
   printf("  -h, --help        Show this help message\n");
   printf("\nExamples:\n");
   printf("  %s program.opp                    # Run program\n", program_name);
   printf("  %s -d program.opp                 # Run with debug output\n", program_name);
   printf("  %s --validate-only program.opp    # Just validate program\n", program_name);
+  printf("  %s --jobs 8 --manifest in.txt program.opp  # Batch run on 8 threads\n", program_name);
+  printf("  %s --write-image fast.opp program.opp     # Convert for zero-copy loading\n", program_name);
+  printf("  %s --profile-super include/superinstructions.h program.opp  # Retune superinstructions\n", program_name);
 }
 
 static int parse_arguments(int argc, const char* argv[], VMOptions* options) {
@@ -43,6 +71,14 @@ static int parse_arguments(int argc, const char* argv[], VMOptions* options) {
   options->validate_only = false;
   options->verbose = false;
   options->validation_level = OVM_VALIDATE_BASIC;
+  options->manifest_file = NULL;
+  options->jobs = 0;
+  options->image_file = NULL;
+  options->profile = false;
+  options->folded_file = NULL;
+  options->super_file = NULL;
+  options->jit = OVM_JIT_OFF;
+  options->jit_threshold = 0;
   
   for (int i = 1; i < argc; i++) {
     if (strcmp(argv[i], "-d") == 0 || strcmp(argv[i], "--debug") == 0) {
@@ -64,6 +100,58 @@ static int parse_arguments(int argc, const char* argv[], VMOptions* options) {
         return 1;
       }
       options->validation_level = (ValidationLevel)level;
+    } else if (strcmp(argv[i], "--manifest") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "Error: --manifest requires an argument\n");
+        return 1;
+      }
+      options->manifest_file = argv[++i];
+    } else if (strcmp(argv[i], "--jobs") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "Error: --jobs requires an argument\n");
+        return 1;
+      }
+      int jobs = atoi(argv[++i]);
+      if (jobs < 1) {
+        fprintf(stderr, "Error: Invalid job count %d\n", jobs);
+        return 1;
+      }
+      options->jobs = (size_t)jobs;
+    } else if (strcmp(argv[i], "--write-image") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "Error: --write-image requires an argument\n");
+        return 1;
+      }
+      options->image_file = argv[++i];
+    } else if (strcmp(argv[i], "--profile") == 0) {
+      options->profile = true;
+    } else if (strcmp(argv[i], "--profile-folded") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "Error: --profile-folded requires an argument\n");
+        return 1;
+      }
+      options->folded_file = argv[++i];
+    } else if (strcmp(argv[i], "--profile-super") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "Error: --profile-super requires an argument\n");
+        return 1;
+      }
+      options->super_file = argv[++i];
+    } else if (strcmp(argv[i], "--jit") == 0) {
+      options->jit = OVM_JIT_TIERED;
+    } else if (strcmp(argv[i], "--jit-eager") == 0) {
+      options->jit = OVM_JIT_EAGER;
+    } else if (strcmp(argv[i], "--jit-threshold") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "Error: --jit-threshold requires an argument\n");
+        return 1;
+      }
+      int threshold = atoi(argv[++i]);
+      if (threshold < 1) {
+        fprintf(stderr, "Error: Invalid JIT threshold %d\n", threshold);
+        return 1;
+      }
+      options->jit_threshold = (uint32_t)threshold;
     } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
       print_usage(argv[0]);
       exit(0);
@@ -85,6 +173,27 @@ static int parse_arguments(int argc, const char* argv[], VMOptions* options) {
     return 1;
   }
   
+  if (options->jobs > 0 && options->manifest_file == NULL) {
+    fprintf(stderr, "Error: --jobs requires --manifest\n");
+    return 1;
+  }
+  
+  if (options->jit_threshold > 0 && options->jit != OVM_JIT_TIERED) {
+    fprintf(stderr, "Error: --jit-threshold requires --jit\n");
+    return 1;
+  }
+  
+  if ((options->profile || options->folded_file || options->super_file) && (options->manifest_file || options->debug_mode)) {
+    fprintf(stderr, "Error: --profile cannot be combined with --manifest or --debug\n");
+    return 1;
+  }
+  
+  if (options->jit && (options->manifest_file || options->debug_mode || options->profile || options->folded_file ||
+                       options->super_file)) {
+    fprintf(stderr, "Error: --jit cannot be combined with --manifest, --debug or --profile\n");
+    return 1;
+  }
+  
   return 0;
 }
 
@@ -99,6 +208,7 @@ static void print_validation_result(ValidationResult result) {
 
 static int run_vm(const VMOptions* options) {
   OrionVM vm;
+  VMProfile* profile = NULL;
   int result = 0;
   
   if (options->verbose) {
@@ -129,7 +239,19 @@ static int run_vm(const VMOptions* options) {
   }
   
   if (options->verbose) {
+    static const char* const tiers[] = { "unprepared", "per-step", "checked", "verified" };
     printf("Loaded %zu instructions\n", vm.instruction_count);
+    printf("Execution tier: %s\n", tiers[vm.run_mode]);
+  }
+  
+  if (options->image_file) {
+    if (ovm_write_image(&vm, options->image_file) != 0) {
+      fprintf(stderr, "Error: %s\n", ovm_get_error(&vm));
+      result = 1;
+    } else {
+      printf("Wrote image: %s\n", options->image_file);
+    }
+    goto cleanup;
   }
   
   // Validate program
@@ -162,7 +284,48 @@ static int run_vm(const VMOptions* options) {
     printf("=========================\n");
   }
   
+  if (options->profile || options->folded_file || options->super_file) {
+    profile = ovm_profile_create();
+    if (!profile || ovm_set_profile(&vm, profile) != 0) {
+      fprintf(stderr, "Error: Failed to set up profiling: %s\n", ovm_get_error(&vm));
+      result = 1;
+      goto cleanup;
+    }
+  }
+  
+  vm.jit_threshold = options->jit_threshold;
+  if (options->jit && ovm_set_jit(&vm, options->jit) != 0) {
+    fprintf(stderr, "Error: %s\n", ovm_get_error(&vm));
+    result = 1;
+    goto cleanup;
+  }
+  
   int exec_result = ovm_run(&vm);
+  if (options->jit && options->verbose) {
+    printf("JIT: %zu of %zu instructions compiled in %zu regions, %zu deoptimized\n",
+           vm.jit ? vm.jit->compiled_count : 0, vm.instruction_count, vm.jit ? vm.jit->region_count : 0,
+           vm.jit ? vm.jit->deopt_count : 0);
+  }
+  if (options->profile) {
+    ovm_profile_print(profile, &vm, stderr, 20);
+  }
+  if (options->folded_file) {
+    const char* root = strrchr(options->input_file, '/');
+    FILE* folded = fopen(options->folded_file, "w");
+    if (!folded || ovm_profile_write_folded(profile, &vm, root ? root + 1 : options->input_file, folded) != 0) {
+      fprintf(stderr, "Error: Failed to write folded stacks to '%s'\n", options->folded_file);
+      result = 1;
+    }
+    if (folded) fclose(folded);
+  }
+  // Only complete runs go into the table
+  if (options->super_file && exec_result == 0) {
+    const char* root = strrchr(options->input_file, '/');
+    if (ovm_profile_update_super_table(profile, root ? root + 1 : options->input_file, options->super_file) != 0) {
+      fprintf(stderr, "Error: Failed to update superinstruction table '%s'\n", options->super_file);
+      result = 1;
+    }
+  }
   
   if (exec_result != 0) {
     fprintf(stderr, "Error: Execution failed: %s\n", ovm_get_error(&vm));
@@ -198,6 +361,159 @@ static int run_vm(const VMOptions* options) {
   
 cleanup:
   ovm_destroy(&vm);
+  ovm_profile_destroy(profile);
+  return result;
+}
+
+// Manifest: one job per line, whitespace-separated integers; '#' starts a comment
+static VMBatchJob* read_manifest(const char* filename, size_t* job_count, int64_t** input_pool) {
+  FILE* file = fopen(filename, "r");
+  if (!file) return NULL;
+  
+  size_t job_capacity = 64, input_capacity = 256, input_count = 0;
+  VMBatchJob* jobs = malloc(job_capacity * sizeof(VMBatchJob));
+  int64_t* inputs = malloc(input_capacity * sizeof(int64_t));
+  size_t* offsets = malloc(job_capacity * sizeof(size_t));
+  *job_count = 0;
+  
+  char line[4096];
+  while (jobs && inputs && offsets && fgets(line, sizeof(line), file)) {
+    char* comment = strchr(line, '#');
+    if (comment) *comment = '\0';
+  
+    char* cursor = line;
+    size_t first = input_count;
+    for (;;) {
+      char* end;
+      long long value = strtoll(cursor, &end, 0);
+      if (end == cursor) break;
+      cursor = end;
+  
+      if (input_count >= input_capacity) {
+        input_capacity *= 2;
+        int64_t* grown = realloc(inputs, input_capacity * sizeof(int64_t));
+        if (!grown) goto fail;
+        inputs = grown;
+      }
+      inputs[input_count++] = value;
+    }
+  
+    // Skip blank and comment-only lines
+    while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r' || *cursor == '\n') cursor++;
+    if (*cursor != '\0') {
+      fprintf(stderr, "Error: Invalid manifest entry near '%s'\n", cursor);
+      goto fail;
+    }
+    if (input_count == first && strspn(line, " \t\r\n") == strlen(line)) continue;
+  
+    if (*job_count >= job_capacity) {
+      job_capacity *= 2;
+      VMBatchJob* grown_jobs = realloc(jobs, job_capacity * sizeof(VMBatchJob));
+      size_t* grown_offsets = realloc(offsets, job_capacity * sizeof(size_t));
+      if (grown_jobs) jobs = grown_jobs;
+      if (grown_offsets) offsets = grown_offsets;
+      if (!grown_jobs || !grown_offsets) goto fail;
+    }
+    offsets[*job_count] = first;
+    jobs[*job_count] = (VMBatchJob){ .input_count = input_count - first };
+    (*job_count)++;
+  }
+  
+  if (!jobs || !inputs || !offsets) goto fail;
+  
+  // The pool has stopped moving, so the per-job pointers can be filled in
+  for (size_t i = 0; i < *job_count; i++) {
+    jobs[i].inputs = inputs + offsets[i];
+  }
+  
+  free(offsets);
+  fclose(file);
+  *input_pool = inputs;
+  return jobs;
+  
+fail:
+  free(jobs);
+  free(inputs);
+  free(offsets);
+  fclose(file);
+  return NULL;
+}
+
+static int run_batch(const VMOptions* options) {
+  OrionVM loader;
+  int result = 0;
+  VMProgram* program = NULL;
+  VMBatchJob* jobs = NULL;
+  int64_t* inputs = NULL;
+  size_t job_count = 0;
+  
+  if (ovm_init(&loader) != 0) {
+    fprintf(stderr, "Error: Failed to initialize VM\n");
+    return 1;
+  }
+  ovm_set_strict_mode(&loader, options->strict_mode);
+  ovm_set_validation_level(&loader, options->validation_level);
+  
+  if (ovm_load_file(&loader, options->input_file) != 0) {
+    fprintf(stderr, "Error: Failed to load file '%s': %s\n", options->input_file, ovm_get_error(&loader));
+    result = 1;
+    goto cleanup;
+  }
+  
+  ValidationResult validation = ovm_validate_program(&loader);
+  if (validation != OVM_VALID) {
+    print_validation_result(validation);
+    fprintf(stderr, "Error: Program validation failed\n");
+    result = 1;
+    goto cleanup;
+  }
+  
+  // Load, decode and verify once; every worker context shares the image
+  program = ovm_program_create(&loader);
+  if (!program) {
+    fprintf(stderr, "Error: Failed to build program image: %s\n", ovm_get_error(&loader));
+    result = 1;
+    goto cleanup;
+  }
+  
+  jobs = read_manifest(options->manifest_file, &job_count, &inputs);
+  if (!jobs) {
+    fprintf(stderr, "Error: Failed to read manifest '%s'\n", options->manifest_file);
+    result = 1;
+    goto cleanup;
+  }
+  
+  VMBatchStats stats;
+  if (ovm_batch_run(program, jobs, job_count, options->jobs ? options->jobs : 1, &stats) != 0) {
+    fprintf(stderr, "Error: Batch execution failed\n");
+    result = 1;
+    goto cleanup;
+  }
+  
+  if (options->verbose) {
+    for (size_t i = 0; i < job_count; i++) {
+      if (jobs[i].status == 0) {
+        printf("Job %zu: %lld\n", i, (long long)jobs[i].result);
+      } else {
+        printf("Job %zu: failed\n", i);
+      }
+    }
+  }
+  
+  printf("Batch: %zu jobs on %zu threads, %zu failed, %zu stolen\n",
+         job_count, stats.threads, stats.failed, stats.stolen);
+  printf("Throughput: %.0f jobs/s (%.3fs total)\n",
+         stats.seconds > 0 ? (double)job_count / stats.seconds : 0.0, stats.seconds);
+  
+  if (stats.failed > 0) {
+    result = 1;
+  }
+  
+cleanup:
+  free(jobs);
+  free(inputs);
+  ovm_program_release(program);
+  ovm_destroy(&loader);
   return result;
 }
 
@@ -218,5 +534,9 @@ int main(int argc, const char* argv[]) {
     printf("---\n");
   }
   
+  if (options.manifest_file) {
+    return run_batch(&options);
+  }
+  
   return run_vm(&options);
 }
\ No newline at end of file
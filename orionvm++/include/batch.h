@@ -0,0 +1,33 @@
+/**
+ * @file include/batch.h
+ * @brief Runs one shared program image over many inputs on a thread pool
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "program.h"
+
+// One execution of the program
+typedef struct {
+  const int64_t* inputs; // values returned by input(index)
+  size_t input_count;
+  int64_t result; // return value, valid when status == 0
+  int status; // 0 on success, -1 if the run failed
+} VMBatchJob;
+
+// Aggregate figures for a batch
+typedef struct {
+  size_t threads;
+  size_t completed;
+  size_t failed;
+  size_t stolen; // jobs a worker took from another worker's queue
+  double seconds;
+} VMBatchStats;
+
+// Runs every job against the image. Each worker thread owns one VM context
+// attached to the image and reuses it for all of its jobs; jobs are queued
+// in per-worker ranges and idle workers steal from the others.
+int ovm_batch_run(VMProgram* program, VMBatchJob* jobs, size_t job_count, size_t threads, VMBatchStats* stats);
+
+#endif // BATCH_H
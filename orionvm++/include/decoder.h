@@ -0,0 +1,32 @@
+/**
+ * @file include/decoder.h
+ * @brief Pre-decoded instruction stream and threaded dispatch loop
+ */
+
+#ifndef DECODER_H
+#define DECODER_H
+
+#include "vm.h"
+
+// Direct-threaded dispatch needs the GNU "labels as values" extension.
+// Define OVM_NO_THREADED_DISPATCH to force the portable switch loop.
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(OVM_NO_THREADED_DISPATCH)
+  #define OVM_THREADED_DISPATCH 1
+#endif
+
+// Decoding
+int ovm_decode_program(OrionVM* vm);
+void ovm_free_decoded(OrionVM* vm);
+VMDecodedOp ovm_decode_opcode(const orinopp_instruction_t* instr);
+const char* ovm_decoded_op_name(VMDecodedOp op);
+
+// Superinstructions are made of ops with a fusable body; only the last op of
+// one may branch
+bool ovm_decoded_op_fusable(VMDecodedOp op);
+bool ovm_decoded_op_branches(VMDecodedOp op);
+
+// Execution
+int ovm_run_decoded(OrionVM* vm);
+int ovm_bind_decoded(OrionVM* vm); // resolve dispatch slots without running
+
+#endif // DECODER_H
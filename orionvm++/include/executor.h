@@ -10,6 +10,7 @@
 
 // Instruction execution functions
 int ovm_execute_instruction(OrionVM* vm, const orinopp_instruction_t* instr);
+bool ovm_is_control_flow(const orinopp_instruction_t* instr);
 
 // ISA instruction handlers
 int ovm_exec_var(OrionVM* vm, const orinopp_instruction_t* instr);
@@ -33,6 +34,16 @@ int ovm_exec_brnz(OrionVM* vm, const orinopp_instruction_t* instr);
 // Call and return
 int ovm_exec_call(OrionVM* vm, const orinopp_instruction_t* instr);
 int ovm_exec_ret(OrionVM* vm, const orinopp_instruction_t* instr);
+int ovm_exec_abi(OrionVM* vm, const orinopp_instruction_t* instr);
+
+// Calls function with the arguments of call and those passed before it, and
+// continues at its entry. Neither a call nor its return allocates, unless it
+// copies a string.
+int ovm_call_function(OrionVM* vm, size_t function, const orinopp_instruction_t* call, size_t return_address);
+
+// Leaves the innermost call for its caller, storing return_value in the
+// CALL's result
+int ovm_return_from_call(OrionVM* vm);
 
 // Arithmetic operations
 int ovm_exec_add(OrionVM* vm, const orinopp_instruction_t* instr);
@@ -71,7 +82,7 @@ int ovm_compare_variables(OrionVM* vm, VMVariable* left, VMVariable* right, int*
 int ovm_branch_if_condition(OrionVM* vm, bool condition, orionpp_label_id_t label_id);
 
 // Type conversion
-int ovm_convert_value(VMVariable* dest, const VMVariable* src, orionpp_type_t target_type);
+int ovm_convert_value(OrionVM* vm, VMVariable* dest, const VMVariable* src, orionpp_type_t target_type);
 bool ovm_types_compatible(orionpp_type_t type1, orionpp_type_t type2);
 
 #endif // EXECUTOR_H
\ No newline at end of file
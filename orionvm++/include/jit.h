@@ -0,0 +1,127 @@
+/**
+ * @file include/jit.h
+ * @brief Baseline x86-64 compiler for the integer subset of decoded programs
+ *
+ * Every decoded record whose op and operand types have a template is copied
+ * into executable memory as a few instructions working on the VM's value
+ * array. Compiled records hand control to each other directly; anything else
+ * returns to the threaded loop, which runs that record and re-enters native
+ * code at the next compiled one.
+ *
+ * Eager mode compiles a verified program up front from its declared types.
+ * Tiered mode counts the back edges of the interpreter and compiles a loop
+ * once it gets hot. Native state is the interpreter's own values, so
+ * execution moves into the loop at the back edge without translating a frame.
+ * Programs the verifier rejects are tiered too, on the types their variables
+ * have when the loop gets hot: every entry into such a loop's code checks
+ * those types first and drops the code back to the interpreter when one
+ * differs.
+ */
+
+#ifndef JIT_H
+#define JIT_H
+
+#include "vm.h"
+#include "decoder.h"
+
+// Native code needs the System V x86-64 ABI and the threaded loop to return
+// into. Define OVM_NO_JIT to leave the compiler out.
+#if defined(OVM_THREADED_DISPATCH) && defined(__x86_64__) && !defined(WIN32) && !defined(OVM_NO_JIT)
+  #define OVM_JIT 1
+#endif
+
+// Runs native code from one record until it reaches a record it has no code
+// for, or one it has to hand back (a CONST whose variable does not exist yet,
+// a division by zero), and returns that record's index
+typedef size_t (*VMJitFunction)(VMValue* values, VMVariable* variables);
+
+// Back edges a loop takes before tiered mode compiles it, unless the VM sets
+// jit_threshold
+#define OVM_JIT_HOT_LOOP 1000
+
+// Times a loop's code may be dropped on a type mismatch before the loop stays
+// on the interpreter
+#define OVM_JIT_MAX_DEOPTS 3
+
+// Back-edge count of a loop that was compiled or given up on
+#define OVM_JIT_DONE UINT32_MAX
+
+// A variable the code of a region assumes exists, is initialized and has type
+typedef struct {
+  orionpp_variable_id_t id;
+  orionpp_type_t type;
+} VMJitGuard;
+
+// Code compiled in one go: the whole program, or one loop. Native jumps never
+// leave a region.
+typedef struct {
+  unsigned char* code; // executable mapping, NULL once dropped
+  size_t size;
+  VMJitGuard* guards; // checked on every entry; none for verified programs
+  size_t guard_count;
+  size_t first; // decoded range covered
+  size_t last;
+} VMJitRegion;
+
+typedef struct VMJit {
+  bool verified; // compiled from declared types, for the verified handlers
+  VMJitRegion* regions;
+  size_t region_count; // every region compiled, dropped ones included
+  VMJitFunction* entries; // by decoded index, NULL where the interpreter runs
+  uint32_t* region_of; // by decoded index, where entries is set
+  uint32_t* back_edges; // tiered mode: times each back edge was taken
+  uint8_t* deopts; // tiered mode: times each back edge's loop was dropped
+  size_t compiled_count; // records with native code
+  size_t deopt_count;
+} VMJit;
+
+// Selects native code for the programs run by this VM. Eager mode leaves
+// programs the verifier rejects on the interpreter; tiered mode also compiles
+// their loops, behind guards. Changing the mode drops the code compiled so far.
+// A VM attached to a shared image cannot use the JIT, as that would rebind the
+// image's handlers.
+int ovm_set_jit(OrionVM* vm, VMJitMode mode);
+
+// Compiles the VM's decoded, verified program. Returns NULL for programs that
+// are not verified and when there is no executable memory.
+VMJit* ovm_jit_compile(OrionVM* vm);
+
+// Tables for tiered mode, with nothing compiled yet, for the verified or the
+// checked handlers
+VMJit* ovm_jit_create(OrionVM* vm, bool verified);
+
+// Compiles the loop closed by the back edge at index, from the declared types
+// of a verified program and from the variables the VM has now otherwise.
+// Returns true when records gained native code. The back edge stops counting
+// either way.
+bool ovm_jit_tier_up(OrionVM* vm, VMJit* jit, size_t index);
+
+// Drops the region holding the record at index after a guard failed, and
+// lets its loops count again unless they were dropped too often
+void ovm_jit_deoptimize(OrionVM* vm, VMJit* jit, size_t index);
+
+void ovm_jit_free(VMJit* jit);
+
+// Jumps and branches to a record at or before their own
+static inline bool ovm_is_back_edge(const VMDecodedInstr* decoded, size_t index) {
+  return decoded[index].op >= OVM_DOP_JMP && decoded[index].op <= OVM_DOP_BRNZ && decoded[index].target <= index;
+}
+
+// Whether the back edge at index still enters the interpreter's counter
+static inline bool ovm_jit_counts(const VMJit* jit, const VMDecodedInstr* decoded, size_t index) {
+  return jit && jit->back_edges && ovm_is_back_edge(decoded, index) && !jit->entries[index] &&
+         jit->back_edges[index] != OVM_JIT_DONE;
+}
+
+// Whether the variables are as the code entered at index assumes. Between
+// two entries only native code runs, and it keeps them so.
+static inline bool ovm_jit_guards_hold(const VMJit* jit, const VMVariable* variables, size_t index) {
+  const VMJitRegion* region = &jit->regions[jit->region_of[index]];
+  for (size_t g = 0; g < region->guard_count; g++) {
+    const VMVariable* var = &variables[region->guards[g].id];
+    if (!var->is_declared || !var->is_initialized || var->type != region->guards[g].type) return false;
+  }
+  return true;
+}
+
+#endif // JIT_H
@@ -0,0 +1,32 @@
+/**
+ * @file include/loader.h
+ * @brief Memory-mapped, zero-copy loading of Orion++ program images
+ */
+
+#ifndef LOADER_H
+#define LOADER_H
+
+#include "vm.h"
+#include "orionpp/codetab.h"
+
+// Maps an open file read-only. Fails on empty files and where mapping is unsupported.
+int ovm_map_file(file_handle_t handle, VMMappedImage* image);
+
+// Reads the rest of a handle into memory with a few large reads, for
+// handles that cannot be mapped such as pipes
+int ovm_read_file(file_handle_t handle, VMMappedImage* image);
+
+// Unmaps or frees the file and frees the operand array pointing into it
+void ovm_unmap_image(VMMappedImage* image);
+
+// True when the mapping starts with the Orion++ magic; headerless streams are not images
+bool ovm_is_image(const VMMappedImage* image);
+
+// Validates the header and points the VM's program at the code table in place.
+// The VM takes ownership of the mapping, also on failure.
+int ovm_load_image(OrionVM* vm, VMMappedImage* image);
+
+// Writes the VM's loaded program as an image ovm_load_image can map
+int ovm_write_image(OrionVM* vm, const char* filename);
+
+#endif // LOADER_H
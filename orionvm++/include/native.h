@@ -0,0 +1,88 @@
+/**
+ * @file include/native.h
+ * @brief Functions the host provides to programs, by name
+ *
+ * A CALL whose symbol is no function of the module goes to the native of
+ * that name. Natives live in a hash table on the VM; the decoder looks every
+ * CALL up once and stores the function pointer in its record, so a call
+ * touches no strings. print and input are natives registered by ovm_init,
+ * and C functions can be bound straight from a shared library.
+ */
+
+#ifndef NATIVE_H
+#define NATIVE_H
+
+#include "vm.h"
+
+// Arguments a C function bound by ovm_bind_extern can take; all of them go
+// in registers under the System V and AArch64 calling conventions
+#define OVM_MAX_EXTERN_ARGS 6
+
+// A C function bound by ovm_bind_extern, cast to its real type at the call
+typedef void (*VMExternFunction)(void);
+
+// What a native accepts and produces
+typedef struct {
+  uint8_t min_args;
+  uint8_t max_args; // at most OVM_MAX_CALL_ARGS
+  orionpp_type_t result; // WORD, SIZE or C; the type the CALL's variable is declared as
+} VMNativeSignature;
+
+// One call of a native. Arguments are the caller's variables as the CALL
+// lists them, NULL where an operand is no initialized variable.
+struct VMNativeCall {
+  const VMVariable* args[OVM_MAX_CALL_ARGS];
+  size_t arg_count;
+  VMExternFunction extern_function; // the C function behind an extern binding
+  VMValue result; // 0 unless the native sets it
+};
+
+typedef struct {
+  char* name;
+  size_t name_length;
+  VMNativeFunction function;
+  VMExternFunction extern_function;
+  VMNativeSignature signature;
+} VMNative;
+
+// Natives by registration order, found through an open-addressed table of
+// their indices + 1
+typedef struct VMNativeTable {
+  VMNative* natives;
+  size_t count;
+  size_t capacity;
+  uint32_t* buckets; // 0 for an empty bucket
+  size_t bucket_count; // power of two
+} VMNativeTable;
+
+VMNativeTable* ovm_natives_create(void);
+void ovm_natives_destroy(VMNativeTable* table);
+
+// Registers print and input; ovm_init calls it
+int ovm_register_builtins(OrionVM* vm);
+
+// Makes function callable by name, replacing a native of the same name.
+// Programs bind their calls when they are decoded, so natives have to be
+// registered before the program is loaded from a file, first runs or is
+// attached to an image; afterwards this and ovm_bind_extern fail.
+int ovm_register_native(OrionVM* vm, const char* name, VMNativeFunction function, VMNativeSignature signature);
+
+// Binds a C function taking and returning int64_t, looked up with dlsym in
+// library, or in the process when library is NULL. Its name and counts are
+// those of a FUNCTION entry of the module's extrntab and its
+// orionpp_function_info_t; a function returning nothing gives 0.
+int ovm_bind_extern(OrionVM* vm, const char* name, uint16_t param_count, uint16_t return_count, void* library);
+
+const VMNative* ovm_find_native(const OrionVM* vm, const char* name, size_t length);
+
+// Whether a CALL with arg_count arguments fits the native
+static inline bool ovm_native_accepts(const VMNative* native, size_t arg_count) {
+  return arg_count >= native->signature.min_args && arg_count <= native->signature.max_args;
+}
+
+// Runs a native for call: collects its arguments from the current frame and
+// stores the result in the variable dest, declaring it as type if needed
+int ovm_call_native(OrionVM* vm, VMNativeFunction function, VMExternFunction extern_function, orionpp_type_t type,
+                    orionpp_variable_id_t dest, const orinopp_instruction_t* call);
+
+#endif // NATIVE_H
@@ -0,0 +1,76 @@
+/**
+ * @file include/profile.h
+ * @brief Execution profile of the decoded loop: counts, pairs and handler time
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "vm.h"
+#include <time.h>
+
+// Profiling enters every dispatch through a counting entry that is only bound
+// while a profile is set. Define OVM_NO_PROFILE to leave it out of the decoded
+// loop altogether; ovm_set_profile then fails.
+#ifndef OVM_NO_PROFILE
+  #define OVM_PROFILE 1
+#endif
+
+// Handler time is read from the time-stamp counter where there is one, and
+// from the wall clock otherwise
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+  #include <x86intrin.h>
+  #define OVM_PROFILE_TICK_UNIT "cycles"
+  static inline uint64_t ovm_profile_ticks(void) {
+    return __rdtsc();
+  }
+#else
+  #define OVM_PROFILE_TICK_UNIT "ns"
+  static inline uint64_t ovm_profile_ticks(void) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+  }
+#endif
+
+typedef struct VMProfile {
+  uint64_t ops[OVM_DOP_COUNT]; // dispatches by decoded op
+  uint64_t op_ticks[OVM_DOP_COUNT];
+  uint64_t pairs[OVM_DOP_COUNT][OVM_DOP_COUNT]; // [first][second] when second is the next record
+  uint64_t* records; // dispatches by decoded index
+  uint64_t* record_ticks;
+  size_t record_count;
+} VMProfile;
+
+VMProfile* ovm_profile_create(void);
+void ovm_profile_destroy(VMProfile* profile);
+
+// Grows the per-record counters to count records; the decoded loop calls it
+// before a profiled run
+int ovm_profile_reserve(VMProfile* profile, size_t count);
+
+// Counts every dispatch of the VM's runs into profile until it is set to
+// NULL. Counts accumulate across runs. A handler's time runs from its dispatch
+// to the next one, so it includes the counting itself. Superinstructions are
+// not formed while profiling, so the histogram is of the plain ops. A VM
+// attached to a shared image cannot be profiled, as that would rebind the
+// image's handlers.
+int ovm_set_profile(OrionVM* vm, VMProfile* profile);
+
+// Prints the count most frequent ops, records and pairs, most frequent first.
+// vm is the profiled VM, for the records' instructions.
+void ovm_profile_print(const VMProfile* profile, OrionVM* vm, FILE* output, size_t count);
+void ovm_profile_print_pairs(const VMProfile* profile, FILE* output, size_t count);
+
+// Writes handler time as folded stacks for flamegraph.pl, one
+// "root;L<label>;<op> <ticks>" line per record that ran, where label is the
+// last label before the record
+int ovm_profile_write_folded(const VMProfile* profile, OrionVM* vm, const char* root, FILE* output);
+
+// Adds profile's fall-through pairs to those recorded in the superinstruction
+// table at path, lists program among the ones profiled and rewrites the table
+// with the most frequent pairs and triples decoder.c can fuse. A missing table
+// starts empty. The recorded counts are added into profile.
+int ovm_profile_update_super_table(VMProfile* profile, const char* program, const char* path);
+
+#endif // PROFILE_H
@@ -0,0 +1,54 @@
+/**
+ * @file include/program.h
+ * @brief Immutable, reference-counted program image shared between VMs
+ */
+
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include "vm.h"
+#include <stdatomic.h>
+
+// Everything a loaded program needs that no run ever writes: instructions
+// and their operand bytes (the constant pool), the label jump table, the
+// function table and the decoded stream with its dispatch slots already bound for one tier. Any
+// number of VMs on any threads may run the same image at once.
+struct VMProgram {
+  orinopp_instruction_t* instructions;
+  size_t instruction_count;
+  VMMappedImage mapped; // file mapping the operands live in, if loaded from an image
+  
+  VMLabel* labels;
+  size_t label_count;
+  size_t* label_targets;
+  
+  VMFunction* functions;
+  size_t function_count;
+  size_t entry;
+  size_t slot_count;
+  size_t call_slots;
+  size_t call_frames;
+  
+  VMDecodedInstr* decoded;
+  size_t decoded_count;
+  
+  bool verified;
+  VMRunMode run_mode; // fixed by the validation level of the VM that built the image
+  
+  atomic_size_t refcount;
+};
+
+// Moves the VM's loaded program into a new image and attaches the VM to it.
+// The caller owns the returned reference. Fails for a VM with a profile or
+// the JIT turned on.
+VMProgram* ovm_program_create(OrionVM* vm);
+VMProgram* ovm_program_retain(VMProgram* program);
+void ovm_program_release(VMProgram* program);
+
+// Makes the VM an execution context of the image, dropping its own program.
+// The context keeps its own variables, call stack, inputs and return value.
+// A VM with a profile or the JIT turned on cannot be attached.
+int ovm_attach_program(OrionVM* vm, VMProgram* program);
+int ovm_detach_program(OrionVM* vm);
+
+#endif // PROGRAM_H
@@ -0,0 +1,106 @@
+/**
+ * @file include/superinstructions.h
+ * @brief Superinstruction table, written by `ovm++ --profile-super`
+ */
+
+// `ovm++ --profile-super include/superinstructions.h PROGRAM` adds the
+// fall-through pairs of a run of PROGRAM to the counts below and picks the
+// 22 most frequent pairs and 3 most frequent triples decoder.c can fuse.
+// A triple is counted as the less frequent of its two pairs.
+
+// program loops_O0.opp
+// program loops_O2.opp
+// pair MOV JMP 6425158
+// pair MOV MOV 4845548
+// pair NOP CONST 4580525
+// pair ADD MOV 4364086
+// pair DIV MOV 3829102
+// pair BREQ CONST 3813715
+// pair NOP MOD 3602522
+// pair NOP BRNEQ 3420647
+// pair CONST BREQ 3420647
+// pair NOP ADD 3324804
+// pair INCP JMP 3305105
+// pair NOP INCP 3195706
+// pair CONST BRNEQ 3165408
+// pair MOD CONST 3165408
+// pair MOD BREQ 3165408
+// pair MOV NOP 3161299
+// pair CONST MOD 2864133
+// pair BRNEQ CONST 1932287
+// pair NOP DIV 1914551
+// pair CONST DIV 1914551
+// pair CONST MUL 1899164
+// pair CONST ADD 949582
+// pair ADD JMP 949582
+// pair MUL CONST 949582
+// pair MUL ADD 949582
+// pair MOD MOV 874228
+// pair NOP BRZ 642546
+// pair BRZ MUL 607074
+// pair BREQ MOD 437114
+// pair NOP NOP 313508
+// pair MUL BRGT 303537
+// pair MUL BRLE 303537
+// pair BRGT MOD 301275
+// pair BREQ MOV 283539
+// pair CONST BRGE 139999
+// pair NOP MOV 137465
+// pair BRGE MOV 119400
+// pair MOV INCP 109399
+// pair ADD ADD 109399
+// pair CONST MOV 108036
+// pair NOP BRLT 89700
+// pair BRNEQ ADD 89401
+// pair CONST BRLT 50299
+// pair MOV CONST 50000
+// pair NOP BRLE 29999
+// pair BRNEQ BRGT 29999
+// pair BRGT MOV 29969
+// pair BRGE CONST 20297
+// pair BRLE NOP 2262
+// pair BRLT ADD 299
+// pair BRLE MOV 30
+// pair VAR VAR 27
+// pair NATIVE CONST 4
+// pair NOP NATIVE 3
+// pair BRLT NATIVE 3
+// pair VAR CONST 2
+// pair CONST CONST 1
+// pair CONST RET 1
+// pair NATIVE MOV 1
+// pair NATIVE RET 1
+
+#ifndef SUPERINSTRUCTIONS_H
+#define SUPERINSTRUCTIONS_H
+
+#define OVM_SUPER_PAIRS(X) \
+  X(MOV, JMP) \
+  X(MOV, MOV) \
+  X(NOP, CONST) \
+  X(ADD, MOV) \
+  X(DIV, MOV) \
+  X(NOP, MOD) \
+  X(NOP, BRNEQ) \
+  X(CONST, BREQ) \
+  X(NOP, ADD) \
+  X(INCP, JMP) \
+  X(NOP, INCP) \
+  X(CONST, BRNEQ) \
+  X(MOD, CONST) \
+  X(MOD, BREQ) \
+  X(MOV, NOP) \
+  X(CONST, MOD) \
+  X(NOP, DIV) \
+  X(CONST, DIV) \
+  X(CONST, MUL) \
+  X(CONST, ADD) \
+  X(ADD, JMP) \
+  X(MUL, CONST)
+
+#define OVM_SUPER_TRIPLES(X) \
+  X(MOV, MOV, MOV) \
+  X(MOV, MOV, JMP) \
+  X(ADD, MOV, MOV)
+
+#endif // SUPERINSTRUCTIONS_H
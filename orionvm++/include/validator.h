@@ -8,14 +8,6 @@
 
 #include "vm.h"
 
-// Validation levels
-typedef enum {
-  OVM_VALIDATE_NONE = 0,
-  OVM_VALIDATE_BASIC = 1,
-  OVM_VALIDATE_STRICT = 2,
-  OVM_VALIDATE_PARANOID = 3
-} ValidationLevel;
-
 // Validation results
 typedef enum {
   OVM_VALID = 0,
@@ -40,6 +32,11 @@ ValidationResult ovm_validate_instruction(OrionVM* vm, const orinopp_instruction
 ValidationResult ovm_validate_labels(OrionVM* vm);
 ValidationResult ovm_validate_variables(OrionVM* vm);
 
+// Static verification: proves operand kinds, label targets, declaration and
+// initialization before use, operand types and call targets on every path,
+// then stamps vm->verified so the check-free loop may run the program
+ValidationResult ovm_verify_program(OrionVM* vm);
+
 // Runtime validation (dynamic checks)
 ValidationResult ovm_validate_execution_safety(OrionVM* vm);
 ValidationResult ovm_validate_variable_access(OrionVM* vm, orionpp_variable_id_t id);
@@ -69,11 +66,15 @@ bool ovm_is_integer_type(orionpp_type_t type);
 bool ovm_is_string_type(orionpp_type_t type);
 bool ovm_can_convert_types(orionpp_type_t from, orionpp_type_t to);
 
+// SIZE is unsigned: division, remainder, right shifts and ordering are
+// unsigned when either operand is one, and signed otherwise
+bool ovm_is_unsigned_operation(orionpp_type_t left, orionpp_type_t right);
+
 // Error reporting
 const char* ovm_validation_result_to_string(ValidationResult result);
 void ovm_report_validation_error(OrionVM* vm, ValidationResult result, const char* context);
 
-// Validation configuration
+// Validation configuration (per VM; ValidationLevel is defined in vm.h)
 void ovm_set_validation_level(OrionVM* vm, ValidationLevel level);
 ValidationLevel ovm_get_validation_level(OrionVM* vm);
 
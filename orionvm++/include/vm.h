@@ -11,48 +11,218 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 // Maximum limits for safety
 #define OVM_MAX_VARIABLES 10000
 #define OVM_MAX_LABELS 1000
-#define OVM_MAX_STACK_SIZE 10000
+#define OVM_MAX_STACK_SIZE 65536 // frame stack slots for the locals of calls
 #define OVM_MAX_CALL_DEPTH 1000
+#define OVM_MAX_CALL_ARGS 16
 #define OVM_MAX_MEMORY_SIZE (1024 * 1024 * 16) // 16MB
 
-// Variable storage
+// Variable value; strings are owned by their variable
+typedef union {
+  int64_t i64;
+  uint64_t u64;
+  double f64;
+  char* str;
+  void* ptr;
+} VMValue;
+
+// Variable declaration and state. The value lives apart, in OrionVM.values
+// under the same id, so that handlers and native code walk 8-byte values only.
 typedef struct {
   orionpp_variable_id_t id;
   orionpp_type_t type;
   orionpp_type_module_t subtype;
-  union {
-    int64_t i64;
-    uint64_t u64;
-    double f64;
-    char* str;
-    void* ptr;
-  } value;
+  bool is_declared;
   bool is_initialized;
 } VMVariable;
 
+// A variable's value copied out of the VM, as RET leaves it
+typedef struct {
+  orionpp_type_t type;
+  VMValue value;
+  bool is_initialized;
+} VMReturnValue;
+
 // Label mapping
 typedef struct {
   orionpp_label_id_t id;
   size_t instruction_index;
 } VMLabel;
 
-// Call stack frame
+// Pre-decoded operation kinds (see decoder.h)
+typedef enum {
+  OVM_DOP_NOP = 0,
+  OVM_DOP_HALT,
+  OVM_DOP_GENERIC,
+  OVM_DOP_VAR,
+  OVM_DOP_CONST,
+  OVM_DOP_MOV,
+  OVM_DOP_JMP,
+  OVM_DOP_BREQ,
+  OVM_DOP_BRNEQ,
+  OVM_DOP_BRGT,
+  OVM_DOP_BRGE,
+  OVM_DOP_BRLT,
+  OVM_DOP_BRLE,
+  OVM_DOP_BRZ,
+  OVM_DOP_BRNZ,
+  OVM_DOP_RET,
+  OVM_DOP_RET_VOID,
+  OVM_DOP_CALL,
+  OVM_DOP_NATIVE,
+  OVM_DOP_ADD,
+  OVM_DOP_SUB,
+  OVM_DOP_MUL,
+  OVM_DOP_DIV,
+  OVM_DOP_MOD,
+  OVM_DOP_AND,
+  OVM_DOP_OR,
+  OVM_DOP_XOR,
+  OVM_DOP_SHL,
+  OVM_DOP_SHR,
+  OVM_DOP_INC,
+  OVM_DOP_DEC,
+  OVM_DOP_INCP,
+  OVM_DOP_DECP,
+  OVM_DOP_NOT,
+  OVM_DOP_COUNT
+} VMDecodedOp;
+
+typedef struct OrionVM OrionVM;
+
+// Function the host provides to CALL (see native.h)
+typedef struct VMNativeCall VMNativeCall;
+typedef int (*VMNativeFunction)(OrionVM* vm, VMNativeCall* call);
+
+// Fixed-size pre-decoded instruction record
+typedef struct {
+  const void* handler; // resolved dispatch target (threaded builds only)
+  VMDecodedOp op;
+  unsigned slot; // dispatch slot: op, or its check-free variant for verified programs
+  orionpp_type_t type; // declared type for VAR/CONST and the result of NATIVE, operand type for typed ops
+  orionpp_variable_id_t a, b, c; // operand slots
+  union {
+    size_t target; // resolved branch target, or the callee's entry for CALL
+    VMNativeFunction native; // bound function for NATIVE
+  };
+  int64_t imm; // immediate for CONST, function index for CALL, extern function for NATIVE
+  const orinopp_instruction_t* instr; // source instruction
+} VMDecodedInstr;
+
+// Execution loop, picked from the validation level when a program is prepared
+typedef enum {
+  OVM_RUN_UNPREPARED = 0,
+  OVM_RUN_STEP, // per-step loop with full safety validation before every instruction
+  OVM_RUN_CHECKED, // decoded loop, handlers check operands at runtime
+  OVM_RUN_VERIFIED // decoded loop without operand checks; requires a verified program
+} VMRunMode;
+
+// How the decoded loop uses native code (see jit.h)
+typedef enum {
+  OVM_JIT_OFF = 0,
+  OVM_JIT_TIERED, // compile loops once their back edges get hot
+  OVM_JIT_EAGER // compile the whole program before it first runs
+} VMJitMode;
+
+// Modules of ORIONPP_OP_ABI instructions, numbered as enum orionpp_opcode_abi
+// in orionpp/code.h. Indices and ids are the first and second operand.
+//   CALLEE_SETUP SYMBOL(name)   starts function name; runs until the next one
+//   CALLEE_ARG index, VAR(id)   declares parameter id from argument index
+//   CALLER_SETUP                starts the arguments of the next CALL
+//   CALLER_ARG index, VAR(id)   passes id as argument index
+//   CALLER_RET index, VAR(id)   stores the return value of the last call in id
+//   CALLEE_RET index, VAR(id)   sets the return value of a RET without operand
+// The cleanups and variadic arguments have no runtime effect.
+typedef enum {
+  OVM_ABI_CALLEE_SETUP,
+  OVM_ABI_CALLEE_CLEANUP,
+  OVM_ABI_CALLER_SETUP,
+  OVM_ABI_CALLER_CLEANUP,
+  OVM_ABI_CALLEE_ARG,
+  OVM_ABI_CALLEE_VARG,
+  OVM_ABI_CALLER_ARG,
+  OVM_ABI_CALLER_VARG,
+  OVM_ABI_CALLEE_RET,
+  OVM_ABI_CALLER_RET
+} VMAbiOp;
+
+// Function of the module, from its callee setup to the next one
+typedef struct {
+  const char* name; // symbol bytes in the program, not terminated
+  size_t name_length;
+  size_t entry; // index of the callee setup
+  size_t slot_count; // largest variable id the function uses + 1
+} VMFunction;
+
+// Call stack frame. A call's locals sit on the frame stack right above its
+// caller's, indexed by variable id from base. The frame above the innermost
+// call collects the arguments of the next one.
 typedef struct {
-  size_t return_address;
-  size_t variable_base;
-  char* function_name;
+  size_t return_address; // record after the CALL
+  size_t base; // first frame stack slot of the callee
+  size_t size; // slots of the callee
+  size_t declared_base; // variable_count when the call was made
+  size_t function; // index into OrionVM.functions
+  orionpp_variable_id_t result; // caller variable receiving the return value, or OVM_NO_VARIABLE
+  size_t arg_count;
+  orionpp_variable_id_t arg_ids[OVM_MAX_CALL_ARGS]; // caller variables, until the call is made
+  orionpp_type_t arg_types[OVM_MAX_CALL_ARGS];
+  VMValue args[OVM_MAX_CALL_ARGS];
 } VMFrame;
 
-// Virtual Machine state
+#define OVM_NO_VARIABLE UINT32_MAX
+
+// Shared, immutable program image (see program.h)
+typedef struct VMProgram VMProgram;
+
+// Read-only file mapping behind a zero-copy program (see loader.h)
 typedef struct {
-  // Program storage
+  void* base;
+  size_t size;
+  bool heap; // base was read into memory rather than mapped
+  orinopp_value_t* values; // operands of every instruction; bytes point into the mapping
+} VMMappedImage;
+
+// Validation levels
+typedef enum {
+  OVM_VALIDATE_NONE = 0,
+  OVM_VALIDATE_BASIC = 1,
+  OVM_VALIDATE_STRICT = 2,
+  OVM_VALIDATE_PARANOID = 3
+} ValidationLevel;
+
+// Virtual Machine state
+//
+// Thread safety: every piece of mutable state lives in the OrionVM instance;
+// the library keeps no process-wide mutable state. Distinct VMs may be used
+// from different threads concurrently without locking. A single VM must only
+// be used by one thread at a time. Functions that take no VM, such as the
+// type predicates and ovm_validation_result_to_string, are always safe to
+// call. The native print writes to stdout, which stdio serialises per call.
+struct OrionVM {
+  // Program storage; borrowed from the image while one is attached
+  VMProgram* program;
   orinopp_instruction_t* instructions;
   size_t instruction_count;
   size_t instruction_capacity;
+  VMMappedImage mapped; // set when the program was loaded from an image
+  
+  // Pre-decoded program (built lazily, see decoder.h)
+  VMDecodedInstr* decoded;
+  size_t decoded_count;
+  bool decoded_threaded; // dispatch slots resolved for decoded_verified
+  bool decoded_verified;
+  bool decoded_profiled; // handlers bound to the profiling entry
+  VMJitMode decoded_jit; // handlers bound to native code and back-edge counters
+  struct VMJit* jit; // native code for the decoded program (see jit.h)
+  
+  // Static verification and the execution tier it unlocks
+  bool verified;
+  VMRunMode run_mode;
   
   // Execution state
   size_t pc; // program counter
@@ -60,20 +230,42 @@ typedef struct {
   bool error;
   char error_message[256];
   
-  // Variable storage
+  // Variables of the current frame, indexed directly by variable id
+  VMValue* values;
   VMVariable* variables;
+  orionpp_variable_id_t* declared; // ids in declaration order, frame after frame
   size_t variable_count;
   
   // Label mapping
   VMLabel* labels;
   size_t label_count;
+  size_t* label_targets; // instruction index by label id, SIZE_MAX if undefined
+  bool labels_resolved;
+  
+  // Functions of the module, in program order
+  VMFunction* functions;
+  size_t function_count;
+  size_t entry; // where runs start: main if the module defines it, else 0
+  size_t slot_count; // largest variable id the program names + 1
+  size_t call_slots; // frame stack slots of the deepest chain of calls, the limit if it recurses
+  size_t call_frames; // calls in that chain
+  bool functions_resolved;
   
-  // Call stack
+  // Call stack, and the frame stack holding the locals of every call. Both
+  // grow as calls need them. The entry frame spans the ids the program names
+  // and grows up to OVM_MAX_VARIABLES slots as more are declared; values and
+  // variables above point at the innermost frame.
   VMFrame* call_stack;
   size_t call_depth;
+  size_t call_capacity;
+  VMValue* value_stack;
+  VMVariable* variable_stack;
+  size_t stack_capacity; // slots of value_stack, variable_stack and declared
+  size_t frame_base;
+  size_t frame_size;
   
   // Return value
-  VMVariable return_value;
+  VMReturnValue return_value;
   
   // Memory management
   size_t memory_used;
@@ -82,29 +274,78 @@ typedef struct {
   bool debug_mode;
   bool strict_mode;
   FILE* debug_output;
-} OrionVM;
+  ValidationLevel validation_level;
+  struct VMProfile* profile; // counts of the decoded loop, owned by the caller (see profile.h)
+  VMJitMode jit_mode; // native code for verified programs (see jit.h)
+  uint32_t jit_threshold; // back edges before a loop is compiled, 0 for the default
+  
+  // Functions the host provides, by name (see native.h)
+  struct VMNativeTable* natives;
+  
+  // Per-run inputs read by the native input(index); owned by the caller
+  const int64_t* inputs;
+  size_t input_count;
+};
 
 // VM lifecycle
 int ovm_init(OrionVM* vm);
 void ovm_destroy(OrionVM* vm);
 int ovm_load_file(OrionVM* vm, const char* filename);
 int ovm_load_from_handle(OrionVM* vm, file_handle_t handle);
+int ovm_prepare_program(OrionVM* vm);
+int ovm_clear_program(OrionVM* vm);
 void ovm_reset(OrionVM* vm);
 
+// Storage for a program the VM owns itself (see program.h for shared images)
+int ovm_alloc_program_storage(OrionVM* vm);
+void ovm_free_program_storage(OrionVM* vm);
+
 // Execution
 int ovm_run(OrionVM* vm);
 int ovm_step(OrionVM* vm);
 void ovm_set_debug_mode(OrionVM* vm, bool debug, FILE* output);
 void ovm_set_strict_mode(OrionVM* vm, bool strict);
+void ovm_set_inputs(OrionVM* vm, const int64_t* inputs, size_t count);
 
-// Variable management
+// Variable management. Declaring an id above the entry frame grows it and
+// may move it, so variables are looked up again after a declaration.
 VMVariable* ovm_get_variable(OrionVM* vm, orionpp_variable_id_t id);
 VMVariable* ovm_create_variable(OrionVM* vm, orionpp_variable_id_t id, orionpp_type_t type);
 int ovm_set_variable_value(OrionVM* vm, orionpp_variable_id_t id, const void* data, size_t size);
+void ovm_set_return_value(OrionVM* vm, const VMVariable* var);
+// Same for a RET leaving a call, whose frame drops the variable: a string
+// moves to the return value instead of being copied
+void ovm_move_return_value(OrionVM* vm, VMVariable* var);
+
+// O(1) lookup for hot paths; same result as ovm_get_variable
+static inline VMVariable* ovm_lookup_variable(const OrionVM* vm, orionpp_variable_id_t id) {
+  return id < vm->frame_size && vm->variables[id].is_declared ? &vm->variables[id] : NULL;
+}
+
+static inline VMValue* ovm_variable_value(const OrionVM* vm, const VMVariable* var) {
+  return &vm->values[var->id];
+}
+
+// Frame stack; ovm_push_frame takes the arguments collected in the frame
+// above the innermost call. Popping a frame drops its variables.
+int ovm_push_frame(OrionVM* vm, size_t function, size_t return_address, orionpp_variable_id_t result);
+const VMFrame* ovm_pop_frame(OrionVM* vm);
+void ovm_unwind_frames(OrionVM* vm);
+
+// Function management
+int ovm_resolve_functions(OrionVM* vm);
+const VMFunction* ovm_find_function(const OrionVM* vm, const char* name, size_t length);
+
+// Length of a SYMBOL operand's name, which need not be terminated
+static inline size_t ovm_symbol_length(const orinopp_value_t* value) {
+  const char* end = memchr(value->bytes, '\0', value->bytesize);
+  return end ? (size_t)(end - value->bytes) : value->bytesize;
+}
 
 // Label management
 int ovm_register_label(OrionVM* vm, orionpp_label_id_t id, size_t instruction_index);
 size_t ovm_find_label(OrionVM* vm, orionpp_label_id_t id);
+int ovm_resolve_labels(OrionVM* vm);
 
 // Error handling
 void ovm_error(OrionVM* vm, const char* format, ...);
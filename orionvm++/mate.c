@@ -23,7 +23,7 @@ i32 main(int argc, const char *argv[]) {
     AddFile(orionpp_vm, "./src/*.c");
     AddFile(orionpp_vm, "./app/main.c");
     if (isLinux()) {
-      LinkSystemLibraries(orionpp_vm, "m"); // Add math library on Linux
+      LinkSystemLibraries(orionpp_vm, "m", "pthread", "dl"); // Add math library on Linux, pthread for --jobs, dl for externs
     }
     LinkSystemLibraries(orionpp_vm, "orion-dev");
     InstallExecutable(orionpp_vm);
@@ -42,7 +42,7 @@ i32 main(int argc, const char *argv[]) {
     AddFile(orionpp_vm_test, "./src/*");  
     AddFile(orionpp_vm_test, "./tests/test_vm.c");
     if (isLinux()) {
-      LinkSystemLibraries(orionpp_vm_test, "m");
+      LinkSystemLibraries(orionpp_vm_test, "m", "pthread", "dl"); // pthread for the concurrent VM test, dl for externs
     }
     LinkSystemLibraries(orionpp_vm_test, "orion-dev");
     InstallExecutable(orionpp_vm_test);
@@ -0,0 +1,143 @@
+/**
+ * @file src/batch.c
+ * @brief Work-stealing batch execution of a shared program image
+ */
+
+#include "batch.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define OVM_BATCH_MAX_THREADS 256
+
+// Jobs [next, end) still waiting in one worker's range
+typedef struct {
+  atomic_size_t next;
+  size_t end;
+} VMBatchQueue;
+
+typedef struct {
+  VMProgram* program;
+  VMBatchJob* jobs;
+  VMBatchQueue* queues;
+  size_t thread_count;
+  atomic_size_t completed;
+  atomic_size_t failed;
+  atomic_size_t stolen;
+  atomic_int setup_failed;
+} VMBatch;
+
+typedef struct {
+  VMBatch* batch;
+  size_t index;
+} VMBatchWorker;
+
+// Owner and thieves both claim with fetch_add, so a job is taken exactly once
+static bool claim_job(VMBatchQueue* queue, size_t* job) {
+  if (atomic_load_explicit(&queue->next, memory_order_relaxed) >= queue->end) return false;
+  *job = atomic_fetch_add_explicit(&queue->next, 1, memory_order_relaxed);
+  return *job < queue->end;
+}
+
+static void run_job(OrionVM* vm, VMBatch* batch, VMBatchJob* job) {
+  ovm_reset(vm);
+  ovm_set_inputs(vm, job->inputs, job->input_count);
+  
+  job->status = ovm_run(vm);
+  job->result = 0;
+  if (job->status == 0 && vm->return_value.is_initialized) {
+    job->result = vm->return_value.value.i64;
+  }
+  
+  atomic_fetch_add_explicit(job->status == 0 ? &batch->completed : &batch->failed, 1, memory_order_relaxed);
+}
+
+static void* batch_worker(void* arg) {
+  VMBatchWorker* worker = arg;
+  VMBatch* batch = worker->batch;
+  OrionVM vm;
+  
+  if (ovm_init(&vm) != 0 || ovm_attach_program(&vm, batch->program) != 0) {
+    atomic_store(&batch->setup_failed, 1);
+    return NULL;
+  }
+  
+  // Own range first, then steal from the others in turn
+  size_t job;
+  for (size_t k = 0; k < batch->thread_count; k++) {
+    size_t victim = (worker->index + k) % batch->thread_count;
+    while (claim_job(&batch->queues[victim], &job)) {
+      run_job(&vm, batch, &batch->jobs[job]);
+      if (k > 0) atomic_fetch_add_explicit(&batch->stolen, 1, memory_order_relaxed);
+    }
+  }
+  
+  ovm_destroy(&vm);
+  return NULL;
+}
+
+static double elapsed_seconds(const struct timespec* start, const struct timespec* end) {
+  return (double)(end->tv_sec - start->tv_sec) + (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int ovm_batch_run(VMProgram* program, VMBatchJob* jobs, size_t job_count, size_t threads, VMBatchStats* stats) {
+  if (!program || (!jobs && job_count > 0)) return -1;
+  
+  if (threads == 0) threads = 1;
+  if (threads > OVM_BATCH_MAX_THREADS) threads = OVM_BATCH_MAX_THREADS;
+  if (threads > job_count && job_count > 0) threads = job_count;
+  
+  VMBatch batch = { .program = program, .jobs = jobs, .thread_count = threads };
+  atomic_init(&batch.completed, 0);
+  atomic_init(&batch.failed, 0);
+  atomic_init(&batch.stolen, 0);
+  atomic_init(&batch.setup_failed, 0);
+  
+  batch.queues = calloc(threads, sizeof(VMBatchQueue));
+  VMBatchWorker* workers = calloc(threads, sizeof(VMBatchWorker));
+  pthread_t* handles = calloc(threads, sizeof(pthread_t));
+  if (!batch.queues || !workers || !handles) {
+    free(batch.queues);
+    free(workers);
+    free(handles);
+    return -1;
+  }
+  
+  // Contiguous, evenly sized ranges keep each worker on its own cache lines
+  for (size_t i = 0; i < threads; i++) {
+    atomic_init(&batch.queues[i].next, job_count * i / threads);
+    batch.queues[i].end = job_count * (i + 1) / threads;
+    workers[i] = (VMBatchWorker){ .batch = &batch, .index = i };
+  }
+  
+  struct timespec start, end;
+  timespec_get(&start, TIME_UTC);
+  
+  // The calling thread doubles as worker 0
+  size_t started = 1;
+  for (; started < threads; started++) {
+    if (pthread_create(&handles[started], NULL, batch_worker, &workers[started]) != 0) break;
+  }
+  batch_worker(&workers[0]);
+  for (size_t i = 1; i < started; i++) {
+    pthread_join(handles[i], NULL);
+  }
+  
+  timespec_get(&end, TIME_UTC);
+  
+  if (stats) {
+    stats->threads = started;
+    stats->completed = atomic_load(&batch.completed);
+    stats->failed = atomic_load(&batch.failed);
+    stats->stolen = atomic_load(&batch.stolen);
+    stats->seconds = elapsed_seconds(&start, &end);
+  }
+  
+  free(batch.queues);
+  free(workers);
+  free(handles);
+  
+  // Jobs left unclaimed only if every worker failed to set up
+  return atomic_load(&batch.setup_failed) && atomic_load(&batch.completed) + atomic_load(&batch.failed) < job_count ? -1 : 0;
+}
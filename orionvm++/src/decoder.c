@@ -0,0 +1,875 @@
+/**
+ * @file src/decoder.c
+ * @brief Load-time instruction pre-decoding and direct-threaded execution loop
+ */
+
+#include "decoder.h"
+#include "executor.h"
+#include "jit.h"
+#include "native.h"
+#include "profile.h"
+#include "validator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+VMDecodedOp ovm_decode_opcode(const orinopp_instruction_t* instr) {
+  if (!instr) return OVM_DOP_GENERIC;
+  
+  switch (instr->root) {
+    case ORIONPP_OP_ISA:
+      switch (instr->child) {
+        case ORIONPP_OP_ISA_VAR: return OVM_DOP_VAR;
+        case ORIONPP_OP_ISA_CONST: return OVM_DOP_CONST;
+        case ORIONPP_OP_ISA_MOV: return OVM_DOP_MOV;
+        case ORIONPP_OP_ISA_LABEL: return OVM_DOP_NOP;
+        case ORIONPP_OP_ISA_JMP: return OVM_DOP_JMP;
+        case ORIONPP_OP_ISA_BREQ: return OVM_DOP_BREQ;
+        case ORIONPP_OP_ISA_BRNEQ: return OVM_DOP_BRNEQ;
+        case ORIONPP_OP_ISA_BRGT: return OVM_DOP_BRGT;
+        case ORIONPP_OP_ISA_BRGE: return OVM_DOP_BRGE;
+        case ORIONPP_OP_ISA_BRLT: return OVM_DOP_BRLT;
+        case ORIONPP_OP_ISA_BRLE: return OVM_DOP_BRLE;
+        case ORIONPP_OP_ISA_BRZ: return OVM_DOP_BRZ;
+        case ORIONPP_OP_ISA_BRNZ: return OVM_DOP_BRNZ;
+        case ORIONPP_OP_ISA_RET: return instr->value_count > 0 ? OVM_DOP_RET : OVM_DOP_RET_VOID;
+        case ORIONPP_OP_ISA_CALL: return OVM_DOP_CALL;
+        case ORIONPP_OP_ISA_ADD: return OVM_DOP_ADD;
+        case ORIONPP_OP_ISA_SUB: return OVM_DOP_SUB;
+        case ORIONPP_OP_ISA_MUL: return OVM_DOP_MUL;
+        case ORIONPP_OP_ISA_DIV: return OVM_DOP_DIV;
+        case ORIONPP_OP_ISA_MOD: return OVM_DOP_MOD;
+        case ORIONPP_OP_ISA_AND: return OVM_DOP_AND;
+        case ORIONPP_OP_ISA_OR: return OVM_DOP_OR;
+        case ORIONPP_OP_ISA_XOR: return OVM_DOP_XOR;
+        case ORIONPP_OP_ISA_SHL: return OVM_DOP_SHL;
+        case ORIONPP_OP_ISA_SHR: return OVM_DOP_SHR;
+        case ORIONPP_OP_ISA_INC: return OVM_DOP_INC;
+        case ORIONPP_OP_ISA_DEC: return OVM_DOP_DEC;
+        case ORIONPP_OP_ISA_INCp: return OVM_DOP_INCP;
+        case ORIONPP_OP_ISA_DECp: return OVM_DOP_DECP;
+        case ORIONPP_OP_ISA_NOT: return OVM_DOP_NOT;
+        default: return OVM_DOP_GENERIC;
+      }
+    case ORIONPP_OP_ABI:
+      // Arguments and return values move through the executor
+      switch (instr->child) {
+        case OVM_ABI_CALLER_SETUP:
+        case OVM_ABI_CALLEE_ARG:
+        case OVM_ABI_CALLER_ARG:
+        case OVM_ABI_CALLEE_RET:
+        case OVM_ABI_CALLER_RET:
+          return OVM_DOP_GENERIC;
+        default:
+          return OVM_DOP_NOP;
+      }
+    case ORIONPP_OP_HINT:
+    case ORIONPP_OP_TYPE:
+    case ORIONPP_OP_OBJ:
+      // Metadata instructions have no runtime effect
+      return OVM_DOP_NOP;
+    default:
+      return OVM_DOP_GENERIC;
+  }
+}
+
+static const char* const decoded_op_names[OVM_DOP_COUNT] = {
+  [OVM_DOP_NOP] = "NOP", [OVM_DOP_HALT] = "HALT", [OVM_DOP_GENERIC] = "GENERIC",
+  [OVM_DOP_VAR] = "VAR", [OVM_DOP_CONST] = "CONST", [OVM_DOP_MOV] = "MOV",
+  [OVM_DOP_JMP] = "JMP", [OVM_DOP_BREQ] = "BREQ", [OVM_DOP_BRNEQ] = "BRNEQ",
+  [OVM_DOP_BRGT] = "BRGT", [OVM_DOP_BRGE] = "BRGE", [OVM_DOP_BRLT] = "BRLT",
+  [OVM_DOP_BRLE] = "BRLE", [OVM_DOP_BRZ] = "BRZ", [OVM_DOP_BRNZ] = "BRNZ",
+  [OVM_DOP_RET] = "RET", [OVM_DOP_RET_VOID] = "RET_VOID", [OVM_DOP_CALL] = "CALL",
+  [OVM_DOP_NATIVE] = "NATIVE", [OVM_DOP_ADD] = "ADD", [OVM_DOP_SUB] = "SUB",
+  [OVM_DOP_MUL] = "MUL", [OVM_DOP_DIV] = "DIV", [OVM_DOP_MOD] = "MOD",
+  [OVM_DOP_AND] = "AND", [OVM_DOP_OR] = "OR", [OVM_DOP_XOR] = "XOR",
+  [OVM_DOP_SHL] = "SHL", [OVM_DOP_SHR] = "SHR", [OVM_DOP_INC] = "INC",
+  [OVM_DOP_DEC] = "DEC", [OVM_DOP_INCP] = "INCP", [OVM_DOP_DECP] = "DECP",
+  [OVM_DOP_NOT] = "NOT"
+};
+
+const char* ovm_decoded_op_name(VMDecodedOp op) {
+  return op < OVM_DOP_COUNT && decoded_op_names[op] ? decoded_op_names[op] : "UNKNOWN";
+}
+
+static bool decode_label(OrionVM* vm, const orinopp_value_t* value, size_t* target) {
+  orionpp_label_id_t label_id;
+  if (ovm_extract_label_id(value, &label_id) != 0) return false;
+  
+  *target = ovm_find_label(vm, label_id);
+  return *target != SIZE_MAX && *target < vm->instruction_count;
+}
+
+// Fill in operand slots; returns false if the instruction has to take the generic path
+static bool decode_operands(OrionVM* vm, const orinopp_instruction_t* instr, VMDecodedInstr* d) {
+  const orinopp_value_t* v = instr->values;
+  
+  switch (d->op) {
+    case OVM_DOP_NOP:
+    case OVM_DOP_RET_VOID:
+      return true;
+    case OVM_DOP_VAR:
+      if (instr->value_count < 2) return false;
+      d->type = v[1].root;
+      return ovm_extract_variable_id(&v[0], &d->a) == 0;
+    case OVM_DOP_CONST:
+      // Only integer constants are decoded; strings keep their heap semantics
+      if (instr->value_count < 3) return false;
+      if (ovm_extract_variable_id(&v[0], &d->a) != 0) return false;
+      d->type = v[1].root;
+      switch (d->type) {
+        case ORIONPP_TYPE_WORD:
+        case ORIONPP_TYPE_SIZE:
+          if (v[2].bytesize < sizeof(int32_t)) return false;
+          d->imm = *(int32_t*)v[2].bytes;
+          return true;
+        case ORIONPP_TYPE_C:
+          if (v[2].bytesize < sizeof(char)) return false;
+          d->imm = *(char*)v[2].bytes;
+          return true;
+        default:
+          return false;
+      }
+    case OVM_DOP_RET:
+      return ovm_extract_variable_id(&v[0], &d->a) == 0;
+    case OVM_DOP_CALL: {
+      // Calls into the module are bound to their function, anything else to
+      // its native. Unknown names and wrong argument counts stay generic.
+      if (instr->value_count < 2 || !v[1].bytes) return false;
+      if (v[1].root != ORIONPP_TYPE_SYMBOL && v[1].root != ORIONPP_TYPE_STRING) return false;
+      size_t length = ovm_symbol_length(&v[1]);
+      const VMFunction* function = v[1].root == ORIONPP_TYPE_SYMBOL ? ovm_find_function(vm, v[1].bytes, length) : NULL;
+      if (function) {
+        d->imm = function - vm->functions;
+        d->target = function->entry;
+        return true;
+      }
+      const VMNative* native = ovm_find_native(vm, v[1].bytes, length);
+      if (!native || !ovm_native_accepts(native, instr->value_count - 2)) return false;
+      if (ovm_extract_variable_id(&v[0], &d->a) != 0) d->a = OVM_NO_VARIABLE;
+      d->op = OVM_DOP_NATIVE;
+      d->type = native->signature.result;
+      d->native = native->function;
+      d->imm = (int64_t)(intptr_t)native->extern_function;
+      return true;
+    }
+    case OVM_DOP_JMP:
+      if (instr->value_count < 1) return false;
+      return decode_label(vm, &v[0], &d->target);
+    case OVM_DOP_BRZ:
+    case OVM_DOP_BRNZ:
+      if (instr->value_count < 2) return false;
+      return ovm_extract_variable_id(&v[0], &d->a) == 0 &&
+             decode_label(vm, &v[1], &d->target);
+    case OVM_DOP_BREQ:
+    case OVM_DOP_BRNEQ:
+    case OVM_DOP_BRGT:
+    case OVM_DOP_BRGE:
+    case OVM_DOP_BRLT:
+    case OVM_DOP_BRLE:
+      if (instr->value_count < 3) return false;
+      return ovm_extract_variable_id(&v[0], &d->a) == 0 &&
+             ovm_extract_variable_id(&v[1], &d->b) == 0 &&
+             decode_label(vm, &v[2], &d->target);
+    case OVM_DOP_MOV:
+    case OVM_DOP_INC:
+    case OVM_DOP_DEC:
+    case OVM_DOP_INCP:
+    case OVM_DOP_DECP:
+    case OVM_DOP_NOT:
+      if (instr->value_count < 2) return false;
+      return ovm_extract_variable_id(&v[0], &d->a) == 0 &&
+             ovm_extract_variable_id(&v[1], &d->b) == 0;
+    case OVM_DOP_ADD:
+    case OVM_DOP_SUB:
+    case OVM_DOP_MUL:
+    case OVM_DOP_DIV:
+    case OVM_DOP_MOD:
+    case OVM_DOP_AND:
+    case OVM_DOP_OR:
+    case OVM_DOP_XOR:
+    case OVM_DOP_SHL:
+    case OVM_DOP_SHR:
+      if (instr->value_count < 3) return false;
+      return ovm_extract_variable_id(&v[0], &d->a) == 0 &&
+             ovm_extract_variable_id(&v[1], &d->b) == 0 &&
+             ovm_extract_variable_id(&v[2], &d->c) == 0;
+    default:
+      return false;
+  }
+}
+
+static bool is_typed_op(VMDecodedOp op) {
+  return (op >= OVM_DOP_BREQ && op <= OVM_DOP_BRLE) || op == OVM_DOP_DIV || op == OVM_DOP_MOD || op == OVM_DOP_SHR;
+}
+
+// Stamps the ops whose result depends on their operand types with the type
+// they operate on, from the declarations: SIZE when the operation is unsigned,
+// the left operand's type otherwise. The verifier holds every variable of a
+// program it accepts to one type, so the verified handlers can be picked by
+// it; the checked handlers look at the variables instead.
+static int decode_operand_types(VMDecodedInstr* decoded, size_t count) {
+  orionpp_type_t* declared = malloc(OVM_MAX_VARIABLES * sizeof(orionpp_type_t));
+  if (!declared) return -1;
+  
+  // Calls are the only other declarations, and produce words unless a
+  // native says otherwise
+  for (size_t id = 0; id < OVM_MAX_VARIABLES; id++) declared[id] = ORIONPP_TYPE_WORD;
+  for (size_t i = 0; i < count; i++) {
+    const VMDecodedInstr* d = &decoded[i];
+    if ((d->op == OVM_DOP_VAR || d->op == OVM_DOP_CONST || d->op == OVM_DOP_NATIVE) && d->a < OVM_MAX_VARIABLES) {
+      declared[d->a] = d->type;
+    }
+  }
+  
+  for (size_t i = 0; i < count; i++) {
+    VMDecodedInstr* d = &decoded[i];
+    if (!is_typed_op(d->op)) continue;
+    orionpp_variable_id_t left = d->op >= OVM_DOP_BREQ && d->op <= OVM_DOP_BRLE ? d->a : d->b;
+    orionpp_variable_id_t right = d->op >= OVM_DOP_BREQ && d->op <= OVM_DOP_BRLE ? d->b : d->c;
+    orionpp_type_t left_type = left < OVM_MAX_VARIABLES ? declared[left] : ORIONPP_TYPE_WORD;
+    orionpp_type_t right_type = right < OVM_MAX_VARIABLES ? declared[right] : ORIONPP_TYPE_WORD;
+    d->type = ovm_is_unsigned_operation(left_type, right_type) ? ORIONPP_TYPE_SIZE : left_type;
+  }
+  
+  free(declared);
+  return 0;
+}
+
+int ovm_decode_program(OrionVM* vm) {
+  if (!vm) return -1;
+  if (vm->decoded) return 0;
+  
+  // One extra record holds the HALT sentinel so the loop never bounds-checks pc
+  VMDecodedInstr* decoded = calloc(vm->instruction_count + 1, sizeof(VMDecodedInstr));
+  if (!decoded) return -1;
+  
+  for (size_t i = 0; i < vm->instruction_count; i++) {
+    const orinopp_instruction_t* instr = &vm->instructions[i];
+    VMDecodedInstr* d = &decoded[i];
+  
+    d->instr = instr;
+    d->op = ovm_decode_opcode(instr);
+    if (!decode_operands(vm, instr, d)) {
+      // Malformed or unsupported operands: let the executor report it at runtime
+      d->op = OVM_DOP_GENERIC;
+    }
+  }
+  decoded[vm->instruction_count].op = OVM_DOP_HALT;
+  
+  if (decode_operand_types(decoded, vm->instruction_count) != 0) {
+    free(decoded);
+    return -1;
+  }
+  
+  vm->decoded = decoded;
+  vm->decoded_count = vm->instruction_count + 1;
+  vm->decoded_threaded = false;
+  return 0;
+}
+
+void ovm_free_decoded(OrionVM* vm) {
+  if (!vm) return;
+  
+  free(vm->decoded);
+  vm->decoded = NULL;
+  vm->decoded_count = 0;
+  vm->decoded_threaded = false;
+  vm->decoded_verified = false;
+  vm->decoded_profiled = false;
+  ovm_jit_free(vm->jit);
+  vm->jit = NULL;
+  vm->decoded_jit = OVM_JIT_OFF;
+}
+
+// Handlers with a check-free variant, used once ovm_verify_program has proven the program
+#define OVM_VERIFIED_OPS(X)                                             \
+  X(MOV) X(BREQ) X(BRNEQ) X(BRGT) X(BRGE) X(BRLT) X(BRLE) X(BRZ) X(BRNZ) \
+  X(ADD) X(SUB) X(MUL) X(DIV) X(MOD) X(AND) X(OR) X(XOR) X(SHL) X(SHR)  \
+  X(INC) X(DEC) X(INCP) X(DECP) X(NOT)
+
+#define VERIFIED_FLAG(name) [OVM_DOP_##name] = true,
+static const bool has_verified_variant[OVM_DOP_COUNT] = { OVM_VERIFIED_OPS(VERIFIED_FLAG) };
+
+// Check-free handlers with a second variant for unsigned operands, picked by
+// the type decode_operand_types stamped on the record
+#define OVM_UNSIGNED_OPS(X) X(BRGT) X(BRGE) X(BRLT) X(BRLE) X(DIV) X(MOD) X(SHR)
+
+// Superinstructions: runs of adjacent records executed in one dispatch by
+// verified programs. OVM_SUPER_PAIRS and OVM_SUPER_TRIPLES come from the pair
+// histogram of `ovm++ --profile-super`, which records its programs in
+// superinstructions.h: orioncc/examples/loops.c built by occ at -O0 and -O2.
+// Only the last op of a run may branch. Every record is bound to the longest
+// run starting at it, so jumps into the middle still work. A back edge still
+// counting towards tier-up keeps a dispatch of its own.
+#include "superinstructions.h"
+
+// Ops with a BODY_ the superinstructions can be made of
+#define OVM_FUSABLE_OPS(X) X(NOP) X(JMP) X(CONST) OVM_VERIFIED_OPS(X)
+
+#define FUSABLE_FLAG(name) [OVM_DOP_##name] = true,
+static const bool has_fusable_body[OVM_DOP_COUNT] = { OVM_FUSABLE_OPS(FUSABLE_FLAG) };
+
+bool ovm_decoded_op_fusable(VMDecodedOp op) {
+  return op < OVM_DOP_COUNT && has_fusable_body[op];
+}
+
+bool ovm_decoded_op_branches(VMDecodedOp op) {
+  return op == OVM_DOP_JMP || (op >= OVM_DOP_BREQ && op <= OVM_DOP_BRNZ);
+}
+
+#define UNSIGNED_SLOT(name) OVM_UNSIGNED_##name,
+#define SUPER_PAIR_SLOT(a, b) OVM_SUPER_##a##_##b,
+#define SUPER_TRIPLE_SLOT(a, b, c) OVM_SUPER_##a##_##b##_##c,
+enum {
+  OVM_EXTRA_SLOT_BASE = 2 * OVM_DOP_COUNT - 1,
+  OVM_UNSIGNED_OPS(UNSIGNED_SLOT)
+  OVM_SUPER_PAIRS(SUPER_PAIR_SLOT)
+  OVM_SUPER_TRIPLES(SUPER_TRIPLE_SLOT)
+  OVM_SLOT_COUNT
+};
+
+#define UNSIGNED_ENTRY(name) [OVM_DOP_##name] = OVM_UNSIGNED_##name,
+static const unsigned short unsigned_slots[OVM_DOP_COUNT] = { OVM_UNSIGNED_OPS(UNSIGNED_ENTRY) };
+
+static inline bool is_branchable_type(orionpp_type_t type) {
+  return type == ORIONPP_TYPE_WORD || type == ORIONPP_TYPE_SIZE || type == ORIONPP_TYPE_C;
+}
+
+// The slot a record of a verified program runs on. Compares of anything but
+// the integer types ovm_compare_variables handles stay on the checked handler.
+static unsigned verified_slot(const VMDecodedInstr* d) {
+  if (!has_verified_variant[d->op]) return d->op;
+  if (d->op >= OVM_DOP_BREQ && d->op <= OVM_DOP_BRLE && !is_branchable_type(d->type)) return d->op;
+  if (d->type == ORIONPP_TYPE_SIZE && unsigned_slots[d->op]) return unsigned_slots[d->op];
+  return OVM_DOP_COUNT + d->op;
+}
+
+// Superinstructions are made of the signed bodies only
+static bool is_fusable(const VMDecodedInstr* d) {
+  return verified_slot(d) == (has_verified_variant[d->op] ? OVM_DOP_COUNT + d->op : d->op);
+}
+
+#define SUPER_PAIR_ENTRY(a, b) [OVM_DOP_##a][OVM_DOP_##b] = OVM_SUPER_##a##_##b,
+static const unsigned short super_pairs[OVM_DOP_COUNT][OVM_DOP_COUNT] = { OVM_SUPER_PAIRS(SUPER_PAIR_ENTRY) };
+
+typedef struct {
+  VMDecodedOp ops[3];
+  unsigned slot;
+} VMSuperTriple;
+
+#define SUPER_TRIPLE_ENTRY(a, b, c) { { OVM_DOP_##a, OVM_DOP_##b, OVM_DOP_##c }, OVM_SUPER_##a##_##b##_##c },
+static const VMSuperTriple super_triples[] = { OVM_SUPER_TRIPLES(SUPER_TRIPLE_ENTRY) { { OVM_DOP_NOP }, 0 } };
+
+// The superinstruction starting at record i of a verified stream, or 0
+static unsigned super_slot(const VMDecodedInstr* decoded, size_t count, size_t i, const VMJit* tiering) {
+  if (i + 1 >= count || ovm_jit_counts(tiering, decoded, i + 1)) return 0;
+  if (!is_fusable(&decoded[i]) || !is_fusable(&decoded[i + 1])) return 0;
+  if (i + 2 < count && !ovm_jit_counts(tiering, decoded, i + 2) && is_fusable(&decoded[i + 2])) {
+    for (size_t t = 0; super_triples[t].slot; t++) {
+      const VMSuperTriple* triple = &super_triples[t];
+      if (decoded[i].op == triple->ops[0] && decoded[i + 1].op == triple->ops[1] && decoded[i + 2].op == triple->ops[2]) {
+        return triple->slot;
+      }
+    }
+  }
+  return super_pairs[decoded[i].op][decoded[i + 1].op];
+}
+
+#ifdef OVM_THREADED_DISPATCH
+  #define CASE(name) op_##name:
+  #define VERIFIED_CASE(name) vop_##name:
+  #define UNSIGNED_CASE(name) uop_##name:
+  #define PAIR_CASE(a, b) sop_##a##_##b:
+  #define TRIPLE_CASE(a, b, c) sop_##a##_##b##_##c:
+  #define DISPATCH() goto *ip->handler
+#else
+  #define CASE(name) case OVM_DOP_##name:
+  #define VERIFIED_CASE(name) case OVM_DOP_COUNT + OVM_DOP_##name:
+  #define UNSIGNED_CASE(name) case OVM_UNSIGNED_##name:
+  #define PAIR_CASE(a, b) case OVM_SUPER_##a##_##b:
+  #define TRIPLE_CASE(a, b, c) case OVM_SUPER_##a##_##b##_##c:
+  #define DISPATCH() continue
+#endif
+
+#define FAIL(...) do { ovm_error(vm, __VA_ARGS__); goto fail; } while (0)
+
+#define LOAD_VAR(var, id, what)                                 \
+  VMVariable* var = ovm_lookup_variable(vm, (id));                 \
+  if (!var) FAIL("Variable %u not found in %s instruction", (id), what)
+
+#define CHECK_INIT(var, msg)                                    \
+  if (ovm_validate_variable_initialization(vm, var) != OVM_VALID) FAIL(msg)
+
+// Verified programs declare and initialize every operand before use on all
+// paths, so their handlers go to the values by id
+#define VALUE(id) vm->values[(id)]
+#define STATE(id) vm->variables[(id)]
+
+// Bodies of the check-free handlers. Each runs the record at ip and leaves
+// ip on the record to run next, so a superinstruction is its bodies in a row.
+// Arithmetic is on int64 values, or on uint64 values for the _U64 bodies.
+#define BINARY_BODY(type, field, expr, divides)                 \
+  {                                                             \
+    type left = VALUE(ip->b).field;                             \
+    type right = VALUE(ip->c).field;                            \
+    if (divides && right == 0) FAIL("Division by zero");        \
+    VALUE(ip->a).field = (expr);                                \
+    STATE(ip->a).is_initialized = true;                         \
+    ip++;                                                       \
+  }
+
+#define SIGNED_BODY(expr, divides) BINARY_BODY(int64_t, i64, expr, divides)
+#define UNSIGNED_BODY(expr, divides) BINARY_BODY(uint64_t, u64, expr, divides)
+
+#define UNARY_BODY(stmt)                                        \
+  {                                                             \
+    stmt;                                                       \
+    STATE(ip->a).is_initialized = true;                         \
+    ip++;                                                       \
+  }
+
+#define COMPARE_BODY(field, op)                                 \
+  {                                                             \
+    ip = VALUE(ip->a).field op VALUE(ip->b).field ? base + ip->target : ip + 1; \
+  }
+
+#define ZERO_BODY(op)                                           \
+  {                                                             \
+    ip = VALUE(ip->a).i64 op 0 ? base + ip->target : ip + 1;    \
+  }
+
+#define BODY_NOP ip++;
+#define BODY_JMP ip = base + ip->target;
+
+#define BODY_CONST                                              \
+  {                                                             \
+    VMVariable* var = ovm_lookup_variable(vm, ip->a);           \
+    if (!var) {                                                 \
+      var = ovm_create_variable(vm, ip->a, ip->type);           \
+      if (!var) goto fail;                                      \
+    }                                                           \
+    VALUE(ip->a).i64 = ip->imm;                                 \
+    var->is_initialized = true;                                 \
+    ip++;                                                       \
+  }
+
+#define BODY_MOV                                                \
+  {                                                             \
+    VMVariable* dest = &STATE(ip->a);                           \
+    if (ovm_convert_value(vm, dest, &STATE(ip->b), dest->type) != 0) FAIL("Incompatible types in MOV instruction"); \
+    ip++;                                                       \
+  }
+
+#define BODY_BREQ COMPARE_BODY(i64, ==)
+#define BODY_BRNEQ COMPARE_BODY(i64, !=)
+#define BODY_BRGT COMPARE_BODY(i64, >)
+#define BODY_BRGE COMPARE_BODY(i64, >=)
+#define BODY_BRLT COMPARE_BODY(i64, <)
+#define BODY_BRLE COMPARE_BODY(i64, <=)
+#define BODY_BRZ ZERO_BODY(==)
+#define BODY_BRNZ ZERO_BODY(!=)
+
+#define BODY_BRGT_U64 COMPARE_BODY(u64, >)
+#define BODY_BRGE_U64 COMPARE_BODY(u64, >=)
+#define BODY_BRLT_U64 COMPARE_BODY(u64, <)
+#define BODY_BRLE_U64 COMPARE_BODY(u64, <=)
+
+#define BODY_ADD SIGNED_BODY(left + right, false)
+#define BODY_SUB SIGNED_BODY(left - right, false)
+#define BODY_MUL SIGNED_BODY(left * right, false)
+#define BODY_DIV SIGNED_BODY(left / right, true)
+#define BODY_MOD SIGNED_BODY(left % right, true)
+#define BODY_AND SIGNED_BODY(left & right, false)
+#define BODY_OR SIGNED_BODY(left | right, false)
+#define BODY_XOR SIGNED_BODY(left ^ right, false)
+#define BODY_SHL SIGNED_BODY(left << right, false)
+#define BODY_SHR SIGNED_BODY(left >> right, false)
+
+#define BODY_DIV_U64 UNSIGNED_BODY(left / right, true)
+#define BODY_MOD_U64 UNSIGNED_BODY(left % right, true)
+#define BODY_SHR_U64 UNSIGNED_BODY(left >> right, false)
+
+#define BODY_INC UNARY_BODY(VALUE(ip->a).i64 = VALUE(ip->b).i64 + 1)
+#define BODY_DEC UNARY_BODY(VALUE(ip->a).i64 = VALUE(ip->b).i64 - 1)
+#define BODY_INCP UNARY_BODY(VALUE(ip->a).i64 = VALUE(ip->b).i64; VALUE(ip->b).i64++)
+#define BODY_DECP UNARY_BODY(VALUE(ip->a).i64 = VALUE(ip->b).i64; VALUE(ip->b).i64--)
+#define BODY_NOT UNARY_BODY(VALUE(ip->a).i64 = ~VALUE(ip->b).i64)
+
+// The checked handlers validate the operands, then run the same body
+#define BINARY_OP(name)                                         \
+  CASE(name) {                                                  \
+    LOAD_VAR(dest, ip->a, #name);                               \
+    LOAD_VAR(left, ip->b, #name);                               \
+    LOAD_VAR(right, ip->c, #name);                              \
+    if (ovm_validate_type_operation(vm, left, right, ip->instr->child) != OVM_VALID) \
+      FAIL("Type validation failed for %s operation", #name);   \
+    BODY_##name                                                 \
+    DISPATCH();                                                 \
+  }
+
+// Binary ops whose result depends on signedness, decided by the variables
+#define TYPED_BINARY_OP(name)                                   \
+  CASE(name) {                                                  \
+    LOAD_VAR(dest, ip->a, #name);                               \
+    LOAD_VAR(left, ip->b, #name);                               \
+    LOAD_VAR(right, ip->c, #name);                              \
+    if (ovm_validate_type_operation(vm, left, right, ip->instr->child) != OVM_VALID) \
+      FAIL("Type validation failed for %s operation", #name);   \
+    if (ovm_is_unsigned_operation(left->type, right->type)) BODY_##name##_U64 \
+    else BODY_##name                                            \
+    DISPATCH();                                                 \
+  }
+
+#define UNARY_OP(name)                                          \
+  CASE(name) {                                                  \
+    LOAD_VAR(dest, ip->a, #name);                               \
+    LOAD_VAR(operand, ip->b, #name);                            \
+    CHECK_INIT(operand, "Operand variable not initialized");    \
+    BODY_##name                                                 \
+    DISPATCH();                                                 \
+  }
+
+#define COMPARE_BRANCH(name, op)                                \
+  CASE(name) {                                                  \
+    LOAD_VAR(left, ip->a, #name);                               \
+    LOAD_VAR(right, ip->b, #name);                              \
+    CHECK_INIT(left, "Left operand not initialized");           \
+    CHECK_INIT(right, "Right operand not initialized");         \
+    int cmp;                                                    \
+    if (ovm_compare_variables(vm, left, right, &cmp) != 0) goto fail; \
+    ip = cmp op 0 ? base + ip->target : ip + 1;                 \
+    DISPATCH();                                                 \
+  }
+
+#define ZERO_BRANCH(name)                                       \
+  CASE(name) {                                                  \
+    LOAD_VAR(var, ip->a, #name);                                \
+    CHECK_INIT(var, "Variable not initialized");                \
+    if (!is_branchable_type(var->type))                         \
+      FAIL("Invalid variable type for %s instruction", #name);  \
+    BODY_##name                                                 \
+    DISPATCH();                                                 \
+  }
+
+#define VERIFIED_HANDLER(name) VERIFIED_CASE(name) { BODY_##name DISPATCH(); }
+#define UNSIGNED_HANDLER(name) UNSIGNED_CASE(name) { BODY_##name##_U64 DISPATCH(); }
+#define SUPER_PAIR_HANDLER(a, b) PAIR_CASE(a, b) { BODY_##a BODY_##b DISPATCH(); }
+#define SUPER_TRIPLE_HANDLER(a, b, c) TRIPLE_CASE(a, b, c) { BODY_##a BODY_##b BODY_##c DISPATCH(); }
+
+#ifdef OVM_PROFILE
+// Charges the time since the last dispatch to the record that ran in it
+#define PROFILE_CHARGE(now)                                     \
+  do {                                                          \
+    profile->op_ticks[previous->op] += (now) - started;         \
+    profile->record_ticks[previous - base] += (now) - started;  \
+  } while (0)
+
+// Counts the record about to run, and the pair it forms with the one before
+// when control fell through from it
+#define PROFILE_COUNT()                                         \
+  do {                                                          \
+    uint64_t now = ovm_profile_ticks();                         \
+    if (previous) {                                             \
+      PROFILE_CHARGE(now);                                      \
+      if (ip == previous + 1) profile->pairs[previous->op][ip->op]++; \
+    }                                                           \
+    profile->ops[ip->op]++;                                     \
+    profile->records[ip - base]++;                              \
+    previous = ip;                                              \
+    started = now;                                              \
+  } while (0)
+
+#define PROFILE_STOP()                                          \
+  do {                                                          \
+    if (profile && previous) PROFILE_CHARGE(ovm_profile_ticks()); \
+  } while (0)
+#else
+#define PROFILE_STOP() ((void)0)
+#endif
+
+// Label addresses and computed gotos are the GNU extension the threaded loop
+// is built on; -Wpedantic flags every use of them
+#ifdef OVM_THREADED_DISPATCH
+  #pragma GCC diagnostic push
+  #pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+// With bind_only set, resolves the dispatch slots for the VM's tier and returns
+static int run_decoded(OrionVM* vm, bool bind_only) {
+  if (!vm || !vm->decoded) return -1;
+  
+  VMDecodedInstr* const base = vm->decoded;
+  VMDecodedInstr* ip = base + vm->pc;
+  
+  // Check-free handlers only ever run programs the verifier has stamped
+  bool verified = vm->run_mode == OVM_RUN_VERIFIED && vm->verified;
+#ifdef OVM_PROFILE
+  VMProfile* const profile = vm->profile;
+  const VMDecodedInstr* previous = NULL;
+  uint64_t started = 0;
+#else
+  const void* const profile = NULL;
+#endif
+
+  // Native code replaces the handlers wherever it was compiled. Tiered mode
+  // compiles nothing up front and counts back edges instead, in checked
+  // programs too; eager mode needs the verifier's declared types.
+#ifdef OVM_JIT
+  VMJitMode jit = profile || (!verified && vm->jit_mode == OVM_JIT_EAGER) ? OVM_JIT_OFF : vm->jit_mode;
+  if (vm->jit && vm->jit->verified != verified) {
+    ovm_jit_free(vm->jit);
+    vm->jit = NULL;
+  }
+  if (jit != OVM_JIT_OFF && !vm->jit) vm->jit = jit == OVM_JIT_EAGER ? ovm_jit_compile(vm) : ovm_jit_create(vm, verified);
+  if (!vm->jit) jit = OVM_JIT_OFF;
+  const VMJit* const tiering = jit == OVM_JIT_TIERED ? vm->jit : NULL;
+  const uint32_t threshold = vm->jit_threshold ? vm->jit_threshold : OVM_JIT_HOT_LOOP;
+#else
+  const VMJitMode jit = OVM_JIT_OFF;
+  const VMJit* const tiering = NULL;
+#endif
+
+#ifdef OVM_THREADED_DISPATCH
+  #define VERIFIED_ENTRY(name) [OVM_DOP_COUNT + OVM_DOP_##name] = &&vop_##name,
+  #define UNSIGNED_ENTRY_LABEL(name) [OVM_UNSIGNED_##name] = &&uop_##name,
+  #define SUPER_PAIR_LABEL(a, b) [OVM_SUPER_##a##_##b] = &&sop_##a##_##b,
+  #define SUPER_TRIPLE_LABEL(a, b, c) [OVM_SUPER_##a##_##b##_##c] = &&sop_##a##_##b##_##c,
+  static const void* const dispatch_table[OVM_SLOT_COUNT] = {
+    [OVM_DOP_NOP] = &&op_NOP, [OVM_DOP_HALT] = &&op_HALT, [OVM_DOP_GENERIC] = &&op_GENERIC,
+    [OVM_DOP_VAR] = &&op_VAR, [OVM_DOP_CONST] = &&op_CONST, [OVM_DOP_MOV] = &&op_MOV,
+    [OVM_DOP_JMP] = &&op_JMP, [OVM_DOP_BREQ] = &&op_BREQ, [OVM_DOP_BRNEQ] = &&op_BRNEQ,
+    [OVM_DOP_BRGT] = &&op_BRGT, [OVM_DOP_BRGE] = &&op_BRGE, [OVM_DOP_BRLT] = &&op_BRLT,
+    [OVM_DOP_BRLE] = &&op_BRLE, [OVM_DOP_BRZ] = &&op_BRZ, [OVM_DOP_BRNZ] = &&op_BRNZ,
+    [OVM_DOP_RET] = &&op_RET, [OVM_DOP_RET_VOID] = &&op_RET_VOID, [OVM_DOP_CALL] = &&op_CALL,
+    [OVM_DOP_NATIVE] = &&op_NATIVE, [OVM_DOP_ADD] = &&op_ADD, [OVM_DOP_SUB] = &&op_SUB,
+    [OVM_DOP_MUL] = &&op_MUL, [OVM_DOP_DIV] = &&op_DIV, [OVM_DOP_MOD] = &&op_MOD,
+    [OVM_DOP_AND] = &&op_AND, [OVM_DOP_OR] = &&op_OR, [OVM_DOP_XOR] = &&op_XOR,
+    [OVM_DOP_SHL] = &&op_SHL, [OVM_DOP_SHR] = &&op_SHR, [OVM_DOP_INC] = &&op_INC,
+    [OVM_DOP_DEC] = &&op_DEC, [OVM_DOP_INCP] = &&op_INCP, [OVM_DOP_DECP] = &&op_DECP,
+    [OVM_DOP_NOT] = &&op_NOT,
+    OVM_VERIFIED_OPS(VERIFIED_ENTRY)
+    OVM_UNSIGNED_OPS(UNSIGNED_ENTRY_LABEL)
+    OVM_SUPER_PAIRS(SUPER_PAIR_LABEL)
+    OVM_SUPER_TRIPLES(SUPER_TRIPLE_LABEL)
+  };
+#endif
+  
+  // Resolve dispatch slots once per tier so dispatch never tests the tier.
+  // While profiling every record enters through op_PROFILE instead, and
+  // no superinstructions are formed so the counts are of plain ops.
+  // Compiled records enter native code through op_JIT but keep their slots
+  // for when native code hands a record back, and back edges still counting
+  // enter through op_BACK_EDGE. Compiling and dropping code binds again.
+#ifdef OVM_JIT
+bind:
+#endif
+  if (!vm->decoded_threaded || vm->decoded_verified != verified || vm->decoded_profiled != (profile != NULL) ||
+      vm->decoded_jit != jit) {
+    for (size_t i = 0; i < vm->decoded_count; i++) {
+      VMDecodedOp op = base[i].op;
+      unsigned super = verified && !profile ? super_slot(base, vm->decoded_count, i, tiering) : 0;
+      base[i].slot = super ? super : verified ? verified_slot(&base[i]) : op;
+#ifdef OVM_THREADED_DISPATCH
+      base[i].handler = dispatch_table[base[i].slot];
+  #ifdef OVM_PROFILE
+      if (profile) base[i].handler = &&op_PROFILE;
+  #endif
+  #ifdef OVM_JIT
+      if (jit && vm->jit->entries[i]) base[i].handler = &&op_JIT;
+      else if (ovm_jit_counts(tiering, base, i)) base[i].handler = &&op_BACK_EDGE;
+  #endif
+#endif
+    }
+    vm->decoded_threaded = true;
+    vm->decoded_verified = verified;
+    vm->decoded_profiled = profile != NULL;
+    vm->decoded_jit = jit;
+  }
+  if (bind_only) return 0;
+#ifdef OVM_PROFILE
+  if (profile && ovm_profile_reserve(profile, vm->decoded_count) != 0) FAIL("Out of memory for the profile");
+#endif
+  
+#ifdef OVM_THREADED_DISPATCH
+  DISPATCH();
+  
+  #ifdef OVM_PROFILE
+  op_PROFILE:
+    PROFILE_COUNT();
+    goto *dispatch_table[ip->slot];
+  #endif
+  
+  #ifdef OVM_JIT
+  // Native code runs until a record it hands back, which the interpreter runs.
+  // Code whose assumed types no longer hold is dropped for the interpreter.
+  op_JIT:
+    if (!ovm_jit_guards_hold(vm->jit, vm->variables, (size_t)(ip - base))) {
+      ovm_jit_deoptimize(vm, vm->jit, (size_t)(ip - base));
+      vm->decoded_threaded = false;
+      goto bind;
+    }
+    ip = base + vm->jit->entries[ip - base](vm->values, vm->variables);
+    goto *dispatch_table[ip->slot];
+  
+  // A hot loop is compiled at its back edge, and execution moves into the
+  // new code right there: it works on the same values as the interpreter
+  op_BACK_EDGE:
+    if (++vm->jit->back_edges[ip - base] < threshold) goto *dispatch_table[ip->slot];
+    ovm_jit_tier_up(vm, vm->jit, (size_t)(ip - base));
+    vm->decoded_threaded = false;
+    goto bind;
+  #endif
+#else
+  for (;;) {
+  #ifdef OVM_PROFILE
+    if (profile) PROFILE_COUNT();
+  #endif
+    switch (ip->slot) {
+#endif
+
+  CASE(NOP) {
+    BODY_NOP
+    DISPATCH();
+  }
+  
+  CASE(HALT) {
+    goto done;
+  }
+  
+  CASE(GENERIC) {
+    // Anything the decoder could not specialise runs through the regular executor
+    vm->pc = (size_t)(ip - base);
+    if (ovm_execute_instruction(vm, ip->instr) != 0) goto fail;
+    if (!vm->running) goto done;
+    if (!ovm_is_control_flow(ip->instr)) vm->pc++;
+    if (vm->pc > vm->instruction_count) FAIL("Program counter out of bounds");
+    ip = base + vm->pc;
+    DISPATCH();
+  }
+  
+  CASE(VAR) {
+    if (ovm_lookup_variable(vm, ip->a) != NULL) FAIL("Variable %u already declared", ip->a);
+    if (!ovm_create_variable(vm, ip->a, ip->type)) goto fail;
+    ip++;
+    DISPATCH();
+  }
+  
+  CASE(CONST) {
+    BODY_CONST
+    DISPATCH();
+  }
+  
+  CASE(MOV) {
+    LOAD_VAR(dest, ip->a, "MOV");
+    LOAD_VAR(src, ip->b, "MOV");
+    CHECK_INIT(src, "Source variable not initialized");
+    if (ovm_convert_value(vm, dest, src, dest->type) != 0) FAIL("Incompatible types in MOV instruction");
+    ip++;
+    DISPATCH();
+  }
+  
+  CASE(JMP) {
+    BODY_JMP
+    DISPATCH();
+  }
+  
+  COMPARE_BRANCH(BREQ, ==)
+  COMPARE_BRANCH(BRNEQ, !=)
+  COMPARE_BRANCH(BRGT, >)
+  COMPARE_BRANCH(BRGE, >=)
+  COMPARE_BRANCH(BRLT, <)
+  COMPARE_BRANCH(BRLE, <=)
+  ZERO_BRANCH(BRZ)
+  ZERO_BRANCH(BRNZ)
+  
+  CASE(RET) {
+    VMVariable* ret_var = ovm_lookup_variable(vm, ip->a);
+    if (vm->call_depth == 0) {
+      ovm_set_return_value(vm, ret_var);
+      vm->running = false;
+      goto done;
+    }
+    ovm_move_return_value(vm, ret_var);
+    if (ovm_return_from_call(vm) != 0) goto fail;
+    ip = base + vm->pc;
+    DISPATCH();
+  }
+  
+  CASE(RET_VOID) {
+    if (vm->call_depth == 0) {
+      vm->running = false;
+      goto done;
+    }
+    if (ovm_return_from_call(vm) != 0) goto fail;
+    ip = base + vm->pc;
+    DISPATCH();
+  }
+  
+  CASE(CALL) {
+    // The callee runs on this loop, on the frame stack; handlers see its
+    // frame through vm->values until it returns
+    if (ovm_call_function(vm, (size_t)ip->imm, ip->instr, (size_t)(ip - base) + 1) != 0) goto fail;
+    ip = base + vm->pc;
+    DISPATCH();
+  }
+  
+  CASE(NATIVE) {
+    // Bound when the program was decoded; only the arguments are looked up
+    if (ovm_call_native(vm, ip->native, (VMExternFunction)(intptr_t)ip->imm, ip->type, ip->a, ip->instr) != 0) goto fail;
+    ip++;
+    DISPATCH();
+  }
+  
+  BINARY_OP(ADD)
+  BINARY_OP(SUB)
+  BINARY_OP(MUL)
+  TYPED_BINARY_OP(DIV)
+  TYPED_BINARY_OP(MOD)
+  BINARY_OP(AND)
+  BINARY_OP(OR)
+  BINARY_OP(XOR)
+  BINARY_OP(SHL)
+  TYPED_BINARY_OP(SHR)
+  
+  UNARY_OP(INC)
+  UNARY_OP(DEC)
+  UNARY_OP(INCP)
+  UNARY_OP(DECP)
+  UNARY_OP(NOT)
+  
+  OVM_VERIFIED_OPS(VERIFIED_HANDLER)
+  OVM_UNSIGNED_OPS(UNSIGNED_HANDLER)
+  OVM_SUPER_PAIRS(SUPER_PAIR_HANDLER)
+  OVM_SUPER_TRIPLES(SUPER_TRIPLE_HANDLER)
+
+#ifndef OVM_THREADED_DISPATCH
+      default:
+        goto fail;
+    }
+  }
+#endif
+
+done:
+  PROFILE_STOP();
+  vm->pc = (size_t)(ip - base);
+  vm->running = false;
+  return vm->error ? -1 : 0;
+
+fail:
+  PROFILE_STOP();
+  vm->pc = (size_t)(ip - base);
+  return -1;
+}
+
+#ifdef OVM_THREADED_DISPATCH
+  #pragma GCC diagnostic pop
+#endif
+
+int ovm_run_decoded(OrionVM* vm) {
+  return run_decoded(vm, false);
+}
+
+int ovm_bind_decoded(OrionVM* vm) {
+  return run_decoded(vm, true);
+}
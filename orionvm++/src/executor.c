@@ -4,11 +4,15 @@
  */
 
 #include "executor.h"
+#include "native.h"
 #include "validator.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+// Value of a variable of this VM
+#define VALUE(var) (*ovm_variable_value(vm, (var)))
+
 int ovm_execute_instruction(OrionVM* vm, const orinopp_instruction_t* instr) {
   if (!vm || !instr) return -1;
   
@@ -52,8 +56,9 @@ int ovm_execute_instruction(OrionVM* vm, const orinopp_instruction_t* instr) {
       }
     case ORIONPP_OP_HINT:
       return ovm_exec_hint(vm, instr);
-    case ORIONPP_OP_TYPE:
     case ORIONPP_OP_ABI:
+      return ovm_exec_abi(vm, instr);
+    case ORIONPP_OP_TYPE:
     case ORIONPP_OP_OBJ:
       // These are metadata instructions - ignore during execution
       return 0;
@@ -63,6 +68,28 @@ int ovm_execute_instruction(OrionVM* vm, const orinopp_instruction_t* instr) {
   }
 }
 
+bool ovm_is_control_flow(const orinopp_instruction_t* instr) {
+  if (!instr || instr->root != ORIONPP_OP_ISA) return false;
+  
+  // These instructions update the program counter themselves
+  switch (instr->child) {
+    case ORIONPP_OP_ISA_JMP:
+    case ORIONPP_OP_ISA_BREQ:
+    case ORIONPP_OP_ISA_BRNEQ:
+    case ORIONPP_OP_ISA_BRGT:
+    case ORIONPP_OP_ISA_BRGE:
+    case ORIONPP_OP_ISA_BRLT:
+    case ORIONPP_OP_ISA_BRLE:
+    case ORIONPP_OP_ISA_BRZ:
+    case ORIONPP_OP_ISA_BRNZ:
+    case ORIONPP_OP_ISA_CALL:
+    case ORIONPP_OP_ISA_RET:
+      return true;
+    default:
+      return false;
+  }
+}
+
 int ovm_exec_var(OrionVM* vm, const orinopp_instruction_t* instr) {
   if (instr->value_count < 2) {
     ovm_error(vm, "VAR instruction requires 2 operands");
@@ -116,7 +143,7 @@ int ovm_exec_const(OrionVM* vm, const orinopp_instruction_t* instr) {
     case ORIONPP_TYPE_WORD:
     case ORIONPP_TYPE_SIZE:
       if (value->bytesize >= sizeof(int32_t)) {
-        var->value.i64 = *(int32_t*)value->bytes;
+        VALUE(var).i64 = *(int32_t*)value->bytes;
         var->is_initialized = true;
       } else {
         ovm_error(vm, "Invalid integer constant size");
@@ -124,19 +151,19 @@ int ovm_exec_const(OrionVM* vm, const orinopp_instruction_t* instr) {
       }
       break;
     case ORIONPP_TYPE_STRING:
-      if (var->value.str) free(var->value.str);
-      var->value.str = malloc(value->bytesize + 1);
-      if (!var->value.str) {
+      if (VALUE(var).str) free(VALUE(var).str);
+      VALUE(var).str = malloc(value->bytesize + 1);
+      if (!VALUE(var).str) {
         ovm_error(vm, "Out of memory for string constant");
         return -1;
       }
-      memcpy(var->value.str, value->bytes, value->bytesize);
-      var->value.str[value->bytesize] = '\0';
+      memcpy(VALUE(var).str, value->bytes, value->bytesize);
+      VALUE(var).str[value->bytesize] = '\0';
       var->is_initialized = true;
       break;
     case ORIONPP_TYPE_C:
       if (value->bytesize >= sizeof(char)) {
-        var->value.i64 = *(char*)value->bytes;
+        VALUE(var).i64 = *(char*)value->bytes;
         var->is_initialized = true;
       } else {
         ovm_error(vm, "Invalid character constant size");
@@ -184,7 +211,7 @@ int ovm_exec_mov(OrionVM* vm, const orinopp_instruction_t* instr) {
   }
   
   // Copy value with type conversion if needed
-  return ovm_convert_value(dest, src, dest->type);
+  return ovm_convert_value(vm, dest, src, dest->type);
 }
 
 int ovm_exec_lea(OrionVM* vm, const orinopp_instruction_t* instr) {
@@ -525,7 +552,7 @@ int ovm_exec_brz(OrionVM* vm, const orinopp_instruction_t* instr) {
     case ORIONPP_TYPE_WORD:
     case ORIONPP_TYPE_SIZE:
     case ORIONPP_TYPE_C:
-      is_zero = (var->value.i64 == 0);
+      is_zero = (VALUE(var).i64 == 0);
       break;
     default:
       ovm_error(vm, "Invalid variable type for BRZ instruction");
@@ -567,7 +594,7 @@ int ovm_exec_brnz(OrionVM* vm, const orinopp_instruction_t* instr) {
     case ORIONPP_TYPE_WORD:
     case ORIONPP_TYPE_SIZE:
     case ORIONPP_TYPE_C:
-      is_not_zero = (var->value.i64 != 0);
+      is_not_zero = (VALUE(var).i64 != 0);
       break;
     default:
       ovm_error(vm, "Invalid variable type for BRNZ instruction");
@@ -583,69 +610,41 @@ int ovm_exec_call(OrionVM* vm, const orinopp_instruction_t* instr) {
     return -1;
   }
   
-  // Simple function call implementation
-  // For now, we'll just handle built-in functions
-  char* function_name;
-  if (ovm_extract_string(&instr->values[1], &function_name) != 0) {
+  // Functions of the module run in a frame of their own
+  const orinopp_value_t* symbol = &instr->values[1];
+  if (symbol->root == ORIONPP_TYPE_SYMBOL && symbol->bytes) {
+    const VMFunction* function = ovm_find_function(vm, symbol->bytes, ovm_symbol_length(symbol));
+    if (function) {
+      return ovm_call_function(vm, (size_t)(function - vm->functions), instr, vm->pc + 1);
+    }
+  }
+  
+  // Anything else is a native, found by hash without copying its name
+  if ((symbol->root != ORIONPP_TYPE_SYMBOL && symbol->root != ORIONPP_TYPE_STRING) || !symbol->bytes) {
     ovm_error(vm, "Invalid function name in CALL instruction");
     return -1;
   }
+  size_t length = ovm_symbol_length(symbol);
+  const VMNative* native = ovm_find_native(vm, symbol->bytes, length);
+  if (!native) {
+    ovm_error(vm, "Unknown function: %.*s", (int)length, symbol->bytes);
+    return -1;
+  }
+  if (!ovm_native_accepts(native, instr->value_count - 2)) {
+    ovm_error(vm, "Function %.*s takes %u to %u arguments", (int)length, symbol->bytes,
+              native->signature.min_args, native->signature.max_args);
+    return -1;
+  }
   
-  // Validate call depth
-  ValidationResult validation = ovm_validate_call_depth(vm);
-  if (validation != OVM_VALID) {
-    ovm_error(vm, "Call depth limit exceeded");
-    free(function_name);
-    return -1;
-  }
-  
-  // For now, we'll implement a simple print function
-  if (strcmp(function_name, "print") == 0) {
-    // Print function - takes one argument
-    if (instr->value_count >= 3) {
-      orionpp_variable_id_t arg_id;
-      if (ovm_extract_variable_id(&instr->values[2], &arg_id) == 0) {
-        VMVariable* arg = ovm_get_variable(vm, arg_id);
-        if (arg && arg->is_initialized) {
-          switch (arg->type) {
-            case ORIONPP_TYPE_WORD:
-            case ORIONPP_TYPE_SIZE:
-              printf("%lld\n", (long long)arg->value.i64);
-              break;
-            case ORIONPP_TYPE_STRING:
-              printf("%s\n", arg->value.str ? arg->value.str : "(null)");
-              break;
-            case ORIONPP_TYPE_C:
-              printf("%c\n", (char)arg->value.i64);
-              break;
-            default:
-              printf("(unhandled type)\n");
-              break;
-          }
-        }
-      }
-    }
-    
-    // Set return value to 0
-    orionpp_variable_id_t result_id;
-    if (ovm_extract_variable_id(&instr->values[0], &result_id) == 0) {
-      VMVariable* result = ovm_get_variable(vm, result_id);
-      if (!result) {
-        result = ovm_create_variable(vm, result_id, ORIONPP_TYPE_WORD);
-      }
-      if (result) {
-        result->value.i64 = 0;
-        result->is_initialized = true;
-      }
-    }
-  } else {
-    ovm_error(vm, "Unknown function: %s", function_name);
-    free(function_name);
+  orionpp_variable_id_t result_id;
+  if (ovm_extract_variable_id(&instr->values[0], &result_id) != 0) {
+    result_id = OVM_NO_VARIABLE;
+  }
+  if (ovm_call_native(vm, native->function, native->extern_function, native->signature.result, result_id, instr) != 0) {
     return -1;
   }
   
   vm->pc++;
-  free(function_name);
   return 0;
 }
 
@@ -655,21 +654,197 @@ int ovm_exec_ret(OrionVM* vm, const orinopp_instruction_t* instr) {
     orionpp_variable_id_t ret_id;
     if (ovm_extract_variable_id(&instr->values[0], &ret_id) == 0) {
       VMVariable* ret_var = ovm_get_variable(vm, ret_id);
-      if (ret_var && ret_var->is_initialized) {
-        vm->return_value = *ret_var;
-        // Don't free the string as we're copying the pointer
-        if (ret_var->type == ORIONPP_TYPE_STRING && ret_var->value.str) {
-          vm->return_value.value.str = strdup(ret_var->value.str);
-        }
+      if (vm->call_depth > 0) {
+        ovm_move_return_value(vm, ret_var); // the frame goes with the call
+      } else {
+        ovm_set_return_value(vm, ret_var);
       }
     }
   }
   
-  // Simple implementation - just stop execution
+  // A call continues in its caller; the entry frame ends the run
+  if (vm->call_depth > 0) {
+    return ovm_return_from_call(vm);
+  }
   vm->running = false;
   return 0;
 }
 
+// The variable id names in the current frame; calls declare their results
+// and parameters as words unless the program declared them itself
+static VMVariable* result_variable(OrionVM* vm, orionpp_variable_id_t id) {
+  VMVariable* var = ovm_get_variable(vm, id);
+  return var ? var : ovm_create_variable(vm, id, ORIONPP_TYPE_WORD);
+}
+
+// Stores a value that lives outside the frame in dest, as MOV would
+static int assign_value(OrionVM* vm, VMVariable* dest, orionpp_type_t type, const VMValue* value) {
+  if (!ovm_types_compatible(type, dest->type)) return -1;
+  
+  if (type == ORIONPP_TYPE_STRING) {
+    free(VALUE(dest).str);
+    VALUE(dest).str = value->str ? strdup(value->str) : NULL;
+  } else {
+    VALUE(dest).i64 = value->i64;
+  }
+  dest->is_initialized = true;
+  return 0;
+}
+
+int ovm_call_function(OrionVM* vm, size_t function, const orinopp_instruction_t* call, size_t return_address) {
+  // Arguments listed on the CALL replace those passed before it
+  VMFrame* frame = &vm->call_stack[vm->call_depth];
+  if (call->value_count > 2) {
+    if (call->value_count - 2 > OVM_MAX_CALL_ARGS) {
+      ovm_error(vm, "Too many arguments in CALL instruction");
+      return -1;
+    }
+    for (size_t i = 2; i < call->value_count; i++) {
+      if (ovm_extract_variable_id(&call->values[i], &frame->arg_ids[i - 2]) != 0) {
+        ovm_error(vm, "Invalid argument in CALL instruction");
+        return -1;
+      }
+    }
+    frame->arg_count = call->value_count - 2;
+  }
+  
+  // Copy the arguments while the caller's frame is current. Strings stay
+  // the caller's, which keeps them until the call returns.
+  for (size_t i = 0; i < frame->arg_count; i++) {
+    VMVariable* arg = ovm_lookup_variable(vm, frame->arg_ids[i]);
+    if (!arg || !arg->is_initialized) {
+      ovm_error(vm, "Argument %zu of call is not an initialized variable", i);
+      return -1;
+    }
+    frame->arg_types[i] = arg->type;
+    frame->args[i] = VALUE(arg);
+  }
+  
+  orionpp_variable_id_t result;
+  if (ovm_extract_variable_id(&call->values[0], &result) != 0) {
+    result = OVM_NO_VARIABLE;
+  }
+  if (ovm_push_frame(vm, function, return_address, result) != 0) {
+    return -1;
+  }
+  
+  vm->pc = vm->functions[function].entry;
+  return 0;
+}
+
+int ovm_return_from_call(OrionVM* vm) {
+  const VMFrame* frame = ovm_pop_frame(vm);
+  if (!frame) {
+    ovm_error(vm, "Return without a call");
+    return -1;
+  }
+  vm->pc = frame->return_address;
+  if (frame->result == OVM_NO_VARIABLE) return 0;
+  
+  // Calls produce words; a function returning nothing produces 0
+  VMVariable* result = result_variable(vm, frame->result);
+  if (!result) return -1;
+  static const VMValue nothing = { .i64 = 0 };
+  bool returned = vm->return_value.is_initialized;
+  if (assign_value(vm, result, returned ? vm->return_value.type : ORIONPP_TYPE_WORD,
+                   returned ? &vm->return_value.value : &nothing) != 0) {
+    ovm_error(vm, "Incompatible return value for variable %u", frame->result);
+    return -1;
+  }
+  return 0;
+}
+
+// Operands of the ABI instructions that move a value: an index, then a variable
+static int extract_abi_operands(OrionVM* vm, const orinopp_instruction_t* instr, const char* what,
+                                size_t* index, orionpp_variable_id_t* id) {
+  int64_t value;
+  if (instr->value_count < 2 || ovm_extract_integer(&instr->values[0], &value) != 0 ||
+      ovm_extract_variable_id(&instr->values[1], id) != 0) {
+    ovm_error(vm, "Invalid operands in %s instruction", what);
+    return -1;
+  }
+  if (value < 0 || value >= OVM_MAX_CALL_ARGS) {
+    ovm_error(vm, "Index %lld out of range in %s instruction", (long long)value, what);
+    return -1;
+  }
+  
+  *index = (size_t)value;
+  return 0;
+}
+
+int ovm_exec_abi(OrionVM* vm, const orinopp_instruction_t* instr) {
+  size_t index;
+  orionpp_variable_id_t id;
+  
+  switch (instr->child) {
+    case OVM_ABI_CALLER_SETUP:
+      vm->call_stack[vm->call_depth].arg_count = 0;
+      return 0;
+  
+    case OVM_ABI_CALLER_ARG: {
+      // Collected in the frame the next call will use, read when it is made
+      if (extract_abi_operands(vm, instr, "CALLER_ARG", &index, &id) != 0) return -1;
+      VMFrame* next = &vm->call_stack[vm->call_depth];
+      for (size_t i = next->arg_count; i < index; i++) {
+        next->arg_ids[i] = OVM_NO_VARIABLE;
+      }
+      next->arg_ids[index] = id;
+      if (index >= next->arg_count) next->arg_count = index + 1;
+      return 0;
+    }
+  
+    case OVM_ABI_CALLEE_ARG: {
+      if (extract_abi_operands(vm, instr, "CALLEE_ARG", &index, &id) != 0) return -1;
+      if (vm->call_depth == 0) {
+        ovm_error(vm, "CALLEE_ARG outside of a call");
+        return -1;
+      }
+      const VMFrame* frame = &vm->call_stack[vm->call_depth - 1];
+      if (index >= frame->arg_count) {
+        ovm_error(vm, "Argument %zu was not passed", index);
+        return -1;
+      }
+      VMVariable* param = result_variable(vm, id);
+      if (!param) return -1;
+      if (assign_value(vm, param, frame->arg_types[index], &frame->args[index]) != 0) {
+        ovm_error(vm, "Incompatible argument %zu for parameter %u", index, id);
+        return -1;
+      }
+      return 0;
+    }
+  
+    case OVM_ABI_CALLER_RET: {
+      if (extract_abi_operands(vm, instr, "CALLER_RET", &index, &id) != 0) return -1;
+      if (index != 0 || !vm->return_value.is_initialized) {
+        ovm_error(vm, "No return value %zu to store", index);
+        return -1;
+      }
+      VMVariable* dest = result_variable(vm, id);
+      if (!dest) return -1;
+      if (assign_value(vm, dest, vm->return_value.type, &vm->return_value.value) != 0) {
+        ovm_error(vm, "Incompatible return value for variable %u", id);
+        return -1;
+      }
+      return 0;
+    }
+  
+    case OVM_ABI_CALLEE_RET: {
+      if (extract_abi_operands(vm, instr, "CALLEE_RET", &index, &id) != 0) return -1;
+      VMVariable* var = ovm_get_variable(vm, id);
+      if (index != 0 || !var || !var->is_initialized) {
+        ovm_error(vm, "Invalid return value %zu", index);
+        return -1;
+      }
+      ovm_set_return_value(vm, var);
+      return 0;
+    }
+  
+    default:
+      // Setups and cleanups of the callee, variadic arguments
+      return 0;
+  }
+}
+
 // Arithmetic operations (keeping existing implementations)
 int ovm_exec_add(OrionVM* vm, const orinopp_instruction_t* instr) {
   if (instr->value_count < 3) {
@@ -700,7 +875,7 @@ int ovm_exec_add(OrionVM* vm, const orinopp_instruction_t* instr) {
     return -1;
   }
   
-  dest->value.i64 = left->value.i64 + right->value.i64;
+  VALUE(dest).i64 = VALUE(left).i64 + VALUE(right).i64;
   dest->is_initialized = true;
   return 0;
 }
@@ -734,7 +909,7 @@ int ovm_exec_sub(OrionVM* vm, const orinopp_instruction_t* instr) {
     return -1;
   }
   
-  dest->value.i64 = left->value.i64 - right->value.i64;
+  VALUE(dest).i64 = VALUE(left).i64 - VALUE(right).i64;
   dest->is_initialized = true;
   return 0;
 }
@@ -768,7 +943,7 @@ int ovm_exec_mul(OrionVM* vm, const orinopp_instruction_t* instr) {
     return -1;
   }
   
-  dest->value.i64 = left->value.i64 * right->value.i64;
+  VALUE(dest).i64 = VALUE(left).i64 * VALUE(right).i64;
   dest->is_initialized = true;
   return 0;
 }
@@ -802,12 +977,16 @@ int ovm_exec_div(OrionVM* vm, const orinopp_instruction_t* instr) {
     return -1;
   }
   
-  if (right->value.i64 == 0) {
+  if (VALUE(right).i64 == 0) {
     ovm_error(vm, "Division by zero");
     return -1;
   }
   
-  dest->value.i64 = left->value.i64 / right->value.i64;
+  if (ovm_is_unsigned_operation(left->type, right->type)) {
+    VALUE(dest).u64 = VALUE(left).u64 / VALUE(right).u64;
+  } else {
+    VALUE(dest).i64 = VALUE(left).i64 / VALUE(right).i64;
+  }
   dest->is_initialized = true;
   return 0;
 }
@@ -841,12 +1020,16 @@ int ovm_exec_mod(OrionVM* vm, const orinopp_instruction_t* instr) {
     return -1;
   }
   
-  if (right->value.i64 == 0) {
+  if (VALUE(right).i64 == 0) {
     ovm_error(vm, "Division by zero in modulo operation");
     return -1;
   }
   
-  dest->value.i64 = left->value.i64 % right->value.i64;
+  if (ovm_is_unsigned_operation(left->type, right->type)) {
+    VALUE(dest).u64 = VALUE(left).u64 % VALUE(right).u64;
+  } else {
+    VALUE(dest).i64 = VALUE(left).i64 % VALUE(right).i64;
+  }
   dest->is_initialized = true;
   return 0;
 }
@@ -878,7 +1061,7 @@ int ovm_exec_inc(OrionVM* vm, const orinopp_instruction_t* instr) {
     return -1;
   }
   
-  dest->value.i64 = operand->value.i64 + 1;
+  VALUE(dest).i64 = VALUE(operand).i64 + 1;
   dest->is_initialized = true;
   return 0;
 }
@@ -910,7 +1093,7 @@ int ovm_exec_dec(OrionVM* vm, const orinopp_instruction_t* instr) {
     return -1;
   }
   
-  dest->value.i64 = operand->value.i64 - 1;
+  VALUE(dest).i64 = VALUE(operand).i64 - 1;
   dest->is_initialized = true;
   return 0;
 }
@@ -943,8 +1126,8 @@ int ovm_exec_incp(OrionVM* vm, const orinopp_instruction_t* instr) {
     return -1;
   }
   
-  dest->value.i64 = operand->value.i64;
-  operand->value.i64++;
+  VALUE(dest).i64 = VALUE(operand).i64;
+  VALUE(operand).i64++;
   dest->is_initialized = true;
   return 0;
 }
@@ -977,8 +1160,8 @@ int ovm_exec_decp(OrionVM* vm, const orinopp_instruction_t* instr) {
     return -1;
   }
   
-  dest->value.i64 = operand->value.i64;
-  operand->value.i64--;
+  VALUE(dest).i64 = VALUE(operand).i64;
+  VALUE(operand).i64--;
   dest->is_initialized = true;
   return 0;
 }
@@ -1012,7 +1195,7 @@ int ovm_exec_and(OrionVM* vm, const orinopp_instruction_t* instr) {
     return -1;
   }
   
-  dest->value.i64 = left->value.i64 & right->value.i64;
+  VALUE(dest).i64 = VALUE(left).i64 & VALUE(right).i64;
   dest->is_initialized = true;
   return 0;
 }
@@ -1046,7 +1229,7 @@ int ovm_exec_or(OrionVM* vm, const orinopp_instruction_t* instr) {
     return -1;
   }
   
-  dest->value.i64 = left->value.i64 | right->value.i64;
+  VALUE(dest).i64 = VALUE(left).i64 | VALUE(right).i64;
   dest->is_initialized = true;
   return 0;
 }
@@ -1080,7 +1263,7 @@ int ovm_exec_xor(OrionVM* vm, const orinopp_instruction_t* instr) {
     return -1;
   }
   
-  dest->value.i64 = left->value.i64 ^ right->value.i64;
+  VALUE(dest).i64 = VALUE(left).i64 ^ VALUE(right).i64;
   dest->is_initialized = true;
   return 0;
 }
@@ -1112,7 +1295,7 @@ int ovm_exec_not(OrionVM* vm, const orinopp_instruction_t* instr) {
     return -1;
   }
   
-  dest->value.i64 = ~operand->value.i64;
+  VALUE(dest).i64 = ~VALUE(operand).i64;
   dest->is_initialized = true;
   return 0;
 }
@@ -1146,7 +1329,7 @@ int ovm_exec_shl(OrionVM* vm, const orinopp_instruction_t* instr) {
     return -1;
   }
   
-  dest->value.i64 = left->value.i64 << right->value.i64;
+  VALUE(dest).i64 = VALUE(left).i64 << VALUE(right).i64;
   dest->is_initialized = true;
   return 0;
 }
@@ -1180,7 +1363,11 @@ int ovm_exec_shr(OrionVM* vm, const orinopp_instruction_t* instr) {
     return -1;
   }
   
-  dest->value.i64 = left->value.i64 >> right->value.i64;
+  if (ovm_is_unsigned_operation(left->type, right->type)) {
+    VALUE(dest).u64 = VALUE(left).u64 >> VALUE(right).i64;
+  } else {
+    VALUE(dest).i64 = VALUE(left).i64 >> VALUE(right).i64;
+  }
   dest->is_initialized = true;
   return 0;
 }
@@ -1252,20 +1439,22 @@ int ovm_compare_variables(OrionVM* vm, VMVariable* left, VMVariable* right, int*
     case ORIONPP_TYPE_WORD:
     case ORIONPP_TYPE_SIZE:
     case ORIONPP_TYPE_C:
-      if (left->value.i64 < right->value.i64) {
+      if (ovm_is_unsigned_operation(left->type, right->type)) {
+        *result = (VALUE(left).u64 > VALUE(right).u64) - (VALUE(left).u64 < VALUE(right).u64);
+      } else if (VALUE(left).i64 < VALUE(right).i64) {
         *result = -1;
-      } else if (left->value.i64 > right->value.i64) {
+      } else if (VALUE(left).i64 > VALUE(right).i64) {
         *result = 1;
       } else {
         *result = 0;
       }
       break;
     case ORIONPP_TYPE_STRING:
-      if (left->value.str && right->value.str) {
-        *result = strcmp(left->value.str, right->value.str);
-      } else if (left->value.str) {
+      if (VALUE(left).str && VALUE(right).str) {
+        *result = strcmp(VALUE(left).str, VALUE(right).str);
+      } else if (VALUE(left).str) {
         *result = 1;
-      } else if (right->value.str) {
+      } else if (VALUE(right).str) {
         *result = -1;
       } else {
         *result = 0;
@@ -1313,42 +1502,54 @@ int ovm_perform_binary_op(OrionVM* vm, VMVariable* dest, VMVariable* left, VMVar
   
   switch (op) {
     case ORIONPP_OP_ISA_ADD:
-      dest->value.i64 = left->value.i64 + right->value.i64;
+      VALUE(dest).i64 = VALUE(left).i64 + VALUE(right).i64;
       break;
     case ORIONPP_OP_ISA_SUB:
-      dest->value.i64 = left->value.i64 - right->value.i64;
+      VALUE(dest).i64 = VALUE(left).i64 - VALUE(right).i64;
       break;
     case ORIONPP_OP_ISA_MUL:
-      dest->value.i64 = left->value.i64 * right->value.i64;
+      VALUE(dest).i64 = VALUE(left).i64 * VALUE(right).i64;
       break;
     case ORIONPP_OP_ISA_DIV:
-      if (right->value.i64 == 0) {
+      if (VALUE(right).i64 == 0) {
         ovm_error(vm, "Division by zero");
         return -1;
       }
-      dest->value.i64 = left->value.i64 / right->value.i64;
+      if (ovm_is_unsigned_operation(left->type, right->type)) {
+        VALUE(dest).u64 = VALUE(left).u64 / VALUE(right).u64;
+      } else {
+        VALUE(dest).i64 = VALUE(left).i64 / VALUE(right).i64;
+      }
       break;
     case ORIONPP_OP_ISA_MOD:
-      if (right->value.i64 == 0) {
+      if (VALUE(right).i64 == 0) {
         ovm_error(vm, "Division by zero in modulo");
         return -1;
       }
-      dest->value.i64 = left->value.i64 % right->value.i64;
+      if (ovm_is_unsigned_operation(left->type, right->type)) {
+        VALUE(dest).u64 = VALUE(left).u64 % VALUE(right).u64;
+      } else {
+        VALUE(dest).i64 = VALUE(left).i64 % VALUE(right).i64;
+      }
       break;
     case ORIONPP_OP_ISA_AND:
-      dest->value.i64 = left->value.i64 & right->value.i64;
+      VALUE(dest).i64 = VALUE(left).i64 & VALUE(right).i64;
       break;
     case ORIONPP_OP_ISA_OR:
-      dest->value.i64 = left->value.i64 | right->value.i64;
+      VALUE(dest).i64 = VALUE(left).i64 | VALUE(right).i64;
       break;
     case ORIONPP_OP_ISA_XOR:
-      dest->value.i64 = left->value.i64 ^ right->value.i64;
+      VALUE(dest).i64 = VALUE(left).i64 ^ VALUE(right).i64;
       break;
     case ORIONPP_OP_ISA_SHL:
-      dest->value.i64 = left->value.i64 << right->value.i64;
+      VALUE(dest).i64 = VALUE(left).i64 << VALUE(right).i64;
       break;
     case ORIONPP_OP_ISA_SHR:
-      dest->value.i64 = left->value.i64 >> right->value.i64;
+      if (ovm_is_unsigned_operation(left->type, right->type)) {
+        VALUE(dest).u64 = VALUE(left).u64 >> VALUE(right).i64;
+      } else {
+        VALUE(dest).i64 = VALUE(left).i64 >> VALUE(right).i64;
+      }
       break;
     default:
       ovm_error(vm, "Unsupported binary operation");
@@ -1369,21 +1570,21 @@ int ovm_perform_unary_op(OrionVM* vm, VMVariable* dest, VMVariable* operand, ori
   
   switch (op) {
     case ORIONPP_OP_ISA_NOT:
-      dest->value.i64 = ~operand->value.i64;
+      VALUE(dest).i64 = ~VALUE(operand).i64;
       break;
     case ORIONPP_OP_ISA_INC:
-      dest->value.i64 = operand->value.i64 + 1;
+      VALUE(dest).i64 = VALUE(operand).i64 + 1;
       break;
     case ORIONPP_OP_ISA_DEC:
-      dest->value.i64 = operand->value.i64 - 1;
+      VALUE(dest).i64 = VALUE(operand).i64 - 1;
       break;
     case ORIONPP_OP_ISA_INCp:
-      dest->value.i64 = operand->value.i64;
-      operand->value.i64++;
+      VALUE(dest).i64 = VALUE(operand).i64;
+      VALUE(operand).i64++;
       break;
     case ORIONPP_OP_ISA_DECp:
-      dest->value.i64 = operand->value.i64;
-      operand->value.i64--;
+      VALUE(dest).i64 = VALUE(operand).i64;
+      VALUE(operand).i64--;
       break;
     default:
       ovm_error(vm, "Unsupported unary operation");
@@ -1394,8 +1595,8 @@ int ovm_perform_unary_op(OrionVM* vm, VMVariable* dest, VMVariable* operand, ori
   return 0;
 }
 
-int ovm_convert_value(VMVariable* dest, const VMVariable* src, orionpp_type_t target_type) {
-  if (!dest || !src || !src->is_initialized) return -1;
+int ovm_convert_value(OrionVM* vm, VMVariable* dest, const VMVariable* src, orionpp_type_t target_type) {
+  if (!vm || !dest || !src || !src->is_initialized) return -1;
   
   // Simple type conversion
   if (src->type == target_type) {
@@ -1404,11 +1605,11 @@ int ovm_convert_value(VMVariable* dest, const VMVariable* src, orionpp_type_t ta
       case ORIONPP_TYPE_WORD:
       case ORIONPP_TYPE_SIZE:
       case ORIONPP_TYPE_C:
-        dest->value.i64 = src->value.i64;
+        VALUE(dest).i64 = VALUE(src).i64;
         break;
       case ORIONPP_TYPE_STRING:
-        if (dest->value.str) free(dest->value.str);
-        dest->value.str = src->value.str ? strdup(src->value.str) : NULL;
+        if (VALUE(dest).str) free(VALUE(dest).str);
+        VALUE(dest).str = VALUE(src).str ? strdup(VALUE(src).str) : NULL;
         break;
       default:
         return -1;
@@ -1419,7 +1620,7 @@ int ovm_convert_value(VMVariable* dest, const VMVariable* src, orionpp_type_t ta
   
   // Basic type conversions
   if (ovm_is_numeric_type(src->type) && ovm_is_numeric_type(target_type)) {
-    dest->value.i64 = src->value.i64;
+    VALUE(dest).i64 = VALUE(src).i64;
     dest->is_initialized = true;
     return 0;
   }
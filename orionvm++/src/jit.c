@@ -0,0 +1,678 @@
+/**
+ * @file src/jit.c
+ * @brief Baseline x86-64 compiler for the integer subset of decoded programs
+ */
+
+#ifndef WIN32
+  #define _DEFAULT_SOURCE // MAP_ANONYMOUS
+#endif
+
+#include "jit.h"
+#include "executor.h"
+#include "validator.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef OVM_JIT
+  #include <sys/mman.h>
+  #include <unistd.h>
+#endif
+
+int ovm_set_jit(OrionVM* vm, VMJitMode mode) {
+  if (!vm) return -1;
+#ifndef OVM_JIT
+  if (mode != OVM_JIT_OFF) {
+    ovm_error(vm, "The JIT is not available in this build");
+    return -1;
+  }
+#endif
+  if (mode != OVM_JIT_OFF && vm->program) {
+    ovm_error(vm, "Cannot compile a VM attached to a shared program image");
+    return -1;
+  }
+
+  if (mode != vm->jit_mode && vm->jit) {
+    // Handlers still point at the old code
+    ovm_jit_free(vm->jit);
+    vm->jit = NULL;
+    vm->decoded_threaded = false;
+  }
+  vm->jit_mode = mode;
+  return 0;
+}
+
+#ifdef OVM_JIT
+
+// Upper bound on the bytes one record compiles to, its fall-through exit included
+#define JIT_MAX_RECORD_SIZE 96
+
+// Registers the templates use. Everything stays in caller-saved registers and
+// nothing touches the stack, so the code of any record is a valid entry point.
+// RDI holds the values and RSI the variables, both indexed by id.
+enum { RAX = 0, RCX = 1, RDX = 2, RSI = 6, RDI = 7 };
+
+// Condition codes of Jcc; flipping the low bit negates one
+enum {
+  CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6, CC_A = 0x7,
+  CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF
+};
+
+#define VALUE_AT(id) ((int32_t)((id) * sizeof(VMValue)))
+#define DECLARED_AT(id) ((int32_t)((id) * sizeof(VMVariable) + offsetof(VMVariable, is_declared)))
+#define INITIALIZED_AT(id) ((int32_t)((id) * sizeof(VMVariable) + offsetof(VMVariable, is_initialized)))
+
+typedef struct {
+  unsigned char* code;
+  size_t size;
+  size_t* offsets; // native offset by decoded index
+  size_t* fixups; // rel32 fields still to point at fixup_targets
+  size_t* fixup_targets;
+  size_t fixup_count;
+} JitBuffer;
+
+static void emit_byte(JitBuffer* b, unsigned char byte) {
+  b->code[b->size++] = byte;
+}
+
+static void emit_bytes(JitBuffer* b, const unsigned char* bytes, size_t count) {
+  memcpy(b->code + b->size, bytes, count);
+  b->size += count;
+}
+
+static void emit_u32(JitBuffer* b, uint32_t value) {
+  memcpy(b->code + b->size, &value, sizeof(value));
+  b->size += sizeof(value);
+}
+
+static void emit_u64(JitBuffer* b, uint64_t value) {
+  memcpy(b->code + b->size, &value, sizeof(value));
+  b->size += sizeof(value);
+}
+
+// ModRM for [base + disp32]; none of the bases used needs a SIB byte
+static void emit_memory(JitBuffer* b, int reg, int base, int32_t disp) {
+  emit_byte(b, (unsigned char)(0x80 | (reg << 3) | base));
+  emit_u32(b, (uint32_t)disp);
+}
+
+// mov reg, [base + disp]
+static void emit_load(JitBuffer* b, int reg, int base, int32_t disp) {
+  emit_bytes(b, (const unsigned char[]){ 0x48, 0x8B }, 2);
+  emit_memory(b, reg, base, disp);
+}
+
+// mov [base + disp], reg
+static void emit_store(JitBuffer* b, int base, int32_t disp, int reg) {
+  emit_bytes(b, (const unsigned char[]){ 0x48, 0x89 }, 2);
+  emit_memory(b, reg, base, disp);
+}
+
+// reg = values[id].i64
+static void emit_load_value(JitBuffer* b, int reg, orionpp_variable_id_t id) {
+  emit_load(b, reg, RDI, VALUE_AT(id));
+}
+
+// values[id].i64 = rax, and marks the variable initialized
+static void emit_store_rax(JitBuffer* b, orionpp_variable_id_t id) {
+  emit_store(b, RDI, VALUE_AT(id), RAX);
+  emit_byte(b, 0xC6); // mov byte [rsi + disp], 1
+  emit_memory(b, 0, RSI, INITIALIZED_AT(id));
+  emit_byte(b, 1);
+}
+
+// mov eax, index; ret
+static void emit_exit(JitBuffer* b, size_t index) {
+  emit_byte(b, 0xB8);
+  emit_u32(b, (uint32_t)index);
+  emit_byte(b, 0xC3);
+}
+
+// Returns index unless the flags satisfy cc
+static void emit_exit_unless(JitBuffer* b, int cc, size_t index) {
+  emit_byte(b, (unsigned char)(0x70 | cc));
+  emit_byte(b, 6); // over the exit
+  emit_exit(b, index);
+}
+
+static void emit_fixup(JitBuffer* b, size_t target) {
+  b->fixups[b->fixup_count] = b->size;
+  b->fixup_targets[b->fixup_count++] = target;
+  emit_u32(b, 0);
+}
+
+// Jumps to target when the flags satisfy cc, natively if target was compiled
+static void emit_branch(JitBuffer* b, const bool* compiled, int cc, size_t target) {
+  if (compiled[target]) {
+    emit_bytes(b, (const unsigned char[]){ 0x0F, (unsigned char)(0x80 | cc) }, 2);
+    emit_fixup(b, target);
+  } else {
+    emit_exit_unless(b, cc ^ 1, target);
+  }
+}
+
+static void emit_jump(JitBuffer* b, const bool* compiled, size_t target) {
+  if (compiled[target]) {
+    emit_byte(b, 0xE9);
+    emit_fixup(b, target);
+  } else {
+    emit_exit(b, target);
+  }
+}
+
+// is_unsigned picks the unsigned forms of the ops that have them
+static void emit_record(JitBuffer* b, const bool* compiled, const VMDecodedInstr* d, size_t index, bool is_unsigned) {
+  switch (d->op) {
+    case OVM_DOP_NOP:
+      break;
+    case OVM_DOP_CONST:
+      // The interpreter creates the variable on its first CONST
+      emit_byte(b, 0x80); // cmp byte [rsi + disp], 0
+      emit_memory(b, 7, RSI, DECLARED_AT(d->a));
+      emit_byte(b, 0);
+      emit_exit_unless(b, CC_NE, index);
+      emit_bytes(b, (const unsigned char[]){ 0x48, 0xB8 }, 2); // mov rax, imm64
+      emit_u64(b, (uint64_t)d->imm);
+      emit_store_rax(b, d->a);
+      break;
+    case OVM_DOP_MOV:
+      emit_load_value(b, RAX, d->b);
+      emit_store_rax(b, d->a);
+      break;
+    case OVM_DOP_JMP:
+      emit_jump(b, compiled, d->target);
+      break;
+    case OVM_DOP_BREQ:
+    case OVM_DOP_BRNEQ:
+    case OVM_DOP_BRGT:
+    case OVM_DOP_BRGE:
+    case OVM_DOP_BRLT:
+    case OVM_DOP_BRLE: {
+      static const int conditions[] = { CC_E, CC_NE, CC_G, CC_GE, CC_L, CC_LE };
+      static const int unsigned_conditions[] = { CC_E, CC_NE, CC_A, CC_AE, CC_B, CC_BE };
+      emit_load_value(b, RAX, d->a);
+      emit_load_value(b, RCX, d->b);
+      emit_bytes(b, (const unsigned char[]){ 0x48, 0x39, 0xC8 }, 3); // cmp rax, rcx
+      emit_branch(b, compiled, (is_unsigned ? unsigned_conditions : conditions)[d->op - OVM_DOP_BREQ], d->target);
+      break;
+    }
+    case OVM_DOP_BRZ:
+    case OVM_DOP_BRNZ:
+      emit_load_value(b, RAX, d->a);
+      emit_bytes(b, (const unsigned char[]){ 0x48, 0x85, 0xC0 }, 3); // test rax, rax
+      emit_branch(b, compiled, d->op == OVM_DOP_BRZ ? CC_E : CC_NE, d->target);
+      break;
+    case OVM_DOP_ADD:
+    case OVM_DOP_SUB:
+    case OVM_DOP_MUL:
+    case OVM_DOP_AND:
+    case OVM_DOP_OR:
+    case OVM_DOP_XOR:
+    case OVM_DOP_SHL:
+    case OVM_DOP_SHR:
+      emit_load_value(b, RAX, d->b);
+      emit_load_value(b, RCX, d->c);
+      switch (d->op) {
+        case OVM_DOP_ADD: emit_bytes(b, (const unsigned char[]){ 0x48, 0x01, 0xC8 }, 3); break; // add rax, rcx
+        case OVM_DOP_SUB: emit_bytes(b, (const unsigned char[]){ 0x48, 0x29, 0xC8 }, 3); break; // sub rax, rcx
+        case OVM_DOP_MUL: emit_bytes(b, (const unsigned char[]){ 0x48, 0x0F, 0xAF, 0xC1 }, 4); break; // imul rax, rcx
+        case OVM_DOP_AND: emit_bytes(b, (const unsigned char[]){ 0x48, 0x21, 0xC8 }, 3); break; // and rax, rcx
+        case OVM_DOP_OR: emit_bytes(b, (const unsigned char[]){ 0x48, 0x09, 0xC8 }, 3); break; // or rax, rcx
+        case OVM_DOP_XOR: emit_bytes(b, (const unsigned char[]){ 0x48, 0x31, 0xC8 }, 3); break; // xor rax, rcx
+        case OVM_DOP_SHL: emit_bytes(b, (const unsigned char[]){ 0x48, 0xD3, 0xE0 }, 3); break; // shl rax, cl
+        default:
+          if (is_unsigned) emit_bytes(b, (const unsigned char[]){ 0x48, 0xD3, 0xE8 }, 3); // shr rax, cl
+          else emit_bytes(b, (const unsigned char[]){ 0x48, 0xD3, 0xF8 }, 3); // sar rax, cl
+          break;
+      }
+      emit_store_rax(b, d->a);
+      break;
+    case OVM_DOP_DIV:
+    case OVM_DOP_MOD:
+      emit_load_value(b, RAX, d->b);
+      emit_load_value(b, RCX, d->c);
+      // The interpreter reports division by zero
+      emit_bytes(b, (const unsigned char[]){ 0x48, 0x85, 0xC9 }, 3); // test rcx, rcx
+      emit_exit_unless(b, CC_NE, index);
+      if (is_unsigned) emit_bytes(b, (const unsigned char[]){ 0x31, 0xD2, 0x48, 0xF7, 0xF1 }, 5); // xor edx, edx; div rcx
+      else emit_bytes(b, (const unsigned char[]){ 0x48, 0x99, 0x48, 0xF7, 0xF9 }, 5); // cqo; idiv rcx
+      if (d->op == OVM_DOP_MOD) emit_bytes(b, (const unsigned char[]){ 0x48, 0x89, 0xD0 }, 3); // mov rax, rdx
+      emit_store_rax(b, d->a);
+      break;
+    case OVM_DOP_INC:
+    case OVM_DOP_DEC:
+    case OVM_DOP_NOT:
+      emit_load_value(b, RAX, d->b);
+      if (d->op == OVM_DOP_INC) emit_bytes(b, (const unsigned char[]){ 0x48, 0x83, 0xC0, 0x01 }, 4); // add rax, 1
+      else if (d->op == OVM_DOP_DEC) emit_bytes(b, (const unsigned char[]){ 0x48, 0x83, 0xE8, 0x01 }, 4); // sub rax, 1
+      else emit_bytes(b, (const unsigned char[]){ 0x48, 0xF7, 0xD0 }, 3); // not rax
+      emit_store_rax(b, d->a);
+      break;
+    case OVM_DOP_INCP:
+    case OVM_DOP_DECP:
+      // dest takes the old value, then the operand steps in place
+      emit_load_value(b, RAX, d->b);
+      emit_store_rax(b, d->a);
+      emit_bytes(b, (const unsigned char[]){ 0x48, 0x83 }, 2); // add/sub qword [rdi + disp], 1
+      emit_memory(b, d->op == OVM_DOP_INCP ? 0 : 5, RDI, VALUE_AT(d->b));
+      emit_byte(b, 1);
+      break;
+    default:
+      break;
+  }
+}
+
+static bool is_integer_type(orionpp_type_t type) {
+  return type == ORIONPP_TYPE_WORD || type == ORIONPP_TYPE_SIZE || type == ORIONPP_TYPE_C;
+}
+
+// Variables every VAR and CONST declares with an integer type, so that the
+// handlers reduce to plain 64-bit arithmetic on the values
+static bool* find_integer_variables(const OrionVM* vm) {
+  bool* integer = calloc(OVM_MAX_VARIABLES, sizeof(bool));
+  bool* other = calloc(OVM_MAX_VARIABLES, sizeof(bool));
+  if (!integer || !other) {
+    free(integer);
+    free(other);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < vm->decoded_count; i++) {
+    const VMDecodedInstr* d = &vm->decoded[i];
+    if ((d->op != OVM_DOP_VAR && d->op != OVM_DOP_CONST) || d->a >= OVM_MAX_VARIABLES) continue;
+    if (is_integer_type(d->type)) integer[d->a] = true;
+    else other[d->a] = true;
+  }
+  for (size_t id = 0; id < OVM_MAX_VARIABLES; id++) {
+    if (other[id]) integer[id] = false;
+  }
+
+  free(other);
+  return integer;
+}
+
+static bool is_compilable(const VMDecodedInstr* d, const bool* integer) {
+  #define INTEGER(id) ((id) < OVM_MAX_VARIABLES && integer[(id)])
+  switch (d->op) {
+    case OVM_DOP_NOP:
+    case OVM_DOP_JMP:
+      return true;
+    case OVM_DOP_CONST:
+    case OVM_DOP_BRZ:
+    case OVM_DOP_BRNZ:
+      return INTEGER(d->a);
+    case OVM_DOP_MOV:
+    case OVM_DOP_BREQ:
+    case OVM_DOP_BRNEQ:
+    case OVM_DOP_BRGT:
+    case OVM_DOP_BRGE:
+    case OVM_DOP_BRLT:
+    case OVM_DOP_BRLE:
+    case OVM_DOP_INC:
+    case OVM_DOP_DEC:
+    case OVM_DOP_INCP:
+    case OVM_DOP_DECP:
+    case OVM_DOP_NOT:
+      return INTEGER(d->a) && INTEGER(d->b);
+    case OVM_DOP_ADD:
+    case OVM_DOP_SUB:
+    case OVM_DOP_MUL:
+    case OVM_DOP_DIV:
+    case OVM_DOP_MOD:
+    case OVM_DOP_AND:
+    case OVM_DOP_OR:
+    case OVM_DOP_XOR:
+    case OVM_DOP_SHL:
+    case OVM_DOP_SHR:
+      return INTEGER(d->a) && INTEGER(d->b) && INTEGER(d->c);
+    default:
+      return false;
+  }
+  #undef INTEGER
+}
+
+// is_compilable for the checked handlers, on the types the variables have now.
+// Operands must exist and be initialized, and their types must also pass the
+// checks the handlers make.
+static bool is_speculable(const VMDecodedInstr* d, const VMVariable* variables) {
+  #define TYPE(id) (variables[(id)].type)
+  #define INTEGER(id) \
+    ((id) < OVM_MAX_VARIABLES && variables[(id)].is_declared && variables[(id)].is_initialized && is_integer_type(TYPE(id)))
+  switch (d->op) {
+    case OVM_DOP_NOP:
+    case OVM_DOP_JMP:
+      return true;
+    case OVM_DOP_CONST:
+    case OVM_DOP_BRZ:
+    case OVM_DOP_BRNZ:
+      return INTEGER(d->a);
+    case OVM_DOP_MOV:
+    case OVM_DOP_BREQ:
+    case OVM_DOP_BRNEQ:
+    case OVM_DOP_BRGT:
+    case OVM_DOP_BRGE:
+    case OVM_DOP_BRLT:
+    case OVM_DOP_BRLE:
+      return INTEGER(d->a) && INTEGER(d->b) && ovm_types_compatible(TYPE(d->a), TYPE(d->b));
+    case OVM_DOP_INC:
+    case OVM_DOP_DEC:
+    case OVM_DOP_INCP:
+    case OVM_DOP_DECP:
+    case OVM_DOP_NOT:
+      return INTEGER(d->a) && INTEGER(d->b);
+    case OVM_DOP_ADD:
+    case OVM_DOP_SUB:
+    case OVM_DOP_MUL:
+    case OVM_DOP_DIV:
+    case OVM_DOP_MOD:
+    case OVM_DOP_AND:
+    case OVM_DOP_OR:
+    case OVM_DOP_XOR:
+    case OVM_DOP_SHL:
+    case OVM_DOP_SHR:
+      return INTEGER(d->a) && INTEGER(d->b) && INTEGER(d->c) && ovm_types_compatible(TYPE(d->b), TYPE(d->c));
+    default:
+      return false;
+  }
+  #undef INTEGER
+  #undef TYPE
+}
+
+// Number of variable operands each op reads or writes, in a, b, c order
+static size_t operand_count(VMDecodedOp op) {
+  switch (op) {
+    case OVM_DOP_CONST: case OVM_DOP_BRZ: case OVM_DOP_BRNZ:
+      return 1;
+    case OVM_DOP_MOV: case OVM_DOP_BREQ: case OVM_DOP_BRNEQ: case OVM_DOP_BRGT:
+    case OVM_DOP_BRGE: case OVM_DOP_BRLT: case OVM_DOP_BRLE: case OVM_DOP_INC:
+    case OVM_DOP_DEC: case OVM_DOP_INCP: case OVM_DOP_DECP: case OVM_DOP_NOT:
+      return 2;
+    case OVM_DOP_ADD: case OVM_DOP_SUB: case OVM_DOP_MUL: case OVM_DOP_DIV: case OVM_DOP_MOD:
+    case OVM_DOP_AND: case OVM_DOP_OR: case OVM_DOP_XOR: case OVM_DOP_SHL: case OVM_DOP_SHR:
+      return 3;
+    default:
+      return 0;
+  }
+}
+
+// Whether the record runs the unsigned form of its op: by the type stamped on
+// it at decode for verified programs, by the variables' types otherwise
+static bool is_unsigned_record(const VMDecodedInstr* d, const VMVariable* variables) {
+  if (!variables) return d->type == ORIONPP_TYPE_SIZE;
+  bool compare = d->op >= OVM_DOP_BREQ && d->op <= OVM_DOP_BRLE;
+  return ovm_is_unsigned_operation(variables[compare ? d->a : d->b].type, variables[compare ? d->b : d->c].type);
+}
+
+static bool reserve_region(VMJit* jit) {
+  VMJitRegion* regions = realloc(jit->regions, (jit->region_count + 1) * sizeof(VMJitRegion));
+  if (!regions) return false;
+  jit->regions = regions;
+  return true;
+}
+
+// Emits the records of [first, last] marked in compiled as a new region and
+// points their entries at it. The caller has reserved the region. variables
+// are the types speculated on, NULL for the declared ones.
+static bool compile_region(OrionVM* vm, VMJit* jit, const bool* compiled, size_t first, size_t last,
+                           const VMVariable* variables) {
+  size_t count = vm->decoded_count;
+  size_t record_count = 0;
+  for (size_t i = first; i <= last; i++) {
+    if (compiled[i]) record_count++;
+  }
+  if (record_count == 0) return false;
+
+  JitBuffer buffer = { 0 };
+  buffer.offsets = calloc(count, sizeof(size_t));
+  buffer.fixups = calloc(record_count, sizeof(size_t));
+  buffer.fixup_targets = calloc(record_count, sizeof(size_t));
+  if (!buffer.offsets || !buffer.fixups || !buffer.fixup_targets) goto fail;
+
+  long page = sysconf(_SC_PAGESIZE);
+  size_t page_size = page > 0 ? (size_t)page : 4096;
+  size_t size = (record_count * JIT_MAX_RECORD_SIZE + page_size - 1) / page_size * page_size;
+  void* code = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (code == MAP_FAILED) goto fail;
+  buffer.code = code;
+
+  for (size_t i = first; i <= last; i++) {
+    if (!compiled[i]) continue;
+    buffer.offsets[i] = buffer.size;
+    emit_record(&buffer, compiled, &vm->decoded[i], i, is_unsigned_record(&vm->decoded[i], variables));
+    // The last record of a run hands over to the interpreter
+    if (vm->decoded[i].op != OVM_DOP_JMP && (i + 1 > last || !compiled[i + 1])) emit_exit(&buffer, i + 1);
+  }
+  for (size_t f = 0; f < buffer.fixup_count; f++) {
+    int32_t rel = (int32_t)((int64_t)buffer.offsets[buffer.fixup_targets[f]] - (int64_t)(buffer.fixups[f] + 4));
+    memcpy(buffer.code + buffer.fixups[f], &rel, sizeof(rel));
+  }
+
+  // Write, then execute: the mapping is never both
+  if (mprotect(code, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(code, size);
+    goto fail;
+  }
+
+  uint32_t index = (uint32_t)jit->region_count++;
+  jit->regions[index] = (VMJitRegion){ .code = code, .size = size, .first = first, .last = last };
+  // Copied rather than cast, as ISO C has no object-to-function pointer conversion
+  for (size_t i = first; i <= last; i++) {
+    if (!compiled[i]) continue;
+    const unsigned char* address = buffer.code + buffer.offsets[i];
+    memcpy(&jit->entries[i], &address, sizeof(address));
+    jit->region_of[i] = index;
+  }
+
+  free(buffer.offsets);
+  free(buffer.fixups);
+  free(buffer.fixup_targets);
+  return true;
+
+fail:
+  free(buffer.offsets);
+  free(buffer.fixups);
+  free(buffer.fixup_targets);
+  return false;
+}
+
+static void drop_region(VMJitRegion* region) {
+  if (region->code) munmap(region->code, region->size);
+  free(region->guards);
+  region->code = NULL;
+  region->guards = NULL;
+  region->guard_count = 0;
+}
+
+// Drops the regions no entry points into any more, and recounts the records
+// with native code
+static void collect_regions(VMJit* jit, size_t count) {
+  bool* live = calloc(jit->region_count ? jit->region_count : 1, sizeof(bool));
+  jit->compiled_count = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (!jit->entries[i]) continue;
+    jit->compiled_count++;
+    if (live) live[jit->region_of[i]] = true;
+  }
+  if (!live) return;
+  for (size_t r = 0; r < jit->region_count; r++) {
+    if (!live[r]) drop_region(&jit->regions[r]);
+  }
+  free(live);
+}
+
+// Tables by decoded index, with the back-edge counters when tiered
+static VMJit* create_jit(OrionVM* vm, bool tiered, bool verified) {
+  // The verified handlers skip operand checks on the verifier's word, and so
+  // does native code compiled for them
+  if (!vm || !vm->decoded || (verified && !vm->verified) || vm->decoded_count > UINT32_MAX) return NULL;
+
+  size_t count = vm->decoded_count;
+  VMJit* jit = calloc(1, sizeof(VMJit));
+  if (!jit) return NULL;
+  jit->verified = verified;
+  jit->entries = calloc(count, sizeof(VMJitFunction));
+  jit->region_of = calloc(count, sizeof(uint32_t));
+  if (tiered) {
+    jit->back_edges = calloc(count, sizeof(uint32_t));
+    jit->deopts = calloc(count, sizeof(uint8_t));
+  }
+  if (!jit->entries || !jit->region_of || (tiered && (!jit->back_edges || !jit->deopts))) {
+    ovm_jit_free(jit);
+    return NULL;
+  }
+  return jit;
+}
+
+VMJit* ovm_jit_create(OrionVM* vm, bool verified) {
+  return create_jit(vm, true, verified);
+}
+
+VMJit* ovm_jit_compile(OrionVM* vm) {
+  VMJit* jit = create_jit(vm, false, true);
+  if (!jit) return NULL;
+
+  size_t count = vm->decoded_count;
+  bool* compiled = calloc(count, sizeof(bool));
+  bool* integer = find_integer_variables(vm);
+  if (!compiled || !integer || !reserve_region(jit)) goto fail;
+
+  bool any = false;
+  for (size_t i = 0; i < count; i++) {
+    compiled[i] = is_compilable(&vm->decoded[i], integer);
+    any = any || compiled[i];
+  }
+  if (any && !compile_region(vm, jit, compiled, 0, count - 1, NULL)) goto fail;
+  collect_regions(jit, count);
+
+  free(compiled);
+  free(integer);
+  return jit;
+
+fail:
+  free(compiled);
+  free(integer);
+  ovm_jit_free(jit);
+  return NULL;
+}
+
+bool ovm_jit_tier_up(OrionVM* vm, VMJit* jit, size_t index) {
+  if (!vm || !jit || !jit->back_edges || index >= vm->decoded_count) return false;
+  jit->back_edges[index] = OVM_JIT_DONE;
+
+  size_t count = vm->decoded_count;
+  size_t first = vm->decoded[index].target;
+  bool* compiled = calloc(count, sizeof(bool));
+  bool* integer = NULL;
+  bool* guarded = NULL;
+  VMJitGuard* guards = NULL;
+  size_t guard_count = 0;
+  bool added = false;
+  if (!compiled || !reserve_region(jit)) goto done;
+
+  if (jit->verified) {
+    // Every variable keeps its declared type, so the code needs no guards
+    integer = find_integer_variables(vm);
+    if (!integer) goto done;
+    for (size_t i = first; i <= index; i++) compiled[i] = is_compilable(&vm->decoded[i], integer);
+  } else {
+    // Speculate that the loop's variables keep the types they have now
+    guarded = calloc(OVM_MAX_VARIABLES, sizeof(bool));
+    if (!guarded) goto done;
+    for (size_t i = first; i <= index; i++) {
+      const VMDecodedInstr* d = &vm->decoded[i];
+      compiled[i] = is_speculable(d, vm->variables);
+      if (!compiled[i]) continue;
+      const orionpp_variable_id_t operands[3] = { d->a, d->b, d->c };
+      for (size_t k = 0; k < operand_count(d->op); k++) {
+        if (guarded[operands[k]]) continue;
+        guarded[operands[k]] = true;
+        guard_count++;
+      }
+    }
+    guards = malloc((guard_count ? guard_count : 1) * sizeof(VMJitGuard));
+    if (!guards) goto done;
+    guard_count = 0;
+    for (size_t id = 0; id < OVM_MAX_VARIABLES; id++) {
+      if (guarded[id]) guards[guard_count++] = (VMJitGuard){ .id = (orionpp_variable_id_t)id, .type = vm->variables[id].type };
+    }
+  }
+
+  if (compile_region(vm, jit, compiled, first, index, jit->verified ? NULL : vm->variables)) {
+    VMJitRegion* region = &jit->regions[jit->region_count - 1];
+    region->guards = guards;
+    region->guard_count = guard_count;
+    guards = NULL;
+    collect_regions(jit, count);
+    added = true;
+  }
+
+done:
+  free(compiled);
+  free(integer);
+  free(guarded);
+  free(guards);
+  return added;
+}
+
+void ovm_jit_deoptimize(OrionVM* vm, VMJit* jit, size_t index) {
+  if (!vm || !jit || !jit->entries[index]) return;
+
+  uint32_t dropped = jit->region_of[index];
+  VMJitRegion* region = &jit->regions[dropped];
+  for (size_t i = region->first; i <= region->last; i++) {
+    if (jit->entries[i] && jit->region_of[i] == dropped) jit->entries[i] = NULL;
+  }
+  // The loop, and the loops nested in it, count again from zero
+  if (jit->back_edges) {
+    if (jit->deopts[region->last] < UINT8_MAX) jit->deopts[region->last]++;
+    for (size_t i = region->first; i <= region->last; i++) {
+      if (!ovm_is_back_edge(vm->decoded, i) || jit->entries[i]) continue;
+      jit->back_edges[i] = jit->deopts[i] < OVM_JIT_MAX_DEOPTS ? 0 : OVM_JIT_DONE;
+    }
+  }
+  jit->deopt_count++;
+  collect_regions(jit, vm->decoded_count);
+}
+
+void ovm_jit_free(VMJit* jit) {
+  if (!jit) return;
+  for (size_t r = 0; r < jit->region_count; r++) drop_region(&jit->regions[r]);
+  free(jit->regions);
+  free(jit->entries);
+  free(jit->region_of);
+  free(jit->back_edges);
+  free(jit->deopts);
+  free(jit);
+}
+
+#else
+
+VMJit* ovm_jit_compile(OrionVM* vm) {
+  (void)vm;
+  return NULL;
+}
+
+VMJit* ovm_jit_create(OrionVM* vm, bool verified) {
+  (void)vm;
+  (void)verified;
+  return NULL;
+}
+
+bool ovm_jit_tier_up(OrionVM* vm, VMJit* jit, size_t index) {
+  (void)vm;
+  (void)jit;
+  (void)index;
+  return false;
+}
+
+void ovm_jit_deoptimize(OrionVM* vm, VMJit* jit, size_t index) {
+  (void)vm;
+  (void)jit;
+  (void)index;
+}
+
+void ovm_jit_free(VMJit* jit) {
+  (void)jit;
+}
+
+#endif // OVM_JIT
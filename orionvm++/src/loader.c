@@ -0,0 +1,324 @@
+/**
+ * @file src/loader.c
+ * @brief Memory-mapped, zero-copy loading of Orion++ program images
+ */
+
+#include "loader.h"
+#include "orionpp/header.h"
+#include "orionpp/stream.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+int ovm_map_file(file_handle_t handle, VMMappedImage* image) {
+  memset(image, 0, sizeof(*image));
+
+#ifdef WIN32
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) return -1;
+  HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!mapping) return -1;
+  void* base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping); // the view keeps the mapping alive
+  if (!base) return -1;
+  image->size = (size_t)size.QuadPart;
+#else
+  struct stat info;
+  if (fstat(handle, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) return -1;
+  void* base = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, handle, 0);
+  if (base == MAP_FAILED) return -1;
+  image->size = (size_t)info.st_size;
+#endif
+
+  image->base = base;
+  return 0;
+}
+
+int ovm_read_file(file_handle_t handle, VMMappedImage* image) {
+  memset(image, 0, sizeof(*image));
+  
+  orionpp_stream_t stream;
+  orionpp_byte_t* data = NULL;
+  size_t size = 0;
+  if (orionpp_stream_reader(&stream, handle, 0) != ORIONPP_ERROR_GOOD) return -1;
+  orionpp_error_t err = orionpp_stream_read_all(&stream, &data, &size);
+  orionpp_stream_close(&stream);
+  if (err != ORIONPP_ERROR_GOOD) return -1;
+  
+  image->base = data;
+  image->size = size;
+  image->heap = true;
+  return 0;
+}
+
+void ovm_unmap_image(VMMappedImage* image) {
+  if (!image) return;
+  
+  free(image->values);
+  if (image->heap) {
+    free(image->base);
+  } else if (image->base) {
+#ifdef WIN32
+    UnmapViewOfFile(image->base);
+#else
+    munmap(image->base, image->size);
+#endif
+  }
+  memset(image, 0, sizeof(*image));
+}
+
+bool ovm_is_image(const VMMappedImage* image) {
+  const uint8_t* bytes = image->base;
+  return bytes && image->size >= 4 &&
+         bytes[0] == ORIONPP_MAGIC0 && bytes[1] == ORIONPP_MAGIC1 &&
+         bytes[2] == ORIONPP_MAGIC2 && bytes[3] == ORIONPP_MAGIC3;
+}
+
+// Counts the records between cursor and end; fails if any of them is cut off
+static int ovm_count_code_table(const uint8_t* cursor, const uint8_t* end, orionpp_code_table_t* counts) {
+  size_t instructions = 0, values = 0;
+  while (cursor < end) {
+    if ((size_t)(end - cursor) < sizeof(orionpp_code_record_t)) return -1;
+    const orionpp_code_record_t* record = (const orionpp_code_record_t*)cursor;
+    cursor += sizeof(*record);
+  
+    for (size_t j = 0; j < record->value_count; j++) {
+      if ((size_t)(end - cursor) < sizeof(orionpp_code_value_t)) return -1;
+      const orionpp_code_value_t* value = (const orionpp_code_value_t*)cursor;
+      cursor += sizeof(*value);
+      size_t padded = ORIONPP_CODE_ALIGN((size_t)value->bytesize);
+      if (padded > (size_t)(end - cursor)) return -1;
+      cursor += padded;
+    }
+    instructions++;
+    values += record->value_count;
+  }
+  
+  if (instructions >= ORIONPP_CODE_UNCOUNTED || values >= ORIONPP_CODE_UNCOUNTED) return -1;
+  counts->instruction_count = (uint32_t)instructions;
+  counts->value_count = (uint32_t)values;
+  return 0;
+}
+
+// Walks the code table once, pointing each operand at its bytes in the mapping
+static int ovm_map_code_table(OrionVM* vm, const uint8_t* cursor, const uint8_t* end) {
+  orionpp_code_table_t counts = *(const orionpp_code_table_t*)cursor;
+  const orionpp_code_table_t* table = &counts;
+  cursor += sizeof(*table);
+  
+  // Streamed tables leave the counts open; walk the records to fill them in
+  if (counts.instruction_count == ORIONPP_CODE_UNCOUNTED) {
+    if (ovm_count_code_table(cursor, end, &counts) != 0) {
+      ovm_error(vm, "Malformed code table");
+      return -1;
+    }
+  }
+  
+  // Reject counts the file cannot possibly hold before allocating for them
+  size_t remaining = (size_t)(end - cursor);
+  if (table->instruction_count > remaining / sizeof(orionpp_code_record_t) ||
+      table->value_count > remaining / sizeof(orionpp_code_value_t)) {
+    ovm_error(vm, "Code table counts exceed image size");
+    return -1;
+  }
+  
+  size_t memory = table->instruction_count * sizeof(orinopp_instruction_t) +
+                  table->value_count * sizeof(orinopp_value_t);
+  if (vm->memory_used + memory > OVM_MAX_MEMORY_SIZE) {
+    ovm_error(vm, "Memory limit exceeded while loading program");
+    return -1;
+  }
+  
+  // One array for the instructions and one for every operand; nothing per instruction
+  if (table->instruction_count > vm->instruction_capacity) {
+    orinopp_instruction_t* instructions = realloc(vm->instructions,
+      table->instruction_count * sizeof(orinopp_instruction_t));
+    if (!instructions) {
+      ovm_error(vm, "Out of memory expanding instruction array");
+      return -1;
+    }
+    vm->instructions = instructions;
+    vm->instruction_capacity = table->instruction_count;
+  }
+  if (table->value_count > 0) {
+    vm->mapped.values = malloc(table->value_count * sizeof(orinopp_value_t));
+    if (!vm->mapped.values) {
+      ovm_error(vm, "Out of memory allocating operands");
+      return -1;
+    }
+  }
+  
+  size_t next_value = 0;
+  for (size_t i = 0; i < table->instruction_count; i++) {
+    if ((size_t)(end - cursor) < sizeof(orionpp_code_record_t)) {
+      ovm_error(vm, "Truncated code table at instruction %zu", i);
+      return -1;
+    }
+    const orionpp_code_record_t* record = (const orionpp_code_record_t*)cursor;
+    cursor += sizeof(*record);
+  
+    if (record->value_count > table->value_count - next_value) {
+      ovm_error(vm, "Operand count mismatch at instruction %zu", i);
+      return -1;
+    }
+  
+    orinopp_instruction_t* instr = &vm->instructions[i];
+    instr->root = record->root;
+    instr->child = record->child;
+    instr->value_count = record->value_count;
+    instr->values = record->value_count ? vm->mapped.values + next_value : NULL;
+    next_value += record->value_count;
+  
+    for (size_t j = 0; j < instr->value_count; j++) {
+      if ((size_t)(end - cursor) < sizeof(orionpp_code_value_t)) {
+        ovm_error(vm, "Truncated code table at instruction %zu", i);
+        return -1;
+      }
+      const orionpp_code_value_t* value = (const orionpp_code_value_t*)cursor;
+      cursor += sizeof(*value);
+  
+      size_t padded = ORIONPP_CODE_ALIGN((size_t)value->bytesize);
+      if (padded > (size_t)(end - cursor)) {
+        ovm_error(vm, "Operand bytes out of bounds at instruction %zu", i);
+        return -1;
+      }
+      instr->values[j].root = value->root;
+      instr->values[j].child = value->child;
+      instr->values[j].bytesize = value->bytesize;
+      instr->values[j].bytes = value->bytesize ? (char*)cursor : NULL;
+      cursor += padded;
+    }
+    vm->instruction_count = i + 1;
+  }
+  
+  if (next_value != table->value_count) {
+    ovm_error(vm, "Operand count mismatch: %zu of %u operands used", next_value, table->value_count);
+    return -1;
+  }
+  
+  vm->memory_used += memory;
+  return 0;
+}
+
+int ovm_load_image(OrionVM* vm, VMMappedImage* image) {
+  if (!vm || !image) return -1;
+  
+  // Reset VM state and discard any previously loaded program
+  ovm_reset(vm);
+  if (ovm_clear_program(vm) != 0) {
+    ovm_unmap_image(image);
+    ovm_error(vm, "Out of memory allocating program storage");
+    return -1;
+  }
+  
+  // From here the mapping is the VM's and goes away with its program
+  vm->mapped = *image;
+  memset(image, 0, sizeof(*image));
+  const uint8_t* base = vm->mapped.base;
+  
+  // Copy the header out: the mapping promises no alignment for its 64-bit fields
+  orionpp_header_t header;
+  if (vm->mapped.size < sizeof(header)) {
+    ovm_error(vm, "Truncated image header");
+    goto fail;
+  }
+  memcpy(&header, base, sizeof(header));
+  
+  orionpp_error_t err = orionpp_header_validate(&header);
+  if (err != ORIONPP_ERROR_GOOD) {
+    ovm_error(vm, "Invalid image header: %s", orionpp_strerr(err));
+    goto fail;
+  }
+  
+  if (header.codetab < sizeof(header) || header.codetab % 4 != 0 ||
+      header.codetab > vm->mapped.size - sizeof(orionpp_code_table_t)) {
+    ovm_error(vm, "Code table offset %llu out of bounds", (unsigned long long)header.codetab);
+    goto fail;
+  }
+  
+  if (ovm_map_code_table(vm, base + header.codetab, base + vm->mapped.size) != 0) {
+    goto fail;
+  }
+  
+  if (vm->debug_mode && vm->debug_output) {
+    fprintf(vm->debug_output, "Mapped %zu instructions\n", vm->instruction_count);
+  }
+  
+  // Resolve, decode, verify and pick the loop once; all of it survives ovm_reset
+  return ovm_prepare_program(vm);
+
+fail:
+  ovm_clear_program(vm);
+  return -1;
+}
+
+int ovm_write_image(OrionVM* vm, const char* filename) {
+  if (!vm || !filename) return -1;
+  
+  size_t value_count = 0;
+  for (size_t i = 0; i < vm->instruction_count; i++) {
+    if (vm->instructions[i].value_count > UINT16_MAX) {
+      ovm_error(vm, "Instruction %zu has too many operands for an image", i);
+      return -1;
+    }
+    for (size_t j = 0; j < vm->instructions[i].value_count; j++) {
+      if (vm->instructions[i].values[j].bytesize > UINT32_MAX) {
+        ovm_error(vm, "Operand too large for an image at instruction %zu", i);
+        return -1;
+      }
+    }
+    value_count += vm->instructions[i].value_count;
+  }
+  if (vm->instruction_count >= ORIONPP_CODE_UNCOUNTED || value_count >= ORIONPP_CODE_UNCOUNTED) {
+    ovm_error(vm, "Program too large for an image");
+    return -1;
+  }
+  
+#ifdef WIN32
+  HANDLE file = CreateFileA(filename, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    ovm_error(vm, "Cannot open file: %s", filename);
+    return -1;
+  }
+#else
+  int file = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (file == -1) {
+    ovm_error(vm, "Cannot open file: %s", filename);
+    return -1;
+  }
+#endif
+  
+  orionpp_stream_t stream;
+  orionpp_code_table_t table = { (uint32_t)vm->instruction_count, (uint32_t)value_count };
+  orionpp_stream_writer(&stream, file, 0);
+  orionpp_stream_write_image_header(&stream, &table);
+  for (size_t i = 0; i < vm->instruction_count; i++) {
+    const orinopp_instruction_t* instr = &vm->instructions[i];
+    orionpp_stream_write_record(&stream, instr->root, instr->child, (uint16_t)instr->value_count);
+    for (size_t j = 0; j < instr->value_count; j++) {
+      const orinopp_value_t* value = &instr->values[j];
+      orionpp_stream_write_value(&stream, value->root, value->child, value->bytes, (uint32_t)value->bytesize);
+    }
+  }
+  orionpp_error_t err = orionpp_stream_close(&stream);
+  
+#ifdef WIN32
+  CloseHandle(file);
+#else
+  close(file);
+#endif
+  
+  if (err != ORIONPP_ERROR_GOOD) {
+    ovm_error(vm, "Failed to write image %s: %s", filename, orionpp_strerr(err));
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,300 @@
+/**
+ * @file src/native.c
+ * @brief Native function registry, the print and input natives and extern binding
+ */
+
+#ifndef WIN32
+  #define _GNU_SOURCE // RTLD_DEFAULT
+#endif
+
+#include "native.h"
+#include "executor.h"
+#include "validator.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WIN32
+  #include <dlfcn.h>
+#endif
+
+// FNV-1a over the name bytes
+static uint32_t hash_name(const char* name, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+  }
+  return hash;
+}
+
+// Bucket holding the native named name, or the empty bucket it would go in
+static size_t find_bucket(const VMNativeTable* table, const char* name, size_t length) {
+  size_t mask = table->bucket_count - 1;
+  for (size_t b = hash_name(name, length) & mask;; b = (b + 1) & mask) {
+    uint32_t slot = table->buckets[b];
+    if (slot == 0) return b;
+    const VMNative* native = &table->natives[slot - 1];
+    if (native->name_length == length && memcmp(native->name, name, length) == 0) return b;
+  }
+}
+
+// Keeps the table at most half full
+static int grow_buckets(VMNativeTable* table) {
+  size_t bucket_count = table->bucket_count ? table->bucket_count * 2 : 16;
+  uint32_t* buckets = calloc(bucket_count, sizeof(uint32_t));
+  if (!buckets) return -1;
+
+  free(table->buckets);
+  table->buckets = buckets;
+  table->bucket_count = bucket_count;
+  for (size_t i = 0; i < table->count; i++) {
+    const VMNative* native = &table->natives[i];
+    buckets[find_bucket(table, native->name, native->name_length)] = (uint32_t)(i + 1);
+  }
+  return 0;
+}
+
+static int add_native(OrionVM* vm, const char* name, VMNativeFunction function, VMExternFunction extern_function,
+                      VMNativeSignature signature) {
+  if (!vm || !vm->natives || !name || !function) return -1;
+  // Decoded calls hold the pointer they were bound to, so they would keep it
+  if (vm->decoded || vm->program) {
+    ovm_error(vm, "Cannot register native %s once the program is prepared", name);
+    return -1;
+  }
+  if (signature.min_args > signature.max_args || signature.max_args > OVM_MAX_CALL_ARGS) {
+    ovm_error(vm, "Invalid argument counts for native %s", name);
+    return -1;
+  }
+  if (signature.result != ORIONPP_TYPE_WORD && signature.result != ORIONPP_TYPE_SIZE &&
+      signature.result != ORIONPP_TYPE_C) {
+    ovm_error(vm, "Native %s must return an integer type", name);
+    return -1;
+  }
+
+  VMNativeTable* table = vm->natives;
+  size_t length = strlen(name);
+  if ((table->count + 1) * 2 > table->bucket_count && grow_buckets(table) != 0) {
+    ovm_error(vm, "Out of memory registering native %s", name);
+    return -1;
+  }
+
+  // A name registered again keeps its slot
+  size_t bucket = find_bucket(table, name, length);
+  if (table->buckets[bucket]) {
+    VMNative* native = &table->natives[table->buckets[bucket] - 1];
+    native->function = function;
+    native->extern_function = extern_function;
+    native->signature = signature;
+    return 0;
+  }
+
+  if (table->count == table->capacity) {
+    size_t capacity = table->capacity ? table->capacity * 2 : 8;
+    VMNative* natives = realloc(table->natives, capacity * sizeof(VMNative));
+    if (!natives) {
+      ovm_error(vm, "Out of memory registering native %s", name);
+      return -1;
+    }
+    table->natives = natives;
+    table->capacity = capacity;
+  }
+
+  char* copy = strdup(name);
+  if (!copy) {
+    ovm_error(vm, "Out of memory registering native %s", name);
+    return -1;
+  }
+  table->natives[table->count] = (VMNative){ copy, length, function, extern_function, signature };
+  table->buckets[bucket] = (uint32_t)++table->count;
+  return 0;
+}
+
+VMNativeTable* ovm_natives_create(void) {
+  return calloc(1, sizeof(VMNativeTable));
+}
+
+void ovm_natives_destroy(VMNativeTable* table) {
+  if (!table) return;
+  for (size_t i = 0; i < table->count; i++) {
+    free(table->natives[i].name);
+  }
+  free(table->natives);
+  free(table->buckets);
+  free(table);
+}
+
+int ovm_register_native(OrionVM* vm, const char* name, VMNativeFunction function, VMNativeSignature signature) {
+  return add_native(vm, name, function, NULL, signature);
+}
+
+const VMNative* ovm_find_native(const OrionVM* vm, const char* name, size_t length) {
+  if (!vm || !vm->natives || vm->natives->count == 0 || !name) return NULL;
+
+  const VMNativeTable* table = vm->natives;
+  uint32_t slot = table->buckets[find_bucket(table, name, length)];
+  return slot ? &table->natives[slot - 1] : NULL;
+}
+
+int ovm_call_native(OrionVM* vm, VMNativeFunction function, VMExternFunction extern_function, orionpp_type_t type,
+                    orionpp_variable_id_t dest, const orinopp_instruction_t* call) {
+  VMNativeCall native_call;
+  native_call.arg_count = call->value_count - 2;
+  native_call.extern_function = extern_function;
+  native_call.result.i64 = 0;
+  for (size_t i = 0; i < native_call.arg_count; i++) {
+    orionpp_variable_id_t id;
+    const VMVariable* arg = NULL;
+    if (ovm_extract_variable_id(&call->values[i + 2], &id) == 0) {
+      arg = ovm_lookup_variable(vm, id);
+    }
+    native_call.args[i] = arg && arg->is_initialized ? arg : NULL;
+  }
+
+  if (function(vm, &native_call) != 0) {
+    if (!vm->error) ovm_error(vm, "Native function failed");
+    return -1;
+  }
+
+  // Store the call result
+  if (dest == OVM_NO_VARIABLE) return 0;
+  VMVariable* result = ovm_lookup_variable(vm, dest);
+  if (!result) {
+    result = ovm_create_variable(vm, dest, type);
+    if (!result) return -1;
+  }
+  ovm_variable_value(vm, result)->i64 = native_call.result.i64;
+  result->is_initialized = true;
+  return 0;
+}
+
+// print(value) writes one value on a line of its own
+static int native_print(OrionVM* vm, VMNativeCall* call) {
+  if (call->arg_count == 0 || !call->args[0]) return 0;
+
+  const VMVariable* arg = call->args[0];
+  const VMValue* value = ovm_variable_value(vm, arg);
+  switch (arg->type) {
+    case ORIONPP_TYPE_WORD:
+    case ORIONPP_TYPE_SIZE:
+      printf("%lld\n", (long long)value->i64);
+      break;
+    case ORIONPP_TYPE_STRING:
+      printf("%s\n", value->str ? value->str : "(null)");
+      break;
+    case ORIONPP_TYPE_C:
+      printf("%c\n", (char)value->i64);
+      break;
+    default:
+      printf("(unhandled type)\n");
+      break;
+  }
+  return 0;
+}
+
+// input(index) - the index-th value handed to ovm_set_inputs, index defaults to 0
+static int native_input(OrionVM* vm, VMNativeCall* call) {
+  int64_t index = 0;
+  if (call->arg_count > 0) {
+    if (!call->args[0]) {
+      ovm_error(vm, "Invalid index argument to input");
+      return -1;
+    }
+    index = ovm_variable_value(vm, call->args[0])->i64;
+  }
+  if (index < 0 || (size_t)index >= vm->input_count) {
+    ovm_error(vm, "Input %lld out of range (%zu inputs)", (long long)index, vm->input_count);
+    return -1;
+  }
+  call->result.i64 = vm->inputs[index];
+  return 0;
+}
+
+int ovm_register_builtins(OrionVM* vm) {
+  const VMNativeSignature one_optional = { 0, 1, ORIONPP_TYPE_WORD };
+  if (ovm_register_native(vm, "print", native_print, one_optional) != 0) return -1;
+  return ovm_register_native(vm, "input", native_input, one_optional);
+}
+
+// Extern functions take integers only
+static int extern_args(OrionVM* vm, const VMNativeCall* call, int64_t* a) {
+  for (size_t i = 0; i < call->arg_count; i++) {
+    const VMVariable* arg = call->args[i];
+    if (!arg || !ovm_is_integer_type(arg->type)) {
+      ovm_error(vm, "Argument %zu of extern function is not an initialized integer", i);
+      return -1;
+    }
+    a[i] = ovm_variable_value(vm, arg)->i64;
+  }
+  return 0;
+}
+
+// Calls the C function in call->extern_function; the argument count was fixed by its
+// signature when it was bound
+static int native_extern(OrionVM* vm, VMNativeCall* call) {
+  int64_t a[OVM_MAX_EXTERN_ARGS];
+  if (extern_args(vm, call, a) != 0) return -1;
+
+  VMExternFunction f = call->extern_function;
+  switch (call->arg_count) {
+    case 0: call->result.i64 = ((int64_t (*)(void))f)(); break;
+    case 1: call->result.i64 = ((int64_t (*)(int64_t))f)(a[0]); break;
+    case 2: call->result.i64 = ((int64_t (*)(int64_t, int64_t))f)(a[0], a[1]); break;
+    case 3: call->result.i64 = ((int64_t (*)(int64_t, int64_t, int64_t))f)(a[0], a[1], a[2]); break;
+    case 4: call->result.i64 = ((int64_t (*)(int64_t, int64_t, int64_t, int64_t))f)(a[0], a[1], a[2], a[3]); break;
+    case 5:
+      call->result.i64 = ((int64_t (*)(int64_t, int64_t, int64_t, int64_t, int64_t))f)(a[0], a[1], a[2], a[3], a[4]);
+      break;
+    case 6:
+      call->result.i64 = ((int64_t (*)(int64_t, int64_t, int64_t, int64_t, int64_t, int64_t))f)(a[0], a[1], a[2], a[3],
+                                                                                               a[4], a[5]);
+      break;
+    default:
+      return -1;
+  }
+  return 0;
+}
+
+// Same as native_extern for functions returning nothing
+static int native_extern_void(OrionVM* vm, VMNativeCall* call) {
+  int64_t a[OVM_MAX_EXTERN_ARGS];
+  if (extern_args(vm, call, a) != 0) return -1;
+
+  VMExternFunction f = call->extern_function;
+  switch (call->arg_count) {
+    case 0: ((void (*)(void))f)(); break;
+    case 1: ((void (*)(int64_t))f)(a[0]); break;
+    case 2: ((void (*)(int64_t, int64_t))f)(a[0], a[1]); break;
+    case 3: ((void (*)(int64_t, int64_t, int64_t))f)(a[0], a[1], a[2]); break;
+    case 4: ((void (*)(int64_t, int64_t, int64_t, int64_t))f)(a[0], a[1], a[2], a[3]); break;
+    case 5: ((void (*)(int64_t, int64_t, int64_t, int64_t, int64_t))f)(a[0], a[1], a[2], a[3], a[4]); break;
+    case 6: ((void (*)(int64_t, int64_t, int64_t, int64_t, int64_t, int64_t))f)(a[0], a[1], a[2], a[3], a[4], a[5]); break;
+    default: return -1;
+  }
+  return 0;
+}
+
+int ovm_bind_extern(OrionVM* vm, const char* name, uint16_t param_count, uint16_t return_count, void* library) {
+  if (!vm || !name) return -1;
+  if (param_count > OVM_MAX_EXTERN_ARGS || return_count > 1) {
+    ovm_error(vm, "Extern %s has an unsupported signature", name);
+    return -1;
+  }
+
+#ifdef WIN32
+  (void)library;
+  ovm_error(vm, "Binding extern %s needs dlsym", name);
+  return -1;
+#else
+  void* symbol = dlsym(library ? library : RTLD_DEFAULT, name);
+  if (!symbol) {
+    ovm_error(vm, "Extern %s not found", name);
+    return -1;
+  }
+  // Copied rather than cast, as ISO C has no object-to-function pointer conversion
+  VMExternFunction function;
+  memcpy(&function, &symbol, sizeof(function));
+
+  const VMNativeSignature signature = { (uint8_t)param_count, (uint8_t)param_count, ORIONPP_TYPE_WORD };
+  return add_native(vm, name, return_count ? native_extern : native_extern_void, function, signature);
+#endif
+}
@@ -0,0 +1,345 @@
+/**
+ * @file src/profile.c
+ * @brief Execution profile of the decoded loop and its reports
+ */
+
+#include "profile.h"
+#include "decoder.h"
+#include "executor.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+// One row of a report, sorted by count
+typedef struct {
+  VMDecodedOp first;
+  VMDecodedOp second;
+  VMDecodedOp third;
+  size_t index;
+  uint64_t count;
+  uint64_t ticks;
+} VMProfileRow;
+
+VMProfile* ovm_profile_create(void) {
+  return calloc(1, sizeof(VMProfile));
+}
+
+void ovm_profile_destroy(VMProfile* profile) {
+  if (!profile) return;
+  free(profile->records);
+  free(profile->record_ticks);
+  free(profile);
+}
+
+int ovm_profile_reserve(VMProfile* profile, size_t count) {
+  if (!profile) return -1;
+  if (count <= profile->record_count) return 0;
+
+  uint64_t* records = realloc(profile->records, count * sizeof(uint64_t));
+  if (!records) return -1;
+  profile->records = records;
+  uint64_t* ticks = realloc(profile->record_ticks, count * sizeof(uint64_t));
+  if (!ticks) return -1;
+  profile->record_ticks = ticks;
+
+  size_t added = count - profile->record_count;
+  memset(records + profile->record_count, 0, added * sizeof(uint64_t));
+  memset(ticks + profile->record_count, 0, added * sizeof(uint64_t));
+  profile->record_count = count;
+  return 0;
+}
+
+int ovm_set_profile(OrionVM* vm, VMProfile* profile) {
+  if (!vm) return -1;
+#ifndef OVM_PROFILE
+  if (profile) {
+    ovm_error(vm, "Profiling support was left out of this build");
+    return -1;
+  }
+#endif
+  if (profile && vm->program) {
+    ovm_error(vm, "Cannot profile a VM attached to a shared program image");
+    return -1;
+  }
+
+  vm->profile = profile;
+  return 0;
+}
+
+static int compare_rows(const void* a, const void* b) {
+  uint64_t left = ((const VMProfileRow*)a)->count;
+  uint64_t right = ((const VMProfileRow*)b)->count;
+  return left < right ? 1 : left > right ? -1 : 0;
+}
+
+static double percent(uint64_t part, uint64_t total) {
+  return total ? 100.0 * (double)part / (double)total : 0.0;
+}
+
+static double per_dispatch(uint64_t ticks, uint64_t count) {
+  return count ? (double)ticks / (double)count : 0.0;
+}
+
+static void print_ops(const VMProfile* profile, FILE* output, size_t count) {
+  VMProfileRow rows[OVM_DOP_COUNT];
+  size_t row_count = 0;
+  uint64_t total = 0, total_ticks = 0;
+  for (int op = 0; op < OVM_DOP_COUNT; op++) {
+    total += profile->ops[op];
+    total_ticks += profile->op_ticks[op];
+    if (profile->ops[op] == 0) continue;
+    rows[row_count++] = (VMProfileRow){ .first = op, .count = profile->ops[op], .ticks = profile->op_ticks[op] };
+  }
+  qsort(rows, row_count, sizeof(VMProfileRow), compare_rows);
+
+  fprintf(output, "Opcodes (%llu dispatches, %llu %s):\n", (unsigned long long)total,
+          (unsigned long long)total_ticks, OVM_PROFILE_TICK_UNIT);
+  for (size_t i = 0; i < row_count && i < count; i++) {
+    fprintf(output, "  %-17s %12llu  %5.1f%%  %5.1f%% of time  %8.1f %s/op\n", ovm_decoded_op_name(rows[i].first),
+            (unsigned long long)rows[i].count, percent(rows[i].count, total), percent(rows[i].ticks, total_ticks),
+            per_dispatch(rows[i].ticks, rows[i].count), OVM_PROFILE_TICK_UNIT);
+  }
+}
+
+static void print_records(const VMProfile* profile, OrionVM* vm, FILE* output, size_t count) {
+  size_t limit = profile->record_count < vm->decoded_count ? profile->record_count : vm->decoded_count;
+  VMProfileRow* rows = malloc((limit ? limit : 1) * sizeof(VMProfileRow));
+  if (!rows) return;
+
+  size_t row_count = 0;
+  for (size_t i = 0; i < limit; i++) {
+    if (profile->records[i] == 0) continue;
+    rows[row_count++] = (VMProfileRow){ .first = vm->decoded[i].op, .index = i,
+                                        .count = profile->records[i], .ticks = profile->record_ticks[i] };
+  }
+  qsort(rows, row_count, sizeof(VMProfileRow), compare_rows);
+
+  fprintf(output, "Instructions:\n");
+  for (size_t i = 0; i < row_count && i < count; i++) {
+    const orinopp_instruction_t* instr = vm->decoded[rows[i].index].instr;
+    const char* name = rows[i].first == OVM_DOP_GENERIC && instr ? ovm_opcode_to_string(instr->root, instr->child)
+                                                                 : ovm_decoded_op_name(rows[i].first);
+    fprintf(output, "  %6zu  %-10s %12llu  %8.1f %s/op\n", rows[i].index, name, (unsigned long long)rows[i].count,
+            per_dispatch(rows[i].ticks, rows[i].count), OVM_PROFILE_TICK_UNIT);
+  }
+  free(rows);
+}
+
+void ovm_profile_print_pairs(const VMProfile* profile, FILE* output, size_t count) {
+  if (!profile || !output) return;
+
+  VMProfileRow* pairs = malloc(OVM_DOP_COUNT * OVM_DOP_COUNT * sizeof(VMProfileRow));
+  if (!pairs) return;
+
+  size_t pair_count = 0;
+  uint64_t total = 0;
+  for (int first = 0; first < OVM_DOP_COUNT; first++) {
+    for (int second = 0; second < OVM_DOP_COUNT; second++) {
+      uint64_t n = profile->pairs[first][second];
+      if (n == 0) continue;
+      pairs[pair_count++] = (VMProfileRow){ .first = first, .second = second, .count = n };
+      total += n;
+    }
+  }
+  qsort(pairs, pair_count, sizeof(VMProfileRow), compare_rows);
+
+  fprintf(output, "Opcode pairs (%llu fall-through dispatches):\n", (unsigned long long)total);
+  for (size_t i = 0; i < pair_count && i < count; i++) {
+    fprintf(output, "  %-8s %-8s %12llu  %5.1f%%\n", ovm_decoded_op_name(pairs[i].first),
+            ovm_decoded_op_name(pairs[i].second), (unsigned long long)pairs[i].count,
+            percent(pairs[i].count, total));
+  }
+  free(pairs);
+}
+
+void ovm_profile_print(const VMProfile* profile, OrionVM* vm, FILE* output, size_t count) {
+  if (!profile || !vm || !output) return;
+
+  print_ops(profile, output, count);
+  print_records(profile, vm, output, count);
+  ovm_profile_print_pairs(profile, output, count);
+}
+
+int ovm_profile_write_folded(const VMProfile* profile, OrionVM* vm, const char* root, FILE* output) {
+  if (!profile || !vm || !output) return -1;
+
+  size_t limit = profile->record_count < vm->decoded_count ? profile->record_count : vm->decoded_count;
+  bool in_label = false;
+  orionpp_label_id_t label = 0;
+  for (size_t i = 0; i < limit; i++) {
+    const orinopp_instruction_t* instr = vm->decoded[i].instr;
+    if (instr && instr->root == ORIONPP_OP_ISA && instr->child == ORIONPP_OP_ISA_LABEL) {
+      in_label = ovm_extract_label_id(&instr->values[0], &label) == 0;
+    }
+    if (profile->records[i] == 0) continue;
+
+    const char* name = vm->decoded[i].op == OVM_DOP_GENERIC && instr ? ovm_opcode_to_string(instr->root, instr->child)
+                                                                     : ovm_decoded_op_name(vm->decoded[i].op);
+    fprintf(output, "%s;", root ? root : "ovm");
+    if (in_label) fprintf(output, "L%u;", label);
+    else fprintf(output, "entry;");
+    fprintf(output, "%s %llu\n", name, (unsigned long long)profile->record_ticks[i]);
+  }
+
+  return ferror(output) ? -1 : 0;
+}
+
+// Runs of each length the superinstruction table holds
+#define OVM_SUPER_TABLE_PAIRS 22
+#define OVM_SUPER_TABLE_TRIPLES 3
+
+// Orders runs by count, then by ops so equal counts give the same table every time
+static int compare_runs(const void* a, const void* b) {
+  const VMProfileRow* left = a;
+  const VMProfileRow* right = b;
+  if (left->count != right->count) return left->count < right->count ? 1 : -1;
+  if (left->first != right->first) return left->first < right->first ? -1 : 1;
+  if (left->second != right->second) return left->second < right->second ? -1 : 1;
+  return left->third < right->third ? -1 : left->third > right->third ? 1 : 0;
+}
+
+static int find_decoded_op(const char* name) {
+  for (int op = 0; op < OVM_DOP_COUNT; op++) {
+    if (strcmp(ovm_decoded_op_name(op), name) == 0) return op;
+  }
+  return -1;
+}
+
+// Reads the table at path into a buffer of NUL-terminated lines; a missing
+// table is an empty one
+static char* read_super_table(const char* path, size_t* size) {
+  *size = 0;
+  char* text = malloc(1);
+  if (!text) return NULL;
+  FILE* input = fopen(path, "r");
+  if (!input) return text;
+
+  char chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), input)) > 0) {
+    char* grown = realloc(text, *size + n + 1);
+    if (!grown) {
+      free(text);
+      fclose(input);
+      return NULL;
+    }
+    text = grown;
+    memcpy(text + *size, chunk, n);
+    *size += n;
+  }
+  bool failed = ferror(input);
+  fclose(input);
+  if (failed) {
+    free(text);
+    return NULL;
+  }
+
+  text[*size] = '\0';
+  for (size_t i = 0; i < *size; i++) {
+    if (text[i] == '\n') text[i] = '\0';
+  }
+  return text;
+}
+
+// The most frequent runs of length 2 or 3 the decoder can fuse: every op needs
+// a body and only the last may branch. The profile has pairs only, so a
+// triple is counted as the less frequent of its two pairs.
+static size_t pick_runs(const VMProfile* profile, size_t length, VMProfileRow* runs, size_t limit) {
+  size_t run_count = 0;
+  for (int a = 0; a < OVM_DOP_COUNT; a++) {
+    if (!ovm_decoded_op_fusable(a) || ovm_decoded_op_branches(a)) continue;
+    for (int b = 0; b < OVM_DOP_COUNT; b++) {
+      uint64_t ab = profile->pairs[a][b];
+      if (ab == 0 || !ovm_decoded_op_fusable(b)) continue;
+      if (length == 2) {
+        runs[run_count++] = (VMProfileRow){ .first = a, .second = b, .count = ab };
+        continue;
+      }
+      if (ovm_decoded_op_branches(b)) continue;
+      for (int c = 0; c < OVM_DOP_COUNT; c++) {
+        uint64_t bc = profile->pairs[b][c];
+        if (bc == 0 || !ovm_decoded_op_fusable(c)) continue;
+        runs[run_count++] = (VMProfileRow){ .first = a, .second = b, .third = c, .count = ab < bc ? ab : bc };
+      }
+    }
+  }
+  qsort(runs, run_count, sizeof(VMProfileRow), compare_runs);
+  return run_count < limit ? run_count : limit;
+}
+
+static void write_super_table(const VMProfile* profile, const char* text, size_t size, const char* program,
+                              VMProfileRow* runs, FILE* output) {
+  fprintf(output, "/**\n"
+                  " * @file include/superinstructions.h\n"
+                  " * @brief Superinstruction table, written by `ovm++ --profile-super`\n"
+                  " */\n\n"
+                  "// `ovm++ --profile-super include/superinstructions.h PROGRAM` adds the\n"
+                  "// fall-through pairs of a run of PROGRAM to the counts below and picks the\n"
+                  "// %d most frequent pairs and %d most frequent triples decoder.c can fuse.\n"
+                  "// A triple is counted as the less frequent of its two pairs.\n\n",
+          OVM_SUPER_TABLE_PAIRS, OVM_SUPER_TABLE_TRIPLES);
+
+  for (const char* line = text; line < text + size; line += strlen(line) + 1) {
+    if (strncmp(line, "// program ", 11) == 0) fprintf(output, "%s\n", line);
+  }
+  fprintf(output, "// program %s\n", program);
+
+  size_t pair_count = 0;
+  for (int first = 0; first < OVM_DOP_COUNT; first++) {
+    for (int second = 0; second < OVM_DOP_COUNT; second++) {
+      uint64_t n = profile->pairs[first][second];
+      if (n) runs[pair_count++] = (VMProfileRow){ .first = first, .second = second, .count = n };
+    }
+  }
+  qsort(runs, pair_count, sizeof(VMProfileRow), compare_runs);
+  for (size_t i = 0; i < pair_count; i++) {
+    fprintf(output, "// pair %s %s %" PRIu64 "\n", ovm_decoded_op_name(runs[i].first),
+            ovm_decoded_op_name(runs[i].second), runs[i].count);
+  }
+
+  fprintf(output, "\n#ifndef SUPERINSTRUCTIONS_H\n#define SUPERINSTRUCTIONS_H\n\n#define OVM_SUPER_PAIRS(X)");
+  size_t count = pick_runs(profile, 2, runs, OVM_SUPER_TABLE_PAIRS);
+  for (size_t i = 0; i < count; i++) {
+    fprintf(output, " \\\n  X(%s, %s)", ovm_decoded_op_name(runs[i].first), ovm_decoded_op_name(runs[i].second));
+  }
+  fprintf(output, "\n\n#define OVM_SUPER_TRIPLES(X)");
+  count = pick_runs(profile, 3, runs, OVM_SUPER_TABLE_TRIPLES);
+  for (size_t i = 0; i < count; i++) {
+    fprintf(output, " \\\n  X(%s, %s, %s)", ovm_decoded_op_name(runs[i].first),
+            ovm_decoded_op_name(runs[i].second), ovm_decoded_op_name(runs[i].third));
+  }
+  fprintf(output, "\n\n#endif // SUPERINSTRUCTIONS_H\n");
+}
+
+int ovm_profile_update_super_table(VMProfile* profile, const char* program, const char* path) {
+  if (!profile || !program || !path) return -1;
+
+  size_t size;
+  char* text = read_super_table(path, &size);
+  VMProfileRow* runs = malloc((size_t)OVM_DOP_COUNT * OVM_DOP_COUNT * OVM_DOP_COUNT * sizeof(VMProfileRow));
+  if (!text || !runs) {
+    free(text);
+    free(runs);
+    return -1;
+  }
+
+  // Pair counts of the programs profiled before
+  for (const char* line = text; line < text + size; line += strlen(line) + 1) {
+    char first[16], second[16];
+    uint64_t n;
+    if (sscanf(line, "// pair %15s %15s %" SCNu64, first, second, &n) != 3) continue;
+    int a = find_decoded_op(first), b = find_decoded_op(second);
+    if (a >= 0 && b >= 0) profile->pairs[a][b] += n;
+  }
+
+  int result = -1;
+  FILE* output = fopen(path, "w");
+  if (output) {
+    write_super_table(profile, text, size, program, runs, output);
+    result = ferror(output) ? -1 : 0;
+    if (fclose(output) != 0) result = -1;
+  }
+  free(text);
+  free(runs);
+  return result;
+}
@@ -0,0 +1,160 @@
+/**
+ * @file src/program.c
+ * @brief Shared program images and the execution contexts attached to them
+ */
+
+#include "program.h"
+#include "decoder.h"
+#include "loader.h"
+#include <stdlib.h>
+#include <string.h>
+
+VMProgram* ovm_program_create(OrionVM* vm) {
+  if (!vm) return NULL;
+  
+  // Profile and JIT handlers write per-VM state, so the bound slots of an
+  // image must be the plain ones every context can run
+  if (vm->profile || vm->jit_mode != OVM_JIT_OFF) {
+    ovm_error(vm, "Cannot share a program that is profiled or compiled");
+    return NULL;
+  }
+  
+  // Already an image: hand out another reference
+  if (vm->program) {
+    return ovm_program_retain(vm->program);
+  }
+  
+  // Resolve, decode and verify once, then fix the dispatch slots for the tier
+  if (ovm_prepare_program(vm) != 0) return NULL;
+  if (vm->run_mode != OVM_RUN_STEP && ovm_bind_decoded(vm) != 0) {
+    ovm_error(vm, "Failed to bind decoded program");
+    return NULL;
+  }
+  
+  VMProgram* program = calloc(1, sizeof(VMProgram));
+  if (!program) {
+    ovm_error(vm, "Out of memory creating program image");
+    return NULL;
+  }
+  
+  // Move the program out of the VM; the VM keeps borrowing it below
+  program->instructions = vm->instructions;
+  program->instruction_count = vm->instruction_count;
+  program->mapped = vm->mapped;
+  program->labels = vm->labels;
+  program->label_count = vm->label_count;
+  program->label_targets = vm->label_targets;
+  program->functions = vm->functions;
+  program->function_count = vm->function_count;
+  program->entry = vm->entry;
+  program->slot_count = vm->slot_count;
+  program->call_slots = vm->call_slots;
+  program->call_frames = vm->call_frames;
+  program->decoded = vm->decoded;
+  program->decoded_count = vm->decoded_count;
+  program->verified = vm->verified;
+  program->run_mode = vm->run_mode;
+  atomic_init(&program->refcount, 2); // the caller and the VM
+  
+  vm->program = program;
+  vm->instruction_capacity = vm->instruction_count;
+  memset(&vm->mapped, 0, sizeof(vm->mapped));
+  return program;
+}
+
+VMProgram* ovm_program_retain(VMProgram* program) {
+  if (program) {
+    atomic_fetch_add_explicit(&program->refcount, 1, memory_order_relaxed);
+  }
+  return program;
+}
+
+void ovm_program_release(VMProgram* program) {
+  if (!program) return;
+  if (atomic_fetch_sub_explicit(&program->refcount, 1, memory_order_acq_rel) != 1) return;
+  
+  if (program->mapped.base) {
+    ovm_unmap_image(&program->mapped);
+  } else {
+    for (size_t i = 0; i < program->instruction_count; i++) {
+      // Value bytes belong to the orionpp reader, as in ovm_destroy
+      free(program->instructions[i].values);
+    }
+  }
+  free(program->instructions);
+  free(program->labels);
+  free(program->label_targets);
+  free(program->functions);
+  free(program->decoded);
+  free(program);
+}
+
+int ovm_attach_program(OrionVM* vm, VMProgram* program) {
+  if (!vm || !program) return -1;
+  if (vm->program == program) return 0;
+  if (vm->profile || vm->jit_mode != OVM_JIT_OFF) {
+    ovm_error(vm, "Cannot attach a profiled or compiled VM to a shared program image");
+    return -1;
+  }
+  
+  // Drop whatever the VM ran before
+  ovm_reset(vm);
+  if (vm->program) {
+    ovm_program_release(vm->program);
+  } else {
+    ovm_free_program_storage(vm);
+  }
+  
+  // Borrow the image; none of these are written while it is attached
+  vm->program = ovm_program_retain(program);
+  vm->instructions = program->instructions;
+  vm->instruction_count = program->instruction_count;
+  vm->instruction_capacity = program->instruction_count;
+  vm->labels = program->labels;
+  vm->label_count = program->label_count;
+  vm->label_targets = program->label_targets;
+  vm->labels_resolved = true;
+  vm->functions = program->functions;
+  vm->function_count = program->function_count;
+  vm->entry = program->entry;
+  vm->slot_count = program->slot_count;
+  vm->call_slots = program->call_slots;
+  vm->call_frames = program->call_frames;
+  vm->functions_resolved = true;
+  vm->decoded = program->decoded;
+  vm->decoded_count = program->decoded_count;
+  vm->decoded_threaded = program->decoded != NULL;
+  vm->decoded_verified = program->run_mode == OVM_RUN_VERIFIED;
+  vm->verified = program->verified;
+  vm->run_mode = program->run_mode;
+  return 0;
+}
+
+int ovm_detach_program(OrionVM* vm) {
+  if (!vm || !vm->program) return 0;
+  
+  ovm_program_release(vm->program);
+  vm->program = NULL;
+  vm->instructions = NULL;
+  vm->instruction_count = 0;
+  vm->labels = NULL;
+  vm->label_count = 0;
+  vm->label_targets = NULL;
+  vm->labels_resolved = false;
+  vm->functions = NULL;
+  vm->function_count = 0;
+  vm->entry = 0;
+  vm->slot_count = 0;
+  vm->call_slots = 0;
+  vm->call_frames = 0;
+  vm->functions_resolved = false;
+  vm->decoded = NULL;
+  vm->decoded_count = 0;
+  vm->decoded_threaded = false;
+  vm->decoded_verified = false;
+  vm->verified = false;
+  vm->run_mode = OVM_RUN_UNPREPARED;
+  
+  // Back to a VM that owns its program
+  return ovm_alloc_program_storage(vm);
+}
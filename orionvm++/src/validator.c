@@ -4,11 +4,13 @@
  */
 
 #include "validator.h"
+#include "executor.h"
+#include "decoder.h"
+#include "native.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-static ValidationLevel current_validation_level = OVM_VALIDATE_BASIC;
-
 bool ovm_types_compatible(orionpp_type_t type1, orionpp_type_t type2); // Forward declaration
 
 ValidationResult ovm_validate_program(OrionVM* vm) {
@@ -115,9 +117,22 @@ ValidationResult ovm_validate_instruction(OrionVM* vm, const orinopp_instruction
           break;
       }
       break;
+    case ORIONPP_OP_ABI:
+      // Moving a value takes an index and a variable
+      switch (instr->child) {
+        case OVM_ABI_CALLEE_ARG:
+        case OVM_ABI_CALLER_ARG:
+        case OVM_ABI_CALLEE_RET:
+        case OVM_ABI_CALLER_RET:
+          if (instr->value_count < 2) return OVM_INVALID_OPERAND;
+          if (instr->values[1].root != ORIONPP_TYPE_VARID) return OVM_INVALID_OPERAND;
+          break;
+        default:
+          break;
+      }
+      break;
     case ORIONPP_OP_HINT:
     case ORIONPP_OP_TYPE:
-    case ORIONPP_OP_ABI:
     case ORIONPP_OP_OBJ:
       // Metadata instructions are always valid
       break;
@@ -131,23 +146,13 @@ ValidationResult ovm_validate_instruction(OrionVM* vm, const orinopp_instruction
 ValidationResult ovm_validate_labels(OrionVM* vm) {
   if (!vm) return OVM_INVALID_LABEL_ID;
   
-  // register all labels
-  for (size_t i = 0; i < vm->instruction_count; i++) {
-    const orinopp_instruction_t* instr = &vm->instructions[i];
-    if (instr->root == ORIONPP_OP_ISA && instr->child == ORIONPP_OP_ISA_LABEL) {
-      if (instr->value_count > 0 && instr->values[0].root == ORIONPP_TYPE_LABELID) {
-        orionpp_label_id_t label_id;
-        if (ovm_extract_label_id(&instr->values[0], &label_id) == 0) {
-          ovm_register_label(vm, label_id, i);
-        }
-      }
-    }
-  }
-
+  // Labels are resolved once per program; this is a no-op after load
+  if (ovm_resolve_labels(vm) != 0) return OVM_INVALID_LABEL_ID;
+  
   // Validate all label references point to valid labels
   for (size_t i = 0; i < vm->instruction_count; i++) {
     const orinopp_instruction_t* instr = &vm->instructions[i];
-    
+  
     if (instr->root == ORIONPP_OP_ISA) {
       switch (instr->child) {
         case ORIONPP_OP_ISA_JMP:
@@ -185,7 +190,7 @@ ValidationResult ovm_validate_variables(OrionVM* vm) {
   
   // For now, just check that variable IDs are reasonable
   for (size_t i = 0; i < vm->variable_count; i++) {
-    if (vm->variables[i].id >= OVM_MAX_VARIABLES) {
+    if (vm->declared[i] >= OVM_MAX_VARIABLES) {
       return OVM_INVALID_VARIABLE_ID;
     }
   }
@@ -193,6 +198,373 @@ ValidationResult ovm_validate_variables(OrionVM* vm) {
   return OVM_VALID;
 }
 
+// Static verification state: one basic block per label or branch boundary
+typedef struct {
+  OrionVM* vm;
+  size_t var_count; // largest variable id + 1
+  size_t words; // bitset words per block
+  size_t block_count;
+  size_t* block_start; // first instruction of each block (block_count + 1 entries)
+  size_t* block_of; // block index of each instruction
+  orionpp_type_t* var_type; // declared type by id
+  bool* var_typed;
+} VerifyState;
+
+#define BIT_SET(set, id) ((set)[(id) / 64] |= (uint64_t)1 << ((id) % 64))
+#define BIT_TEST(set, id) (((set)[(id) / 64] >> ((id) % 64)) & 1)
+
+static bool verify_var_id(const VerifyState* st, const orinopp_value_t* value, orionpp_variable_id_t* id) {
+  return ovm_extract_variable_id(value, id) == 0 && *id < st->var_count;
+}
+
+static bool verify_ends_block(VMDecodedOp op) {
+  switch (op) {
+    case OVM_DOP_JMP: case OVM_DOP_BREQ: case OVM_DOP_BRNEQ: case OVM_DOP_BRGT:
+    case OVM_DOP_BRGE: case OVM_DOP_BRLT: case OVM_DOP_BRLE: case OVM_DOP_BRZ:
+    case OVM_DOP_BRNZ: case OVM_DOP_RET: case OVM_DOP_RET_VOID:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Records the declared type of every variable; an id declared with two types is rejected
+static ValidationResult verify_declare_type(VerifyState* st, orionpp_variable_id_t id, orionpp_type_t type) {
+  if (st->var_typed[id] && st->var_type[id] != type) return OVM_TYPE_MISMATCH;
+  st->var_type[id] = type;
+  st->var_typed[id] = true;
+  return OVM_VALID;
+}
+
+// Operand must be declared and initialized on every path reaching it
+#define VERIFY_READ(index)                                                     \
+  do {                                                                         \
+    if (!verify_var_id(st, &instr->values[index], &id)) return OVM_INVALID_VARIABLE_ID; \
+    if (check && !BIT_TEST(decl, id)) return OVM_INVALID_VARIABLE_ID;          \
+    if (check && !BIT_TEST(init, id)) return OVM_UNINITIALIZED_VARIABLE;       \
+  } while (0)
+
+// Destination must be declared and hold a value of the result type
+#define VERIFY_WRITE(index, type)                                              \
+  do {                                                                         \
+    if (!verify_var_id(st, &instr->values[index], &id)) return OVM_INVALID_VARIABLE_ID; \
+    if (check && !BIT_TEST(decl, id)) return OVM_INVALID_VARIABLE_ID;          \
+    if (check && !ovm_can_convert_types((type), st->var_type[id])) return OVM_TYPE_MISMATCH; \
+    BIT_SET(init, id);                                                         \
+  } while (0)
+
+// The check-free handlers do integer arithmetic on every operand
+static bool verify_integer(orionpp_type_t type) {
+  return type == ORIONPP_TYPE_WORD || type == ORIONPP_TYPE_SIZE || type == ORIONPP_TYPE_C;
+}
+
+#define VERIFY_INTEGER(id)                                                     \
+  do {                                                                         \
+    if (check && !verify_integer(st->var_type[id])) return OVM_TYPE_MISMATCH;  \
+  } while (0)
+
+// Applies one block to the declared/initialized sets; with check set, also proves its operands
+static ValidationResult verify_block(const VerifyState* st, size_t block, uint64_t* decl, uint64_t* init, bool check) {
+  orionpp_variable_id_t id, other;
+  
+  for (size_t i = st->block_start[block]; i < st->block_start[block + 1]; i++) {
+    const orinopp_instruction_t* instr = &st->vm->instructions[i];
+    VMDecodedOp op = ovm_decode_opcode(instr);
+  
+    switch (op) {
+      case OVM_DOP_NOP:
+      case OVM_DOP_JMP:
+      case OVM_DOP_RET:
+      case OVM_DOP_RET_VOID:
+        break;
+      case OVM_DOP_VAR:
+        if (!verify_var_id(st, &instr->values[0], &id)) return OVM_INVALID_VARIABLE_ID;
+        BIT_SET(decl, id);
+        break;
+      case OVM_DOP_CONST:
+        if (!verify_var_id(st, &instr->values[0], &id)) return OVM_INVALID_VARIABLE_ID;
+        BIT_SET(decl, id);
+        BIT_SET(init, id);
+        break;
+      case OVM_DOP_MOV:
+        VERIFY_READ(1);
+        other = id;
+        VERIFY_WRITE(0, st->var_type[other]);
+        break;
+      case OVM_DOP_BREQ: case OVM_DOP_BRNEQ: case OVM_DOP_BRGT:
+      case OVM_DOP_BRGE: case OVM_DOP_BRLT: case OVM_DOP_BRLE:
+        VERIFY_READ(0);
+        other = id;
+        VERIFY_READ(1);
+        if (check && !ovm_types_compatible(st->var_type[other], st->var_type[id])) return OVM_TYPE_MISMATCH;
+        break;
+      case OVM_DOP_BRZ:
+      case OVM_DOP_BRNZ:
+        VERIFY_READ(0);
+        VERIFY_INTEGER(id);
+        break;
+      case OVM_DOP_ADD: case OVM_DOP_SUB: case OVM_DOP_MUL: case OVM_DOP_DIV: case OVM_DOP_MOD:
+      case OVM_DOP_AND: case OVM_DOP_OR: case OVM_DOP_XOR: case OVM_DOP_SHL: case OVM_DOP_SHR:
+        VERIFY_READ(1);
+        VERIFY_INTEGER(id);
+        other = id;
+        VERIFY_READ(2);
+        VERIFY_INTEGER(id);
+        if (check && !ovm_types_compatible(st->var_type[other], st->var_type[id])) return OVM_TYPE_MISMATCH;
+        if (check && (op == OVM_DOP_DIV || op == OVM_DOP_MOD) && st->var_type[id] != ORIONPP_TYPE_WORD &&
+            st->var_type[id] != ORIONPP_TYPE_SIZE) return OVM_TYPE_MISMATCH;
+        VERIFY_WRITE(0, st->var_type[other]);
+        break;
+      case OVM_DOP_INC: case OVM_DOP_DEC: case OVM_DOP_INCP: case OVM_DOP_DECP: case OVM_DOP_NOT:
+        VERIFY_READ(1);
+        VERIFY_INTEGER(id);
+        other = id;
+        VERIFY_WRITE(0, st->var_type[other]);
+        break;
+      case OVM_DOP_CALL:
+        // Natives and functions of the module; the call checks its own depth
+        if (check) {
+          char* name;
+          if (ovm_extract_string(&instr->values[1], &name) != 0) return OVM_INVALID_FUNCTION_CALL;
+          ValidationResult result = ovm_validate_function_call(st->vm, name);
+          free(name);
+          if (result != OVM_VALID) return result;
+        }
+        for (size_t arg = 2; arg < instr->value_count; arg++) {
+          VERIFY_READ(arg);
+        }
+        if (!verify_var_id(st, &instr->values[0], &id)) return OVM_INVALID_VARIABLE_ID;
+        BIT_SET(decl, id);
+        BIT_SET(init, id);
+        break;
+      default:
+        // Arguments and return values
+        if (instr->root != ORIONPP_OP_ABI) return OVM_INVALID_INSTRUCTION;
+        if (instr->child == OVM_ABI_CALLER_ARG || instr->child == OVM_ABI_CALLEE_RET) {
+          VERIFY_READ(1);
+        } else if (instr->child == OVM_ABI_CALLEE_ARG || instr->child == OVM_ABI_CALLER_RET) {
+          if (!verify_var_id(st, &instr->values[1], &id)) return OVM_INVALID_VARIABLE_ID;
+          BIT_SET(decl, id);
+          BIT_SET(init, id);
+        }
+        break;
+    }
+  }
+  
+  return OVM_VALID;
+}
+
+// Functions of the module return words, natives what their signature says
+static orionpp_type_t call_result_type(const OrionVM* vm, const orinopp_instruction_t* call) {
+  const orinopp_value_t* symbol = &call->values[1];
+  if (!symbol->bytes) return ORIONPP_TYPE_WORD;
+  size_t length = ovm_symbol_length(symbol);
+  if (symbol->root == ORIONPP_TYPE_SYMBOL && ovm_find_function(vm, symbol->bytes, length)) return ORIONPP_TYPE_WORD;
+  const VMNative* native = ovm_find_native(vm, symbol->bytes, length);
+  return native ? native->signature.result : ORIONPP_TYPE_WORD;
+}
+
+// Builds blocks and declared types; operand shapes have been validated already
+static ValidationResult verify_prepare(VerifyState* st) {
+  OrionVM* vm = st->vm;
+  size_t count = vm->instruction_count;
+  
+  for (size_t i = 0; i < count; i++) {
+    const orinopp_instruction_t* instr = &vm->instructions[i];
+    for (size_t j = 0; j < instr->value_count; j++) {
+      orionpp_variable_id_t id;
+      if (instr->values[j].root != ORIONPP_TYPE_VARID) continue;
+      if (ovm_extract_variable_id(&instr->values[j], &id) != 0 || id >= OVM_MAX_VARIABLES) {
+        return OVM_INVALID_VARIABLE_ID;
+      }
+      if ((size_t)id + 1 > st->var_count) st->var_count = (size_t)id + 1;
+    }
+  }
+  
+  st->words = (st->var_count + 63) / 64;
+  st->block_start = malloc((count + 1) * sizeof(size_t));
+  st->block_of = malloc((count ? count : 1) * sizeof(size_t));
+  st->var_type = calloc(st->var_count ? st->var_count : 1, sizeof(orionpp_type_t));
+  st->var_typed = calloc(st->var_count ? st->var_count : 1, sizeof(bool));
+  if (!st->block_start || !st->block_of || !st->var_type || !st->var_typed) return OVM_MEMORY_LIMIT_EXCEEDED;
+  
+  for (size_t i = 0; i < count; i++) {
+    const orinopp_instruction_t* instr = &vm->instructions[i];
+    VMDecodedOp op = ovm_decode_opcode(instr);
+    bool leader = i == 0 || (instr->root == ORIONPP_OP_ISA && instr->child == ORIONPP_OP_ISA_LABEL) ||
+                  (instr->root == ORIONPP_OP_ABI && instr->child == OVM_ABI_CALLEE_SETUP) ||
+                  verify_ends_block(ovm_decode_opcode(&vm->instructions[i - 1]));
+    if (leader) st->block_start[st->block_count++] = i;
+    st->block_of[i] = st->block_count - 1;
+  
+    orionpp_variable_id_t id;
+    ValidationResult result = OVM_VALID;
+    if (op == OVM_DOP_VAR || op == OVM_DOP_CONST) {
+      ovm_extract_variable_id(&instr->values[0], &id);
+      result = verify_declare_type(st, id, instr->values[1].root);
+    } else if (op == OVM_DOP_CALL) {
+      ovm_extract_variable_id(&instr->values[0], &id);
+      result = verify_declare_type(st, id, call_result_type(vm, instr));
+    }
+    if (result != OVM_VALID) return result;
+  }
+  st->block_start[st->block_count] = count;
+  
+  // Parameters and stored return values are words unless declared otherwise
+  for (size_t i = 0; i < count; i++) {
+    const orinopp_instruction_t* instr = &vm->instructions[i];
+    orionpp_variable_id_t id;
+    if (instr->root == ORIONPP_OP_ABI && (instr->child == OVM_ABI_CALLEE_ARG || instr->child == OVM_ABI_CALLER_RET) &&
+        ovm_extract_variable_id(&instr->values[1], &id) == 0 && !st->var_typed[id]) {
+      verify_declare_type(st, id, ORIONPP_TYPE_WORD);
+    }
+  }
+  
+  return OVM_VALID;
+}
+
+// Successor blocks of a block; SIZE_MAX marks "none"
+static void verify_successors(const VerifyState* st, size_t block, size_t succ[2]) {
+  OrionVM* vm = st->vm;
+  size_t last = st->block_start[block + 1] - 1;
+  const orinopp_instruction_t* instr = &vm->instructions[last];
+  VMDecodedOp op = ovm_decode_opcode(instr);
+  size_t next = last + 1 < vm->instruction_count ? st->block_of[last + 1] : SIZE_MAX;
+  
+  succ[0] = next;
+  succ[1] = SIZE_MAX;
+  if (!verify_ends_block(op)) return;
+  if (op == OVM_DOP_RET || op == OVM_DOP_RET_VOID) {
+    succ[0] = SIZE_MAX;
+    return;
+  }
+  
+  // Branch targets were validated by ovm_validate_labels
+  orionpp_label_id_t label_id;
+  ovm_extract_label_id(&instr->values[op == OVM_DOP_JMP ? 0 : (op == OVM_DOP_BRZ || op == OVM_DOP_BRNZ) ? 1 : 2], &label_id);
+  size_t index = ovm_find_label(vm, label_id);
+  size_t target = index < vm->instruction_count ? st->block_of[index] : SIZE_MAX;
+  if (op == OVM_DOP_JMP) {
+    succ[0] = target;
+  } else {
+    succ[1] = target;
+  }
+}
+
+static ValidationResult verify_dataflow(VerifyState* st) {
+  size_t n = st->block_count;
+  size_t words = st->words;
+  ValidationResult result = OVM_MEMORY_LIMIT_EXCEEDED;
+  
+  // Must-analysis: a block's entry sets are the intersection over reached predecessors
+  uint64_t* in_decl = calloc(n * words + 1, sizeof(uint64_t));
+  uint64_t* in_init = calloc(n * words + 1, sizeof(uint64_t));
+  uint64_t* decl = calloc(words + 1, sizeof(uint64_t));
+  uint64_t* init = calloc(words + 1, sizeof(uint64_t));
+  bool* reached = calloc(n + 1, sizeof(bool));
+  bool* queued = calloc(n + 1, sizeof(bool));
+  size_t* worklist = malloc((n + 1) * sizeof(size_t));
+  if (!in_decl || !in_init || !decl || !init || !reached || !queued || !worklist) goto cleanup;
+  
+  // The program and every function start with nothing declared
+  size_t pending = 0;
+  reached[0] = queued[0] = true;
+  worklist[pending++] = 0;
+  for (size_t f = 0; f < st->vm->function_count; f++) {
+    size_t entry = st->block_of[st->vm->functions[f].entry];
+    if (queued[entry]) continue;
+    reached[entry] = queued[entry] = true;
+    worklist[pending++] = entry;
+  }
+  
+  while (pending > 0) {
+    size_t block = worklist[--pending];
+    queued[block] = false;
+    memcpy(decl, &in_decl[block * words], words * sizeof(uint64_t));
+    memcpy(init, &in_init[block * words], words * sizeof(uint64_t));
+  
+    result = verify_block(st, block, decl, init, false);
+    if (result != OVM_VALID) goto cleanup;
+  
+    size_t succ[2];
+    verify_successors(st, block, succ);
+    for (int k = 0; k < 2; k++) {
+      size_t s = succ[k];
+      if (s == SIZE_MAX) continue;
+  
+      bool changed = !reached[s];
+      for (size_t w = 0; w < words; w++) {
+        uint64_t d = reached[s] ? in_decl[s * words + w] & decl[w] : decl[w];
+        uint64_t v = reached[s] ? in_init[s * words + w] & init[w] : init[w];
+        changed |= d != in_decl[s * words + w] || v != in_init[s * words + w];
+        in_decl[s * words + w] = d;
+        in_init[s * words + w] = v;
+      }
+      reached[s] = true;
+  
+      if (changed && !queued[s]) {
+        queued[s] = true;
+        worklist[pending++] = s;
+      }
+    }
+  }
+  
+  // Fixed point reached: prove every operand of every reachable block
+  result = OVM_VALID;
+  for (size_t block = 0; block < n && result == OVM_VALID; block++) {
+    if (!reached[block]) continue;
+    memcpy(decl, &in_decl[block * words], words * sizeof(uint64_t));
+    memcpy(init, &in_init[block * words], words * sizeof(uint64_t));
+    result = verify_block(st, block, decl, init, true);
+  }
+  
+cleanup:
+  free(in_decl);
+  free(in_init);
+  free(decl);
+  free(init);
+  free(reached);
+  free(queued);
+  free(worklist);
+  return result;
+}
+
+ValidationResult ovm_verify_program(OrionVM* vm) {
+  if (!vm) return OVM_INVALID_INSTRUCTION;
+  
+  vm->verified = false;
+  
+  // Operand kinds
+  for (size_t i = 0; i < vm->instruction_count; i++) {
+    ValidationResult result = ovm_validate_instruction(vm, &vm->instructions[i], i);
+    if (result != OVM_VALID) return result;
+  }
+  
+  // Label targets and function entries
+  ValidationResult result = ovm_validate_labels(vm);
+  if (result != OVM_VALID) return result;
+  if (ovm_resolve_functions(vm) != 0) return OVM_MEMORY_LIMIT_EXCEEDED;
+  if (vm->instruction_count == 0) {
+    vm->verified = true;
+    return OVM_VALID;
+  }
+  
+  // Declaration and initialization before use, operand types and call targets
+  VerifyState st = { .vm = vm };
+  result = verify_prepare(&st);
+  if (result == OVM_VALID) {
+    result = verify_dataflow(&st);
+  }
+  
+  free(st.block_start);
+  free(st.block_of);
+  free(st.var_type);
+  free(st.var_typed);
+  
+  vm->verified = result == OVM_VALID;
+  return result;
+}
+
 ValidationResult ovm_validate_execution_safety(OrionVM* vm) {
   if (!vm) return OVM_INVALID_INSTRUCTION;
   
@@ -245,12 +617,12 @@ ValidationResult ovm_validate_label_jump(OrionVM* vm, orionpp_label_id_t id) {
 ValidationResult ovm_validate_function_call(OrionVM* vm, const char* function_name) {
   if (!vm || !function_name) return OVM_INVALID_FUNCTION_CALL;
   
-  // For now, only allow certain built-in functions
-  if (strcmp(function_name, "print") == 0) {
+  // Functions of the module and natives
+  size_t length = strlen(function_name);
+  if (ovm_find_function(vm, function_name, length) || ovm_find_native(vm, function_name, length)) {
     return OVM_VALID;
   }
   
-  // Add more built-in functions as needed
   return OVM_INVALID_FUNCTION_CALL;
 }
 
@@ -284,7 +656,7 @@ ValidationResult ovm_validate_division(OrionVM* vm, const VMVariable* divisor) {
   switch (divisor->type) {
     case ORIONPP_TYPE_WORD:
     case ORIONPP_TYPE_SIZE:
-      if (divisor->value.i64 == 0) {
+      if (ovm_variable_value(vm, divisor)->i64 == 0) {
         return OVM_DIVISION_BY_ZERO;
       }
       break;
@@ -419,6 +791,10 @@ bool ovm_can_convert_types(orionpp_type_t from, orionpp_type_t to) {
   return false;
 }
 
+bool ovm_is_unsigned_operation(orionpp_type_t left, orionpp_type_t right) {
+  return left == ORIONPP_TYPE_SIZE || right == ORIONPP_TYPE_SIZE;
+}
+
 const char* ovm_validation_result_to_string(ValidationResult result) {
   switch (result) {
     case OVM_VALID: return "Valid";
@@ -452,10 +828,12 @@ void ovm_report_validation_error(OrionVM* vm, ValidationResult result, const cha
 
 void ovm_set_validation_level(OrionVM* vm, ValidationLevel level) {
   if (vm) {
-    current_validation_level = level;
+    vm->validation_level = level;
+    // The execution tier is picked from the level; pick again on the next run
+    vm->run_mode = OVM_RUN_UNPREPARED;
   }
 }
 
 ValidationLevel ovm_get_validation_level(OrionVM* vm) {
-  return current_validation_level;
+  return vm ? vm->validation_level : OVM_VALIDATE_BASIC;
 }
\ No newline at end of file
@@ -3,9 +3,17 @@
  * @brief Enhanced Orion++ Virtual Machine implementation with conditional branch support
  */
 
+#ifndef WIN32
+  #define _DEFAULT_SOURCE // fileno
+#endif
+
 #include "vm.h"
 #include "executor.h"
 #include "validator.h"
+#include "decoder.h"
+#include "program.h"
+#include "loader.h"
+#include "native.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,39 +27,92 @@
   #include <fcntl.h>
 #endif
 
+// Stacks a VM starts with. Runs grow them to what the program's calls take,
+// up to the OVM_MAX_* limits, and calls only move within them.
+#define OVM_INITIAL_STACK_SLOTS 256
+#define OVM_INITIAL_CALL_DEPTH 16
+#define OVM_MAX_STACK_SLOTS (OVM_MAX_VARIABLES + OVM_MAX_STACK_SIZE)
+
+// Makes room for slots frame stack slots, at most the limit. The frames
+// move, so the current one is pointed at again.
+static int reserve_stack(OrionVM* vm, size_t slots) {
+  if (slots <= vm->stack_capacity) return 0;
+  
+  size_t capacity = vm->stack_capacity ? vm->stack_capacity : OVM_INITIAL_STACK_SLOTS;
+  while (capacity < slots) capacity *= 2;
+  if (capacity > OVM_MAX_STACK_SLOTS) capacity = OVM_MAX_STACK_SLOTS;
+  
+  // Each stack is pointed at as soon as it moves, so a later failure leaves
+  // the VM on valid, if partly grown, stacks
+  VMValue* values = realloc(vm->value_stack, capacity * sizeof(VMValue));
+  if (!values) return -1;
+  vm->value_stack = values;
+  vm->values = values + vm->frame_base;
+  VMVariable* variables = realloc(vm->variable_stack, capacity * sizeof(VMVariable));
+  if (!variables) return -1;
+  vm->variable_stack = variables;
+  vm->variables = variables + vm->frame_base;
+  orionpp_variable_id_t* declared = realloc(vm->declared, capacity * sizeof(orionpp_variable_id_t));
+  if (!declared) return -1;
+  vm->declared = declared;
+  
+  // New slots start out as popped frames leave theirs
+  memset(values + vm->stack_capacity, 0, (capacity - vm->stack_capacity) * sizeof(VMValue));
+  memset(variables + vm->stack_capacity, 0, (capacity - vm->stack_capacity) * sizeof(VMVariable));
+  vm->stack_capacity = capacity;
+  return 0;
+}
+
+// Makes room for frames call frames, at most OVM_MAX_CALL_DEPTH
+static int reserve_calls(OrionVM* vm, size_t frames) {
+  if (frames <= vm->call_capacity) return 0;
+  
+  size_t capacity = vm->call_capacity ? vm->call_capacity : OVM_INITIAL_CALL_DEPTH;
+  while (capacity < frames) capacity *= 2;
+  if (capacity > OVM_MAX_CALL_DEPTH) capacity = OVM_MAX_CALL_DEPTH;
+  
+  VMFrame* call_stack = realloc(vm->call_stack, capacity * sizeof(VMFrame));
+  if (!call_stack) return -1;
+  memset(call_stack + vm->call_capacity, 0, (capacity - vm->call_capacity) * sizeof(VMFrame));
+  vm->call_stack = call_stack;
+  vm->call_capacity = capacity;
+  return 0;
+}
+
+// Widens the entry frame to slots ids. Calls sit right above it, so it only
+// grows while none is running.
+static int grow_entry_frame(OrionVM* vm, size_t slots) {
+  if (slots <= vm->frame_size || vm->call_depth > 0) return 0;
+  if (reserve_stack(vm, slots) != 0) return -1;
+  vm->frame_size = slots;
+  return 0;
+}
+
 int ovm_init(OrionVM* vm) {
   if (!vm) return -1;
   
   memset(vm, 0, sizeof(OrionVM));
   
-  // Initialize instruction storage
-  vm->instruction_capacity = 1000;
-  vm->instructions = malloc(vm->instruction_capacity * sizeof(orinopp_instruction_t));
-  if (!vm->instructions) {
-    return -1;
-  }
-  
-  // Initialize variable storage
-  vm->variables = malloc(OVM_MAX_VARIABLES * sizeof(VMVariable));
-  if (!vm->variables) {
-    free(vm->instructions);
+  // Initialize instruction and label storage
+  if (ovm_alloc_program_storage(vm) != 0) {
     return -1;
   }
   
-  // Initialize label storage
-  vm->labels = malloc(OVM_MAX_LABELS * sizeof(VMLabel));
-  if (!vm->labels) {
-    free(vm->instructions);
-    free(vm->variables);
+  // Frame stack and call stack, small until a program needs more. Ids index
+  // a frame directly; the entry frame is empty until something is declared.
+  if (reserve_stack(vm, OVM_INITIAL_STACK_SLOTS) != 0 || reserve_calls(vm, OVM_INITIAL_CALL_DEPTH) != 0) {
+    ovm_free_program_storage(vm);
+    free(vm->value_stack);
+    free(vm->variable_stack);
+    free(vm->declared);
+    free(vm->call_stack);
     return -1;
   }
   
-  // Initialize call stack
-  vm->call_stack = malloc(OVM_MAX_CALL_DEPTH * sizeof(VMFrame));
-  if (!vm->call_stack) {
-    free(vm->instructions);
-    free(vm->variables);
-    free(vm->labels);
+  // print and input, and whatever the host registers on top
+  vm->natives = ovm_natives_create();
+  if (!vm->natives || ovm_register_builtins(vm) != 0) {
+    ovm_destroy(vm);
     return -1;
   }
   
@@ -67,18 +128,51 @@ int ovm_init(OrionVM* vm) {
   vm->debug_mode = false;
   vm->strict_mode = false;
   vm->debug_output = NULL;
+  vm->validation_level = OVM_VALIDATE_BASIC;
   
   // Initialize return value
-  memset(&vm->return_value, 0, sizeof(VMVariable));
+  memset(&vm->return_value, 0, sizeof(VMReturnValue));
   
   return 0;
 }
 
-void ovm_destroy(OrionVM* vm) {
-  if (!vm) return;
+int ovm_alloc_program_storage(OrionVM* vm) {
+  // Initialize instruction storage
+  vm->instruction_capacity = 1000;
+  vm->instructions = malloc(vm->instruction_capacity * sizeof(orinopp_instruction_t));
+  if (!vm->instructions) {
+    return -1;
+  }
+  
+  // Initialize label storage
+  vm->labels = malloc(OVM_MAX_LABELS * sizeof(VMLabel));
+  if (!vm->labels) {
+    free(vm->instructions);
+    vm->instructions = NULL;
+    return -1;
+  }
   
+  // Jump table indexed by label id
+  vm->label_targets = malloc(OVM_MAX_LABELS * sizeof(size_t));
+  if (!vm->label_targets) {
+    free(vm->instructions);
+    free(vm->labels);
+    vm->instructions = NULL;
+    vm->labels = NULL;
+    return -1;
+  }
+  for (size_t i = 0; i < OVM_MAX_LABELS; i++) {
+    vm->label_targets[i] = SIZE_MAX;
+  }
+  
+  return 0;
+}
+
+void ovm_free_program_storage(OrionVM* vm) {
   // Free instructions
-  if (vm->instructions) {
+  if (vm->mapped.base) {
+    ovm_unmap_image(&vm->mapped);
+  } else if (vm->instructions) {
     for (size_t i = 0; i < vm->instruction_count; i++) {
       if (vm->instructions[i].values) {
         for (size_t j = 0; j < vm->instructions[i].value_count; j++) {
@@ -87,33 +181,59 @@ void ovm_destroy(OrionVM* vm) {
         free(vm->instructions[i].values);
       }
     }
-    free(vm->instructions);
   }
+  free(vm->instructions);
+  vm->instructions = NULL;
+  vm->instruction_count = 0;
+  vm->instruction_capacity = 0;
   
-  // Free variables
-  if (vm->variables) {
-    for (size_t i = 0; i < vm->variable_count; i++) {
-      if (vm->variables[i].type == ORIONPP_TYPE_STRING && vm->variables[i].value.str) {
-        free(vm->variables[i].value.str);
-      }
-    }
-    free(vm->variables);
-  }
+  // Free decoded program
+  ovm_free_decoded(vm);
   
   // Free labels
-  if (vm->labels) {
-    free(vm->labels);
+  free(vm->labels);
+  free(vm->label_targets);
+  vm->labels = NULL;
+  vm->label_targets = NULL;
+  vm->label_count = 0;
+  vm->labels_resolved = false;
+  
+  // Free functions
+  free(vm->functions);
+  vm->functions = NULL;
+  vm->function_count = 0;
+  vm->entry = 0;
+  vm->slot_count = 0;
+  vm->call_slots = 0;
+  vm->call_frames = 0;
+  vm->functions_resolved = false;
+}
+
+void ovm_destroy(OrionVM* vm) {
+  if (!vm) return;
+  
+  // Free the program, or drop this VM's reference to a shared image
+  if (vm->program) {
+    ovm_program_release(vm->program);
+  } else {
+    ovm_free_program_storage(vm);
   }
   
-  // Free call stack
-  if (vm->call_stack) {
-    for (size_t i = 0; i < vm->call_depth; i++) {
-      if (vm->call_stack[i].function_name) {
-        free(vm->call_stack[i].function_name);
+  // Free variables, those of unfinished calls first
+  if (vm->variables) {
+    ovm_unwind_frames(vm);
+    for (size_t i = 0; i < vm->variable_count; i++) {
+      orionpp_variable_id_t id = vm->declared[i];
+      if (vm->variables[id].type == ORIONPP_TYPE_STRING) {
+        free(vm->values[id].str);
       }
     }
-    free(vm->call_stack);
   }
+  free(vm->value_stack);
+  free(vm->variable_stack);
+  free(vm->declared);
+  free(vm->call_stack);
+  ovm_natives_destroy(vm->natives);
   
   // Free return value string if needed
   if (vm->return_value.type == ORIONPP_TYPE_STRING && vm->return_value.value.str) {
@@ -123,6 +243,42 @@ void ovm_destroy(OrionVM* vm) {
   memset(vm, 0, sizeof(OrionVM));
 }
 
+// Drop the loaded program along with everything resolved against it
+int ovm_clear_program(OrionVM* vm) {
+  if (vm->program) {
+    return ovm_detach_program(vm);
+  }
+  
+  if (vm->mapped.base) {
+    ovm_unmap_image(&vm->mapped);
+  } else {
+    for (size_t i = 0; i < vm->instruction_count; i++) {
+      free(vm->instructions[i].values);
+    }
+  }
+  vm->instruction_count = 0;
+  
+  for (size_t i = 0; i < vm->label_count; i++) {
+    vm->label_targets[vm->labels[i].id] = SIZE_MAX;
+  }
+  vm->label_count = 0;
+  vm->labels_resolved = false;
+  
+  free(vm->functions);
+  vm->functions = NULL;
+  vm->function_count = 0;
+  vm->entry = 0;
+  vm->slot_count = 0;
+  vm->call_slots = 0;
+  vm->call_frames = 0;
+  vm->functions_resolved = false;
+  
+  ovm_free_decoded(vm);
+  vm->verified = false;
+  vm->run_mode = OVM_RUN_UNPREPARED;
+  return 0;
+}
+
 int ovm_load_file(OrionVM* vm, const char* filename) {
   if (!vm || !filename) return -1;
   
@@ -140,7 +296,15 @@ int ovm_load_file(OrionVM* vm, const char* filename) {
   }
 #endif
   
-  int result = ovm_load_from_handle(vm, file);
+  // Images are mapped and used in place; headerless streams are read record by record
+  VMMappedImage image;
+  int result;
+  if (ovm_map_file(file, &image) == 0 && ovm_is_image(&image)) {
+    result = ovm_load_image(vm, &image);
+  } else {
+    ovm_unmap_image(&image);
+    result = ovm_load_from_handle(vm, file);
+  }
   
 #ifdef WIN32
   CloseHandle(file);
@@ -151,23 +315,46 @@ int ovm_load_file(OrionVM* vm, const char* filename) {
   return result;
 }
 
-int ovm_load_from_handle(OrionVM* vm, file_handle_t handle) {
-  if (!vm) return -1;
-  
-  // Reset VM state
-  ovm_reset(vm);
+// A handle reading back bytes already taken from a stream. Headerless
+// programs are in the record format of orionpp_readf, which reads from
+// handles only, so the bytes go through an unnamed temporary file instead of
+// back to a stream that may be a pipe.
+static FILE* replay_file(const VMMappedImage* image, file_handle_t* handle) {
+  FILE* file = tmpfile();
+  if (!file) return NULL;
+  if ((image->size && fwrite(image->base, 1, image->size, file) != image->size) || fflush(file) != 0) {
+    fclose(file);
+    return NULL;
+  }
   
-  // Read instructions one by one
+  // Read through the handle from the start; stdio holds nothing back after the flush
+#ifdef WIN32
+  LARGE_INTEGER zero = { 0 };
+  *handle = (HANDLE)_get_osfhandle(_fileno(file));
+  bool rewound = SetFilePointerEx(*handle, zero, NULL, FILE_BEGIN);
+#else
+  *handle = fileno(file);
+  bool rewound = lseek(*handle, 0, SEEK_SET) == 0;
+#endif
+  if (!rewound) {
+    fclose(file);
+    return NULL;
+  }
+  return file;
+}
+
+// Reads records until the stream ends
+static int read_records(OrionVM* vm, file_handle_t handle) {
   orinopp_instruction_t instr;
   while (true) {
     memset(&instr, 0, sizeof(instr));
     orionpp_readf(handle, &instr);
-    
+  
     // Check for end of file or error
     if (instr.root == 0 && instr.child == 0 && instr.value_count == 0) {
       break;
     }
-    
+  
     // Check if we need to resize instruction array
     if (vm->instruction_count >= vm->instruction_capacity) {
       vm->instruction_capacity *= 2;
@@ -179,11 +366,11 @@ int ovm_load_from_handle(OrionVM* vm, file_handle_t handle) {
       }
       vm->instructions = new_instructions;
     }
-    
+  
     // Store instruction
     vm->instructions[vm->instruction_count] = instr;
     vm->instruction_count++;
-    
+  
     // Update memory usage
     vm->memory_used += sizeof(orinopp_instruction_t);
     if (instr.values) {
@@ -192,18 +379,92 @@ int ovm_load_from_handle(OrionVM* vm, file_handle_t handle) {
         vm->memory_used += instr.values[i].bytesize;
       }
     }
-    
+  
     // Check memory limit
     if (vm->memory_used > OVM_MAX_MEMORY_SIZE) {
       ovm_error(vm, "Memory limit exceeded while loading program");
       return -1;
     }
   }
+  return 0;
+}
+
+int ovm_load_from_handle(OrionVM* vm, file_handle_t handle) {
+  if (!vm) return -1;
+  
+  // Pull the stream in with a few block reads; headerless streams are then
+  // read back from memory, so pipes and stdin load too
+  VMMappedImage image;
+  if (ovm_read_file(handle, &image) != 0) {
+    ovm_error(vm, "Failed to read program");
+    return -1;
+  }
+  if (ovm_is_image(&image)) {
+    return ovm_load_image(vm, &image);
+  }
+  
+  file_handle_t records;
+  FILE* replay = replay_file(&image, &records);
+  ovm_unmap_image(&image);
+  if (!replay) {
+    ovm_error(vm, "Failed to buffer headerless program");
+    return -1;
+  }
+  
+  // Reset VM state and discard any previously loaded program
+  ovm_reset(vm);
+  if (ovm_clear_program(vm) != 0) {
+    fclose(replay);
+    ovm_error(vm, "Out of memory allocating program storage");
+    return -1;
+  }
+  
+  int result = read_records(vm, records);
+  fclose(replay);
+  if (result != 0) return -1;
   
   if (vm->debug_mode && vm->debug_output) {
     fprintf(vm->debug_output, "Loaded %zu instructions\n", vm->instruction_count);
   }
   
+  // Resolve, decode, verify and pick the loop once; all of it survives ovm_reset
+  return ovm_prepare_program(vm);
+}
+
+int ovm_prepare_program(OrionVM* vm) {
+  if (!vm) return -1;
+  if (vm->run_mode != OVM_RUN_UNPREPARED) return 0;
+  
+  // A shared image was prepared once for all of its contexts
+  if (vm->program) {
+    vm->run_mode = vm->program->run_mode;
+    return 0;
+  }
+  
+  if (ovm_resolve_labels(vm) != 0 || ovm_resolve_functions(vm) != 0) {
+    return -1;
+  }
+  if (ovm_decode_program(vm) != 0) {
+    ovm_error(vm, "Out of memory decoding program");
+    return -1;
+  }
+  
+  // The validation level selects the loop here rather than inside it:
+  //   0-1: check-free loop for verified programs, checked decoded loop otherwise
+  //   2:   checked decoded loop even for verified programs
+  //   3:   per-step loop validating execution safety before every instruction
+  switch (ovm_get_validation_level(vm)) {
+    case OVM_VALIDATE_PARANOID:
+      vm->run_mode = OVM_RUN_STEP;
+      break;
+    case OVM_VALIDATE_STRICT:
+      vm->run_mode = OVM_RUN_CHECKED;
+      break;
+    default:
+      vm->run_mode = ovm_verify_program(vm) == OVM_VALID ? OVM_RUN_VERIFIED : OVM_RUN_CHECKED;
+      break;
+  }
+  
   return 0;
 }
 
@@ -216,30 +477,26 @@ void ovm_reset(OrionVM* vm) {
   vm->error = false;
   vm->error_message[0] = '\0';
   
-  // Clear variables
+  // Clear variables (only the ids in use, the tables keep their size),
+  // dropping the frames of calls an error left unfinished first
+  ovm_unwind_frames(vm);
   for (size_t i = 0; i < vm->variable_count; i++) {
-    if (vm->variables[i].type == ORIONPP_TYPE_STRING && vm->variables[i].value.str) {
-      free(vm->variables[i].value.str);
+    orionpp_variable_id_t id = vm->declared[i];
+    if (vm->variables[id].type == ORIONPP_TYPE_STRING) {
+      free(vm->values[id].str);
     }
+    vm->values[id].u64 = 0;
+    memset(&vm->variables[id], 0, sizeof(VMVariable));
   }
   vm->variable_count = 0;
   
-  // Clear labels
-  vm->label_count = 0;
-  
-  // Clear call stack
-  for (size_t i = 0; i < vm->call_depth; i++) {
-    if (vm->call_stack[i].function_name) {
-      free(vm->call_stack[i].function_name);
-    }
-  }
-  vm->call_depth = 0;
+  // Labels, functions and the decoded stream belong to the program and are kept
   
   // Reset return value
   if (vm->return_value.type == ORIONPP_TYPE_STRING && vm->return_value.value.str) {
     free(vm->return_value.value.str);
   }
-  memset(&vm->return_value, 0, sizeof(VMVariable));
+  memset(&vm->return_value, 0, sizeof(VMReturnValue));
   
   // Reset memory usage (but keep allocated structures)
   vm->memory_used = sizeof(OrionVM);
@@ -249,19 +506,35 @@ int ovm_run(OrionVM* vm) {
   if (!vm) return -1;
   
   vm->running = true;
-  vm->pc = 0;
   
-  // First pass: register all labels
-  for (size_t i = 0; i < vm->instruction_count; i++) {
-    const orinopp_instruction_t* instr = &vm->instructions[i];
-    if (instr->root == ORIONPP_OP_ISA && instr->child == ORIONPP_OP_ISA_LABEL) {
-      if (instr->value_count > 0 && instr->values[0].root == ORIONPP_TYPE_LABELID) {
-        orionpp_label_id_t label_id;
-        if (ovm_extract_label_id(&instr->values[0], &label_id) == 0) {
-          ovm_register_label(vm, label_id, i);
-        }
+  // Loaded programs are prepared already; programs built in memory prepare on first run
+  if (ovm_prepare_program(vm) != 0) {
+    return -1;
+  }
+  vm->pc = vm->entry;
+  
+  // The entry frame holds every id the program names before it starts, as
+  // native code tests whether a variable is declared by reading its slot.
+  // Above it go the frames of the deepest chain of calls, plus the frame
+  // collecting the arguments of the innermost call's own calls.
+  if (grow_entry_frame(vm, vm->slot_count) != 0 || reserve_stack(vm, vm->frame_size + vm->call_slots) != 0 ||
+      reserve_calls(vm, vm->call_frames + 1) != 0) {
+    ovm_error(vm, "Out of memory growing the frame stack");
+    return -1;
+  }
+  
+  // Decoded loops for every tier but paranoid. Debug tracing needs the per-step path.
+  if (!vm->debug_mode && vm->run_mode != OVM_RUN_STEP) {
+    // Decoded handlers never touch memory_used, and calls check their own depth,
+    // so one check covers the run
+    if (ovm_get_validation_level(vm) != OVM_VALIDATE_NONE) {
+      ValidationResult validation = ovm_validate_execution_safety(vm);
+      if (validation != OVM_VALID) {
+        ovm_error(vm, "Safety validation failed: %s", ovm_validation_result_to_string(validation));
+        return -1;
       }
     }
+    return ovm_run_decoded(vm);
   }
   
   // Main execution loop
@@ -307,26 +580,7 @@ int ovm_step(OrionVM* vm) {
   }
   
   // Don't automatically increment PC for control flow instructions
-  if (instr->root == ORIONPP_OP_ISA) {
-    switch (instr->child) {
-      case ORIONPP_OP_ISA_JMP:
-      case ORIONPP_OP_ISA_BREQ:
-      case ORIONPP_OP_ISA_BRNEQ:
-      case ORIONPP_OP_ISA_BRGT:
-      case ORIONPP_OP_ISA_BRGE:
-      case ORIONPP_OP_ISA_BRLT:
-      case ORIONPP_OP_ISA_BRLE:
-      case ORIONPP_OP_ISA_BRZ:
-      case ORIONPP_OP_ISA_BRNZ:
-      case ORIONPP_OP_ISA_CALL:
-      case ORIONPP_OP_ISA_RET:
-        // PC already updated by instruction
-        break;
-      default:
-        vm->pc++;
-        break;
-    }
-  } else {
+  if (!ovm_is_control_flow(instr)) {
     vm->pc++;
   }
   
@@ -344,29 +598,48 @@ void ovm_set_strict_mode(OrionVM* vm, bool strict) {
   vm->strict_mode = strict;
 }
 
+void ovm_set_inputs(OrionVM* vm, const int64_t* inputs, size_t count) {
+  if (!vm) return;
+  vm->inputs = inputs;
+  vm->input_count = count;
+}
+
 VMVariable* ovm_get_variable(OrionVM* vm, orionpp_variable_id_t id) {
   if (!vm) return NULL;
+  return ovm_lookup_variable(vm, id);
+}
+
+VMVariable* ovm_create_variable(OrionVM* vm, orionpp_variable_id_t id, orionpp_type_t type) {
+  if (!vm) return NULL;
   
-  for (size_t i = 0; i < vm->variable_count; i++) {
-    if (vm->variables[i].id == id) {
-      return &vm->variables[i];
+  // A call's frame holds the ids its function uses; the entry frame grows
+  // to any id below OVM_MAX_VARIABLES
+  if (id >= vm->frame_size) {
+    size_t limit = vm->call_depth > 0 ? vm->frame_size : OVM_MAX_VARIABLES;
+    if (id >= limit) {
+      ovm_error(vm, "Variable id %u exceeds limit of %zu", id, limit - 1);
+      return NULL;
+    }
+    if (grow_entry_frame(vm, (size_t)id + 1) != 0) {
+      ovm_error(vm, "Out of memory growing the frame stack");
+      return NULL;
     }
   }
   
-  return NULL;
-}
-
-VMVariable* ovm_create_variable(OrionVM* vm, orionpp_variable_id_t id, orionpp_type_t type) {
-  if (!vm || vm->variable_count >= OVM_MAX_VARIABLES) {
-    if (vm) ovm_error(vm, "Maximum variable count exceeded");
-    return NULL;
+  // Declaring an id again starts it over
+  VMVariable* var = &vm->variables[id];
+  if (var->is_declared) {
+    if (var->type == ORIONPP_TYPE_STRING) free(vm->values[id].str);
+  } else {
+    vm->declared[vm->variable_count++] = id;
   }
   
-  VMVariable* var = &vm->variables[vm->variable_count++];
   memset(var, 0, sizeof(VMVariable));
   var->id = id;
   var->type = type;
+  var->is_declared = true;
   var->is_initialized = false;
+  vm->values[id].u64 = 0;
   
   return var;
 }
@@ -381,29 +654,30 @@ int ovm_set_variable_value(OrionVM* vm, orionpp_variable_id_t id, const void* da
   }
   
   // Set value based on type
+  VMValue* value = ovm_variable_value(vm, var);
   switch (var->type) {
     case ORIONPP_TYPE_WORD:
     case ORIONPP_TYPE_SIZE:
       if (size >= sizeof(int64_t)) {
-        var->value.i64 = *(int64_t*)data;
+        value->i64 = *(int64_t*)data;
       } else if (size >= sizeof(int32_t)) {
-        var->value.i64 = *(int32_t*)data;
+        value->i64 = *(int32_t*)data;
       } else {
         ovm_error(vm, "Invalid data size for integer variable");
         return -1;
       }
       break;
     case ORIONPP_TYPE_STRING:
-      if (var->value.str) {
-        free(var->value.str);
+      if (value->str) {
+        free(value->str);
       }
-      var->value.str = malloc(size + 1);
-      if (!var->value.str) {
+      value->str = malloc(size + 1);
+      if (!value->str) {
         ovm_error(vm, "Out of memory for string variable");
         return -1;
       }
-      memcpy(var->value.str, data, size);
-      var->value.str[size] = '\0';
+      memcpy(value->str, data, size);
+      value->str[size] = '\0';
       break;
     default:
       ovm_error(vm, "Unsupported variable type");
@@ -414,29 +688,285 @@ int ovm_set_variable_value(OrionVM* vm, orionpp_variable_id_t id, const void* da
   return 0;
 }
 
+void ovm_set_return_value(OrionVM* vm, const VMVariable* var) {
+  if (!vm || !var || !var->is_initialized) return;
+  
+  if (vm->return_value.type == ORIONPP_TYPE_STRING) {
+    free(vm->return_value.value.str);
+  }
+  vm->return_value.type = var->type;
+  vm->return_value.value = *ovm_variable_value(vm, var);
+  vm->return_value.is_initialized = true;
+  
+  // The VM keeps the variable's own string
+  if (var->type == ORIONPP_TYPE_STRING && vm->return_value.value.str) {
+    vm->return_value.value.str = strdup(vm->return_value.value.str);
+  }
+}
+
+void ovm_move_return_value(OrionVM* vm, VMVariable* var) {
+  if (!vm || !var || !var->is_initialized) return;
+  
+  if (vm->return_value.type == ORIONPP_TYPE_STRING) {
+    free(vm->return_value.value.str);
+  }
+  vm->return_value.type = var->type;
+  vm->return_value.value = *ovm_variable_value(vm, var);
+  vm->return_value.is_initialized = true;
+  if (var->type == ORIONPP_TYPE_STRING) {
+    ovm_variable_value(vm, var)->str = NULL;
+  }
+}
+
+int ovm_push_frame(OrionVM* vm, size_t function, size_t return_address, orionpp_variable_id_t result) {
+  if (!vm || function >= vm->function_count) return -1;
+  
+  if (ovm_validate_call_depth(vm) != OVM_VALID) {
+    ovm_error(vm, "Call depth limit exceeded");
+    return -1;
+  }
+  
+  // Every id the callee names has to stay on the stack
+  size_t base = vm->frame_base + vm->frame_size;
+  // ovm_run sized both stacks for the program, up to the limits, so a call
+  // never allocates: the callee's slots, its frame and the one collecting
+  // its own calls' arguments are there already unless a limit is hit
+  if (base + vm->functions[function].slot_count > vm->stack_capacity || vm->call_depth + 2 > vm->call_capacity) {
+    ovm_error(vm, "Frame stack overflow");
+    return -1;
+  }
+  
+  // The arguments were collected in this frame already
+  VMFrame* frame = &vm->call_stack[vm->call_depth++];
+  frame->return_address = return_address;
+  frame->base = base;
+  frame->size = vm->functions[function].slot_count;
+  frame->declared_base = vm->variable_count;
+  frame->function = function;
+  frame->result = result;
+  
+  vm->frame_base = base;
+  vm->frame_size = frame->size;
+  vm->values = vm->value_stack + base;
+  vm->variables = vm->variable_stack + base;
+  
+  // The callee sets a return value of its own, if any
+  if (vm->return_value.type == ORIONPP_TYPE_STRING) {
+    free(vm->return_value.value.str);
+  }
+  memset(&vm->return_value, 0, sizeof(VMReturnValue));
+  return 0;
+}
+
+const VMFrame* ovm_pop_frame(OrionVM* vm) {
+  if (!vm || vm->call_depth == 0) return NULL;
+  
+  // Drop the callee's variables, leaving its slots as a new frame expects them
+  VMFrame* frame = &vm->call_stack[--vm->call_depth];
+  for (size_t i = frame->declared_base; i < vm->variable_count; i++) {
+    orionpp_variable_id_t id = vm->declared[i];
+    if (vm->variables[id].type == ORIONPP_TYPE_STRING) {
+      free(vm->values[id].str);
+    }
+    vm->values[id].u64 = 0;
+    memset(&vm->variables[id], 0, sizeof(VMVariable));
+  }
+  vm->variable_count = frame->declared_base;
+  frame->arg_count = 0;
+  
+  // Back to the caller's frame
+  const VMFrame* caller = vm->call_depth > 0 ? &vm->call_stack[vm->call_depth - 1] : NULL;
+  vm->frame_base = caller ? caller->base : 0;
+  vm->frame_size = caller ? caller->size : frame->base; // the entry frame ends where the call began
+  vm->values = vm->value_stack + vm->frame_base;
+  vm->variables = vm->variable_stack + vm->frame_base;
+  return frame;
+}
+
+void ovm_unwind_frames(OrionVM* vm) {
+  if (!vm || !vm->call_stack) return;
+  
+  while (vm->call_depth > 0) {
+    ovm_pop_frame(vm);
+  }
+  vm->call_stack[0].arg_count = 0;
+}
+
+// Function of the module a CALL runs, as the decoder binds it
+static const VMFunction* called_function(const OrionVM* vm, const orinopp_instruction_t* instr) {
+  if (instr->root != ORIONPP_OP_ISA || instr->child != ORIONPP_OP_ISA_CALL || instr->value_count < 2) return NULL;
+  const orinopp_value_t* symbol = &instr->values[1];
+  if (symbol->root != ORIONPP_TYPE_SYMBOL || !symbol->bytes) return NULL;
+  return ovm_find_function(vm, symbol->bytes, ovm_symbol_length(symbol));
+}
+
+// Frame stack slots and frames the deepest chain of calls starting with a
+// call of function takes. A chain that comes back to a function still on it
+// recurses, and takes all the limits allow.
+static void measure_calls(const OrionVM* vm, size_t function, uint8_t* state, size_t* slots, size_t* frames) {
+  state[function] = 1; // on the chain
+  size_t deepest_slots = 0;
+  size_t deepest_frames = 0;
+  size_t end = function + 1 < vm->function_count ? vm->functions[function + 1].entry : vm->instruction_count;
+  for (size_t i = vm->functions[function].entry; i < end; i++) {
+    const VMFunction* callee = called_function(vm, &vm->instructions[i]);
+    if (!callee) continue;
+    size_t c = (size_t)(callee - vm->functions);
+    if (state[c] == 1) {
+      deepest_slots = OVM_MAX_STACK_SLOTS;
+      deepest_frames = OVM_MAX_CALL_DEPTH;
+      break;
+    }
+    if (state[c] == 0) measure_calls(vm, c, state, slots, frames);
+    if (slots[c] > deepest_slots) deepest_slots = slots[c];
+    if (frames[c] > deepest_frames) deepest_frames = frames[c];
+  }
+  
+  size_t total = vm->functions[function].slot_count + deepest_slots;
+  slots[function] = total < OVM_MAX_STACK_SLOTS ? total : OVM_MAX_STACK_SLOTS;
+  frames[function] = deepest_frames < OVM_MAX_CALL_DEPTH ? deepest_frames + 1 : OVM_MAX_CALL_DEPTH;
+  state[function] = 2; // measured
+}
+
+static bool is_function_entry(const orinopp_instruction_t* instr) {
+  return instr->root == ORIONPP_OP_ABI && instr->child == OVM_ABI_CALLEE_SETUP && instr->value_count > 0 &&
+         instr->values[0].root == ORIONPP_TYPE_SYMBOL;
+}
+
+int ovm_resolve_functions(OrionVM* vm) {
+  if (!vm) return -1;
+  if (vm->functions_resolved) return 0;
+  
+  size_t count = 0;
+  for (size_t i = 0; i < vm->instruction_count; i++) {
+    if (is_function_entry(&vm->instructions[i])) count++;
+  }
+  
+  free(vm->functions);
+  vm->functions = count ? malloc(count * sizeof(VMFunction)) : NULL;
+  vm->function_count = 0;
+  if (count && !vm->functions) {
+    ovm_error(vm, "Out of memory resolving functions");
+    return -1;
+  }
+  
+  // A function's frame holds every id its instructions name, the entry frame
+  // every id of the program
+  vm->slot_count = 0;
+  for (size_t i = 0; i < vm->instruction_count; i++) {
+    const orinopp_instruction_t* instr = &vm->instructions[i];
+    if (is_function_entry(instr)) {
+      VMFunction* function = &vm->functions[vm->function_count++];
+      function->name = instr->values[0].bytes;
+      function->name_length = ovm_symbol_length(&instr->values[0]);
+      function->entry = i;
+      function->slot_count = 0;
+      continue;
+    }
+    VMFunction* function = vm->function_count ? &vm->functions[vm->function_count - 1] : NULL;
+    for (size_t j = 0; j < instr->value_count; j++) {
+      orionpp_variable_id_t id;
+      if (ovm_extract_variable_id(&instr->values[j], &id) != 0 || id >= OVM_MAX_VARIABLES) continue;
+      if (id >= vm->slot_count) vm->slot_count = (size_t)id + 1;
+      if (function && id >= function->slot_count) function->slot_count = (size_t)id + 1;
+    }
+  }
+  
+  // Any function may be the first called. The entry frame is sized apart,
+  // as it holds every id of the program.
+  vm->call_slots = 0;
+  vm->call_frames = 0;
+  if (count) {
+    uint8_t* state = calloc(count, sizeof(uint8_t));
+    size_t* slots = malloc(count * sizeof(size_t));
+    size_t* frames = malloc(count * sizeof(size_t));
+    if (!state || !slots || !frames) {
+      free(state);
+      free(slots);
+      free(frames);
+      ovm_error(vm, "Out of memory resolving functions");
+      return -1;
+    }
+    for (size_t f = 0; f < count; f++) {
+      if (state[f] == 0) measure_calls(vm, f, state, slots, frames);
+      if (slots[f] > vm->call_slots) vm->call_slots = slots[f];
+      if (frames[f] > vm->call_frames) vm->call_frames = frames[f];
+    }
+    free(state);
+    free(slots);
+    free(frames);
+  }
+  
+  const VMFunction* main = ovm_find_function(vm, "main", 4);
+  vm->entry = main ? main->entry : 0;
+  vm->functions_resolved = true;
+  return 0;
+}
+
+const VMFunction* ovm_find_function(const OrionVM* vm, const char* name, size_t length) {
+  if (!vm || !name) return NULL;
+  
+  // First definition wins, as for labels
+  for (size_t i = 0; i < vm->function_count; i++) {
+    const VMFunction* function = &vm->functions[i];
+    if (function->name_length == length && memcmp(function->name, name, length) == 0) {
+      return function;
+    }
+  }
+  return NULL;
+}
+
 int ovm_register_label(OrionVM* vm, orionpp_label_id_t id, size_t instruction_index) {
-  if (!vm || vm->label_count >= OVM_MAX_LABELS) {
-    if (vm) ovm_error(vm, "Maximum label count exceeded");
+  if (!vm) return -1;
+  
+  if (id >= OVM_MAX_LABELS) {
+    ovm_error(vm, "Label id %u exceeds limit of %d", id, OVM_MAX_LABELS);
+    return -1;
+  }
+  
+  // First definition wins, matching the old linear lookup
+  if (vm->label_targets[id] != SIZE_MAX) {
+    return 0;
+  }
+  
+  if (vm->label_count >= OVM_MAX_LABELS) {
+    ovm_error(vm, "Maximum label count exceeded");
     return -1;
   }
   
   vm->labels[vm->label_count].id = id;
   vm->labels[vm->label_count].instruction_index = instruction_index;
   vm->label_count++;
+  vm->label_targets[id] = instruction_index;
   
   return 0;
 }
 
 size_t ovm_find_label(OrionVM* vm, orionpp_label_id_t id) {
-  if (!vm) return SIZE_MAX;
+  if (!vm || id >= OVM_MAX_LABELS) return SIZE_MAX;
   
-  for (size_t i = 0; i < vm->label_count; i++) {
-    if (vm->labels[i].id == id) {
-      return vm->labels[i].instruction_index;
+  return vm->label_targets[id];
+}
+
+int ovm_resolve_labels(OrionVM* vm) {
+  if (!vm) return -1;
+  if (vm->labels_resolved) return 0;
+  
+  for (size_t i = 0; i < vm->instruction_count; i++) {
+    const orinopp_instruction_t* instr = &vm->instructions[i];
+    if (instr->root == ORIONPP_OP_ISA && instr->child == ORIONPP_OP_ISA_LABEL) {
+      if (instr->value_count > 0 && instr->values[0].root == ORIONPP_TYPE_LABELID) {
+        orionpp_label_id_t label_id;
+        if (ovm_extract_label_id(&instr->values[0], &label_id) == 0 &&
+            ovm_register_label(vm, label_id, i) != 0) {
+          return -1;
+        }
+      }
     }
   }
   
-  return SIZE_MAX;
+  vm->labels_resolved = true;
+  return 0;
 }
 
 void ovm_error(OrionVM* vm, const char* format, ...) {
@@ -527,7 +1057,7 @@ void ovm_print_instruction(OrionVM* vm, const orinopp_instruction_t* instr) {
   
   for (size_t i = 0; i < instr->value_count; i++) {
     fprintf(vm->debug_output, " %s:", ovm_type_to_string(instr->values[i].root));
-    
+  
     switch (instr->values[i].root) {
       case ORIONPP_TYPE_VARID:
       case ORIONPP_TYPE_LABELID:
@@ -568,19 +1098,22 @@ void ovm_print_state(OrionVM* vm) {
   fprintf(vm->debug_output, "Call depth: %zu\n", vm->call_depth);
   fprintf(vm->debug_output, "Memory used: %zu bytes\n", vm->memory_used);
   
-  if (vm->variable_count > 0) {
+  // Only the current frame's variables are visible
+  size_t first = vm->call_depth > 0 ? vm->call_stack[vm->call_depth - 1].declared_base : 0;
+  if (vm->variable_count > first) {
     fprintf(vm->debug_output, "Variables:\n");
-    for (size_t i = 0; i < vm->variable_count; i++) {
-      VMVariable* var = &vm->variables[i];
+    for (size_t i = first; i < vm->variable_count; i++) {
+      VMVariable* var = &vm->variables[vm->declared[i]];
+      const VMValue* value = ovm_variable_value(vm, var);
       fprintf(vm->debug_output, "  %u: %s = ", var->id, ovm_type_to_string(var->type));
       if (var->is_initialized) {
         switch (var->type) {
           case ORIONPP_TYPE_WORD:
           case ORIONPP_TYPE_SIZE:
-            fprintf(vm->debug_output, "%lld", (long long)var->value.i64);
+            fprintf(vm->debug_output, "%lld", (long long)value->i64);
             break;
           case ORIONPP_TYPE_STRING:
-            fprintf(vm->debug_output, "\"%s\"", var->value.str ? var->value.str : "(null)");
+            fprintf(vm->debug_output, "\"%s\"", value->str ? value->str : "(null)");
             break;
           default:
             fprintf(vm->debug_output, "(unhandled type)");
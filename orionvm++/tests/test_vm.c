@@ -3,15 +3,117 @@
  * @brief Test program for the Orion++ Virtual Machine
  */
 
+#ifndef WIN32
+  #define _XOPEN_SOURCE 700 // POSIX 2008 and random
+#endif
+
 #include "vm.h"
 #include "executor.h"
 #include "validator.h"
+#include "decoder.h"
+#include "batch.h"
+#include "loader.h"
+#include "profile.h"
+#include "jit.h"
+#include "native.h"
+#include "superinstructions.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
+#ifndef WIN32
+  #include <pthread.h>
+  #include <time.h>
+  #include <unistd.h>
+#endif
+
 // Test helper functions
+static void set_operand(orinopp_value_t* value, orionpp_type_t type, uint32_t id) {
+  value->root = type;
+  value->child = 0;
+  value->bytes = malloc(sizeof(id));
+  memcpy(value->bytes, &id, sizeof(id));
+  value->bytesize = sizeof(id);
+}
+
+static void set_instruction(orinopp_instruction_t* instr, orionpp_opcode_module_t op, size_t value_count) {
+  instr->root = ORIONPP_OP_ISA;
+  instr->child = op;
+  instr->value_count = value_count;
+  instr->values = calloc(value_count ? value_count : 1, sizeof(orinopp_value_t));
+}
+
+// Builds: var c, n, one; c = 0; n = limit; one = 1; loop: c = c + one; brlt c n loop; ret c
+static void load_counter_program(OrionVM* vm, int32_t limit) {
+  const int32_t values[3] = { 0, limit, 1 };
+  vm->instruction_count = 10;
+  vm->instructions = realloc(vm->instructions, vm->instruction_count * sizeof(orinopp_instruction_t));
+  orinopp_instruction_t* in = vm->instructions;
+  
+  for (uint32_t id = 0; id < 3; id++) {
+    set_instruction(&in[id], ORIONPP_OP_ISA_VAR, 2);
+    set_operand(&in[id].values[0], ORIONPP_TYPE_VARID, id);
+    in[id].values[1].root = ORIONPP_TYPE_WORD;
+  
+    set_instruction(&in[3 + id], ORIONPP_OP_ISA_CONST, 3);
+    set_operand(&in[3 + id].values[0], ORIONPP_TYPE_VARID, id);
+    in[3 + id].values[1].root = ORIONPP_TYPE_WORD;
+    set_operand(&in[3 + id].values[2], ORIONPP_TYPE_WORD, (uint32_t)values[id]);
+  }
+  
+  set_instruction(&in[6], ORIONPP_OP_ISA_LABEL, 1);
+  set_operand(&in[6].values[0], ORIONPP_TYPE_LABELID, 7);
+  
+  set_instruction(&in[7], ORIONPP_OP_ISA_ADD, 3);
+  set_operand(&in[7].values[0], ORIONPP_TYPE_VARID, 0);
+  set_operand(&in[7].values[1], ORIONPP_TYPE_VARID, 0);
+  set_operand(&in[7].values[2], ORIONPP_TYPE_VARID, 2);
+  
+  set_instruction(&in[8], ORIONPP_OP_ISA_BRLT, 3);
+  set_operand(&in[8].values[0], ORIONPP_TYPE_VARID, 0);
+  set_operand(&in[8].values[1], ORIONPP_TYPE_VARID, 1);
+  set_operand(&in[8].values[2], ORIONPP_TYPE_LABELID, 7);
+  
+  set_instruction(&in[9], ORIONPP_OP_ISA_RET, 1);
+  set_operand(&in[9].values[0], ORIONPP_TYPE_VARID, 0);
+}
+
+// Builds: index = 0; x = input(index); three = 3; var r; r = x * three; ret r
+static void load_input_program(OrionVM* vm) {
+  vm->instruction_count = 6;
+  orinopp_instruction_t* in = vm->instructions;
+  
+  set_instruction(&in[0], ORIONPP_OP_ISA_CONST, 3);
+  set_operand(&in[0].values[0], ORIONPP_TYPE_VARID, 1);
+  in[0].values[1].root = ORIONPP_TYPE_WORD;
+  set_operand(&in[0].values[2], ORIONPP_TYPE_WORD, 0);
+  
+  set_instruction(&in[1], ORIONPP_OP_ISA_CALL, 3);
+  set_operand(&in[1].values[0], ORIONPP_TYPE_VARID, 0);
+  in[1].values[1].root = ORIONPP_TYPE_SYMBOL;
+  in[1].values[1].bytes = strdup("input");
+  in[1].values[1].bytesize = 5;
+  set_operand(&in[1].values[2], ORIONPP_TYPE_VARID, 1);
+  
+  set_instruction(&in[2], ORIONPP_OP_ISA_CONST, 3);
+  set_operand(&in[2].values[0], ORIONPP_TYPE_VARID, 2);
+  in[2].values[1].root = ORIONPP_TYPE_WORD;
+  set_operand(&in[2].values[2], ORIONPP_TYPE_WORD, 3);
+  
+  set_instruction(&in[3], ORIONPP_OP_ISA_VAR, 2);
+  set_operand(&in[3].values[0], ORIONPP_TYPE_VARID, 3);
+  in[3].values[1].root = ORIONPP_TYPE_WORD;
+  
+  set_instruction(&in[4], ORIONPP_OP_ISA_MUL, 3);
+  set_operand(&in[4].values[0], ORIONPP_TYPE_VARID, 3);
+  set_operand(&in[4].values[1], ORIONPP_TYPE_VARID, 0);
+  set_operand(&in[4].values[2], ORIONPP_TYPE_VARID, 2);
+  
+  set_instruction(&in[5], ORIONPP_OP_ISA_RET, 1);
+  set_operand(&in[5].values[0], ORIONPP_TYPE_VARID, 3);
+}
+
 static void test_vm_init_destroy() {
   printf("Testing VM initialization and destruction...\n");
   
@@ -19,7 +121,9 @@ static void test_vm_init_destroy() {
   int result = ovm_init(&vm);
   assert(result == 0);
   assert(vm.instructions != NULL);
+  assert(vm.values != NULL);
   assert(vm.variables != NULL);
+  assert(sizeof(VMValue) == 8 && sizeof(VMVariable) == 8);
   assert(vm.labels != NULL);
   assert(vm.call_stack != NULL);
   assert(vm.instruction_count == 0);
@@ -58,18 +162,41 @@ static void test_variable_management() {
   found = ovm_get_variable(&vm, 999);
   assert(found == NULL);
   
+  // Variables and values are indexed directly by id, up to the variable limit
+  VMVariable* high = ovm_create_variable(&vm, OVM_MAX_VARIABLES - 1, ORIONPP_TYPE_WORD);
+  assert(high != NULL);
+  assert(ovm_get_variable(&vm, OVM_MAX_VARIABLES - 1) == high);
+  
+  // Growing the entry frame moved the variables declared before
+  var1 = ovm_get_variable(&vm, 1);
+  var2 = ovm_get_variable(&vm, 2);
+  assert(var1 != NULL && var1->id == 1 && var1->type == ORIONPP_TYPE_WORD);
+  assert(var2 != NULL && var2->id == 2 && var2->type == ORIONPP_TYPE_STRING);
+  assert(ovm_lookup_variable(&vm, 1) == var1);
+  assert(ovm_variable_value(&vm, high) == &vm.values[OVM_MAX_VARIABLES - 1]);
+  assert(ovm_create_variable(&vm, OVM_MAX_VARIABLES, ORIONPP_TYPE_WORD) == NULL);
+  assert(ovm_has_error(&vm));
+  vm.error = false;
+  
   // Test setting variable values
   int32_t int_value = 42;
   int result = ovm_set_variable_value(&vm, 1, &int_value, sizeof(int_value));
   assert(result == 0);
   assert(var1->is_initialized == true);
-  assert(var1->value.i64 == 42);
+  assert(ovm_variable_value(&vm, var1)->i64 == 42);
   
   const char* str_value = "Hello, World!";
   result = ovm_set_variable_value(&vm, 2, str_value, strlen(str_value));
   assert(result == 0);
   assert(var2->is_initialized == true);
-  assert(strcmp(var2->value.str, "Hello, World!") == 0);
+  assert(strcmp(ovm_variable_value(&vm, var2)->str, "Hello, World!") == 0);
+  
+  // Reset drops the variables but keeps the tables allocated
+  ovm_reset(&vm);
+  assert(ovm_get_variable(&vm, 1) == NULL);
+  assert(ovm_get_variable(&vm, OVM_MAX_VARIABLES - 1) == NULL);
+  assert(vm.variable_count == 0 && vm.values != NULL && vm.variables != NULL);
+  assert(vm.values[1].i64 == 0);
   
   ovm_destroy(&vm);
   printf("✓ Variable management test passed\n");
@@ -98,6 +225,18 @@ static void test_label_management() {
   addr = ovm_find_label(&vm, 999);
   assert(addr == SIZE_MAX);
   
+  // Redefinition keeps the first target and does not grow the table
+  result = ovm_register_label(&vm, 100, 42);
+  assert(result == 0);
+  assert(ovm_find_label(&vm, 100) == 5);
+  assert(vm.label_count == 2);
+  
+  // Ids index the jump table directly, so they are bounded
+  result = ovm_register_label(&vm, OVM_MAX_LABELS, 1);
+  assert(result == -1);
+  assert(ovm_has_error(&vm));
+  assert(ovm_find_label(&vm, OVM_MAX_LABELS) == SIZE_MAX);
+  
   ovm_destroy(&vm);
   printf("✓ Label management test passed\n");
 }
@@ -125,7 +264,7 @@ static void test_validation() {
   assert(result == OVM_UNINITIALIZED_VARIABLE);
   
   var->is_initialized = true;
-  var->value.i64 = 10;
+  ovm_variable_value(&vm, var)->i64 = 10;
   result = ovm_validate_variable_initialization(&vm, var);
   assert(result == OVM_VALID);
   
@@ -133,7 +272,7 @@ static void test_validation() {
   result = ovm_validate_division(&vm, var);
   assert(result == OVM_VALID);
   
-  var->value.i64 = 0;
+  ovm_variable_value(&vm, var)->i64 = 0;
   result = ovm_validate_division(&vm, var);
   assert(result == OVM_DIVISION_BY_ZERO);
   
@@ -318,13 +457,13 @@ static void test_type_system() {
   VMVariable* src = ovm_create_variable(&vm, 1, ORIONPP_TYPE_WORD);
   VMVariable* dest = ovm_create_variable(&vm, 2, ORIONPP_TYPE_SIZE);
   
-  src->value.i64 = 123;
+  ovm_variable_value(&vm, src)->i64 = 123;
   src->is_initialized = true;
   
-  int result = ovm_convert_value(dest, src, ORIONPP_TYPE_SIZE);
+  int result = ovm_convert_value(&vm, dest, src, ORIONPP_TYPE_SIZE);
   assert(result == 0);
   assert(dest->is_initialized == true);
-  assert(dest->value.i64 == 123);
+  assert(ovm_variable_value(&vm, dest)->i64 == 123);
   
   ovm_destroy(&vm);
   printf("✓ Type system test passed\n");
@@ -382,6 +521,1173 @@ static void test_memory_safety() {
   printf("✓ Memory safety test passed\n");
 }
 
+static void test_decoded_dispatch() {
+  printf("Testing pre-decoded dispatch...\n");
+  
+  OrionVM vm;
+  ovm_init(&vm);
+  load_counter_program(&vm, 1000);
+  
+  int result = ovm_run(&vm);
+  assert(result == 0);
+  assert(vm.decoded != NULL);
+  assert(vm.decoded_count == vm.instruction_count + 1);
+  assert(vm.decoded[7].op == OVM_DOP_ADD);
+  assert(vm.decoded[8].op == OVM_DOP_BRLT);
+  assert(vm.decoded[8].target == 6);
+  assert(vm.decoded[vm.instruction_count].op == OVM_DOP_HALT);
+  assert(vm.return_value.is_initialized);
+  assert(vm.return_value.value.i64 == 1000);
+  
+  // The per-step path must agree with the decoded loop
+  OrionVM stepped;
+  ovm_init(&stepped);
+  load_counter_program(&stepped, 1000);
+  ovm_set_debug_mode(&stepped, true, NULL);
+  result = ovm_run(&stepped);
+  assert(result == 0);
+  assert(stepped.return_value.value.i64 == vm.return_value.value.i64);
+  
+  // Labels and the decoded stream are program state and survive a reset
+  const VMDecodedInstr* decoded = vm.decoded;
+  ovm_reset(&vm);
+  assert(vm.labels_resolved);
+  assert(vm.label_count == 1);
+  assert(ovm_find_label(&vm, 7) == 6);
+  assert(vm.decoded == decoded);
+  
+  result = ovm_run(&vm);
+  assert(result == 0);
+  assert(vm.label_count == 1);
+  assert(vm.decoded == decoded);
+  assert(vm.return_value.value.i64 == 1000);
+  
+  ovm_destroy(&stepped);
+  ovm_destroy(&vm);
+  printf("✓ Pre-decoded dispatch test passed\n");
+}
+
+// Whether the superinstruction table decoder.c was built with has a run
+#define SUPER_PAIR_MATCH(a, b) || (first == OVM_DOP_##a && second == OVM_DOP_##b)
+#define SUPER_TRIPLE_MATCH(a, b, c) || (first == OVM_DOP_##a && second == OVM_DOP_##b && third == OVM_DOP_##c)
+static bool has_super_pair(VMDecodedOp first, VMDecodedOp second) {
+  return false OVM_SUPER_PAIRS(SUPER_PAIR_MATCH);
+}
+static bool has_super_triple(VMDecodedOp first, VMDecodedOp second, VMDecodedOp third) {
+  return false OVM_SUPER_TRIPLES(SUPER_TRIPLE_MATCH);
+}
+
+static void test_superinstructions() {
+  printf("Testing superinstructions...\n");
+  
+  // Profiling counts the plain ops: the loop is label, add, brlt
+  OrionVM profiled;
+  ovm_init(&profiled);
+  load_counter_program(&profiled, 1000);
+  VMProfile* profile = ovm_profile_create();
+  assert(profile != NULL);
+  assert(ovm_set_profile(&profiled, profile) == 0);
+  assert(ovm_run(&profiled) == 0);
+  assert(profiled.return_value.value.i64 == 1000);
+  assert(profiled.decoded_profiled);
+  assert(profile->ops[OVM_DOP_ADD] == 1000);
+  assert(profile->ops[OVM_DOP_BRLT] == 1000);
+  assert(profile->pairs[OVM_DOP_NOP][OVM_DOP_ADD] == 1000);
+  assert(profile->pairs[OVM_DOP_ADD][OVM_DOP_BRLT] == 1000);
+  // Taken branches are not fall-through pairs
+  assert(profile->pairs[OVM_DOP_BRLT][OVM_DOP_NOP] == 0);
+  
+  // The table written from this profile fuses the whole loop
+  const char* path = "ovm_test_superinstructions.h";
+  remove(path);
+  assert(ovm_profile_update_super_table(profile, "counter", path) == 0);
+  assert(ovm_profile_update_super_table(profile, "counter", path) == 0);
+  FILE* table = fopen(path, "r");
+  assert(table != NULL);
+  char line[128];
+  size_t programs = 0;
+  bool found_count = false, found_pair = false, found_triple = false;
+  while (fgets(line, sizeof(line), table)) {
+    if (strcmp(line, "// program counter\n") == 0) programs++;
+    // The second update added the first one's counts to the profile's
+    if (strcmp(line, "// pair ADD BRLT 2000\n") == 0) found_count = true;
+    if (strstr(line, "X(ADD, BRLT)")) found_pair = true;
+    if (strstr(line, "X(NOP, ADD, BRLT)")) found_triple = true;
+  }
+  fclose(table);
+  remove(path);
+  assert(programs == 2);
+  assert(found_count && found_pair && found_triple);
+  
+  // Dropping the profile rebinds the stream with the loop fused as far as
+  // the built-in table goes
+  assert(ovm_set_profile(&profiled, NULL) == 0);
+  ovm_reset(&profiled);
+  assert(ovm_run(&profiled) == 0);
+  assert(!profiled.decoded_profiled);
+  bool head = has_super_triple(OVM_DOP_NOP, OVM_DOP_ADD, OVM_DOP_BRLT) || has_super_pair(OVM_DOP_NOP, OVM_DOP_ADD);
+  assert((profiled.decoded[6].slot >= 2 * OVM_DOP_COUNT) == head);
+  // Records inside a run are bound too, for jumps into the middle
+  bool tail = has_super_pair(OVM_DOP_ADD, OVM_DOP_BRLT);
+  assert((profiled.decoded[7].slot >= 2 * OVM_DOP_COUNT) == tail);
+  assert(profiled.decoded[8].slot == OVM_DOP_COUNT + OVM_DOP_BRLT);
+  assert(profiled.return_value.value.i64 == 1000);
+  
+  // The checked tier never fuses
+  OrionVM checked;
+  ovm_init(&checked);
+  ovm_set_validation_level(&checked, OVM_VALIDATE_STRICT);
+  load_counter_program(&checked, 1000);
+  assert(ovm_run(&checked) == 0);
+  assert(checked.decoded[6].slot == OVM_DOP_NOP);
+  assert(checked.return_value.value.i64 == 1000);
+  
+  ovm_profile_destroy(profile);
+  ovm_destroy(&checked);
+  ovm_destroy(&profiled);
+  printf("✓ Superinstructions test passed\n");
+}
+
+static void test_profile() {
+  printf("Testing execution profile...\n");
+  
+  OrionVM vm;
+  ovm_init(&vm);
+  load_counter_program(&vm, 1000);
+  VMProfile* profile = ovm_profile_create();
+  assert(profile != NULL);
+  assert(ovm_set_profile(&vm, profile) == 0);
+  assert(ovm_run(&vm) == 0);
+  
+  // The label is entered once by falling through and 999 times by the branch
+  assert(profile->record_count >= vm.decoded_count);
+  assert(profile->records[0] == 1);
+  assert(profile->records[6] == 1000);
+  assert(profile->records[7] == 1000);
+  assert(profile->records[8] == 1000);
+  assert(profile->records[9] == 1);
+  
+  uint64_t ticks = 0;
+  for (int op = 0; op < OVM_DOP_COUNT; op++) ticks += profile->op_ticks[op];
+  assert(ticks > 0);
+  
+  // Counts accumulate across runs
+  ovm_reset(&vm);
+  assert(ovm_run(&vm) == 0);
+  assert(profile->records[7] == 2000);
+  assert(profile->ops[OVM_DOP_ADD] == 2000);
+  
+  // One folded stack per record that ran, under the label it follows
+  FILE* folded = tmpfile();
+  assert(folded != NULL);
+  assert(ovm_profile_write_folded(profile, &vm, "counter", folded) == 0);
+  rewind(folded);
+  char line[128];
+  size_t lines = 0;
+  bool found_add = false;
+  while (fgets(line, sizeof(line), folded)) {
+    lines++;
+    if (strncmp(line, "counter;L7;ADD ", 15) == 0) found_add = true;
+  }
+  assert(lines == vm.instruction_count);
+  assert(found_add);
+  fclose(folded);
+  
+  FILE* report = tmpfile();
+  assert(report != NULL);
+  ovm_profile_print(profile, &vm, report, 5);
+  assert(ftell(report) > 0);
+  fclose(report);
+  
+  // Counting handlers write the VM's own profile, so images never carry them
+  assert(ovm_program_create(&vm) == NULL);
+  assert(vm.program == NULL);
+  OrionVM loader;
+  ovm_init(&loader);
+  load_counter_program(&loader, 10);
+  VMProgram* program = ovm_program_create(&loader);
+  assert(program != NULL);
+  assert(ovm_attach_program(&vm, program) == -1);
+  assert(vm.program == NULL);
+  assert(ovm_set_profile(&loader, profile) == -1);
+  ovm_program_release(program);
+  ovm_destroy(&loader);
+  
+  ovm_profile_destroy(profile);
+  ovm_destroy(&vm);
+  printf("✓ Execution profile test passed\n");
+}
+
+// Differential harness for the JIT: random integer programs over these
+// variables, run on the interpreter and on native code
+enum {
+  JIT_SHIFT, // shift count, 0-15
+  JIT_DIVISOR, // 1-9
+  JIT_MASK, // keeps every result small, so nothing overflows
+  JIT_COUNTER,
+  JIT_LIMIT,
+  JIT_DATA, // first of the variables the program computes with
+  JIT_VARIABLES = JIT_DATA + 6
+};
+
+static uint32_t next_random(uint64_t* state) {
+  *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+  return (uint32_t)(*state >> 33);
+}
+
+static orinopp_instruction_t* add_instruction(OrionVM* vm, orionpp_opcode_module_t op, size_t value_count) {
+  orinopp_instruction_t* instr = &vm->instructions[vm->instruction_count++];
+  set_instruction(instr, op, value_count);
+  return instr;
+}
+
+static void add_variables(orinopp_instruction_t* instr, size_t count, uint32_t a, uint32_t b, uint32_t c) {
+  const uint32_t ids[3] = { a, b, c };
+  for (size_t i = 0; i < count; i++) set_operand(&instr->values[i], ORIONPP_TYPE_VARID, ids[i]);
+}
+
+static void add_const(OrionVM* vm, uint32_t id, uint32_t value) {
+  orinopp_instruction_t* instr = add_instruction(vm, ORIONPP_OP_ISA_CONST, 3);
+  set_operand(&instr->values[0], ORIONPP_TYPE_VARID, id);
+  instr->values[1].root = ORIONPP_TYPE_WORD;
+  set_operand(&instr->values[2], ORIONPP_TYPE_WORD, value);
+}
+
+static void add_label(OrionVM* vm, uint32_t label) {
+  set_operand(&add_instruction(vm, ORIONPP_OP_ISA_LABEL, 1)->values[0], ORIONPP_TYPE_LABELID, label);
+}
+
+// One random operation on the data variables, masked back into range
+static void add_random_operation(OrionVM* vm, uint64_t* state) {
+  static const orionpp_opcode_module_t binary[] = {
+    ORIONPP_OP_ISA_ADD, ORIONPP_OP_ISA_SUB, ORIONPP_OP_ISA_MUL, ORIONPP_OP_ISA_DIV, ORIONPP_OP_ISA_MOD,
+    ORIONPP_OP_ISA_AND, ORIONPP_OP_ISA_OR, ORIONPP_OP_ISA_XOR, ORIONPP_OP_ISA_SHL, ORIONPP_OP_ISA_SHR
+  };
+  static const orionpp_opcode_module_t unary[] = {
+    ORIONPP_OP_ISA_MOV, ORIONPP_OP_ISA_INC, ORIONPP_OP_ISA_DEC, ORIONPP_OP_ISA_INCp, ORIONPP_OP_ISA_DECp, ORIONPP_OP_ISA_NOT
+  };
+  uint32_t dest = JIT_DATA + next_random(state) % (JIT_VARIABLES - JIT_DATA);
+  uint32_t left = JIT_DATA + next_random(state) % (JIT_VARIABLES - JIT_DATA);
+  uint32_t right = JIT_DATA + next_random(state) % (JIT_VARIABLES - JIT_DATA);
+  
+  uint32_t pick = next_random(state) % 24;
+  if (pick < 10) {
+    orionpp_opcode_module_t op = binary[pick];
+    if (op == ORIONPP_OP_ISA_DIV || op == ORIONPP_OP_ISA_MOD) right = JIT_DIVISOR;
+    if (op == ORIONPP_OP_ISA_SHL || op == ORIONPP_OP_ISA_SHR) right = JIT_SHIFT;
+    add_variables(add_instruction(vm, op, 3), 3, dest, left, right);
+  } else if (pick < 16) {
+    add_variables(add_instruction(vm, unary[pick - 10], 2), 2, dest, left, 0);
+  } else if (pick < 18) {
+    add_const(vm, dest, next_random(state) % 1000);
+  } else {
+    add_variables(add_instruction(vm, ORIONPP_OP_ISA_ADD, 3), 3, dest, left, right);
+  }
+  add_variables(add_instruction(vm, ORIONPP_OP_ISA_AND, 3), 3, dest, dest, JIT_MASK);
+}
+
+// A loop of random operations with forward branches and jumps around some of them
+static void load_random_program(OrionVM* vm, uint64_t seed) {
+  uint64_t state = seed;
+  uint32_t label = 1;
+  vm->instruction_count = 0;
+  
+  for (uint32_t id = 0; id < JIT_VARIABLES; id++) {
+    orinopp_instruction_t* var = add_instruction(vm, ORIONPP_OP_ISA_VAR, 2);
+    set_operand(&var->values[0], ORIONPP_TYPE_VARID, id);
+    var->values[1].root = ORIONPP_TYPE_WORD;
+  }
+  add_const(vm, JIT_SHIFT, next_random(&state) % 16);
+  add_const(vm, JIT_DIVISOR, 1 + next_random(&state) % 9);
+  add_const(vm, JIT_MASK, 0xFFFF);
+  add_const(vm, JIT_COUNTER, 0);
+  add_const(vm, JIT_LIMIT, 1 + next_random(&state) % 20);
+  for (uint32_t id = JIT_DATA; id < JIT_VARIABLES; id++) add_const(vm, id, next_random(&state) % 1000);
+  
+  uint32_t loop = label++;
+  add_label(vm, loop);
+  size_t operations = 4 + next_random(&state) % 20;
+  for (size_t i = 0; i < operations; i++) {
+    uint32_t kind = next_random(&state) % 8;
+    if (kind == 0) {
+      // Compare two data variables and maybe skip the next operations
+      static const orionpp_opcode_module_t branches[] = {
+        ORIONPP_OP_ISA_BREQ, ORIONPP_OP_ISA_BRNEQ, ORIONPP_OP_ISA_BRGT,
+        ORIONPP_OP_ISA_BRGE, ORIONPP_OP_ISA_BRLT, ORIONPP_OP_ISA_BRLE
+      };
+      uint32_t skip = label++;
+      orinopp_instruction_t* branch = add_instruction(vm, branches[next_random(&state) % 6], 3);
+      add_variables(branch, 2, JIT_DATA + next_random(&state) % (JIT_VARIABLES - JIT_DATA),
+                    JIT_DATA + next_random(&state) % (JIT_VARIABLES - JIT_DATA), 0);
+      set_operand(&branch->values[2], ORIONPP_TYPE_LABELID, skip);
+      add_random_operation(vm, &state);
+      add_label(vm, skip);
+    } else if (kind == 1) {
+      uint32_t skip = label++;
+      orinopp_instruction_t* branch = add_instruction(vm, next_random(&state) % 2 ? ORIONPP_OP_ISA_BRZ : ORIONPP_OP_ISA_BRNZ, 2);
+      set_operand(&branch->values[0], ORIONPP_TYPE_VARID, JIT_DATA + next_random(&state) % (JIT_VARIABLES - JIT_DATA));
+      set_operand(&branch->values[1], ORIONPP_TYPE_LABELID, skip);
+      add_random_operation(vm, &state);
+      add_label(vm, skip);
+    } else if (kind == 2) {
+      uint32_t skip = label++;
+      set_operand(&add_instruction(vm, ORIONPP_OP_ISA_JMP, 1)->values[0], ORIONPP_TYPE_LABELID, skip);
+      add_random_operation(vm, &state);
+      add_label(vm, skip);
+    } else {
+      add_random_operation(vm, &state);
+    }
+  }
+  
+  add_variables(add_instruction(vm, ORIONPP_OP_ISA_INC, 2), 2, JIT_COUNTER, JIT_COUNTER, 0);
+  orinopp_instruction_t* back = add_instruction(vm, ORIONPP_OP_ISA_BRLT, 3);
+  add_variables(back, 2, JIT_COUNTER, JIT_LIMIT, 0);
+  set_operand(&back->values[2], ORIONPP_TYPE_LABELID, loop);
+  add_variables(add_instruction(vm, ORIONPP_OP_ISA_RET, 1), 1, JIT_DATA, 0, 0);
+}
+
+// Runs a loop over x, which input(0) == 0 makes a WORD from input(1) and
+// anything else a SIZE of 2; returns 50 * x. The verifier rejects x's two
+// types, so this runs on the checked handlers.
+static void load_speculation_program(OrionVM* vm) {
+  enum { SELECTOR, X, COUNTER, LIMIT, SUM, FIRST, SECOND };
+  vm->instruction_count = 0;
+  add_const(vm, FIRST, 0);
+  orinopp_instruction_t* call = add_instruction(vm, ORIONPP_OP_ISA_CALL, 3);
+  add_variables(call, 3, SELECTOR, 0, FIRST);
+  call->values[1].root = ORIONPP_TYPE_SYMBOL;
+  call->values[1].bytes = strdup("input");
+  call->values[1].bytesize = 5;
+  orinopp_instruction_t* branch = add_instruction(vm, ORIONPP_OP_ISA_BRZ, 2);
+  set_operand(&branch->values[0], ORIONPP_TYPE_VARID, SELECTOR);
+  set_operand(&branch->values[1], ORIONPP_TYPE_LABELID, 1);
+  
+  orinopp_instruction_t* var = add_instruction(vm, ORIONPP_OP_ISA_VAR, 2);
+  set_operand(&var->values[0], ORIONPP_TYPE_VARID, X);
+  var->values[1].root = ORIONPP_TYPE_SIZE;
+  add_const(vm, X, 2);
+  vm->instructions[vm->instruction_count - 1].values[1].root = ORIONPP_TYPE_SIZE;
+  set_operand(&add_instruction(vm, ORIONPP_OP_ISA_JMP, 1)->values[0], ORIONPP_TYPE_LABELID, 2);
+  
+  add_label(vm, 1);
+  add_const(vm, SECOND, 1);
+  call = add_instruction(vm, ORIONPP_OP_ISA_CALL, 3);
+  add_variables(call, 3, X, 0, SECOND);
+  call->values[1].root = ORIONPP_TYPE_SYMBOL;
+  call->values[1].bytes = strdup("input");
+  call->values[1].bytesize = 5;
+  
+  add_label(vm, 2);
+  add_const(vm, COUNTER, 0);
+  add_const(vm, LIMIT, 50);
+  add_const(vm, SUM, 0);
+  add_label(vm, 3);
+  add_variables(add_instruction(vm, ORIONPP_OP_ISA_ADD, 3), 3, SUM, SUM, X);
+  add_variables(add_instruction(vm, ORIONPP_OP_ISA_INC, 2), 2, COUNTER, COUNTER, 0);
+  orinopp_instruction_t* back = add_instruction(vm, ORIONPP_OP_ISA_BRLT, 3);
+  add_variables(back, 2, COUNTER, LIMIT, 0);
+  set_operand(&back->values[2], ORIONPP_TYPE_LABELID, 3);
+  add_variables(add_instruction(vm, ORIONPP_OP_ISA_RET, 1), 1, SUM, 0, 0);
+}
+
+static void test_jit() {
+  printf("Testing JIT...\n");
+  
+#ifdef OVM_JIT
+  size_t compiled = 0, regions = 0, guarded = 0;
+  for (uint64_t seed = 0; seed < 900; seed++) {
+    // Each program compiles up front, then tiers up once its loop has run
+    // twice, on the verified and on the checked handlers
+    OrionVM interpreted, native;
+    ovm_init(&interpreted);
+    ovm_init(&native);
+    load_random_program(&interpreted, 1 + seed / 3);
+    load_random_program(&native, 1 + seed / 3);
+    assert(ovm_set_jit(&native, seed % 3 == 0 ? OVM_JIT_EAGER : OVM_JIT_TIERED) == 0);
+    native.jit_threshold = 2;
+    if (seed % 3 == 2) ovm_set_validation_level(&native, OVM_VALIDATE_STRICT);
+  
+    assert(ovm_run(&interpreted) == 0);
+    assert(ovm_run(&native) == 0);
+    assert(native.run_mode == (seed % 3 == 2 ? OVM_RUN_CHECKED : OVM_RUN_VERIFIED));
+    assert(native.jit != NULL);
+    compiled += native.jit->compiled_count;
+    if (seed % 3 != 0) regions += native.jit->region_count;
+    if (seed % 3 == 2 && native.jit->region_count > 0) guarded += native.jit->regions[0].guard_count;
+  
+    assert(native.return_value.value.i64 == interpreted.return_value.value.i64);
+    for (uint32_t id = 0; id < JIT_VARIABLES; id++) {
+      VMVariable* expected = ovm_get_variable(&interpreted, id);
+      VMVariable* actual = ovm_get_variable(&native, id);
+      assert(expected && actual);
+      assert(actual->is_initialized == expected->is_initialized);
+      assert(ovm_variable_value(&native, actual)->i64 == ovm_variable_value(&interpreted, expected)->i64);
+    }
+  
+    // Reset variables are recreated by the interpreter, then native code resumes
+    ovm_reset(&native);
+    assert(ovm_run(&native) == 0);
+    assert(native.return_value.value.i64 == interpreted.return_value.value.i64);
+  
+    ovm_destroy(&native);
+    ovm_destroy(&interpreted);
+  }
+  assert(compiled > 0);
+  assert(regions > 0 && guarded > 0);
+  
+  // Loops tier up mid-run once hot, and not at all in short runs
+  const int64_t word_inputs[] = { 0, 3 };
+  const int64_t char_inputs[] = { 1 };
+  OrionVM tiered;
+  ovm_init(&tiered);
+  load_speculation_program(&tiered);
+  assert(ovm_set_jit(&tiered, OVM_JIT_TIERED) == 0);
+  ovm_set_inputs(&tiered, word_inputs, 2);
+  assert(ovm_run(&tiered) == 0);
+  assert(tiered.return_value.value.i64 == 150);
+  assert(tiered.run_mode == OVM_RUN_CHECKED);
+  assert(tiered.jit != NULL && tiered.jit->region_count == 0);
+  
+  tiered.jit_threshold = 10;
+  ovm_reset(&tiered);
+  assert(ovm_run(&tiered) == 0);
+  assert(tiered.return_value.value.i64 == 150);
+  assert(tiered.jit->region_count == 1 && tiered.jit->deopt_count == 0);
+  size_t head = tiered.decoded[tiered.decoded_count - 3].target;
+  assert(tiered.jit->entries[head] != NULL);
+  
+  // The same loop over a SIZE instead of a WORD fails its guard, runs on the
+  // interpreter, and tiers up again with the new type
+  ovm_reset(&tiered);
+  ovm_set_inputs(&tiered, char_inputs, 1);
+  assert(ovm_run(&tiered) == 0);
+  assert(tiered.return_value.value.i64 == 100);
+  assert(tiered.jit->deopt_count == 1 && tiered.jit->region_count == 2);
+  assert(tiered.jit->entries[head] != NULL);
+  
+  // Changing the mode drops the code
+  assert(ovm_set_jit(&tiered, OVM_JIT_OFF) == 0);
+  assert(tiered.jit == NULL);
+  ovm_reset(&tiered);
+  ovm_set_inputs(&tiered, word_inputs, 2);
+  assert(ovm_run(&tiered) == 0);
+  assert(tiered.return_value.value.i64 == 150);
+  ovm_destroy(&tiered);
+  
+  // Native code hands a division by zero back, so the error and pc are the interpreter's
+  OrionVM vm;
+  ovm_init(&vm);
+  ovm_set_jit(&vm, OVM_JIT_EAGER);
+  vm.instruction_count = 0;
+  for (uint32_t id = 0; id < 3; id++) {
+    orinopp_instruction_t* var = add_instruction(&vm, ORIONPP_OP_ISA_VAR, 2);
+    set_operand(&var->values[0], ORIONPP_TYPE_VARID, id);
+    var->values[1].root = ORIONPP_TYPE_WORD;
+  }
+  add_const(&vm, 0, 10);
+  add_const(&vm, 1, 0);
+  add_variables(add_instruction(&vm, ORIONPP_OP_ISA_DIV, 3), 3, 2, 0, 1);
+  add_variables(add_instruction(&vm, ORIONPP_OP_ISA_RET, 1), 1, 2, 0, 0);
+  assert(ovm_run(&vm) == -1);
+  assert(vm.jit != NULL && vm.jit->entries[5] != NULL);
+  assert(vm.pc == 5);
+  assert(strstr(ovm_get_error(&vm), "Division by zero") != NULL);
+  ovm_destroy(&vm);
+  
+  // Shared images keep their handlers
+  OrionVM loader;
+  ovm_init(&loader);
+  load_counter_program(&loader, 10);
+  VMProgram* program = ovm_program_create(&loader);
+  assert(program != NULL);
+  assert(ovm_set_jit(&loader, OVM_JIT_TIERED) == -1);
+  
+  // Tiering rebinds the decoded stream, so a compiling VM neither builds nor joins an image
+  OrionVM compiling;
+  ovm_init(&compiling);
+  assert(ovm_set_jit(&compiling, OVM_JIT_TIERED) == 0);
+  assert(ovm_attach_program(&compiling, program) == -1);
+  assert(compiling.program == NULL);
+  load_counter_program(&compiling, 10);
+  assert(ovm_program_create(&compiling) == NULL);
+  assert(compiling.program == NULL);
+  ovm_reset(&compiling);
+  assert(ovm_run(&compiling) == 0);
+  ovm_destroy(&compiling);
+  
+  ovm_program_release(program);
+  ovm_destroy(&loader);
+#else
+  OrionVM vm;
+  ovm_init(&vm);
+  assert(ovm_set_jit(&vm, OVM_JIT_TIERED) == -1);
+  assert(ovm_set_jit(&vm, OVM_JIT_OFF) == 0);
+  ovm_destroy(&vm);
+#endif
+  
+  printf("✓ JIT test passed\n");
+}
+
+static void test_validation_tiers() {
+  printf("Testing validation tiers...\n");
+  
+  const ValidationLevel levels[] = { OVM_VALIDATE_NONE, OVM_VALIDATE_BASIC, OVM_VALIDATE_STRICT, OVM_VALIDATE_PARANOID };
+  const VMRunMode modes[] = { OVM_RUN_VERIFIED, OVM_RUN_VERIFIED, OVM_RUN_CHECKED, OVM_RUN_STEP };
+  
+  for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+    OrionVM vm;
+    ovm_init(&vm);
+    load_counter_program(&vm, 500);
+    ovm_set_validation_level(&vm, levels[i]);
+  
+    assert(ovm_prepare_program(&vm) == 0);
+    assert(vm.run_mode == modes[i]);
+    assert(ovm_run(&vm) == 0);
+    assert(vm.return_value.value.i64 == 500);
+    if (modes[i] == OVM_RUN_VERIFIED) {
+      assert(vm.verified);
+      assert(vm.decoded_verified);
+    }
+  
+    ovm_destroy(&vm);
+  }
+  
+  // Reading a declared but never initialized variable cannot be verified
+  OrionVM vm;
+  ovm_init(&vm);
+  ovm_set_validation_level(&vm, OVM_VALIDATE_BASIC);
+  vm.instruction_count = 3;
+  orinopp_instruction_t* in = vm.instructions;
+  set_instruction(&in[0], ORIONPP_OP_ISA_VAR, 2);
+  set_operand(&in[0].values[0], ORIONPP_TYPE_VARID, 0);
+  in[0].values[1].root = ORIONPP_TYPE_WORD;
+  set_instruction(&in[1], ORIONPP_OP_ISA_ADD, 3);
+  set_operand(&in[1].values[0], ORIONPP_TYPE_VARID, 0);
+  set_operand(&in[1].values[1], ORIONPP_TYPE_VARID, 0);
+  set_operand(&in[1].values[2], ORIONPP_TYPE_VARID, 0);
+  set_instruction(&in[2], ORIONPP_OP_ISA_RET, 1);
+  set_operand(&in[2].values[0], ORIONPP_TYPE_VARID, 0);
+  
+  assert(ovm_verify_program(&vm) == OVM_UNINITIALIZED_VARIABLE);
+  assert(!vm.verified);
+  assert(ovm_prepare_program(&vm) == 0);
+  assert(vm.run_mode == OVM_RUN_CHECKED);
+  
+  // The checked loop still catches it at runtime
+  assert(ovm_run(&vm) == -1);
+  assert(ovm_has_error(&vm));
+
+  ovm_destroy(&vm);
+
+  // Arithmetic on a string, or into one, is no integer operation
+  enum { TEXT, NUMBER };
+  const orionpp_opcode_module_t string_ops[] = { ORIONPP_OP_ISA_ADD, ORIONPP_OP_ISA_INC, ORIONPP_OP_ISA_ADD };
+  const uint32_t operands[][3] = { { TEXT, TEXT, TEXT }, { TEXT, TEXT, 0 }, { TEXT, NUMBER, NUMBER } };
+  for (size_t i = 0; i < sizeof(string_ops) / sizeof(string_ops[0]); i++) {
+    ovm_init(&vm);
+    vm.instruction_count = 0;
+    add_const(&vm, TEXT, 0);
+    vm.instructions[vm.instruction_count - 1].values[1].root = ORIONPP_TYPE_STRING;
+    add_const(&vm, NUMBER, 1);
+    size_t count = string_ops[i] == ORIONPP_OP_ISA_INC ? 2 : 3;
+    add_variables(add_instruction(&vm, string_ops[i], count), count, operands[i][0], operands[i][1], operands[i][2]);
+    add_variables(add_instruction(&vm, ORIONPP_OP_ISA_RET, 1), 1, NUMBER, 0, 0);
+
+    assert(ovm_verify_program(&vm) == OVM_TYPE_MISMATCH);
+    assert(!vm.verified);
+    ovm_destroy(&vm);
+  }
+
+  printf("✓ Validation tiers test passed\n");
+}
+
+// Loops over a SIZE of 2^64 - 2: divides it by a SIZE 2, shifts it right by a
+// SIZE 1 and takes it modulo a WORD 3, then counts the iterations where it is
+// above 2. Every one of these is unsigned, as a SIZE is involved.
+static void load_unsigned_program(OrionVM* vm) {
+  enum { X, TWO, ONE, THREE, QUOTIENT, SHIFTED, REMAINDER, COUNTER, LIMIT, ABOVE, COUNT };
+  static const orionpp_type_t types[COUNT] = {
+    ORIONPP_TYPE_SIZE, ORIONPP_TYPE_SIZE, ORIONPP_TYPE_SIZE, ORIONPP_TYPE_WORD, ORIONPP_TYPE_SIZE,
+    ORIONPP_TYPE_SIZE, ORIONPP_TYPE_SIZE, ORIONPP_TYPE_WORD, ORIONPP_TYPE_WORD, ORIONPP_TYPE_WORD
+  };
+  static const int32_t values[COUNT] = { -2, 2, 1, 3, 0, 0, 0, 0, 20, 0 };
+  vm->instruction_count = 0;
+  for (uint32_t id = 0; id < COUNT; id++) {
+    orinopp_instruction_t* var = add_instruction(vm, ORIONPP_OP_ISA_VAR, 2);
+    set_operand(&var->values[0], ORIONPP_TYPE_VARID, id);
+    var->values[1].root = types[id];
+    add_const(vm, id, (uint32_t)values[id]);
+    vm->instructions[vm->instruction_count - 1].values[1].root = types[id];
+  }
+  
+  add_label(vm, 1);
+  add_variables(add_instruction(vm, ORIONPP_OP_ISA_DIV, 3), 3, QUOTIENT, X, TWO);
+  add_variables(add_instruction(vm, ORIONPP_OP_ISA_SHR, 3), 3, SHIFTED, X, ONE);
+  add_variables(add_instruction(vm, ORIONPP_OP_ISA_MOD, 3), 3, REMAINDER, X, THREE);
+  orinopp_instruction_t* branch = add_instruction(vm, ORIONPP_OP_ISA_BRLE, 3);
+  add_variables(branch, 2, X, TWO, 0);
+  set_operand(&branch->values[2], ORIONPP_TYPE_LABELID, 2);
+  add_variables(add_instruction(vm, ORIONPP_OP_ISA_INC, 2), 2, ABOVE, ABOVE, 0);
+  add_label(vm, 2);
+  add_variables(add_instruction(vm, ORIONPP_OP_ISA_INC, 2), 2, COUNTER, COUNTER, 0);
+  orinopp_instruction_t* back = add_instruction(vm, ORIONPP_OP_ISA_BRLT, 3);
+  add_variables(back, 2, COUNTER, LIMIT, 0);
+  set_operand(&back->values[2], ORIONPP_TYPE_LABELID, 1);
+  add_variables(add_instruction(vm, ORIONPP_OP_ISA_RET, 1), 1, ABOVE, 0, 0);
+}
+
+static void test_unsigned_operations() {
+  printf("Testing unsigned operations...\n");
+  
+  // Every tier picks the same unsigned forms: the verified handlers and the
+  // JIT from the declared types, the checked ones from the variables
+  const ValidationLevel levels[] = { OVM_VALIDATE_BASIC, OVM_VALIDATE_STRICT, OVM_VALIDATE_PARANOID };
+  const VMJitMode jits[] = { OVM_JIT_OFF, OVM_JIT_EAGER, OVM_JIT_TIERED };
+  for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+    for (size_t j = 0; j < sizeof(jits) / sizeof(jits[0]); j++) {
+#ifndef OVM_JIT
+      if (jits[j] != OVM_JIT_OFF) continue;
+#endif
+      OrionVM vm;
+      ovm_init(&vm);
+      load_unsigned_program(&vm);
+      ovm_set_validation_level(&vm, levels[i]);
+      assert(ovm_set_jit(&vm, jits[j]) == 0);
+      vm.jit_threshold = 2;
+  
+      assert(ovm_run(&vm) == 0);
+      assert(vm.return_value.value.i64 == 20);
+      assert(ovm_variable_value(&vm, ovm_get_variable(&vm, 4))->u64 == UINT64_MAX / 2);
+      assert(ovm_variable_value(&vm, ovm_get_variable(&vm, 5))->u64 == UINT64_MAX / 2);
+      assert(ovm_variable_value(&vm, ovm_get_variable(&vm, 6))->u64 == 2);
+      if (levels[i] == OVM_VALIDATE_BASIC) assert(vm.run_mode == OVM_RUN_VERIFIED);
+#ifdef OVM_JIT
+      // Eager mode leaves checked programs on the interpreter
+      bool native = jits[j] == OVM_JIT_TIERED ? vm.run_mode != OVM_RUN_STEP
+                                              : jits[j] == OVM_JIT_EAGER && vm.run_mode == OVM_RUN_VERIFIED;
+      if (native) assert(vm.jit != NULL && vm.jit->compiled_count > 0);
+#endif
+  
+      ovm_destroy(&vm);
+    }
+  }
+  
+  printf("✓ Unsigned operations test passed\n");
+}
+
+static orinopp_instruction_t* add_abi(OrionVM* vm, VMAbiOp op, size_t value_count) {
+  orinopp_instruction_t* instr = add_instruction(vm, op, value_count);
+  instr->root = ORIONPP_OP_ABI;
+  return instr;
+}
+
+static void set_symbol(orinopp_value_t* value, const char* name) {
+  value->root = ORIONPP_TYPE_SYMBOL;
+  value->child = 0;
+  value->bytes = strdup(name);
+  value->bytesize = strlen(name);
+}
+
+// Moves variable id through argument or return slot index
+static void add_abi_move(OrionVM* vm, VMAbiOp op, uint32_t index, uint32_t id) {
+  orinopp_instruction_t* instr = add_abi(vm, op, 2);
+  set_operand(&instr->values[0], ORIONPP_TYPE_WORD, index);
+  set_operand(&instr->values[1], ORIONPP_TYPE_VARID, id);
+}
+
+static orinopp_instruction_t* add_call(OrionVM* vm, uint32_t dest, const char* name, size_t arg_count) {
+  orinopp_instruction_t* instr = add_instruction(vm, ORIONPP_OP_ISA_CALL, 2 + arg_count);
+  set_operand(&instr->values[0], ORIONPP_TYPE_VARID, dest);
+  set_symbol(&instr->values[1], name);
+  return instr;
+}
+
+// Builds: n = 10; fib(n) through the staged arguments; ret. fib recurses with
+// inline arguments on the same ids as its caller.
+static void load_fib_program(OrionVM* vm) {
+  enum { N, R, ONE, TWO, A, B, M };
+  vm->instruction_count = 0;
+  add_const(vm, N, 10);
+  add_abi(vm, OVM_ABI_CALLER_SETUP, 0);
+  add_abi_move(vm, OVM_ABI_CALLER_ARG, 0, N);
+  add_call(vm, R, "fib", 0);
+  add_abi_move(vm, OVM_ABI_CALLER_RET, 0, A);
+  add_abi(vm, OVM_ABI_CALLER_CLEANUP, 0);
+  add_variables(add_instruction(vm, ORIONPP_OP_ISA_RET, 1), 1, A, 0, 0);
+  
+  set_symbol(&add_abi(vm, OVM_ABI_CALLEE_SETUP, 1)->values[0], "fib");
+  add_abi_move(vm, OVM_ABI_CALLEE_ARG, 0, N);
+  for (uint32_t id = R; id <= M; id++) {
+    orinopp_instruction_t* var = add_instruction(vm, ORIONPP_OP_ISA_VAR, 2);
+    set_operand(&var->values[0], ORIONPP_TYPE_VARID, id);
+    var->values[1].root = ORIONPP_TYPE_WORD;
+  }
+  add_const(vm, ONE, 1);
+  add_const(vm, TWO, 2);
+  orinopp_instruction_t* branch = add_instruction(vm, ORIONPP_OP_ISA_BRLT, 3);
+  add_variables(branch, 2, N, TWO, 0);
+  set_operand(&branch->values[2], ORIONPP_TYPE_LABELID, 1);
+  add_variables(add_instruction(vm, ORIONPP_OP_ISA_SUB, 3), 3, M, N, ONE);
+  set_operand(&add_call(vm, A, "fib", 1)->values[2], ORIONPP_TYPE_VARID, M);
+  add_variables(add_instruction(vm, ORIONPP_OP_ISA_SUB, 3), 3, M, M, ONE);
+  set_operand(&add_call(vm, B, "fib", 1)->values[2], ORIONPP_TYPE_VARID, M);
+  add_variables(add_instruction(vm, ORIONPP_OP_ISA_ADD, 3), 3, R, A, B);
+  add_abi_move(vm, OVM_ABI_CALLEE_RET, 0, R);
+  add_variables(add_instruction(vm, ORIONPP_OP_ISA_RET, 1), 1, R, 0, 0);
+  add_label(vm, 1);
+  add_abi_move(vm, OVM_ABI_CALLEE_RET, 0, N);
+  add_instruction(vm, ORIONPP_OP_ISA_RET, 0);
+  add_abi(vm, OVM_ABI_CALLEE_CLEANUP, 0);
+}
+
+static void test_function_calls() {
+  printf("Testing function calls...\n");
+  
+  // Every loop and tier runs the same frames
+  const ValidationLevel levels[] = { OVM_VALIDATE_NONE, OVM_VALIDATE_BASIC, OVM_VALIDATE_STRICT, OVM_VALIDATE_PARANOID };
+  const VMJitMode jits[] = { OVM_JIT_OFF, OVM_JIT_EAGER, OVM_JIT_TIERED };
+  for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+    for (size_t j = 0; j < sizeof(jits) / sizeof(jits[0]); j++) {
+#ifndef OVM_JIT
+      if (jits[j] != OVM_JIT_OFF) continue;
+#endif
+      OrionVM vm;
+      ovm_init(&vm);
+      assert(vm.stack_capacity < OVM_MAX_VARIABLES && vm.call_capacity < OVM_MAX_CALL_DEPTH);
+      load_fib_program(&vm);
+      ovm_set_validation_level(&vm, levels[i]);
+      assert(ovm_set_jit(&vm, jits[j]) == 0);
+      vm.jit_threshold = 2;
+  
+      assert(ovm_run(&vm) == 0);
+      assert(vm.return_value.value.i64 == 55);
+      assert(vm.function_count == 1);
+      assert(vm.call_depth == 0);
+      if (levels[i] == OVM_VALIDATE_BASIC) assert(vm.verified);
+  
+      // The callee's frames left the caller's variables alone
+      assert(ovm_variable_value(&vm, ovm_get_variable(&vm, 0))->i64 == 10);
+      assert(ovm_variable_value(&vm, ovm_get_variable(&vm, 1))->i64 == 55);
+      assert(ovm_get_variable(&vm, 6) == NULL);
+      assert(vm.frame_size == vm.slot_count);
+  
+      // fib recurses, so the run took stacks as deep as the limits allow
+      assert(vm.call_frames == OVM_MAX_CALL_DEPTH && vm.call_capacity == OVM_MAX_CALL_DEPTH);
+  
+      ovm_destroy(&vm);
+    }
+  }
+  
+  // Unbounded recursion stops at the depth limit and leaves no frames behind
+  OrionVM vm;
+  ovm_init(&vm);
+  vm.instruction_count = 0;
+  add_call(&vm, 0, "loop", 0);
+  add_variables(add_instruction(&vm, ORIONPP_OP_ISA_RET, 1), 1, 0, 0, 0);
+  set_symbol(&add_abi(&vm, OVM_ABI_CALLEE_SETUP, 1)->values[0], "loop");
+  add_call(&vm, 0, "loop", 0);
+  add_variables(add_instruction(&vm, ORIONPP_OP_ISA_RET, 1), 1, 0, 0, 0);
+  
+  assert(ovm_run(&vm) == -1);
+  assert(ovm_has_error(&vm));
+  assert(vm.call_depth == OVM_MAX_CALL_DEPTH - 1);
+  assert(vm.call_capacity == OVM_MAX_CALL_DEPTH);
+  ovm_reset(&vm);
+  assert(vm.call_depth == 0);
+  assert(vm.variable_count == 0);
+  assert(vm.values == vm.value_stack);
+  
+  ovm_destroy(&vm);
+  
+  // A string returned from a call reaches the caller's variable
+  ovm_init(&vm);
+  vm.instruction_count = 0;
+  orinopp_instruction_t* var = add_instruction(&vm, ORIONPP_OP_ISA_VAR, 2);
+  set_operand(&var->values[0], ORIONPP_TYPE_VARID, 1);
+  var->values[1].root = ORIONPP_TYPE_STRING;
+  add_call(&vm, 1, "greet", 0);
+  add_variables(add_instruction(&vm, ORIONPP_OP_ISA_RET, 1), 1, 1, 0, 0);
+  set_symbol(&add_abi(&vm, OVM_ABI_CALLEE_SETUP, 1)->values[0], "greet");
+  orinopp_instruction_t* greeting = add_instruction(&vm, ORIONPP_OP_ISA_CONST, 3);
+  set_operand(&greeting->values[0], ORIONPP_TYPE_VARID, 0);
+  greeting->values[1].root = ORIONPP_TYPE_STRING;
+  set_symbol(&greeting->values[2], "hi");
+  greeting->values[2].root = ORIONPP_TYPE_STRING;
+  add_variables(add_instruction(&vm, ORIONPP_OP_ISA_RET, 1), 1, 0, 0, 0);
+  
+  assert(ovm_run(&vm) == 0);
+  assert(vm.return_value.type == ORIONPP_TYPE_STRING && strcmp(vm.return_value.value.str, "hi") == 0);
+  const char* kept = ovm_variable_value(&vm, ovm_get_variable(&vm, 1))->str;
+  assert(strcmp(kept, "hi") == 0 && kept != vm.return_value.value.str);
+  
+  // greet calls nothing: its one slot and frame were all the run reserved
+  assert(vm.call_slots == 1 && vm.call_frames == 1);
+  assert(vm.stack_capacity < OVM_MAX_VARIABLES && vm.call_capacity < OVM_MAX_CALL_DEPTH);
+  ovm_destroy(&vm);
+  
+  // Calls to functions the module does not define are still rejected
+  ovm_init(&vm);
+  ovm_set_validation_level(&vm, OVM_VALIDATE_STRICT);
+  vm.instruction_count = 0;
+  add_call(&vm, 0, "missing", 0);
+  add_variables(add_instruction(&vm, ORIONPP_OP_ISA_RET, 1), 1, 0, 0, 0);
+  assert(ovm_verify_program(&vm) == OVM_INVALID_FUNCTION_CALL);
+  
+  ovm_destroy(&vm);
+  printf("✓ Function calls test passed\n");
+}
+
+// mix(a, b, c) = a * 100 + b * 10 + c
+static int native_mix(OrionVM* vm, VMNativeCall* call) {
+  int64_t digits[3];
+  for (size_t i = 0; i < 3; i++) {
+    if (!call->args[i]) return -1;
+    digits[i] = ovm_variable_value(vm, call->args[i])->i64;
+  }
+  call->result.i64 = digits[0] * 100 + digits[1] * 10 + digits[2];
+  return 0;
+}
+
+// Builds: a, b, c = 1, 2, 3; m = name(a, b, c); ret m
+static void load_native_program(OrionVM* vm, const char* name) {
+  vm->instruction_count = 0;
+  for (uint32_t id = 0; id < 3; id++) add_const(vm, id, id + 1);
+  orinopp_instruction_t* call = add_call(vm, 3, name, 3);
+  for (uint32_t id = 0; id < 3; id++) set_operand(&call->values[2 + id], ORIONPP_TYPE_VARID, id);
+  add_variables(add_instruction(vm, ORIONPP_OP_ISA_RET, 1), 1, 3, 0, 0);
+}
+
+static void test_natives() {
+  printf("Testing native functions...\n");
+  
+  // Every tier calls the pointer bound at decode time
+  const ValidationLevel levels[] = { OVM_VALIDATE_BASIC, OVM_VALIDATE_STRICT, OVM_VALIDATE_PARANOID };
+  for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+    OrionVM vm;
+    ovm_init(&vm);
+    assert(ovm_register_native(&vm, "mix", native_mix, (VMNativeSignature){ 3, 3, ORIONPP_TYPE_WORD }) == 0);
+    load_native_program(&vm, "mix");
+    ovm_set_validation_level(&vm, levels[i]);
+  
+    assert(ovm_run(&vm) == 0);
+    assert(vm.return_value.value.i64 == 123);
+    if (vm.run_mode != OVM_RUN_STEP) {
+      assert(vm.decoded[3].op == OVM_DOP_NATIVE);
+      assert(vm.decoded[3].native == native_mix);
+    }
+    if (levels[i] == OVM_VALIDATE_BASIC) assert(vm.verified);
+  
+    // Calls stay bound to the pointer they were decoded with, on every tier
+    assert(ovm_register_native(&vm, "mix", native_mix, (VMNativeSignature){ 0, 3, ORIONPP_TYPE_WORD }) == -1);
+    assert(ovm_find_native(&vm, "mix", 3)->signature.min_args == 3);
+  
+    ovm_destroy(&vm);
+  }
+  
+  // print and input are natives too, and can be replaced
+  OrionVM vm;
+  ovm_init(&vm);
+  assert(ovm_find_native(&vm, "print", 5) != NULL);
+  assert(ovm_find_native(&vm, "input", 5) != NULL);
+  assert(ovm_find_native(&vm, "inpu", 4) == NULL);
+  assert(ovm_register_native(&vm, "input", native_mix, (VMNativeSignature){ 3, 3, ORIONPP_TYPE_WORD }) == 0);
+  assert(ovm_find_native(&vm, "input", 5)->function == native_mix);
+  
+  // Many names keep their own entries as the table grows
+  char name[16];
+  for (int n = 0; n < 100; n++) {
+    snprintf(name, sizeof(name), "native%d", n);
+    assert(ovm_register_native(&vm, name, native_mix, (VMNativeSignature){ 0, 0, ORIONPP_TYPE_WORD }) == 0);
+  }
+  for (int n = 0; n < 100; n++) {
+    snprintf(name, sizeof(name), "native%d", n);
+    const VMNative* native = ovm_find_native(&vm, name, strlen(name));
+    assert(native != NULL && strcmp(native->name, name) == 0);
+  }
+  assert(ovm_register_native(&vm, "bad", native_mix, (VMNativeSignature){ 2, 1, ORIONPP_TYPE_WORD }) == -1);
+  ovm_destroy(&vm);
+  
+  // A call with the wrong argument count is left to the executor, which fails it
+  ovm_init(&vm);
+  assert(ovm_register_native(&vm, "mix", native_mix, (VMNativeSignature){ 2, 2, ORIONPP_TYPE_WORD }) == 0);
+  load_native_program(&vm, "mix");
+  assert(ovm_run(&vm) == -1);
+  assert(vm.decoded[3].op == OVM_DOP_GENERIC);
+  ovm_destroy(&vm);
+  
+#ifndef WIN32
+  // C functions bind by name; labs takes and returns a long
+  ovm_init(&vm);
+  assert(ovm_bind_extern(&vm, "labs", 1, 1, NULL) == 0);
+  vm.instruction_count = 0;
+  add_const(&vm, 0, (uint32_t)-42);
+  set_operand(&add_call(&vm, 1, "labs", 1)->values[2], ORIONPP_TYPE_VARID, 0);
+  add_variables(add_instruction(&vm, ORIONPP_OP_ISA_RET, 1), 1, 1, 0, 0);
+  assert(ovm_run(&vm) == 0);
+  assert(vm.return_value.value.i64 == 42);
+  assert(ovm_bind_extern(&vm, "no_such_function", 1, 1, NULL) == -1);
+  ovm_destroy(&vm);
+
+  // srandom returns nothing and random takes nothing; the value random
+  // gives after the program seeds it shows the seed got through
+  srandom(7);
+  long expected = random();
+  srandom(1);
+  ovm_init(&vm);
+  assert(ovm_bind_extern(&vm, "srandom", 1, 0, NULL) == 0);
+  assert(ovm_bind_extern(&vm, "random", 0, 1, NULL) == 0);
+  vm.instruction_count = 0;
+  add_const(&vm, 0, 7);
+  set_operand(&add_call(&vm, 1, "srandom", 1)->values[2], ORIONPP_TYPE_VARID, 0);
+  add_call(&vm, 2, "random", 0);
+  add_variables(add_instruction(&vm, ORIONPP_OP_ISA_RET, 1), 1, 2, 0, 0);
+  assert(ovm_run(&vm) == 0);
+  assert(vm.decoded[1].op == OVM_DOP_NATIVE && vm.decoded[2].op == OVM_DOP_NATIVE);
+  assert(vm.return_value.value.i64 == expected);
+  ovm_destroy(&vm);
+#endif
+  
+  printf("✓ Native functions test passed\n");
+}
+
+static void test_shared_program() {
+  printf("Testing shared program images...\n");
+  
+  OrionVM loader;
+  ovm_init(&loader);
+  load_input_program(&loader);
+  
+  VMProgram* program = ovm_program_create(&loader);
+  assert(program != NULL);
+  assert(loader.program == program);
+  assert(atomic_load(&program->refcount) == 2);
+  assert(program->verified);
+  assert(program->run_mode == OVM_RUN_VERIFIED);
+  
+  // Two contexts borrow the same instructions and decoded stream
+  OrionVM a, b;
+  ovm_init(&a);
+  ovm_init(&b);
+  assert(ovm_attach_program(&a, program) == 0);
+  assert(ovm_attach_program(&b, program) == 0);
+  assert(atomic_load(&program->refcount) == 4);
+  assert(a.instructions == program->instructions && b.decoded == program->decoded);
+  
+  const int64_t seven = 7, eleven = 11, two = 2;
+  ovm_set_inputs(&a, &seven, 1);
+  ovm_set_inputs(&b, &eleven, 1);
+  assert(ovm_run(&a) == 0 && a.return_value.value.i64 == 21);
+  assert(ovm_run(&b) == 0 && b.return_value.value.i64 == 33);
+  
+  // The image outlives the VM that built it
+  ovm_destroy(&loader);
+  assert(atomic_load(&program->refcount) == 3);
+  ovm_reset(&a);
+  ovm_set_inputs(&a, &two, 1);
+  assert(ovm_run(&a) == 0 && a.return_value.value.i64 == 6);
+  
+  // Missing inputs fail the run, not the process
+  ovm_reset(&b);
+  ovm_set_inputs(&b, NULL, 0);
+  assert(ovm_run(&b) == -1);
+  assert(ovm_has_error(&b));
+  
+  // Detaching gives the context its own empty program back
+  assert(ovm_detach_program(&b) == 0);
+  assert(b.program == NULL && b.instruction_count == 0 && b.instructions != NULL);
+  assert(atomic_load(&program->refcount) == 2);
+  
+  // Batch: one job per input on a small pool, job 10 has no input and fails
+  enum { JOB_COUNT = 64 };
+  int64_t values[JOB_COUNT];
+  VMBatchJob jobs[JOB_COUNT];
+  for (size_t i = 0; i < JOB_COUNT; i++) {
+    values[i] = (int64_t)i;
+    jobs[i] = (VMBatchJob){ .inputs = &values[i], .input_count = i == 10 ? 0 : 1 };
+  }
+  
+  VMBatchStats stats;
+  assert(ovm_batch_run(program, jobs, JOB_COUNT, 3, &stats) == 0);
+  assert(stats.threads == 3);
+  assert(stats.completed == JOB_COUNT - 1);
+  assert(stats.failed == 1);
+  for (size_t i = 0; i < JOB_COUNT; i++) {
+    assert(i == 10 ? jobs[i].status == -1 : jobs[i].status == 0 && jobs[i].result == 3 * (int64_t)i);
+  }
+  assert(atomic_load(&program->refcount) == 2);
+  
+  ovm_destroy(&a);
+  ovm_destroy(&b);
+  ovm_program_release(program);
+  printf("✓ Shared program images test passed\n");
+}
+
+static void test_mapped_image() {
+  printf("Testing memory-mapped program images...\n");
+  
+  const char* path = "ovm_test_image.opp";
+  OrionVM writer;
+  ovm_init(&writer);
+  load_input_program(&writer);
+  assert(ovm_write_image(&writer, path) == 0);
+  ovm_destroy(&writer);
+  
+  // Operands are read in place from the mapping, not copied
+  OrionVM vm;
+  ovm_init(&vm);
+  assert(ovm_load_file(&vm, path) == 0);
+  assert(vm.mapped.base != NULL);
+  assert(vm.instruction_count == 6);
+  const char* symbol = vm.instructions[1].values[1].bytes;
+  assert(symbol > (const char*)vm.mapped.base && symbol < (const char*)vm.mapped.base + vm.mapped.size);
+  assert(memcmp(symbol, "input", 5) == 0);
+  assert(vm.run_mode == OVM_RUN_VERIFIED);
+  
+  const int64_t seven = 7;
+  ovm_set_inputs(&vm, &seven, 1);
+  assert(ovm_run(&vm) == 0 && vm.return_value.value.i64 == 21);
+  
+  // A mapped program can back a shared image; the image takes the mapping
+  VMProgram* program = ovm_program_create(&vm);
+  assert(program != NULL && program->mapped.base != NULL && vm.mapped.base == NULL);
+  OrionVM context;
+  ovm_init(&context);
+  assert(ovm_attach_program(&context, program) == 0);
+  ovm_set_inputs(&context, &seven, 1);
+  assert(ovm_run(&context) == 0 && context.return_value.value.i64 == 21);
+  ovm_destroy(&context);
+  ovm_destroy(&vm);
+  ovm_program_release(program);
+  
+  // Handles that cannot be mapped are read whole with a few block reads
+  FILE* file = fopen(path, "rb");
+  char bytes[512];
+  size_t size = fread(bytes, 1, sizeof(bytes), file);
+  fclose(file);
+#ifndef WIN32
+  int fds[2];
+  assert(pipe(fds) == 0);
+  assert(write(fds[1], bytes, size) == (ssize_t)size);
+  close(fds[1]);
+  ovm_init(&vm);
+  assert(ovm_load_from_handle(&vm, fds[0]) == 0);
+  close(fds[0]);
+  assert(vm.mapped.heap && vm.instruction_count == 6);
+  ovm_set_inputs(&vm, &seven, 1);
+  assert(ovm_run(&vm) == 0 && vm.return_value.value.i64 == 21);
+  ovm_destroy(&vm);
+#endif
+  
+  // A newer format version is refused by the header check
+  file = fopen(path, "r+b");
+  assert(file != NULL);
+  fseek(file, 5, SEEK_SET);
+  fputc(0x7f, file);
+  fclose(file);
+  ovm_init(&vm);
+  assert(ovm_load_file(&vm, path) == -1);
+  assert(strstr(ovm_get_error(&vm), "INVALID_VERSION") != NULL);
+  assert(vm.mapped.base == NULL && vm.instruction_count == 0);
+  ovm_destroy(&vm);
+  
+  // Truncated code tables fail cleanly
+  file = fopen(path, "wb");
+  fwrite(bytes, 1, size - 6, file);
+  fclose(file);
+  ovm_init(&vm);
+  assert(ovm_load_file(&vm, path) == -1);
+  assert(vm.mapped.base == NULL);
+  ovm_destroy(&vm);
+  
+  remove(path);
+  printf("✓ Memory-mapped program images test passed\n");
+}
+
+#ifndef WIN32
+typedef struct {
+  ValidationLevel level;
+  int runs;
+  bool ok;
+} VMWorker;
+
+// Each worker owns its VM; the level it sets must not leak into other workers
+static void* run_vm_worker(void* arg) {
+  VMWorker* worker = arg;
+  OrionVM vm;
+  
+  worker->ok = ovm_init(&vm) == 0;
+  if (!worker->ok) return NULL;
+  
+  ovm_set_validation_level(&vm, worker->level);
+  load_counter_program(&vm, 20000);
+  for (int i = 0; i < worker->runs && worker->ok; i++) {
+    ovm_reset(&vm);
+    worker->ok = ovm_run(&vm) == 0 && vm.return_value.value.i64 == 20000 &&
+                 ovm_get_validation_level(&vm) == worker->level;
+  }
+  
+  ovm_destroy(&vm);
+  return NULL;
+}
+
+static double run_vm_workers(VMWorker* workers, size_t count) {
+  pthread_t threads[16];
+  struct timespec start, end;
+  
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (size_t i = 0; i < count; i++) {
+    int created = pthread_create(&threads[i], NULL, run_vm_worker, &workers[i]);
+    if (created != 0) {
+      fprintf(stderr, "pthread_create failed: %s\n", strerror(created));
+      abort();
+    }
+  }
+  for (size_t i = 0; i < count; i++) {
+    pthread_join(threads[i], NULL);
+    assert(workers[i].ok);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  
+  return (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static void test_concurrent_vms() {
+  printf("Testing concurrent VMs...\n");
+  
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t count = cpus < 2 ? 2 : cpus > 16 ? 16 : (size_t)cpus;
+  VMWorker workers[16];
+  
+  // Baseline: one VM doing one unit of work
+  workers[0] = (VMWorker){ .level = OVM_VALIDATE_BASIC, .runs = 50 };
+  double single = run_vm_workers(workers, 1);
+  
+  // N VMs with mixed levels: each run checks its own level stayed put
+  for (size_t i = 0; i < count; i++) {
+    workers[i] = (VMWorker){ .level = (ValidationLevel)(i % 4), .runs = 50 };
+  }
+  run_vm_workers(workers, count);
+  
+  // N VMs at one level, one unit of work each. Shared state would serialize
+  // them, so the speedup over one VM has to grow with the cores; the bound is
+  // loose enough for a busy machine.
+  for (size_t i = 0; i < count; i++) {
+    workers[i] = (VMWorker){ .level = OVM_VALIDATE_BASIC, .runs = 50 };
+  }
+  double uniform = run_vm_workers(workers, count);
+  double speedup = uniform > 0 ? single * (double)count / uniform : (double)count;
+  
+  printf("  1 VM: %.3fs, %zu VMs: %.3fs (speedup %.2f)\n", single, count, uniform, speedup);
+  if (cpus >= 2) {
+    assert(speedup >= (double)count / 4);
+  } else {
+    printf("  one core online, scaling not checked\n");
+  }
+  
+  printf("✓ Concurrent VMs test passed\n");
+}
+#endif
+
 int main() {
   printf("Running Orion++ Virtual Machine Tests\n");
   printf("=====================================\n\n");
@@ -392,6 +1698,19 @@ int main() {
   test_validation();
   test_value_extraction();
   test_simple_program();
+  test_decoded_dispatch();
+  test_superinstructions();
+  test_profile();
+  test_jit();
+  test_validation_tiers();
+  test_unsigned_operations();
+  test_function_calls();
+  test_natives();
+  test_shared_program();
+  test_mapped_image();
+#ifndef WIN32
+  test_concurrent_vms();
+#endif
   test_type_system();
   test_error_handling();
   test_memory_safety();